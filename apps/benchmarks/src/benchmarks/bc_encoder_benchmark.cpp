@@ -0,0 +1,151 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#include "benchmarks/benchmark.h"
+
+#include <core/job_system.h>
+
+#include <asset/image_processing.h>
+
+#include <DirectXTex/DirectXTex.h>
+
+namespace era_engine::benchmarks
+{
+	// Smooth color gradients with some low frequency detail, roughly like an albedo texture. Alpha is not constant, so BC3 and BC7
+	// have something to encode.
+	static void createTestImage(uint32 size, DirectX::ScratchImage& image)
+	{
+		checkResult(image.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, size, size, 1, 1));
+
+		const DirectX::Image& target = *image.GetImage(0, 0, 0);
+		for (uint32 y = 0; y < size; ++y)
+		{
+			uint8* row = target.pixels + y * target.rowPitch;
+			for (uint32 x = 0; x < size; ++x)
+			{
+				float u = (float)x / size;
+				float v = (float)y / size;
+				float detail = 0.5f + 0.5f * sinf(u * 37.f) * cosf(v * 23.f);
+
+				row[x * 4 + 0] = (uint8)(255.f * u);
+				row[x * 4 + 1] = (uint8)(255.f * v);
+				row[x * 4 + 2] = (uint8)(255.f * detail);
+				row[x * 4 + 3] = (uint8)(255.f * (0.5f + 0.5f * sinf((u + v) * 11.f)));
+			}
+		}
+	}
+
+	// Over RGB only, BC1 has no real alpha.
+	static double computePSNR(const DirectX::ScratchImage& source, const DirectX::ScratchImage& compressed)
+	{
+		DirectX::ScratchImage decompressed;
+		checkResult(DirectX::Decompress(*compressed.GetImage(0, 0, 0), DXGI_FORMAT_R8G8B8A8_UNORM, decompressed));
+
+		const DirectX::Image& a = *source.GetImage(0, 0, 0);
+		const DirectX::Image& b = *decompressed.GetImage(0, 0, 0);
+
+		double squaredError = 0.0;
+		for (uint32 y = 0; y < (uint32)a.height; ++y)
+		{
+			const uint8* rowA = a.pixels + y * a.rowPitch;
+			const uint8* rowB = b.pixels + y * b.rowPitch;
+			for (uint32 x = 0; x < (uint32)a.width; ++x)
+			{
+				for (uint32 c = 0; c < 3; ++c)
+				{
+					double d = (double)rowA[x * 4 + c] - (double)rowB[x * 4 + c];
+					squaredError += d * d;
+				}
+			}
+		}
+
+		double mse = squaredError / ((double)a.width * a.height * 3);
+		return (mse > 0.0) ? 10.0 * log10(255.0 * 255.0 / mse) : 100.0;
+	}
+
+	struct EncoderCase
+	{
+		const char* name;
+		DXGI_FORMAT format;
+		image_compression_quality quality;
+	};
+
+	static const EncoderCase encoderCases[] =
+	{
+		{ "BC1 fast", DXGI_FORMAT_BC1_UNORM, image_compression_quality_fast },
+		{ "BC1 normal", DXGI_FORMAT_BC1_UNORM, image_compression_quality_normal },
+		{ "BC3 normal", DXGI_FORMAT_BC3_UNORM, image_compression_quality_normal },
+		{ "BC7 fast", DXGI_FORMAT_BC7_UNORM, image_compression_quality_fast },
+		{ "BC7 normal", DXGI_FORMAT_BC7_UNORM, image_compression_quality_normal },
+		{ "BC7 high", DXGI_FORMAT_BC7_UNORM, image_compression_quality_high },
+	};
+
+	// Returns the throughput in MB of source pixels per second, or a negative value if the encoder failed.
+	static double measureEncoder(const DirectX::ScratchImage& source, const EncoderCase& encoderCase, double& psnr)
+	{
+		DirectX::ScratchImage compressed;
+		bool ok = true;
+
+		double time = measure([&]()
+		{
+			compressed.Release();
+			ok &= compressImageParallel(source, encoderCase.format, encoderCase.quality, compressed);
+		});
+
+		if (!ok)
+		{
+			return -1.0;
+		}
+
+		psnr = computePSNR(source, compressed);
+		return (double)source.GetPixelsSize() / time / (1024.0 * 1024.0);
+	}
+
+	// Throughput of the CPU BC encoders used by texture import, on one core and on the job system. Before the job system is
+	// initialized, parallelFor runs all its jobs on the calling thread.
+	static bool run_bc_encoder_benchmark()
+	{
+		constexpr uint32 size = 1024;
+
+		DirectX::ScratchImage source;
+		createTestImage(size, source);
+
+		const uint32 numCases = (uint32)arraysize(encoderCases);
+		double singleCore[arraysize(encoderCases)];
+		double psnr[arraysize(encoderCases)];
+
+		bool ok = true;
+		for (uint32 i = 0; i < numCases; ++i)
+		{
+			singleCore[i] = measureEncoder(source, encoderCases[i], psnr[i]);
+			ok &= (singleCore[i] > 0.0);
+		}
+
+		static bool jobSystemInitialized = false;
+		if (!jobSystemInitialized)
+		{
+			initialize_job_system();
+			jobSystemInitialized = true;
+		}
+
+		// Workers of the low priority queue plus the calling thread, which helps while waiting.
+		const uint32 numCores = std::thread::hardware_concurrency() + 1;
+
+		printf("  %ux%u RGBA8, %u threads when parallel\n", size, size, numCores);
+		for (uint32 i = 0; i < numCases; ++i)
+		{
+			double unused;
+			double parallel = measureEncoder(source, encoderCases[i], unused);
+			ok &= (parallel > 0.0);
+
+			printf("  %-11s %8.1f MB/s single core, %8.1f MB/s parallel (%6.1f MB/s per core), PSNR %5.2f dB\n",
+				encoderCases[i].name, singleCore[i], parallel, parallel / numCores, psnr[i]);
+
+			// Smooth content, every encoder should get well above this.
+			ok &= (psnr[i] > 30.0);
+		}
+
+		return ok;
+	}
+
+	REGISTER_BENCHMARK("bc_encoder", run_bc_encoder_benchmark);
+}
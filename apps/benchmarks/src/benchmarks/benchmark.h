@@ -0,0 +1,52 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+namespace era_engine::benchmarks
+{
+	// Returns false if one of the benchmark's correctness checks failed.
+	using BenchmarkFunction = bool (*)();
+
+	struct Benchmark
+	{
+		const char* name;
+		BenchmarkFunction function;
+	};
+
+	std::vector<Benchmark>& get_benchmarks();
+
+	struct BenchmarkRegistration
+	{
+		BenchmarkRegistration(const char* name, BenchmarkFunction function)
+		{
+			get_benchmarks().push_back({ name, function });
+		}
+	};
+
+	// Calls func until at least min_seconds have passed. Returns the average time per call in seconds.
+	template <typename Func_>
+	double measure(const Func_& func, double min_seconds = 0.5)
+	{
+		using clock = std::chrono::high_resolution_clock;
+
+		func(); // Warm up.
+
+		uint64 num_iterations = 0;
+		double elapsed = 0.0;
+
+		clock::time_point start = clock::now();
+		while (elapsed < min_seconds)
+		{
+			func();
+			++num_iterations;
+			elapsed = std::chrono::duration<double>(clock::now() - start).count();
+		}
+
+		return elapsed / num_iterations;
+	}
+}
+
+#define REGISTER_BENCHMARK(name, function) static era_engine::benchmarks::BenchmarkRegistration function##_registration(name, function)
@@ -0,0 +1,158 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#include "benchmarks/benchmark.h"
+
+#include <core/block_allocator.h>
+#include <core/random.h>
+
+namespace era_engine::benchmarks
+{
+	struct LiveAllocation
+	{
+		uint64 offset;
+		uint64 size;
+	};
+
+	struct AllocatorTraceResult
+	{
+		uint64 num_operations = 0;
+		uint64 num_failed_allocations = 0;
+
+		// Sampled whenever the heap is at its target occupancy.
+		uint64 num_samples = 0;
+		double fragmentation_sum = 0.0;
+		double max_fragmentation = 0.0;
+		uint32 max_free_blocks = 0;
+
+		bool ok = true;
+	};
+
+	static constexpr uint64 trace_capacity = 256ull * 1024 * 1024;
+	static constexpr uint64 trace_granularity = 256;
+	static constexpr uint32 trace_length = 200000;
+
+	// Resource heap like sizes between 256 B and 4 MB, evenly distributed over the powers of two.
+	static uint64 random_allocation_size(RandomNumberGenerator& rng)
+	{
+		uint32 power = rng.random_uint32_between(0, 14);
+		return rng.random_uint64_between(1ull << power, 2ull << power) * trace_granularity;
+	}
+
+	// Replays a randomized allocate/free trace, which keeps the heap around 70% full. Frees hit random live allocations, so the
+	// free list sees the same kind of fragmentation as a long running resource heap. With verify set, every allocation is checked
+	// for overlap and fragmentation is sampled. The trace only depends on the seed and the allocator's results.
+	static AllocatorTraceResult run_allocator_trace(BlockAllocator& allocator, std::vector<LiveAllocation>& live, bool verify)
+	{
+		RandomNumberGenerator rng = { 9012 };
+		AllocatorTraceResult result;
+
+		allocator.initialize(trace_capacity);
+		live.clear();
+
+		std::map<uint64, uint64> live_ranges;
+		uint64 live_bytes = 0;
+
+		for (uint32 i = 0; i < trace_length; ++i)
+		{
+			// Mostly allocate below the target occupancy, mostly free above it.
+			bool below_target = live_bytes < trace_capacity * 7 / 10;
+			uint32 allocate_chance = below_target ? 3 : 1;
+			if (live.empty() || rng.random_uint32_between(0, 4) < allocate_chance)
+			{
+				uint64 size = random_allocation_size(rng);
+				uint64 offset = allocator.allocate(size);
+				if (offset == UINT64_MAX)
+				{
+					++result.num_failed_allocations;
+				}
+				else
+				{
+					live.push_back({ offset, size });
+					live_bytes += size;
+
+					if (verify)
+					{
+						auto it = live_ranges.lower_bound(offset);
+						bool overlaps_next = it != live_ranges.end() && it->first < offset + size;
+						bool overlaps_prev = it != live_ranges.begin() && std::prev(it)->first + std::prev(it)->second > offset;
+						result.ok &= !overlaps_next && !overlaps_prev && offset + size <= trace_capacity;
+						live_ranges[offset] = size;
+					}
+				}
+			}
+			else
+			{
+				uint32 index = rng.random_uint32_between(0, (uint32)live.size());
+				LiveAllocation allocation = live[index];
+				live[index] = live.back();
+				live.pop_back();
+
+				allocator.free(allocation.offset, allocation.size);
+				live_bytes -= allocation.size;
+
+				if (verify)
+				{
+					live_ranges.erase(allocation.offset);
+				}
+			}
+			++result.num_operations;
+
+			if (verify)
+			{
+				result.ok &= allocator.available_size == trace_capacity - live_bytes;
+
+				if (!below_target)
+				{
+					// Share of the free memory which is not usable for an allocation of its full size.
+					double fragmentation = 1.0 - (double)allocator.get_largest_free_block() / (double)allocator.available_size;
+					result.fragmentation_sum += fragmentation;
+					result.max_fragmentation = max(result.max_fragmentation, fragmentation);
+					++result.num_samples;
+				}
+				result.max_free_blocks = max(result.max_free_blocks, allocator.get_num_free_blocks());
+			}
+		}
+
+		for (const LiveAllocation& allocation : live)
+		{
+			allocator.free(allocation.offset, allocation.size);
+			++result.num_operations;
+		}
+
+		// Everything must have merged back into one block.
+		if (verify)
+		{
+			result.ok &= allocator.available_size == trace_capacity;
+			result.ok &= allocator.get_num_free_blocks() == 1;
+			result.ok &= allocator.get_largest_free_block() == trace_capacity;
+		}
+
+		return result;
+	}
+
+	// Throughput and fragmentation of BlockAllocator on a randomized resource heap trace.
+	static bool run_block_allocator_benchmark()
+	{
+		BlockAllocator allocator;
+		std::vector<LiveAllocation> live;
+		live.reserve(trace_length);
+
+		AllocatorTraceResult verified = run_allocator_trace(allocator, live, true);
+
+		uint64 num_operations = 0;
+		double time = measure([&]()
+		{
+			num_operations = run_allocator_trace(allocator, live, false).num_operations;
+		});
+
+		printf("  %u MB heap, %u trace operations, %llu failed allocations\n",
+			(uint32)(trace_capacity / (1024 * 1024)), trace_length, verified.num_failed_allocations);
+		printf("  %8.1f ns per operation (%.2f M operations/s)\n", time / num_operations * 1e9, num_operations / time / 1e6);
+		printf("  fragmentation at 70%% occupancy: %.3f average, %.3f max, %u free blocks max\n",
+			verified.fragmentation_sum / max(verified.num_samples, 1ull), verified.max_fragmentation, verified.max_free_blocks);
+
+		return verified.ok;
+	}
+
+	REGISTER_BENCHMARK("block_allocator", run_block_allocator_benchmark);
+}
@@ -0,0 +1,108 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#include "benchmarks/benchmark.h"
+
+#include <core/random.h>
+
+#include <ecs/component.h>
+
+namespace era_engine::benchmarks
+{
+	struct BenchmarkPosition
+	{
+		vec3 position;
+	};
+
+	// Same payload as SlimVelocity, but with the Component base (vptr and ref<Entity::EcsData>) in front of it.
+	class ComponentVelocity : public Component
+	{
+	public:
+		ComponentVelocity(ref<Entity::EcsData> _data, const vec3& _velocity) : Component(_data), velocity(_velocity) {}
+
+		vec3 velocity;
+	};
+
+	struct SlimVelocity
+	{
+		vec3 velocity;
+	};
+
+	template <typename Velocity_>
+	static void integrate(entt::registry& registry, float dt)
+	{
+		registry.view<BenchmarkPosition, Velocity_>().each([dt](BenchmarkPosition& position, const Velocity_& velocity)
+		{
+			position.position += velocity.velocity * dt;
+		});
+	}
+
+	static vec3 sum_positions(entt::registry& registry)
+	{
+		vec3 sum(0.f);
+		registry.view<BenchmarkPosition>().each([&sum](const BenchmarkPosition& position) { sum += position.position; });
+		return sum;
+	}
+
+	// Iteration bandwidth of a Component-derived pool against a slim pool with the same payload.
+	static bool run_ecs_iteration_benchmark()
+	{
+		constexpr uint32 num_entities = 1 << 20;
+		constexpr float dt = 1.f / 60.f;
+
+		RandomNumberGenerator rng = { 5678 };
+
+		std::vector<vec3> velocities(num_entities);
+		for (vec3& velocity : velocities)
+		{
+			velocity = rng.random_vec3_between(-1.f, 1.f);
+		}
+
+		entt::registry component_registry;
+		entt::registry slim_registry;
+
+		for (uint32 i = 0; i < num_entities; ++i)
+		{
+			entt::entity entity = component_registry.create();
+			component_registry.emplace<BenchmarkPosition>(entity, vec3(0.f));
+			component_registry.emplace<ComponentVelocity>(entity, nullptr, velocities[i]);
+
+			entity = slim_registry.create();
+			slim_registry.emplace<BenchmarkPosition>(entity, vec3(0.f));
+			slim_registry.emplace<SlimVelocity>(entity, velocities[i]);
+		}
+
+		uint64 num_component_iterations = 0;
+		double component_time = measure([&]()
+		{
+			integrate<ComponentVelocity>(component_registry, dt);
+			++num_component_iterations;
+		});
+
+		uint64 num_slim_iterations = 0;
+		double slim_time = measure([&]()
+		{
+			integrate<SlimVelocity>(slim_registry, dt);
+			++num_slim_iterations;
+		});
+
+		// Both registries integrated the same velocities, so the positions only differ by the iteration counts.
+		vec3 component_sum = sum_positions(component_registry) / (float)num_component_iterations;
+		vec3 slim_sum = sum_positions(slim_registry) / (float)num_slim_iterations;
+		float error = length(component_sum - slim_sum) / max(length(slim_sum), 1.f);
+
+		auto bandwidth = [](double time, uint64 velocity_size)
+		{
+			return (double)num_entities * (2 * sizeof(BenchmarkPosition) + velocity_size) / time / (1024.0 * 1024.0 * 1024.0);
+		};
+
+		printf("  %u entities, velocity pool element %u bytes (component) vs %u bytes (slim)\n",
+			num_entities, (uint32)sizeof(ComponentVelocity), (uint32)sizeof(SlimVelocity));
+		printf("  component: %8.3f ms (%.2f GB/s)\n", component_time * 1000.0, bandwidth(component_time, sizeof(ComponentVelocity)));
+		printf("  slim:      %8.3f ms (%.2f GB/s, %.2fx)\n", slim_time * 1000.0, bandwidth(slim_time, sizeof(SlimVelocity)), component_time / slim_time);
+		printf("  relative position difference: %g\n", error);
+
+		return error < 1e-3f;
+	}
+
+	REGISTER_BENCHMARK("ecs_iteration", run_ecs_iteration_benchmark);
+}
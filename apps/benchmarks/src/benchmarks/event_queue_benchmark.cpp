@@ -0,0 +1,112 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#include "benchmarks/benchmark.h"
+
+#include <core/event_queue.h>
+
+namespace era_engine::benchmarks
+{
+	struct StressEvent
+	{
+		uint32 producer;
+		uint32 sequence;
+	};
+
+	// Small segments, so that segments are retired and recycled all the time.
+	using StressQueue = MPSCEventQueue<StressEvent, 64>;
+
+	// Pushes its sequence numbers in order, alternating between single events and batches of varying size.
+	static void run_stress_producer(StressQueue& queue, uint32 producer, uint32 num_events)
+	{
+		StressEvent batch[100];
+
+		uint32 sequence = 0;
+		while (sequence < num_events)
+		{
+			uint32 batch_size = min(sequence % 100 + 1, num_events - sequence);
+			if (batch_size == 1)
+			{
+				queue.push_event(StressEvent{ producer, sequence++ });
+				continue;
+			}
+
+			for (uint32 i = 0; i < batch_size; ++i)
+			{
+				batch[i] = { producer, sequence++ };
+			}
+			queue.push_events(batch, batch_size);
+		}
+	}
+
+	// Several producers against a consumer which drains continuously. Every event must arrive exactly once, and the events of each
+	// producer in the order they were pushed.
+	static bool run_event_queue_stress()
+	{
+		const uint32 num_producers = max(std::thread::hardware_concurrency() - 1, 2u);
+		constexpr uint32 events_per_producer = 1000000;
+
+		StressQueue queue;
+		std::vector<uint32> next_sequence(num_producers, 0);
+		bool in_order = true;
+
+		auto consume = [&](StressEvent& event)
+		{
+			in_order &= (event.producer < num_producers) && (event.sequence == next_sequence[event.producer]);
+			if (event.producer < num_producers)
+			{
+				next_sequence[event.producer] = event.sequence + 1;
+			}
+		};
+
+		using clock = std::chrono::high_resolution_clock;
+		clock::time_point start = clock::now();
+
+		std::atomic<uint32> num_running = num_producers;
+		std::vector<std::thread> producers;
+		for (uint32 i = 0; i < num_producers; ++i)
+		{
+			producers.emplace_back([&queue, &num_running, i]()
+			{
+				run_stress_producer(queue, i, events_per_producer);
+				--num_running;
+			});
+		}
+
+		uint64 num_processed = 0;
+		uint64 num_passes = 0;
+		while (num_running.load() > 0)
+		{
+			num_processed += queue.process_queue(consume);
+			++num_passes;
+		}
+
+		for (std::thread& producer : producers)
+		{
+			producer.join();
+		}
+
+		// A pass stops at slots which are reserved but not yet written, so drain until nothing is left.
+		while (!queue.empty())
+		{
+			num_processed += queue.process_queue(consume);
+			++num_passes;
+		}
+
+		double time = std::chrono::duration<double>(clock::now() - start).count();
+
+		uint64 num_expected = (uint64)num_producers * events_per_producer;
+		bool complete = num_processed == num_expected;
+		for (uint32 sequence : next_sequence)
+		{
+			complete &= (sequence == events_per_producer);
+		}
+
+		printf("  %u producers, %llu events in %llu passes: %.2f M events/s\n",
+			num_producers, num_processed, num_passes, num_processed / time / 1e6);
+		printf("  %s, %s\n", complete ? "complete" : "EVENTS MISSING", in_order ? "in order per producer" : "OUT OF ORDER");
+
+		return complete && in_order;
+	}
+
+	REGISTER_BENCHMARK("event_queue_stress", run_event_queue_stress);
+}
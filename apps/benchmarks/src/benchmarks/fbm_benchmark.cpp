@@ -0,0 +1,155 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#include "benchmarks/benchmark.h"
+
+#include <core/random.h>
+#include <core/random_simd.h>
+
+namespace era_engine::benchmarks
+{
+	struct FbmSamples
+	{
+		std::vector<float> value;
+		std::vector<float> derivX;
+		std::vector<float> derivY;
+
+		void resize(uint32 count)
+		{
+			value.resize(count);
+			derivX.resize(count);
+			derivY.resize(count);
+		}
+	};
+
+	// Texel positions of a grid, shifted like the terrain generator does so that all inputs are positive. Templated so that the wide
+	// path computes bit identical positions.
+	template <typename float_t>
+	static float_t sample_coordinate(float_t texel)
+	{
+		return texel * 0.37f + 1000.f;
+	}
+
+	static void fbm_scalar(fbm_noise_2D noise_func, uint32 size, uint32 num_octaves, FbmSamples& out)
+	{
+		for (uint32 y = 0; y < size; ++y)
+		{
+			for (uint32 x = 0; x < size; ++x)
+			{
+				vec3 n = fbm(noise_func, vec2(sample_coordinate((float)x), sample_coordinate((float)y)), num_octaves);
+
+				uint32 index = y * size + x;
+				out.value[index] = n.x;
+				out.derivX[index] = n.y;
+				out.derivY[index] = n.z;
+			}
+		}
+	}
+
+	// size must be a multiple of the width.
+	template <typename float_t, uint32 width, typename noise_func_t>
+	static void fbm_wide(noise_func_t noise_func, uint32 size, uint32 num_octaves, FbmSamples& out)
+	{
+		static const float laneIndices[] = { 0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f };
+		static_assert(width <= arraysize(laneIndices));
+
+		float_t lanes(laneIndices);
+
+		for (uint32 y = 0; y < size; ++y)
+		{
+			float_t positionY = sample_coordinate(float_t((float)y));
+			for (uint32 x = 0; x < size; x += width)
+			{
+				float_t positionX = sample_coordinate(float_t((float)x) + lanes);
+				wN_vec3<float_t> n = fbm(noise_func, wN_vec2<float_t>(positionX, positionY), num_octaves);
+
+				uint32 index = y * size + x;
+				n.x.store(out.value.data() + index);
+				n.y.store(out.derivX.data() + index);
+				n.z.store(out.derivY.data() + index);
+			}
+		}
+	}
+
+	// Largest difference to the scalar reference. The derivatives grow with the lacunarity per octave, so they are compared relative
+	// to their magnitude.
+	static float max_fbm_error(const FbmSamples& reference, const FbmSamples& samples)
+	{
+		float error = 0.f;
+		for (uint32 i = 0; i < (uint32)reference.value.size(); ++i)
+		{
+			error = max(error, abs(reference.value[i] - samples.value[i]));
+			error = max(error, abs(reference.derivX[i] - samples.derivX[i]) / max(abs(reference.derivX[i]), 1.f));
+			error = max(error, abs(reference.derivY[i] - samples.derivY[i]) / max(abs(reference.derivY[i]), 1.f));
+		}
+		return error;
+	}
+
+	struct FbmCase
+	{
+		const char* name;
+		fbm_noise_2D scalar;
+		w4_fbm_noise_2D w4;
+#if defined(SIMD_AVX_2)
+		w8_fbm_noise_2D w8;
+#endif
+	};
+
+	// Single core throughput of the scalar fBm against the wide versions used by CPU terrain generation.
+	static bool run_fbm_benchmark()
+	{
+		constexpr uint32 size = 256;
+		constexpr uint32 num_samples = size * size;
+
+		const FbmCase cases[] =
+		{
+#if defined(SIMD_AVX_2)
+			{ "value", value_noise, value_noise, value_noise },
+			{ "gradient", gradient_noise, gradient_noise, gradient_noise },
+#else
+			{ "value", value_noise, value_noise },
+			{ "gradient", gradient_noise, gradient_noise },
+#endif
+		};
+
+		// 6 is the default and what the terrain heightmap uses, 15 is the octave count of the terrain normal map.
+		const uint32 octave_counts[] = { 6, 15 };
+
+		FbmSamples reference;
+		FbmSamples samples;
+		reference.resize(num_samples);
+		samples.resize(num_samples);
+
+		auto throughput = [](double time) { return num_samples / time / 1e6; };
+
+		bool ok = true;
+
+		printf("  %ux%u samples, single core\n", size, size);
+		for (const FbmCase& fbmCase : cases)
+		{
+			for (uint32 num_octaves : octave_counts)
+			{
+				double scalar_time = measure([&]() { fbm_scalar(fbmCase.scalar, size, num_octaves, reference); });
+
+				double w4_time = measure([&]() { fbm_wide<w4_float, 4>(fbmCase.w4, size, num_octaves, samples); });
+				float w4_error = max_fbm_error(reference, samples);
+				ok &= (w4_error < 1e-3f);
+
+				printf("  %-8s %2u octaves: scalar %7.2f M/s, w4 %7.2f M/s (%.2fx, max error %g)",
+					fbmCase.name, num_octaves, throughput(scalar_time), throughput(w4_time), scalar_time / w4_time, w4_error);
+
+#if defined(SIMD_AVX_2)
+				double w8_time = measure([&]() { fbm_wide<w8_float, 8>(fbmCase.w8, size, num_octaves, samples); });
+				float w8_error = max_fbm_error(reference, samples);
+				ok &= (w8_error < 1e-3f);
+
+				printf(", w8 %7.2f M/s (%.2fx, max error %g)", throughput(w8_time), scalar_time / w8_time, w8_error);
+#endif
+				printf("\n");
+			}
+		}
+
+		return ok;
+	}
+
+	REGISTER_BENCHMARK("fbm", run_fbm_benchmark);
+}
@@ -0,0 +1,55 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#include "benchmarks/benchmark.h"
+
+#include <cstring>
+
+namespace era_engine::benchmarks
+{
+	std::vector<Benchmark>& get_benchmarks()
+	{
+		static std::vector<Benchmark> benchmarks;
+		return benchmarks;
+	}
+
+	static bool is_selected(const char* name, int argc, char** argv)
+	{
+		if (argc <= 1)
+		{
+			return true;
+		}
+
+		for (int i = 1; i < argc; ++i)
+		{
+			if (strcmp(argv[i], name) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+// Usage: benchmarks [name...]. Runs all benchmarks if no name is given. Fails if any check inside a benchmark fails.
+int main(int argc, char** argv)
+{
+	using namespace era_engine::benchmarks;
+
+	bool success = true;
+	for (const Benchmark& benchmark : get_benchmarks())
+	{
+		if (!is_selected(benchmark.name, argc, argv))
+		{
+			continue;
+		}
+
+		printf("%s\n", benchmark.name);
+
+		bool result = benchmark.function();
+		printf("  %s\n\n", result ? "OK" : "FAILED");
+
+		success &= result;
+	}
+
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
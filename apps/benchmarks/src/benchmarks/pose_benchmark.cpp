@@ -0,0 +1,201 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#include "benchmarks/benchmark.h"
+
+#include <core/memory.h>
+#include <core/random.h>
+
+#include <animation/animation.h>
+#include <animation/pose_simd.h>
+
+namespace era_engine::benchmarks
+{
+	// Scalar local-to-skinning-matrix path against SkinningBatch, which runs instances of the same skeleton through the SIMD kernels.
+	static bool run_pose_benchmark()
+	{
+		constexpr uint32 num_joints = 100;
+		constexpr uint32 num_instances = 1000;
+		constexpr uint32 num_transforms = num_joints * num_instances;
+
+		RandomNumberGenerator rng = { 1234 };
+
+		animation::AnimationSkeleton skeleton;
+		skeleton.joints.resize(num_joints);
+		for (uint32 i = 0; i < num_joints; ++i)
+		{
+			animation::SkeletonJoint& joint = skeleton.joints[i];
+			joint.parent_id = (i == 0) ? INVALID_JOINT : rng.random_uint32_between(0, i - 1);
+
+			joint.inv_bind_transform = mat4::identity;
+			joint.inv_bind_transform.m03 = rng.random_float_between(-1.f, 1.f);
+			joint.inv_bind_transform.m13 = rng.random_float_between(-1.f, 1.f);
+			joint.inv_bind_transform.m23 = rng.random_float_between(-1.f, 1.f);
+		}
+
+		std::vector<trs> local_transforms(num_transforms);
+		for (trs& transform : local_transforms)
+		{
+			transform = trs(rng.random_vec3_between(-1.f, 1.f), rng.randomRotation(), vec3(rng.random_float_between(0.9f, 1.1f)));
+		}
+
+		std::vector<trs> scalar_global_transforms(num_transforms);
+		std::vector<mat4> scalar_skinning_matrices(num_transforms);
+
+		double scalar_time = measure([&]()
+		{
+			for (uint32 i = 0; i < num_instances; ++i)
+			{
+				uint32 offset = i * num_joints;
+				skeleton.getSkinningMatricesFromLocalTransforms(&local_transforms[offset], &scalar_global_transforms[offset], &scalar_skinning_matrices[offset]);
+			}
+		});
+
+		std::vector<trs> batched_global_transforms(num_transforms);
+		std::vector<mat4> batched_skinning_matrices(num_transforms);
+
+		Allocator arena;
+		arena.initialize(0, MB(64));
+
+		double batched_time = measure([&]()
+		{
+			ScopedAllocator scope(arena);
+
+			animation::SkinningBatch batch(arena, num_instances);
+			for (uint32 i = 0; i < num_instances; ++i)
+			{
+				uint32 offset = i * num_joints;
+				batch.push(&skeleton, &local_transforms[offset], &batched_global_transforms[offset], &batched_skinning_matrices[offset]);
+			}
+			batch.flush();
+		});
+
+		float max_error = 0.f;
+		for (uint32 i = 0; i < num_transforms; ++i)
+		{
+			const float* a = scalar_skinning_matrices[i].m;
+			const float* b = batched_skinning_matrices[i].m;
+			for (uint32 j = 0; j < 16; ++j)
+			{
+				max_error = max(max_error, fabsf(a[j] - b[j]));
+			}
+		}
+
+		printf("  %u instances of a %u joint skeleton\n", num_instances, num_joints);
+		printf("  scalar:  %8.3f ms\n", scalar_time * 1000.0);
+		printf("  batched: %8.3f ms (%.2fx)\n", batched_time * 1000.0, scalar_time / batched_time);
+		printf("  max skinning matrix difference: %g\n", max_error);
+
+		return max_error < 1e-3f;
+	}
+
+	static float max_transform_difference(const std::vector<trs>& a, const std::vector<trs>& b)
+	{
+		float error = 0.f;
+		for (uint32 i = 0; i < (uint32)a.size(); ++i)
+		{
+			error = max(error, length(a[i].rotation.v4 - b[i].rotation.v4));
+			error = max(error, length(a[i].position - b[i].position));
+			error = max(error, length(a[i].scale - b[i].scale));
+		}
+		return error;
+	}
+
+	// Scalar lerp of two local poses against AnimationSkeleton::blendLocalTransforms (joints in the SIMD lanes) and blendSoaPoses
+	// (instances in the SIMD lanes).
+	static bool run_pose_blend_benchmark()
+	{
+		constexpr uint32 num_joints = 100;
+		constexpr uint32 num_instances = 1000;
+		constexpr uint32 num_transforms = num_joints * num_instances;
+		constexpr float t = 0.3f;
+
+		RandomNumberGenerator rng = { 4321 };
+
+		animation::AnimationSkeleton skeleton;
+		skeleton.joints.resize(num_joints);
+
+		std::vector<trs> from(num_transforms);
+		std::vector<trs> to(num_transforms);
+		for (uint32 i = 0; i < num_transforms; ++i)
+		{
+			from[i] = trs(rng.random_vec3_between(-1.f, 1.f), rng.randomRotation(), vec3(rng.random_float_between(0.9f, 1.1f)));
+
+			// Nearby rotations like consecutive keyframes, so the blend never goes the long way around.
+			quat offset = rng.randomRotation(0.4f);
+			to[i] = trs(from[i].position + rng.random_vec3_between(-0.1f, 0.1f), normalize(offset * from[i].rotation), from[i].scale);
+		}
+
+		std::vector<trs> scalar_blended(num_transforms);
+		double scalar_time = measure([&]()
+		{
+			for (uint32 i = 0; i < num_transforms; ++i)
+			{
+				scalar_blended[i] = lerp(from[i], to[i], t);
+			}
+		});
+
+		std::vector<trs> skeleton_blended(num_transforms);
+		double skeleton_time = measure([&]()
+		{
+			for (uint32 i = 0; i < num_instances; ++i)
+			{
+				uint32 offset = i * num_joints;
+				skeleton.blendLocalTransforms(&from[offset], &to[offset], t, &skeleton_blended[offset]);
+			}
+		});
+
+		float skeleton_error = max_transform_difference(scalar_blended, skeleton_blended);
+
+		printf("  %u instances of a %u joint skeleton\n", num_instances, num_joints);
+		printf("  scalar:                %8.3f ms\n", scalar_time * 1000.0);
+		printf("  blendLocalTransforms:  %8.3f ms (%.2fx, max difference %g)\n", skeleton_time * 1000.0, scalar_time / skeleton_time, skeleton_error);
+
+		bool ok = skeleton_error < 1e-4f;
+
+#if defined(SIMD_AVX_2)
+		std::vector<trs> batched_blended(num_transforms);
+
+		Allocator arena;
+		arena.initialize(0, MB(64));
+
+		double batched_time = measure([&]()
+		{
+			ScopedAllocator scope(arena);
+
+			animation::SoaPose pose_from = animation::allocateSoaPose(arena, num_joints);
+			animation::SoaPose pose_to = animation::allocateSoaPose(arena, num_joints);
+
+			for (uint32 first = 0; first < num_instances; first += POSE_BATCH_SIZE)
+			{
+				uint32 count = min(num_instances - first, (uint32)POSE_BATCH_SIZE);
+
+				const trs* lanes_from[POSE_BATCH_SIZE];
+				const trs* lanes_to[POSE_BATCH_SIZE];
+				trs* lanes_out[POSE_BATCH_SIZE];
+				for (uint32 i = 0; i < count; ++i)
+				{
+					uint32 offset = (first + i) * num_joints;
+					lanes_from[i] = &from[offset];
+					lanes_to[i] = &to[offset];
+					lanes_out[i] = &batched_blended[offset];
+				}
+
+				animation::loadSoaPose(lanes_from, count, pose_from);
+				animation::loadSoaPose(lanes_to, count, pose_to);
+				animation::blendSoaPoses(pose_from, pose_to, t, pose_from);
+				animation::storeSoaPose(pose_from, lanes_out, count);
+			}
+		});
+
+		float batched_error = max_transform_difference(scalar_blended, batched_blended);
+		printf("  blendSoaPoses batched: %8.3f ms (%.2fx, max difference %g)\n", batched_time * 1000.0, scalar_time / batched_time, batched_error);
+
+		ok &= batched_error < 1e-4f;
+#endif
+
+		return ok;
+	}
+
+	REGISTER_BENCHMARK("pose", run_pose_benchmark);
+	REGISTER_BENCHMARK("pose_blend", run_pose_blend_benchmark);
+}
@@ -0,0 +1,306 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#include "benchmarks/benchmark.h"
+
+#include <core/random.h>
+
+#include <terrain/terrain.h>
+
+#include "terrain_rs.hlsli"
+
+namespace era_engine::benchmarks
+{
+	static constexpr uint32 num_cells_per_dim = TERRAIN_LOD_0_VERTICES_PER_DIMENSION - 1;
+	static constexpr uint32 height_stride = TERRAIN_LOD_0_VERTICES_PER_DIMENSION;
+
+	// Fills the chunks with an fBm heightfield. Heights are sampled at global vertex coordinates, so the shared border vertices of
+	// neighboring chunks match like in generated terrain.
+	static void fill_terrain_heights(TerrainComponent& terrain)
+	{
+		for (uint32 cz = 0; cz < terrain.chunksPerDim; ++cz)
+		{
+			for (uint32 cx = 0; cx < terrain.chunksPerDim; ++cx)
+			{
+				terrain_chunk& chunk = terrain.chunk(cx, cz);
+				chunk.heights.resize(height_stride * height_stride);
+
+				for (uint32 z = 0; z < height_stride; ++z)
+				{
+					for (uint32 x = 0; x < height_stride; ++x)
+					{
+						vec2 position((float)(cx * num_cells_per_dim + x), (float)(cz * num_cells_per_dim + z));
+						float n = fbm(value_noise, position * 0.02f + vec2(1000.f, 1000.f)).x;
+						chunk.heights[z * height_stride + x] = (uint16)(clamp(n * 0.5f + 0.5f, 0.f, 1.f) * UINT16_MAX);
+					}
+				}
+
+				TerrainComponent::build_height_bounds(chunk);
+			}
+		}
+	}
+
+	// Closest hit of the ray with any LOD 0 triangle of the terrain, without the cell lookup or the height bounds of the queries.
+	// The triangle vertices are computed like the terrain computes them, so hits on the same triangle agree exactly.
+	static bool raycast_brute_force(const TerrainComponent& terrain, vec3 position_offset, const ray& r, float max_distance,
+		float& out_distance, vec3& out_normal)
+	{
+		const vec3 min_corner = terrain.get_min_corner(position_offset);
+		const float cell_size = terrain.chunkSize / num_cells_per_dim;
+		const float height_scale = terrain.amplitudeScale / UINT16_MAX;
+
+		float distance = max_distance;
+		bool hit = false;
+
+		for (uint32 cz = 0; cz < terrain.chunksPerDim; ++cz)
+		{
+			for (uint32 cx = 0; cx < terrain.chunksPerDim; ++cx)
+			{
+				const terrain_chunk& chunk = terrain.chunk(cx, cz);
+				vec3 chunk_min_corner = min_corner + vec3(cx * terrain.chunkSize, 0.f, cz * terrain.chunkSize);
+
+				for (uint32 z = 0; z < num_cells_per_dim; ++z)
+				{
+					for (uint32 x = 0; x < num_cells_per_dim; ++x)
+					{
+						const uint16* h = chunk.heights.data() + z * height_stride + x;
+						vec3 p00 = chunk_min_corner + vec3(x * cell_size, h[0] * height_scale, z * cell_size);
+						vec3 p10 = chunk_min_corner + vec3((x + 1) * cell_size, h[1] * height_scale, z * cell_size);
+						vec3 p01 = chunk_min_corner + vec3(x * cell_size, h[height_stride] * height_scale, (z + 1) * cell_size);
+						vec3 p11 = chunk_min_corner + vec3((x + 1) * cell_size, h[height_stride + 1] * height_scale, (z + 1) * cell_size);
+
+						const vec3 triangles[2][3] = { { p00, p01, p10 }, { p10, p01, p11 } };
+						for (const auto& tri : triangles)
+						{
+							float t;
+							bool front_facing;
+							if (r.intersectTriangle(tri[0], tri[1], tri[2], t, front_facing) && t < distance)
+							{
+								distance = t;
+								out_normal = normalize(cross(tri[1] - tri[0], tri[2] - tri[0]));
+								hit = true;
+							}
+						}
+					}
+				}
+			}
+		}
+
+		out_distance = distance;
+		return hit;
+	}
+
+	// Height and normal of the surface under the position, sampled by dropping a ray onto every triangle. Positions outside of the
+	// terrain are clamped to its border, like the queries do. The border is pulled in by a tiny fraction of a cell, because a ray
+	// exactly on the outer edge of a triangle may miss it.
+	static bool sample_brute_force(const TerrainComponent& terrain, vec3 position_offset, vec2 position, float& out_height, vec3& out_normal)
+	{
+		const vec3 min_corner = terrain.get_min_corner(position_offset);
+		const float extent = terrain.chunkSize * terrain.chunksPerDim;
+		const float inset = 1e-4f * terrain.chunkSize / num_cells_per_dim;
+
+		position.x = clamp(position.x, min_corner.x + inset, min_corner.x + extent - inset);
+		position.y = clamp(position.y, min_corner.z + inset, min_corner.z + extent - inset);
+
+		const float top = min_corner.y + terrain.amplitudeScale + 1.f;
+
+		ray r;
+		r.origin = vec3(position.x, top, position.y);
+		r.direction = vec3(0.f, -1.f, 0.f);
+
+		float distance;
+		if (!raycast_brute_force(terrain, position_offset, r, FLT_MAX, distance, out_normal))
+		{
+			return false;
+		}
+
+		out_height = top - distance;
+		return true;
+	}
+
+	// Height, normal and raycast queries of TerrainComponent against brute-force sampling of all LOD 0 triangles, and their cost.
+	static bool run_terrain_queries_check()
+	{
+		constexpr uint32 chunks_per_dim = 2;
+		constexpr float chunk_size = 64.f;
+		constexpr float amplitude_scale = 40.f;
+
+		constexpr uint32 num_checked_samples = 512;
+		constexpr uint32 num_checked_rays = 256;
+		constexpr uint32 num_timed_queries = 65536;
+
+		const float max_height_error = 1e-3f;
+		const float max_normal_error = 1e-4f;
+		const float max_distance_error = 1e-3f;
+
+		const vec3 position_offset(10.f, -5.f, 20.f);
+
+		TerrainComponent terrain(nullptr, chunks_per_dim, chunk_size, amplitude_scale, nullptr, nullptr, nullptr);
+		fill_terrain_heights(terrain);
+
+		const vec3 min_corner = terrain.get_min_corner(position_offset);
+		const float extent = chunk_size * chunks_per_dim;
+
+		RandomNumberGenerator rng = { 3456 };
+
+		// Mostly inside of the terrain, some slightly outside to check the clamping.
+		auto random_position = [&]()
+		{
+			return vec2(min_corner.x, min_corner.z) + rng.random_vec2_between(-0.05f * extent, 1.05f * extent);
+		};
+
+		bool ok = true;
+
+		// Heights and normals.
+		std::vector<vec2> positions(num_checked_samples);
+		for (vec2& position : positions)
+		{
+			position = random_position();
+		}
+
+		std::vector<float> heights(num_checked_samples);
+		terrain.get_heights(position_offset, positions.data(), heights.data(), num_checked_samples);
+
+		float height_error = 0.f;
+		float wide_height_error = 0.f;
+		float normal_error = 0.f;
+		uint32 num_missed_samples = 0;
+
+		for (uint32 i = 0; i < num_checked_samples; ++i)
+		{
+			float reference_height;
+			vec3 reference_normal;
+			if (!sample_brute_force(terrain, position_offset, positions[i], reference_height, reference_normal))
+			{
+				++num_missed_samples;
+				continue;
+			}
+
+			height_error = max(height_error, abs(terrain.get_height(position_offset, positions[i]) - reference_height));
+			wide_height_error = max(wide_height_error, abs(heights[i] - reference_height));
+			normal_error = max(normal_error, length(terrain.get_normal(position_offset, positions[i]) - reference_normal));
+		}
+
+		ok &= num_missed_samples == 0;
+		ok &= height_error <= max_height_error;
+		ok &= wide_height_error <= max_height_error;
+		ok &= normal_error <= max_normal_error;
+
+		// Raycasts from above, at grazing to steep angles, some of which leave the terrain without a hit.
+		std::vector<ray> rays(num_checked_rays);
+		for (ray& r : rays)
+		{
+			vec2 origin = random_position();
+			r.origin = vec3(origin.x, min_corner.y + amplitude_scale + rng.random_float_between(1.f, 20.f), origin.y);
+
+			vec2 horizontal = rng.random_vec2_between(-1.f, 1.f);
+			r.direction = normalize(vec3(horizontal.x, -rng.random_float_between(0.05f, 1.f), horizontal.y));
+		}
+
+		const float max_ray_distance = 2.f * extent;
+
+		float distance_error = 0.f;
+		float ray_normal_error = 0.f;
+		uint32 num_hits = 0;
+		uint32 num_hit_mismatches = 0;
+
+		double brute_force_time = measure([&]()
+		{
+			for (const ray& r : rays)
+			{
+				float distance;
+				vec3 normal;
+				raycast_brute_force(terrain, position_offset, r, max_ray_distance, distance, normal);
+			}
+		}, 0.0) / num_checked_rays;
+
+		for (const ray& r : rays)
+		{
+			float reference_distance;
+			vec3 reference_normal;
+			bool reference_hit = raycast_brute_force(terrain, position_offset, r, max_ray_distance, reference_distance, reference_normal);
+
+			float distance;
+			vec3 normal;
+			bool hit = terrain.raycast(position_offset, r, max_ray_distance, distance, &normal);
+
+			if (hit != reference_hit)
+			{
+				++num_hit_mismatches;
+				continue;
+			}
+
+			if (hit)
+			{
+				distance_error = max(distance_error, abs(distance - reference_distance));
+				ray_normal_error = max(ray_normal_error, length(normal - reference_normal));
+				++num_hits;
+			}
+		}
+
+		ok &= num_hit_mismatches == 0;
+		ok &= distance_error <= max_distance_error;
+		ok &= ray_normal_error <= max_normal_error;
+
+		// Cost of the queries.
+		std::vector<vec2> timed_positions(num_timed_queries);
+		for (vec2& position : timed_positions)
+		{
+			position = random_position();
+		}
+		std::vector<float> timed_heights(num_timed_queries);
+
+		float sink = 0.f;
+
+		double height_time = measure([&]()
+		{
+			for (uint32 i = 0; i < num_timed_queries; ++i)
+			{
+				timed_heights[i] = terrain.get_height(position_offset, timed_positions[i]);
+			}
+		}) / num_timed_queries;
+
+		double heights_time = measure([&]()
+		{
+			terrain.get_heights(position_offset, timed_positions.data(), timed_heights.data(), num_timed_queries);
+		}) / num_timed_queries;
+
+		double normal_time = measure([&]()
+		{
+			for (uint32 i = 0; i < num_timed_queries; ++i)
+			{
+				sink += terrain.get_normal(position_offset, timed_positions[i]).y;
+			}
+		}) / num_timed_queries;
+
+		double raycast_time = measure([&]()
+		{
+			for (const ray& r : rays)
+			{
+				float distance;
+				if (terrain.raycast(position_offset, r, max_ray_distance, distance))
+				{
+					sink += distance;
+				}
+			}
+		}) / num_checked_rays;
+
+		printf("  %ux%u chunks of %ux%u cells\n", chunks_per_dim, chunks_per_dim, num_cells_per_dim, num_cells_per_dim);
+		printf("  get_height:  %7.1f ns, max error %g (bound %g)\n", height_time * 1e9, height_error, max_height_error);
+		printf("  get_heights: %7.1f ns, max error %g (bound %g)\n", heights_time * 1e9, wide_height_error, max_height_error);
+		printf("  get_normal:  %7.1f ns, max error %g (bound %g)\n", normal_time * 1e9, normal_error, max_normal_error);
+		printf("  %u samples, %u without a brute-force hit\n", num_checked_samples, num_missed_samples);
+		printf("  raycast:     %7.1f us, brute force %7.1f us (%.0fx)\n", raycast_time * 1e6, brute_force_time * 1e6, brute_force_time / raycast_time);
+		printf("  %u rays, %u hits, %u hit/miss mismatches, max distance error %g (bound %g), max normal error %g (bound %g)\n",
+			num_checked_rays, num_hits, num_hit_mismatches, distance_error, max_distance_error, ray_normal_error, max_normal_error);
+
+		// Keeps the timed loops from being optimized away.
+		if (sink == -1.f)
+		{
+			printf("  %g\n", sink);
+		}
+
+		return ok;
+	}
+
+	REGISTER_BENCHMARK("terrain_queries", run_terrain_queries_check);
+}
@@ -0,0 +1,96 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#include "benchmarks/benchmark.h"
+
+#include <core/random.h>
+
+#include <geometry/vertex_compression.h>
+
+namespace era_engine::benchmarks
+{
+	// Round trips of the compressed vertex formats against their error bounds.
+	static bool run_vertex_compression_check()
+	{
+		constexpr uint32 num_samples = 100000;
+
+		RandomNumberGenerator rng = { 5678 };
+		bool success = true;
+
+		// Octahedral normals with 16 bit SNORM components. The worst case is about 6.5e-5 radians. For these small angles the chord
+		// length is the angle, and it is less sensitive to float rounding than acos of the dot product.
+		const float max_normal_error = 1e-4f;
+
+		float normal_error = 0.f;
+		for (uint32 i = 0; i < num_samples; ++i)
+		{
+			vec3 v = rng.random_point_on_unit_sphere();
+			normal_error = max(normal_error, length(decompressUnitVector(compressUnitVector(v)) - v));
+		}
+
+		// Directions on the folds of the octahedron.
+		const vec3 edge_cases[] = { vec3(1.f, 0.f, 0.f), vec3(-1.f, 0.f, 0.f), vec3(0.f, 1.f, 0.f), vec3(0.f, -1.f, 0.f), vec3(0.f, 0.f, 1.f), vec3(0.f, 0.f, -1.f),
+			normalize(vec3(1.f, 1.f, 0.f)), normalize(vec3(-1.f, 1.f, 0.f)), normalize(vec3(1.f, -1.f, -1.f)), normalize(vec3(-1.f, -1.f, -1.f)) };
+		for (vec3 v : edge_cases)
+		{
+			normal_error = max(normal_error, length(decompressUnitVector(compressUnitVector(v)) - v));
+		}
+
+		printf("  octahedral normals: max error %g rad (bound %g)\n", normal_error, max_normal_error);
+		success &= normal_error <= max_normal_error;
+
+		// Half UVs keep 10 mantissa bits, so the error relative to the UV is at most 2^-10. Below 2^-14 halfs are denormal and the
+		// error is absolute.
+		const float max_uv_relative_error = 1.f / 1024.f;
+
+		float uv_error = 0.f;
+		for (uint32 i = 0; i < num_samples; ++i)
+		{
+			vec2 uv = rng.random_vec2_between(-8.f, 8.f);
+			vec2 decoded = decompressUV(compressUV(uv));
+
+			uv_error = max(uv_error, abs(decoded.x - uv.x) / max(abs(uv.x), 1.f / 16384.f));
+			uv_error = max(uv_error, abs(decoded.y - uv.y) / max(abs(uv.y), 1.f / 16384.f));
+		}
+
+		printf("  half UVs: max relative error %g (bound %g)\n", uv_error, max_uv_relative_error);
+		success &= uv_error <= max_uv_relative_error;
+
+		// Quantized positions are off by at most half a step of 1/65535 of the box extent per axis. The y axis is degenerate and must
+		// come back exactly.
+		bounding_box box = bounding_box::fromMinMax(vec3(-3.f, 0.5f, -100.f), vec3(7.f, 0.5f, 250.f));
+		vec3 extent = box.maxCorner - box.minCorner;
+		mat4 dequantization = getPositionDequantizationMatrix(box);
+
+		float position_error = 0.f; // In quantization steps.
+		float matrix_error = 0.f;
+		bool degenerate_axis_exact = true;
+		for (uint32 i = 0; i < num_samples; ++i)
+		{
+			vec3 position = box.minCorner + vec3(rng.random_float01(), rng.random_float01(), rng.random_float01()) * extent;
+
+			quantized_position quantized = quantizePosition(position, box);
+			vec3 decoded = dequantizePosition(quantized, box);
+
+			position_error = max(position_error, abs(decoded.x - position.x) / extent.x * 65535.f);
+			position_error = max(position_error, abs(decoded.z - position.z) / extent.z * 65535.f);
+			degenerate_axis_exact &= (decoded.y == position.y);
+
+			// What the vertex shader computes from the UNORM fetch.
+			vec4 unorm = vec4(quantized.x / 65535.f, quantized.y / 65535.f, quantized.z / 65535.f, 1.f);
+			vec4 transformed = dequantization * unorm;
+			matrix_error = max(matrix_error, length(transformed.xyz - decoded));
+		}
+
+		// Float rounding of the box extent adds a little on top of the half step.
+		const float max_position_error = 0.51f;
+		const float max_matrix_error = 1e-3f;
+
+		printf("  quantized positions: max error %g steps (bound %g), degenerate axis %s\n", position_error, max_position_error, degenerate_axis_exact ? "exact" : "NOT exact");
+		printf("  dequantization matrix: max difference %g (bound %g)\n", matrix_error, max_matrix_error);
+		success &= position_error <= max_position_error && degenerate_axis_exact && matrix_error <= max_matrix_error;
+
+		return success;
+	}
+
+	REGISTER_BENCHMARK("vertex_compression", run_vertex_compression_check);
+}
@@ -1,7 +1,8 @@
 set(CMAKE_CXX_STANDARD 20)
 set(CMAKE_MODULE_PATH ${CMAKE_CURRENT_SOURCE_DIR}/cmake)
 
-set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} /MP /arch:AVX2 /Zi /Gy /GF /EHsc")
+# /GT: jobs run on fibers and may resume on another thread after a wait, so thread locals must not be cached across calls.
+set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} /MP /arch:AVX2 /Zi /Gy /GF /EHsc /GT")
 
 set(ENGINE_DEFAULT_LIBS
 d3d12.lib
@@ -32,6 +33,7 @@ function(default_linkage name)
         _CRT_SECURE_NO_WARNINGS
         ENABLE_CPU_PROFILING=1
         ENABLE_MESSAGE_LOG=1
+        ENABLE_MEMORY_TRACKING=1
         ENGINE_PATH=L"${ERA_ENGINE_PATH}"
         SHADER_BIN_DIR=L"${ERA_ENGINE_PATH}/modules/shaders/bin/Release/"
         USE_NETCORE
@@ -109,6 +111,7 @@ function(era_begin name target_type)
     endif()
 
     add_definitions(/FI"${ERA_ENGINE_PATH}/resources/common/era_common.h")
+    include_directories(${ERA_ENGINE_PATH}/resources/common)
 endfunction()
 
 function(require_module target module)
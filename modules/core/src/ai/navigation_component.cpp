@@ -40,6 +40,8 @@ namespace era_engine::ai
 	RTTR_REGISTRATION
 	{
 		using namespace rttr;
+		impl::ensure_component_type_registered<NavigationComponent>();
+
 		rttr::registration::class_<NavigationComponent>("NavigationComponent")
 			.constructor<>()
 			.constructor<ref<Entity::EcsData>, NavigationComponent::NavType>()
@@ -2,6 +2,7 @@
 
 #include "animation/animation.h"
 #include "animation/skinning.h"
+#include "animation/pose_simd.h"
 
 #include "core/memory.h"
 #include "core/random.h"
@@ -231,6 +232,55 @@ namespace era_engine::animation
 		}
 
 #endif
+
+		computeJointLods();
+	}
+
+	void AnimationSkeleton::computeJointLods()
+	{
+		uint32 numJoints = (uint32)joints.size();
+		joint_lods.assign(numJoints, 0);
+
+		// Limbs sampled at each joint LOD. Hands and feet drop out at the coarsest one, fingers, toes and
+		// all other unclassified leaf joints (face, twist bones etc.) are only sampled at full detail.
+		const uint8 limbLods[limb_type_count] =
+		{
+			0,			// None.
+			2, 2,		// Torso, head.
+			2, 2, 1,	// Right arm.
+			2, 2, 1,	// Left arm.
+			2, 2, 1,	// Right leg.
+			2, 2, 1,	// Left leg.
+		};
+
+		bool anyLimb = false;
+		for (uint32 i = limb_type_none + 1; i < limb_type_count; ++i)
+		{
+			uint32 jointID = limbs[i].representative_joint;
+			if (jointID == INVALID_JOINT)
+			{
+				continue;
+			}
+
+			anyLimb = true;
+
+			// Everything between the root and the representative joint is needed to place the limb.
+			uint8 lod = limbLods[i];
+			while (jointID != INVALID_JOINT)
+			{
+				joint_lods[jointID] = max(joint_lods[jointID], lod);
+				jointID = joints[jointID].parent_id;
+			}
+		}
+
+		for (uint32 i = 0; i < numJoints; ++i)
+		{
+			if (!anyLimb || joints[i].parent_id == INVALID_JOINT)
+			{
+				// Without any limb information we cannot reduce the skeleton safely.
+				joint_lods[i] = ANIMATION_JOINT_LOD_COUNT - 1;
+			}
+		}
 	}
 
 	static vec3 samplePosition(const AnimationClip& clip, const AnimationJoint& animJoint, float time)
@@ -340,15 +390,22 @@ namespace era_engine::animation
 		return lerp(a, b, t);
 	}
 
-	void AnimationSkeleton::sampleAnimation(const AnimationClip& clip, float time, trs* outLocalTransforms, trs* outRootMotion) const
+	void AnimationSkeleton::sampleAnimation(const AnimationClip& clip, float time, trs* outLocalTransforms, trs* outRootMotion, uint32 jointLod) const
 	{
 		ASSERT(clip.joints.size() == joints.size());
 
 		time = clamp(time, 0.f, clip.length_in_seconds);
 
+		const uint8* lods = (jointLod > 0 && joint_lods.size() == joints.size()) ? joint_lods.data() : nullptr;
+
 		uint32 numJoints = (uint32)joints.size();
 		for (uint32 i = 0; i < numJoints; ++i)
 		{
+			if (lods && lods[i] < jointLod)
+			{
+				continue;
+			}
+
 			const AnimationJoint& animJoint = clip.joints[i];
 
 			if (animJoint.is_animated)
@@ -405,18 +462,52 @@ namespace era_engine::animation
 		}
 	}
 
-	void AnimationSkeleton::sampleAnimation(uint32 index, float time, trs* outLocalTransforms, trs* outRootMotion) const
+	void AnimationSkeleton::sampleAnimation(uint32 index, float time, trs* outLocalTransforms, trs* outRootMotion, uint32 jointLod) const
 	{
-		sampleAnimation(clips[index], time, outLocalTransforms, outRootMotion);
+		sampleAnimation(clips[index], time, outLocalTransforms, outRootMotion, jointLod);
+	}
+
+	void AnimationSkeleton::sampleRootMotion(const AnimationClip& clip, float time, trs& outRootMotion) const
+	{
+		time = clamp(time, 0.f, clip.length_in_seconds);
+
+		if (!clip.root_motion_joint.is_animated)
+		{
+			outRootMotion = trs::identity;
+			return;
+		}
+
+		outRootMotion.position = samplePosition(clip, clip.root_motion_joint, time);
+		outRootMotion.rotation = sampleRotation(clip, clip.root_motion_joint, time);
+		outRootMotion.scale = sampleScale(clip, clip.root_motion_joint, time);
+
+		// Same result as sampleAnimation, minus the parts which are baked into the pose.
+		if (clip.bake_root_rotation_into_pose)
+		{
+			outRootMotion.rotation = quat::identity;
+		}
+		if (clip.bake_root_xz_translation_into_pose)
+		{
+			outRootMotion.position.x = 0.f;
+			outRootMotion.position.z = 0.f;
+		}
+		if (clip.bake_root_y_translation_into_pose)
+		{
+			outRootMotion.position.y = 0.f;
+		}
 	}
 
 	void AnimationSkeleton::blendLocalTransforms(const trs* localTransforms1, const trs* localTransforms2, float t, trs* outBlendedLocalTransforms) const
 	{
+#if defined(SIMD_AVX_2)
+		blendLocalTransformsSoa(localTransforms1, localTransforms2, (uint32)joints.size(), t, outBlendedLocalTransforms);
+#else
 		t = clamp01(t);
 		for (uint32 jointID = 0; jointID < (uint32)joints.size(); ++jointID)
 		{
 			outBlendedLocalTransforms[jointID] = lerp(localTransforms1[jointID], localTransforms2[jointID], t);
 		}
+#endif
 	}
 
 	void AnimationSkeleton::getSkinningMatricesFromLocalTransforms(const trs* localTransforms, mat4* outSkinningMatrices, const trs& worldTransform) const
@@ -594,20 +685,7 @@ namespace era_engine::animation
 
 		if (valid())
 		{
-			time += dt;
-			if (time >= clip->length_in_seconds)
-			{
-				if (clip->looping)
-				{
-					time = fmod(time, clip->length_in_seconds);
-					lastRootMotion = clip->get_first_root_transform();
-				}
-				else
-				{
-					time = clip->length_in_seconds;
-					finished = true;
-				}
-			}
+			advanceTime(dt);
 
 			trs rootMotion;
 			skeleton.sampleAnimation(*clip, time, outLocalTransforms, &rootMotion);
@@ -617,6 +695,41 @@ namespace era_engine::animation
 		}
 	}
 
+	void AnimationInstance::advance(const AnimationSkeleton& skeleton, float dt, trs& outDeltaRootMotion)
+	{
+		if (paused)
+			return;
+
+		if (valid())
+		{
+			advanceTime(dt);
+
+			trs rootMotion;
+			skeleton.sampleRootMotion(*clip, time, rootMotion);
+
+			outDeltaRootMotion = invert(lastRootMotion) * rootMotion;
+			lastRootMotion = rootMotion;
+		}
+	}
+
+	void AnimationInstance::advanceTime(float dt)
+	{
+		time += dt;
+		if (time >= clip->length_in_seconds)
+		{
+			if (clip->looping)
+			{
+				time = fmod(time, clip->length_in_seconds);
+				lastRootMotion = clip->get_first_root_transform();
+			}
+			else
+			{
+				time = clip->length_in_seconds;
+				finished = true;
+			}
+		}
+	}
+
 #if 1
 	AnimationBlendTree1d::AnimationBlendTree1d(std::initializer_list<AnimationClip*> clips, float startBlendValue, float startRelTime)
 	{
@@ -817,6 +930,8 @@ namespace era_engine::animation
 	RTTR_REGISTRATION
 	{
 		using namespace rttr;
+		impl::ensure_component_type_registered<AnimationComponent>();
+
 		rttr::registration::class_<AnimationComponent>("AnimationComponent")
 			.constructor<ref<Entity::EcsData>>();
 	}
@@ -853,27 +968,89 @@ namespace era_engine::animation
 		}
 	}
 
-	void AnimationComponent::update(const ref<multi_mesh>& mesh, Allocator& arena, float dt, trs* transform)
+	void AnimationComponent::update(const ref<multi_mesh>& mesh, Allocator& arena, float dt, trs* transform, const AnimationLodFrame& lod_frame, SkinningBatch* skinning_batch)
 	{
 		const dx_mesh& dxMesh = mesh->mesh;
 		AnimationSkeleton& skeleton = mesh->skeleton;
 
+		const uint32 numJoints = (uint32)skeleton.joints.size();
+
 		current_global_transforms = 0;
+		current_lod = lod_frame.lod;
 
-		if (animation && animation->valid())
+		if (animation && animation->valid() && !lod_frame.visible && last_local_transforms.size() == numJoints)
 		{
-			auto [vb, skinningMatrices] = skinObject(dxMesh.vertexBuffer, dxMesh.vertexBuffer.positions->elementCount, (uint32)skeleton.joints.size());
+			// Nobody sees the animation, so only the clock and root motion advance. The last evaluated pose is skinned again, so that
+			// shadows and reflections of culled characters don't show the bind pose.
+			auto [vb, skinningMatrices] = skinObject(dxMesh.vertexBuffer, dxMesh.vertexBuffer.positions->elementCount, numJoints);
 
 			prev_frame_vertex_buffer = current_vertex_buffer;
 			current_vertex_buffer = vb;
 
-			trs* localTransforms = arena.allocate<trs>((uint32)skeleton.joints.size());
-			trs deltaRootMotion;
-			animation->update(skeleton, dt * time_scale, localTransforms, deltaRootMotion);
+			trs deltaRootMotion = trs::identity;
+			animation->advance(skeleton, dt * time_scale, deltaRootMotion);
 
-			trs* globalTransforms = arena.allocate<trs>((uint32)skeleton.joints.size());
+			// Force a full evaluation once the character becomes visible again.
+			lod_poses_valid = false;
 
-			skeleton.getSkinningMatricesFromLocalTransforms(localTransforms, globalTransforms, skinningMatrices);
+			trs* globalTransforms = arena.allocate<trs>(numJoints);
+
+			if (skinning_batch)
+			{
+				skinning_batch->push(&skeleton, last_local_transforms.data(), globalTransforms, skinningMatrices);
+			}
+			else
+			{
+				skeleton.getSkinningMatricesFromLocalTransforms(last_local_transforms.data(), globalTransforms, skinningMatrices);
+			}
+
+			if (transform)
+			{
+				*transform = *transform * deltaRootMotion;
+				transform->rotation = normalize(transform->rotation);
+			}
+
+			current_global_transforms = globalTransforms;
+
+			if (animation->finished)
+			{
+				controller->state_machine.update();
+			}
+		}
+		else if (animation && animation->valid())
+		{
+			// Culled characters without an evaluated pose yet get one here.
+			auto [vb, skinningMatrices] = skinObject(dxMesh.vertexBuffer, dxMesh.vertexBuffer.positions->elementCount, numJoints);
+
+			prev_frame_vertex_buffer = current_vertex_buffer;
+			current_vertex_buffer = vb;
+
+			trs* localTransforms = arena.allocate<trs>(numJoints);
+			trs deltaRootMotion = trs::identity;
+
+			if (lod_frame.update_interval <= 1 && lod_frame.lod == 0)
+			{
+				animation->update(skeleton, dt * time_scale, localTransforms, deltaRootMotion);
+				lod_poses_valid = false;
+			}
+			else
+			{
+				animation->advance(skeleton, dt * time_scale, deltaRootMotion);
+				update_lod_pose(skeleton, localTransforms, lod_frame);
+			}
+
+			last_local_transforms.assign(localTransforms, localTransforms + numJoints);
+
+			trs* globalTransforms = arena.allocate<trs>(numJoints);
+
+			if (skinning_batch)
+			{
+				skinning_batch->push(&skeleton, localTransforms, globalTransforms, skinningMatrices);
+			}
+			else
+			{
+				skeleton.getSkinningMatricesFromLocalTransforms(localTransforms, globalTransforms, skinningMatrices);
+			}
 
 			if (transform)
 			{
@@ -898,6 +1075,45 @@ namespace era_engine::animation
 		}
 	}
 
+	void AnimationComponent::update_lod_pose(const AnimationSkeleton& skeleton, trs* out_local_transforms, const AnimationLodFrame& lod_frame)
+	{
+		uint32 num_joints = (uint32)skeleton.joints.size();
+		uint32 joint_lod = min(lod_frame.lod, (uint32)ANIMATION_JOINT_LOD_COUNT - 1);
+
+		std::vector<trs>& from = lod_poses[0];
+		std::vector<trs>& to = lod_poses[1];
+
+		if (!lod_poses_valid || to.size() != num_joints)
+		{
+			// Sample all joints once, so that joints skipped by reduced LODs start from a sensible pose.
+			to.resize(num_joints);
+
+			trs rootMotion;
+			skeleton.sampleAnimation(*animation->clip, animation->time, to.data(), &rootMotion, 0);
+			from = to;
+
+			frames_since_lod_evaluation = 0;
+			lod_poses_valid = true;
+		}
+		else if (lod_frame.evaluate)
+		{
+			// Continue from what was displayed last frame to avoid pops when the interval changes.
+			float t = clamp01((float)frames_since_lod_evaluation / (float)max(lod_frame.update_interval, 1u));
+			skeleton.blendLocalTransforms(from.data(), to.data(), t, from.data());
+
+			trs rootMotion;
+			skeleton.sampleAnimation(*animation->clip, animation->time, to.data(), &rootMotion, joint_lod);
+
+			frames_since_lod_evaluation = 0;
+		}
+
+		++frames_since_lod_evaluation;
+
+		// The displayed pose trails the sampled one by one interval, which keeps the motion smooth without extrapolating.
+		float t = clamp01((float)frames_since_lod_evaluation / (float)max(lod_frame.update_interval, 1u));
+		skeleton.blendLocalTransforms(from.data(), to.data(), t, out_local_transforms);
+	}
+
 	void AnimationComponent::draw_current_skeleton(const ref<multi_mesh>& mesh, const trs& transform, ldr_render_pass* render_pass) const
 	{
 		const dx_mesh& dxMesh = mesh->mesh;
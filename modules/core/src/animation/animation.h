@@ -15,6 +15,10 @@
 
 #define INVALID_JOINT 0xFFFFFFFF
 
+// Animation LODs. LOD 0 samples all joints every frame, higher LODs update at reduced rates and with fewer joints.
+#define ANIMATION_LOD_COUNT 4
+#define ANIMATION_JOINT_LOD_COUNT 3
+
 namespace era_engine
 {
 	struct multi_mesh;
@@ -23,6 +27,8 @@ namespace era_engine
 
 namespace era_engine::animation
 {
+	struct SkinningBatch;
+
 	struct ERA_CORE_API SkinningWeights
 	{
 		uint8 skin_indices[4];
@@ -127,9 +133,12 @@ namespace era_engine::animation
 	struct ERA_CORE_API AnimationSkeleton
 	{
 		void analyzeJoints(const vec3* positions, const void* others, uint32 otherStride, uint32 numVertices);
+		void computeJointLods();
 
-		void sampleAnimation(const AnimationClip& clip, float time, trs* outLocalTransforms, trs* outRootMotion = 0) const;
-		void sampleAnimation(uint32 index, float time, trs* outLocalTransforms, trs* outRootMotion = 0) const;
+		// If jointLod > 0, joints whose joint_lods entry is below it are skipped and keep their previous value in outLocalTransforms.
+		void sampleAnimation(const AnimationClip& clip, float time, trs* outLocalTransforms, trs* outRootMotion = 0, uint32 jointLod = 0) const;
+		void sampleAnimation(uint32 index, float time, trs* outLocalTransforms, trs* outRootMotion = 0, uint32 jointLod = 0) const;
+		void sampleRootMotion(const AnimationClip& clip, float time, trs& outRootMotion) const;
 		void blendLocalTransforms(const trs* localTransforms1, const trs* localTransforms2, float t, trs* outBlendedLocalTransforms) const;
 		void getSkinningMatricesFromLocalTransforms(const trs* localTransforms, mat4* outSkinningMatrices, const trs& worldTransform = trs::identity) const;
 		void getSkinningMatricesFromLocalTransforms(const trs* localTransforms, trs* outGlobalTransforms, mat4* outSkinningMatrices, const trs& worldTransform = trs::identity) const;
@@ -147,6 +156,9 @@ namespace era_engine::animation
 		std::vector<fs::path> files;
 
 		SkeletonLimb limbs[limb_type_count];
+
+		// Per joint, the highest joint LOD at which the joint is still sampled. Derived from the limbs in computeJointLods.
+		std::vector<uint8> joint_lods;
 	};
 
 	struct ERA_CORE_API AnimationInstance
@@ -157,6 +169,9 @@ namespace era_engine::animation
 		void set(const AnimationClip* clip, float startTime = 0.f);
 		void update(const AnimationSkeleton& skeleton, float dt, trs* outLocalTransforms, trs& outDeltaRootMotion);
 
+		// Advances time and root motion without sampling the pose.
+		void advance(const AnimationSkeleton& skeleton, float dt, trs& outDeltaRootMotion);
+
 		bool valid() const { return clip != 0; }
 
 		const AnimationClip* clip = 0;
@@ -166,6 +181,9 @@ namespace era_engine::animation
 
 		bool paused = false;
 		bool finished = false;
+
+	private:
+		void advanceTime(float dt);
 	};
 
 	struct ERA_CORE_API AnimationBlackboard
@@ -251,6 +269,18 @@ namespace era_engine::animation
 		trs lastRootMotion;
 	};
 
+	struct ERA_CORE_API AnimationLodFrame
+	{
+		uint32 lod = 0;
+		uint32 update_interval = 1;
+
+		// False on the frames in between two pose evaluations of a reduced rate LOD. The pose is interpolated instead.
+		bool evaluate = true;
+
+		// Off-screen characters only advance their time and root motion.
+		bool visible = true;
+	};
+
 	class ERA_CORE_API AnimationComponent : public Component
 	{
 	public:
@@ -258,7 +288,8 @@ namespace era_engine::animation
 		virtual ~AnimationComponent();
 
 		void initialize(std::vector<AnimationClip>& clips, size_t start_index = 0);
-		void update(const ref<multi_mesh>& mesh, Allocator& arena, float dt, trs* transform = nullptr);
+		// With a skinning batch, the global transforms and skinning matrices are only computed when the batch is flushed.
+		void update(const ref<multi_mesh>& mesh, Allocator& arena, float dt, trs* transform = nullptr, const AnimationLodFrame& lod_frame = {}, SkinningBatch* skinning_batch = nullptr);
 		void draw_current_skeleton(const ref<multi_mesh>& mesh, const trs& transform, ldr_render_pass* render_pass) const;
 
 		ERA_VIRTUAL_REFLECT(Component)
@@ -274,5 +305,21 @@ namespace era_engine::animation
 
 		float time_scale = 1.f;
 		bool draw_sceleton = false;
+
+		// Visibility hook. Renderers or gameplay code may clear this for characters that are known to be invisible.
+		bool visible = true;
+
+		uint32 current_lod = 0;
+
+	private:
+		void update_lod_pose(const AnimationSkeleton& skeleton, trs* out_local_transforms, const AnimationLodFrame& lod_frame);
+
+		// Persistent poses for reduced rate LODs. The displayed pose is interpolated from the first to the second.
+		std::vector<trs> lod_poses[2];
+		uint32 frames_since_lod_evaluation = 0;
+		bool lod_poses_valid = false;
+
+		// Last evaluated local pose, skinned again while the character is culled.
+		std::vector<trs> last_local_transforms;
 	};
 }
\ No newline at end of file
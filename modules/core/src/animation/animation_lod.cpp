@@ -0,0 +1,77 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#include "animation/animation_lod.h"
+
+#include <rttr/registration>
+
+namespace era_engine::animation
+{
+	RTTR_REGISTRATION
+	{
+		using namespace rttr;
+		impl::ensure_component_type_registered<AnimationLodRootComponent>();
+
+		rttr::registration::class_<AnimationLodRootComponent>("AnimationLodRootComponent")
+			.constructor<ref<Entity::EcsData>>();
+	}
+
+	AnimationLodRootComponent::AnimationLodRootComponent(ref<Entity::EcsData> _data)
+		: Component(_data)
+	{
+	}
+
+	AnimationLodRootComponent::~AnimationLodRootComponent()
+	{
+	}
+
+	void AnimationLodRootComponent::set_viewer(const render_camera& camera)
+	{
+		viewer_position = camera.position;
+		viewer_frustum = camera.getWorldSpaceFrustumPlanes();
+		has_viewer = true;
+	}
+
+	void AnimationLodRootComponent::clear_viewer()
+	{
+		has_viewer = false;
+	}
+
+	AnimationLodFrame AnimationLodRootComponent::get_lod_frame(const trs& transform, const bounding_box& aabb, uint32 current_lod, uint32 stagger) const
+	{
+		AnimationLodFrame result;
+		if (!has_viewer)
+		{
+			return result;
+		}
+
+		if (settings.frustum_culling && aabb.maxCorner != aabb.minCorner)
+		{
+			result.visible = !viewer_frustum.cullModelSpaceAABB(aabb, transform);
+		}
+
+		float distance = length(transform.position - viewer_position);
+
+		uint32 lod = 0;
+		while (lod < ANIMATION_LOD_COUNT - 1)
+		{
+			float threshold = settings.lod_distances[lod];
+			if (lod < current_lod)
+			{
+				// Stay in the coarser LOD until clearly inside the finer one, so characters near a threshold do not flicker.
+				threshold *= 1.f - settings.hysteresis;
+			}
+
+			if (distance < threshold)
+			{
+				break;
+			}
+			++lod;
+		}
+
+		result.lod = lod;
+		result.update_interval = max(settings.update_intervals[lod], 1u);
+		result.evaluate = ((frame_index + stagger) % result.update_interval) == 0;
+
+		return result;
+	}
+}
@@ -0,0 +1,55 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#pragma once
+
+#include "core_api.h"
+
+#include "core/math.h"
+#include "core/camera.h"
+
+#include "animation/animation.h"
+
+#include "ecs/component.h"
+
+namespace era_engine::animation
+{
+	struct ERA_CORE_API AnimationLodSettings
+	{
+		// Distance to the viewer from which on the next LOD is used.
+		float lod_distances[ANIMATION_LOD_COUNT - 1] = { 15.f, 40.f, 80.f };
+
+		// Pose evaluation interval in frames per LOD. Characters sharing a LOD are staggered across these frames.
+		uint32 update_intervals[ANIMATION_LOD_COUNT] = { 1, 2, 4, 8 };
+
+		// Fraction of a LOD distance a character has to move back before switching to the finer LOD again.
+		float hysteresis = 0.1f;
+
+		bool frustum_culling = true;
+	};
+
+	class ERA_CORE_API AnimationLodRootComponent final : public Component
+	{
+	public:
+		AnimationLodRootComponent() = default;
+		AnimationLodRootComponent(ref<Entity::EcsData> _data);
+
+		~AnimationLodRootComponent() override;
+
+		void set_viewer(const render_camera& camera);
+		void clear_viewer();
+
+		NODISCARD AnimationLodFrame get_lod_frame(const trs& transform, const bounding_box& aabb, uint32 current_lod, uint32 stagger) const;
+
+		ERA_VIRTUAL_REFLECT(Component)
+
+	public:
+		AnimationLodSettings settings;
+
+		uint32 frame_index = 0;
+
+	private:
+		vec3 viewer_position = vec3(0.f);
+		camera_frustum_planes viewer_frustum;
+		bool has_viewer = false;
+	};
+}
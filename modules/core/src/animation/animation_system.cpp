@@ -2,6 +2,7 @@
 
 #include "core/cpu_profiling.h"
 #include "core/memory.h"
+#include "core/job_system.h"
 
 #include "engine/engine.h"
 
@@ -12,6 +13,8 @@
 #include "ecs/rendering/mesh_component.h"
 #include "ecs/base_components/transform_component.h"
 #include "animation/animation.h"
+#include "animation/animation_lod.h"
+#include "animation/pose_simd.h"
 
 #include <rttr/policy.h>
 #include <rttr/registration>
@@ -31,31 +34,95 @@ namespace era_engine::animation
 	AnimationSystem::AnimationSystem(World* _world)
 		: System(_world)
 	{
+		lod_rc = world->add_root_component<AnimationLodRootComponent>();
+		ASSERT(lod_rc != nullptr);
 	}
 
 	AnimationSystem::~AnimationSystem()
 	{
-		allocator->reset();
 	}
 
 	void AnimationSystem::init()
 	{
-		allocator = get_transient_object<Allocator>();
 	}
 
 	void AnimationSystem::update(float dt)
 	{
-		MemoryMarker marker = allocator->get_marker();
-		for (auto [entityHandle, anim, mesh, transform] : world->group(components_group<AnimationComponent, MeshComponent, TransformComponent>).each())
+		auto group = world->group(components_group<AnimationComponent, MeshComponent, TransformComponent>);
+		using AnimationGroup = decltype(group);
+
+		uint32 num_entities = (uint32)group.size();
+		if (num_entities == 0)
+		{
+			return;
+		}
+
+		struct AnimationJobData
+		{
+			AnimationSystem* system;
+			AnimationGroup group;
+			uint32 first;
+			uint32 count;
+			float dt;
+		};
+
+		JobHandle parent_job = high_priority_job_queue.createJob<AnimationJobData>([](AnimationJobData& data, JobHandle parent)
+			{
+				for (uint32 first = 0; first < data.count; first += ENTITIES_PER_JOB)
+				{
+					AnimationJobData chunk_data = data;
+					chunk_data.first = first;
+					chunk_data.count = min(ENTITIES_PER_JOB, data.count - first);
+
+					JobHandle job = high_priority_job_queue.createJob<AnimationJobData>([](AnimationJobData& data, JobHandle)
+						{
+							CPU_PROFILE_BLOCK("Animation chunk");
+
+							// Local, global and skinning transforms live in the frame arenas, so that debug drawing and other
+							// readers can still use them during the next frame.
+							Allocator& arena = get_frame_arena();
+							const AnimationLodRootComponent* lod_rc = data.system->lod_rc;
+
+							// Characters sharing a skeleton are concatenated and skinned together with the SIMD pose kernels.
+							SkinningBatch skinning_batch(arena, data.count);
+
+							for (uint32 i = data.first; i < data.first + data.count; ++i)
+							{
+								Entity::Handle handle = data.group[i];
+								auto [anim, mesh, transform] = data.group.get<AnimationComponent, MeshComponent, TransformComponent>(handle);
+								if (!mesh.mesh)
+								{
+									continue;
+								}
+
+								AnimationLodFrame lod_frame = lod_rc->get_lod_frame(transform.transform, mesh.mesh->aabb, anim.current_lod, (uint32)handle);
+								lod_frame.visible &= anim.visible;
+
+								anim.update(mesh.mesh, arena, data.dt, &transform.transform, lod_frame, &skinning_batch);
+							}
+
+							skinning_batch.flush();
+						}, chunk_data, parent);
+					job.submit_now();
+				}
+			}, { this, group, 0, num_entities, dt });
+		parent_job.submit_now();
+
+		// The wait may resume this job on another thread, so no profile block is open across it. The chunks have their own.
+		parent_job.wait_for_completion();
+
+		CPU_PROFILE_BLOCK("Animation debug draw");
+
+		++lod_rc->frame_index;
+
+		// Debug rendering records into a shared render pass, so this stays on the calling thread.
+		for (auto [entityHandle, anim, mesh, transform] : group.each())
 		{
-			anim.update(mesh.mesh, *allocator, dt, &transform.transform);
-			
 			if (anim.draw_sceleton)
 			{
 				anim.draw_current_skeleton(mesh.mesh, transform.transform, &globalApp.ldrRenderPass);
 			}
 		}
-		allocator->reset_to_marker(marker);
 	}
 
 }
\ No newline at end of file
@@ -2,13 +2,10 @@
 
 #include "ecs/system.h"
 
-namespace era_engine
-{
-	struct Allocator;
-}
-
 namespace era_engine::animation
 {
+	class AnimationLodRootComponent;
+
 	class AnimationSystem final : public System
 	{
 	public:
@@ -20,6 +17,8 @@ namespace era_engine::animation
 
 		ERA_VIRTUAL_REFLECT(System)
 	private:
-		Allocator* allocator = nullptr;
+		AnimationLodRootComponent* lod_rc = nullptr;
+
+		static constexpr uint32 ENTITIES_PER_JOB = 16;
 	};
-}
\ No newline at end of file
+}
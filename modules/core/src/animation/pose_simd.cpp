@@ -0,0 +1,397 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#include "animation/pose_simd.h"
+#include "animation/animation.h"
+
+#include "core/math_simd.h"
+#include "core/memory.h"
+
+#include <algorithm>
+
+namespace era_engine::animation
+{
+#if defined(SIMD_AVX_2)
+
+	// The loads and stores below move rotation, position and scale.x of a trs with a single 8 float access.
+	static_assert(sizeof(quat) == 4 * sizeof(float) && sizeof(vec3) == 3 * sizeof(float));
+
+	// data must hold 10 * numJoints * POSE_BATCH_SIZE floats, 32 byte aligned.
+	static SoaPose createSoaPose(float* data, uint32 numJoints)
+	{
+		uint32 count = numJoints * POSE_BATCH_SIZE;
+
+		SoaPose result;
+		result.rotation = { data + count * 0, data + count * 1, data + count * 2, data + count * 3 };
+		result.position = { data + count * 4, data + count * 5, data + count * 6 };
+		result.scale = { data + count * 7, data + count * 8, data + count * 9 };
+		result.num_joints = numJoints;
+		return result;
+	}
+
+	SoaPose allocateSoaPose(Allocator& arena, uint32 numJoints)
+	{
+		float* data = (float*)arena.allocate(sizeof(float) * numJoints * POSE_BATCH_SIZE * 10, 32);
+		return createSoaPose(data, numJoints);
+	}
+
+	static void loadJoint(const trs* const* transforms, uint32 numInstances, uint32 jointID, w8_quat& outRotation, w8_vec3& outPosition, w8_vec3& outScale)
+	{
+		const trs* lanes[POSE_BATCH_SIZE];
+		for (uint32 i = 0; i < POSE_BATCH_SIZE; ++i)
+		{
+			lanes[i] = &transforms[i < numInstances ? i : 0][jointID];
+		}
+
+		w8_float r0(&lanes[0]->rotation.x);
+		w8_float r1(&lanes[1]->rotation.x);
+		w8_float r2(&lanes[2]->rotation.x);
+		w8_float r3(&lanes[3]->rotation.x);
+		w8_float r4(&lanes[4]->rotation.x);
+		w8_float r5(&lanes[5]->rotation.x);
+		w8_float r6(&lanes[6]->rotation.x);
+		w8_float r7(&lanes[7]->rotation.x);
+
+		transpose(r0, r1, r2, r3, r4, r5, r6, r7);
+
+		outRotation = w8_quat(r0, r1, r2, r3);
+		outPosition = w8_vec3(r4, r5, r6);
+		outScale.x = r7;
+		outScale.y = w8_float(lanes[0]->scale.y, lanes[1]->scale.y, lanes[2]->scale.y, lanes[3]->scale.y, lanes[4]->scale.y, lanes[5]->scale.y, lanes[6]->scale.y, lanes[7]->scale.y);
+		outScale.z = w8_float(lanes[0]->scale.z, lanes[1]->scale.z, lanes[2]->scale.z, lanes[3]->scale.z, lanes[4]->scale.z, lanes[5]->scale.z, lanes[6]->scale.z, lanes[7]->scale.z);
+	}
+
+	static void storeJoint(trs* const* outTransforms, uint32 numInstances, uint32 jointID, w8_quat rotation, w8_vec3 position, w8_vec3 scale)
+	{
+		w8_float r0 = rotation.x, r1 = rotation.y, r2 = rotation.z, r3 = rotation.w;
+		w8_float r4 = position.x, r5 = position.y, r6 = position.z, r7 = scale.x;
+
+		transpose(r0, r1, r2, r3, r4, r5, r6, r7);
+
+		const w8_float rows[POSE_BATCH_SIZE] = { r0, r1, r2, r3, r4, r5, r6, r7 };
+
+		alignas(32) float scaleY[POSE_BATCH_SIZE];
+		alignas(32) float scaleZ[POSE_BATCH_SIZE];
+		scale.y.store(scaleY);
+		scale.z.store(scaleZ);
+
+		for (uint32 i = 0; i < numInstances; ++i)
+		{
+			trs& t = outTransforms[i][jointID];
+			rows[i].store(&t.rotation.x);
+			t.scale.y = scaleY[i];
+			t.scale.z = scaleZ[i];
+		}
+	}
+
+	static w8_quat loadSoa(soa_quat q, uint32 offset)
+	{
+		return w8_quat(w8_float(q.x + offset), w8_float(q.y + offset), w8_float(q.z + offset), w8_float(q.w + offset));
+	}
+
+	static w8_vec3 loadSoa(soa_vec3 v, uint32 offset)
+	{
+		return w8_vec3(w8_float(v.x + offset), w8_float(v.y + offset), w8_float(v.z + offset));
+	}
+
+	static void storeSoa(soa_quat q, uint32 offset, w8_quat value)
+	{
+		value.store(q.x + offset, q.y + offset, q.z + offset, q.w + offset);
+	}
+
+	static void storeSoa(soa_vec3 v, uint32 offset, w8_vec3 value)
+	{
+		value.x.store(v.x + offset);
+		value.y.store(v.y + offset);
+		value.z.store(v.z + offset);
+	}
+
+	// Full precision normalization. The rsqrt approximation used by the generic normalize is too coarse for rotations that are concatenated down a chain.
+	static w8_quat normalizeRotation(w8_quat q)
+	{
+		w8_quat result;
+		result.v4 = q.v4 * (w8_float(1.f) / sqrt(dot(q.v4, q.v4)));
+		return result;
+	}
+
+	static w8_vec3 rotate(w8_quat q, w8_vec3 v)
+	{
+		w8_vec3 t = cross(q.v, v) * w8_float(2.f);
+		return v + t * q.w + cross(q.v, t);
+	}
+
+	void loadSoaPose(const trs* const* transforms, uint32 numInstances, SoaPose& outPose)
+	{
+		ASSERT(numInstances > 0 && numInstances <= POSE_BATCH_SIZE);
+
+		for (uint32 jointID = 0; jointID < outPose.num_joints; ++jointID)
+		{
+			w8_quat rotation;
+			w8_vec3 position, scale;
+			loadJoint(transforms, numInstances, jointID, rotation, position, scale);
+
+			uint32 offset = jointID * POSE_BATCH_SIZE;
+			storeSoa(outPose.rotation, offset, rotation);
+			storeSoa(outPose.position, offset, position);
+			storeSoa(outPose.scale, offset, scale);
+		}
+	}
+
+	void storeSoaPose(const SoaPose& pose, trs* const* outTransforms, uint32 numInstances)
+	{
+		ASSERT(numInstances > 0 && numInstances <= POSE_BATCH_SIZE);
+
+		for (uint32 jointID = 0; jointID < pose.num_joints; ++jointID)
+		{
+			uint32 offset = jointID * POSE_BATCH_SIZE;
+			storeJoint(outTransforms, numInstances, jointID, loadSoa(pose.rotation, offset), loadSoa(pose.position, offset), loadSoa(pose.scale, offset));
+		}
+	}
+
+	void blendSoaPoses(const SoaPose& a, const SoaPose& b, float t, SoaPose& outPose)
+	{
+		ASSERT(a.num_joints == b.num_joints && a.num_joints == outPose.num_joints);
+
+		w8_float t8 = clamp01(t);
+
+		// Joints are independent here, so the whole pose is one flat loop. Matches the scalar lerp(trs, trs, float).
+		for (uint32 offset = 0; offset < a.num_joints * POSE_BATCH_SIZE; offset += POSE_BATCH_SIZE)
+		{
+			w8_quat rotation;
+			rotation.v4 = lerp(loadSoa(a.rotation, offset).v4, loadSoa(b.rotation, offset).v4, t8);
+
+			storeSoa(outPose.rotation, offset, normalizeRotation(rotation));
+			storeSoa(outPose.position, offset, lerp(loadSoa(a.position, offset), loadSoa(b.position, offset), t8));
+			storeSoa(outPose.scale, offset, lerp(loadSoa(a.scale, offset), loadSoa(b.scale, offset), t8));
+		}
+	}
+
+	void blendLocalTransformsSoa(const trs* a, const trs* b, uint32 numJoints, float t, trs* out)
+	{
+		// Each joint of a chunk becomes one lane of a single joint pose.
+		alignas(32) float data[3][10 * POSE_BATCH_SIZE];
+		SoaPose poseA = createSoaPose(data[0], 1);
+		SoaPose poseB = createSoaPose(data[1], 1);
+		SoaPose blended = createSoaPose(data[2], 1);
+
+		for (uint32 first = 0; first < numJoints; first += POSE_BATCH_SIZE)
+		{
+			uint32 count = min(numJoints - first, (uint32)POSE_BATCH_SIZE);
+
+			const trs* lanesA[POSE_BATCH_SIZE];
+			const trs* lanesB[POSE_BATCH_SIZE];
+			trs* lanesOut[POSE_BATCH_SIZE];
+			for (uint32 i = 0; i < count; ++i)
+			{
+				lanesA[i] = a + first + i;
+				lanesB[i] = b + first + i;
+				lanesOut[i] = out + first + i;
+			}
+
+			loadSoaPose(lanesA, count, poseA);
+			loadSoaPose(lanesB, count, poseB);
+			blendSoaPoses(poseA, poseB, t, blended);
+			storeSoaPose(blended, lanesOut, count);
+		}
+	}
+
+	void localToGlobalSoa(const AnimationSkeleton& skeleton, const SoaPose& localPose, SoaPose& outGlobalPose)
+	{
+		ASSERT(localPose.num_joints == (uint32)skeleton.joints.size() && outGlobalPose.num_joints == localPose.num_joints);
+
+		for (uint32 jointID = 0; jointID < localPose.num_joints; ++jointID)
+		{
+			uint32 offset = jointID * POSE_BATCH_SIZE;
+
+			w8_quat rotation = loadSoa(localPose.rotation, offset);
+			w8_vec3 position = loadSoa(localPose.position, offset);
+			w8_vec3 scale = loadSoa(localPose.scale, offset);
+
+			uint32 parentID = skeleton.joints[jointID].parent_id;
+			if (parentID != INVALID_JOINT)
+			{
+				ASSERT(jointID > parentID); // Parent already processed.
+
+				uint32 parentOffset = parentID * POSE_BATCH_SIZE;
+				w8_quat parentRotation = loadSoa(outGlobalPose.rotation, parentOffset);
+				w8_vec3 parentPosition = loadSoa(outGlobalPose.position, parentOffset);
+				w8_vec3 parentScale = loadSoa(outGlobalPose.scale, parentOffset);
+
+				// Same composition as trs operator*.
+				position = rotate(parentRotation, parentScale * position) + parentPosition;
+				rotation = parentRotation * rotation;
+				scale = parentScale * scale;
+			}
+
+			storeSoa(outGlobalPose.rotation, offset, rotation);
+			storeSoa(outGlobalPose.position, offset, position);
+			storeSoa(outGlobalPose.scale, offset, scale);
+		}
+	}
+
+	static w8_mat4 createModelMatrix(w8_vec3 position, w8_quat rotation, w8_vec3 scale)
+	{
+		// Same formulation as create_model_matrix.
+		const w8_float one(1.f);
+		const w8_float zero = w8_float::zero();
+
+		const w8_float x2 = rotation.x + rotation.x;
+		const w8_float y2 = rotation.y + rotation.y;
+		const w8_float z2 = rotation.z + rotation.z;
+
+		const w8_float xx2 = rotation.x * x2;
+		const w8_float yy2 = rotation.y * y2;
+		const w8_float zz2 = rotation.z * z2;
+		const w8_float yz2 = rotation.y * z2;
+		const w8_float wx2 = rotation.w * x2;
+		const w8_float xy2 = rotation.x * y2;
+		const w8_float wz2 = rotation.w * z2;
+		const w8_float xz2 = rotation.x * z2;
+		const w8_float wy2 = rotation.w * y2;
+
+		w8_mat4 result;
+		result.m00 = (one - (yy2 + zz2)) * scale.x;
+		result.m10 = (xy2 + wz2) * scale.x;
+		result.m20 = (xz2 - wy2) * scale.x;
+		result.m30 = zero;
+
+		result.m01 = (xy2 - wz2) * scale.y;
+		result.m11 = (one - (xx2 + zz2)) * scale.y;
+		result.m21 = (yz2 + wx2) * scale.y;
+		result.m31 = zero;
+
+		result.m02 = (xz2 + wy2) * scale.z;
+		result.m12 = (yz2 - wx2) * scale.z;
+		result.m22 = (one - (xx2 + yy2)) * scale.z;
+		result.m32 = zero;
+
+		result.m03 = position.x;
+		result.m13 = position.y;
+		result.m23 = position.z;
+		result.m33 = one;
+		return result;
+	}
+
+	void getSkinningMatricesSoa(const AnimationSkeleton& skeleton, const SoaPose& globalPose, mat4* const* outSkinningMatrices, uint32 numInstances)
+	{
+		ASSERT(globalPose.num_joints == (uint32)skeleton.joints.size());
+		ASSERT(numInstances > 0 && numInstances <= POSE_BATCH_SIZE);
+
+		for (uint32 jointID = 0; jointID < globalPose.num_joints; ++jointID)
+		{
+			uint32 offset = jointID * POSE_BATCH_SIZE;
+
+			w8_mat4 global = createModelMatrix(loadSoa(globalPose.position, offset), loadSoa(globalPose.rotation, offset), loadSoa(globalPose.scale, offset));
+
+			// The inverse bind matrix is shared by all instances, so it is simply broadcast.
+			const mat4& invBind = skeleton.joints[jointID].inv_bind_transform;
+			w8_mat4 invBind8;
+			for (uint32 i = 0; i < 16; ++i)
+			{
+				invBind8.m[i] = invBind.m[i];
+			}
+
+			w8_mat4 skinning = global * invBind8;
+
+			// Transposing turns "one matrix element of all instances" into "8 consecutive elements of one instance".
+			w8_float lo0 = skinning.m[0], lo1 = skinning.m[1], lo2 = skinning.m[2], lo3 = skinning.m[3];
+			w8_float lo4 = skinning.m[4], lo5 = skinning.m[5], lo6 = skinning.m[6], lo7 = skinning.m[7];
+			w8_float hi0 = skinning.m[8], hi1 = skinning.m[9], hi2 = skinning.m[10], hi3 = skinning.m[11];
+			w8_float hi4 = skinning.m[12], hi5 = skinning.m[13], hi6 = skinning.m[14], hi7 = skinning.m[15];
+
+			transpose(lo0, lo1, lo2, lo3, lo4, lo5, lo6, lo7);
+			transpose(hi0, hi1, hi2, hi3, hi4, hi5, hi6, hi7);
+
+			const w8_float lo[POSE_BATCH_SIZE] = { lo0, lo1, lo2, lo3, lo4, lo5, lo6, lo7 };
+			const w8_float hi[POSE_BATCH_SIZE] = { hi0, hi1, hi2, hi3, hi4, hi5, hi6, hi7 };
+
+			for (uint32 i = 0; i < numInstances; ++i)
+			{
+				float* dest = outSkinningMatrices[i][jointID].m;
+				lo[i].store(dest);
+				hi[i].store(dest + 8);
+			}
+		}
+	}
+
+#endif
+
+	SkinningBatch::SkinningBatch(Allocator& arena, uint32 capacity)
+		: arena(arena), capacity(capacity)
+	{
+		entries = arena.allocate<Entry>(capacity);
+	}
+
+	void SkinningBatch::push(const AnimationSkeleton* skeleton, const trs* localTransforms, trs* outGlobalTransforms, mat4* outSkinningMatrices)
+	{
+		if (num_entries == capacity)
+		{
+			flush();
+		}
+
+		entries[num_entries++] = { skeleton, localTransforms, outGlobalTransforms, outSkinningMatrices };
+	}
+
+	void SkinningBatch::flush()
+	{
+#if defined(SIMD_AVX_2)
+		// Below this many instances of one skeleton the transposes cost more than the SIMD math saves.
+		static constexpr uint32 MIN_SIMD_INSTANCES = 4;
+
+		std::sort(entries, entries + num_entries, [](const Entry& a, const Entry& b) { return a.skeleton < b.skeleton; });
+
+		uint32 first = 0;
+		while (first < num_entries)
+		{
+			const AnimationSkeleton* skeleton = entries[first].skeleton;
+
+			uint32 count = 1;
+			while (first + count < num_entries && count < POSE_BATCH_SIZE && entries[first + count].skeleton == skeleton)
+			{
+				++count;
+			}
+
+			if (count >= MIN_SIMD_INSTANCES)
+			{
+				ScopedAllocator scope(arena);
+
+				const trs* localTransforms[POSE_BATCH_SIZE];
+				trs* globalTransforms[POSE_BATCH_SIZE];
+				mat4* skinningMatrices[POSE_BATCH_SIZE];
+				for (uint32 i = 0; i < count; ++i)
+				{
+					localTransforms[i] = entries[first + i].local_transforms;
+					globalTransforms[i] = entries[first + i].global_transforms;
+					skinningMatrices[i] = entries[first + i].skinning_matrices;
+				}
+
+				uint32 numJoints = (uint32)skeleton->joints.size();
+				SoaPose localPose = allocateSoaPose(arena, numJoints);
+				SoaPose globalPose = allocateSoaPose(arena, numJoints);
+
+				loadSoaPose(localTransforms, count, localPose);
+				localToGlobalSoa(*skeleton, localPose, globalPose);
+				storeSoaPose(globalPose, globalTransforms, count);
+				getSkinningMatricesSoa(*skeleton, globalPose, skinningMatrices, count);
+			}
+			else
+			{
+				for (uint32 i = first; i < first + count; ++i)
+				{
+					const Entry& e = entries[i];
+					e.skeleton->getSkinningMatricesFromLocalTransforms(e.local_transforms, e.global_transforms, e.skinning_matrices);
+				}
+			}
+
+			first += count;
+		}
+#else
+		for (uint32 i = 0; i < num_entries; ++i)
+		{
+			const Entry& e = entries[i];
+			e.skeleton->getSkinningMatricesFromLocalTransforms(e.local_transforms, e.global_transforms, e.skinning_matrices);
+		}
+#endif
+
+		num_entries = 0;
+	}
+}
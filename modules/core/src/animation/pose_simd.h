@@ -0,0 +1,79 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#pragma once
+
+#include "core_api.h"
+
+#include "core/math.h"
+#include "core/soa.h"
+
+namespace era_engine
+{
+	struct Allocator;
+}
+
+// Number of instances of one skeleton that the batched pose kernels process at once (one per SIMD lane).
+#define POSE_BATCH_SIZE 8
+
+namespace era_engine::animation
+{
+	struct AnimationSkeleton;
+
+	// Pose of up to POSE_BATCH_SIZE instances of the same skeleton in structure-of-arrays layout.
+	// Component c of joint j of instance i is stored at c[j * POSE_BATCH_SIZE + i], so one joint of all instances fills one w8_float.
+	struct ERA_CORE_API SoaPose
+	{
+		soa_quat rotation;
+		soa_vec3 position;
+		soa_vec3 scale;
+
+		uint32 num_joints = 0;
+	};
+
+#if defined(SIMD_AVX_2)
+	NODISCARD SoaPose allocateSoaPose(Allocator& arena, uint32 numJoints);
+
+	// Instances beyond numInstances are filled with the first one, so that all lanes always hold a valid pose.
+	void loadSoaPose(const trs* const* transforms, uint32 numInstances, SoaPose& outPose);
+	void storeSoaPose(const SoaPose& pose, trs* const* outTransforms, uint32 numInstances);
+
+	// Normalized lerp of the rotations, lerp of positions and scales. Matches the scalar lerp(trs, trs, float). outPose may alias a or b.
+	void blendSoaPoses(const SoaPose& a, const SoaPose& b, float t, SoaPose& outPose);
+
+	// Same blend for the local transforms of a single instance, with consecutive joints in the lanes. out may alias a or b.
+	void blendLocalTransformsSoa(const trs* a, const trs* b, uint32 numJoints, float t, trs* out);
+
+	// Concatenates local transforms down the hierarchy. Root joints are treated as being relative to the model.
+	void localToGlobalSoa(const AnimationSkeleton& skeleton, const SoaPose& localPose, SoaPose& outGlobalPose);
+
+	// Multiplies the global transforms with the inverse bind matrices. Each instance's matrices are written with full 32 byte stores,
+	// which is the access pattern the write-combined skinning buffer wants.
+	void getSkinningMatricesSoa(const AnimationSkeleton& skeleton, const SoaPose& globalPose, mat4* const* outSkinningMatrices, uint32 numInstances);
+#endif
+
+	// Collects the skinning work of several animated characters and runs instances of the same skeleton through the SIMD kernels together.
+	// Not thread safe. The intended use is one batch per animation job.
+	struct ERA_CORE_API SkinningBatch
+	{
+		SkinningBatch(Allocator& arena, uint32 capacity);
+
+		// All pointers must stay valid until flush. The output arrays are only written during flush.
+		void push(const AnimationSkeleton* skeleton, const trs* localTransforms, trs* outGlobalTransforms, mat4* outSkinningMatrices);
+		void flush();
+
+	private:
+		struct Entry
+		{
+			const AnimationSkeleton* skeleton;
+			const trs* local_transforms;
+			trs* global_transforms;
+			mat4* skinning_matrices;
+		};
+
+		Allocator& arena;
+
+		Entry* entries;
+		uint32 num_entries = 0;
+		uint32 capacity;
+	};
+}
@@ -7,6 +7,8 @@
 #include "dx/dx_profiling.h"
 #include "dx/dx_buffer.h"
 
+#include "core/memory.h"
+
 #include "rendering/material.h"
 #include "rendering/render_pass.h"
 
@@ -39,7 +41,6 @@ namespace era_engine::animation
 		vertex_buffer_group skinnedVertexBuffer;
 		ref<dx_buffer> skinningMatricesBuffer;
 
-		mat4* skinningMatrices;
 		uint32 numSkinningMatrices;
 		uint32 matrixOffset;
 
@@ -62,9 +63,7 @@ namespace era_engine::animation
 			{
 				PROFILE_ALL(cl, "Skeletal");
 
-				mat4* mats = (mat4*)mapBuffer(data.skinningMatricesBuffer, false);
-				memcpy(mats + data.matrixOffset, data.skinningMatrices, sizeof(mat4) * data.numSkinningMatrices);
-				unmapBuffer(data.skinningMatricesBuffer, true, map_range{ data.matrixOffset, data.numSkinningMatrices });
+				// Skinning matrices have already been written straight into the persistently mapped upload buffer by skinObject.
 
 				cl->setPipelineState(*skinningPipeline.pipeline);
 				cl->setComputeRootSignature(*skinningPipeline.rootSignature);
@@ -76,6 +75,11 @@ namespace era_engine::animation
 				for (uint32 i = 0; i < data.numCalls; ++i)
 				{
 					auto& c = data.calls[i];
+					if (c.range.numVertices == 0)
+					{
+						continue;
+					}
+
 					cl->setRootComputeSRV(SKINNING_RS_INPUT_VERTEX_BUFFER0, c.vertexBuffer.positions.view.BufferLocation);
 					cl->setRootComputeSRV(SKINNING_RS_INPUT_VERTEX_BUFFER1, c.vertexBuffer.others.view.BufferLocation);
 					cl->setCompute32BitConstants(SKINNING_RS_CB, skinning_cb{ c.jointOffset, c.numJoints, c.range.firstVertex, c.range.numVertices, c.vertexOffset });
@@ -103,51 +107,113 @@ namespace era_engine::animation
 		}
 	};
 
-#define MAX_NUM_SKINNING_MATRICES_PER_FRAME 4096
-#define MAX_NUM_SKINNED_VERTICES_PER_FRAME (1024 * 256)
+	// Initial capacities. Whenever a frame asks for more, the buffers grow before the next frame. Objects which don't fit are
+	// rendered in their bind pose for that one frame.
+#define INITIAL_NUM_SKINNING_MATRICES_PER_FRAME 4096
+#define INITIAL_NUM_SKINNED_VERTICES_PER_FRAME (1024 * 256)
+#define INITIAL_NUM_SKINNING_CALLS_PER_FRAME 1024
 
 	static ref<dx_buffer> skinningMatricesBuffer; // Buffered frames are in a single dx_buffer.
+	static mat4* mappedSkinningMatrices; // Upload heaps stay mapped for their whole lifetime, so animation jobs write here directly.
+	static uint32 skinningMatrixCapacity; // Per buffered frame.
 
 	static uint32 currentSkinnedVertexBuffer;
 	static vertex_buffer_group skinnedVertexBuffer[2]; // We have two of these, so that we can compute screen space velocities.
+	static uint32 skinnedVertexCapacity;
 
-	static mat4 skinningMatrices[MAX_NUM_SKINNING_MATRICES_PER_FRAME];
 	static volatile uint32 numSkinningMatricesThisFrame;
 
-	static skinning_call calls[1024];
+	static std::vector<skinning_call> calls;
 	static volatile uint32 numCalls;
 
+	// Resources replaced by the last growth. The last frame's skinned vertices are still read for velocities during this frame.
+	static vertex_buffer_group retiredSkinnedVertexBuffers[2];
+	static std::vector<skinning_call> retiredCalls;
+
 	static cloth_skinning_call clothCalls[128];
 	static volatile uint32 numClothCalls;
 
 	static volatile uint32 totalNumVertices;
 
-	void initializeSkinning()
+	static void createSkinningMatricesBuffer(uint32 capacity)
 	{
-		skinningMatricesBuffer = createUploadBuffer(sizeof(mat4), MAX_NUM_SKINNING_MATRICES_PER_FRAME * NUM_BUFFERED_FRAMES, 0);
+		skinningMatrixCapacity = capacity;
+		skinningMatricesBuffer = createUploadBuffer(sizeof(mat4), skinningMatrixCapacity * NUM_BUFFERED_FRAMES, 0);
+		mappedSkinningMatrices = (mat4*)mapBuffer(skinningMatricesBuffer, false);
+	}
 
+	static void createSkinnedVertexBuffers(uint32 capacity)
+	{
+		skinnedVertexCapacity = capacity;
 		for (uint32 i = 0; i < 2; ++i)
 		{
-			skinnedVertexBuffer[i].positions = createVertexBuffer(sizeof(vec3), MAX_NUM_SKINNED_VERTICES_PER_FRAME, 0, true);
+			skinnedVertexBuffer[i].positions = createVertexBuffer(sizeof(vec3), skinnedVertexCapacity, 0, true);
 			skinnedVertexBuffer[i].others = createVertexBuffer(
 				getVertexOthersSize(mesh_creation_flags_with_positions | mesh_creation_flags_with_uvs | mesh_creation_flags_with_normals | mesh_creation_flags_with_tangents),
-				MAX_NUM_SKINNED_VERTICES_PER_FRAME, 0, true);
+				skinnedVertexCapacity, 0, true);
+		}
+	}
+
+	static uint32 growCapacity(uint32 capacity, uint32 required)
+	{
+		while (capacity < required)
+		{
+			capacity *= 2;
+		}
+		return capacity;
+	}
+
+	// Main thread, while no skinObject calls are in flight. The old matrix buffer is kept alive by the skinning task of this frame.
+	static void growSkinningBuffers(uint32 requiredMatrices, uint32 requiredVertices, uint32 requiredCalls)
+	{
+		if (requiredMatrices > skinningMatrixCapacity)
+		{
+			createSkinningMatricesBuffer(growCapacity(skinningMatrixCapacity, requiredMatrices));
+		}
+
+		if (requiredVertices > skinnedVertexCapacity)
+		{
+			retiredSkinnedVertexBuffers[0] = skinnedVertexBuffer[0];
+			retiredSkinnedVertexBuffers[1] = skinnedVertexBuffer[1];
+			createSkinnedVertexBuffers(growCapacity(skinnedVertexCapacity, requiredVertices));
 		}
 
+		if (requiredCalls > (uint32)calls.size())
+		{
+			std::vector<skinning_call> grownCalls(growCapacity((uint32)calls.size(), requiredCalls));
+			retiredCalls = std::move(calls);
+			calls = std::move(grownCalls);
+		}
+	}
+
+	void initializeSkinning()
+	{
+		createSkinningMatricesBuffer(INITIAL_NUM_SKINNING_MATRICES_PER_FRAME);
+		createSkinnedVertexBuffers(INITIAL_NUM_SKINNED_VERTICES_PER_FRAME);
+		calls.resize(INITIAL_NUM_SKINNING_CALLS_PER_FRAME);
+
 		skinningPipeline = createReloadablePipeline("skinning_cs");
 		clothSkinningPipeline = createReloadablePipeline("cloth_skinning_cs");
 	}
 
 	NODISCARD std::tuple<dx_vertex_buffer_group_view, mat4*> skinObject(const dx_vertex_buffer_group_view& vertexBuffer, vertex_range range, uint32 numJoints)
 	{
+		// The counters keep counting past the capacities, so that performSkinning knows how much this frame asked for.
 		uint32 jointOffset = atomic_add(numSkinningMatricesThisFrame, numJoints);
-		ASSERT(jointOffset + numJoints <= MAX_NUM_SKINNING_MATRICES_PER_FRAME);
-
 		uint32 vertexOffset = atomic_add(totalNumVertices, range.numVertices);
-		ASSERT(vertexOffset + range.numVertices <= MAX_NUM_SKINNED_VERTICES_PER_FRAME);
 
 		uint32 callIndex = atomic_increment(numCalls);
-		ASSERT(callIndex < arraysize(calls));
+
+		if (jointOffset + numJoints > skinningMatrixCapacity || vertexOffset + range.numVertices > skinnedVertexCapacity || callIndex >= (uint32)calls.size())
+		{
+			if (callIndex < (uint32)calls.size())
+			{
+				calls[callIndex] = {}; // Skipped by the pipeline.
+			}
+
+			// Bind pose for this frame. The matrices are still written by the caller, so they need somewhere to go.
+			return { vertexBuffer, get_frame_arena().allocate<mat4>(numJoints) };
+		}
 
 		calls[callIndex] =
 		{
@@ -171,7 +237,9 @@ namespace era_engine::animation
 		result.others.view.SizeInBytes = others->elementSize * numVertices;
 		result.others.view.StrideInBytes = others->elementSize;
 
-		return { result, skinningMatrices + jointOffset };
+		// The upload heap is write-combined memory. Callers must only write (never read back) these matrices.
+		mat4* frameSkinningMatrices = mappedSkinningMatrices + dxContext.bufferedFrameID * skinningMatrixCapacity;
+		return { result, frameSkinningMatrices + jointOffset };
 	}
 
 	NODISCARD std::tuple<dx_vertex_buffer_group_view, mat4*> skinObject(const dx_vertex_buffer_group_view& vertexBuffer, uint32 numVertices, uint32 numJoints)
@@ -191,7 +259,7 @@ namespace era_engine::animation
 	{
 		uint32 numVertices = gridSizeX * gridSizeY;
 		uint32 vertexOffset = atomic_add(totalNumVertices, numVertices);
-		ASSERT(vertexOffset + numVertices <= MAX_NUM_SKINNED_VERTICES_PER_FRAME);
+		ASSERT(vertexOffset + numVertices <= skinnedVertexCapacity);
 
 		uint32 callIndex = atomic_increment(numClothCalls);
 		ASSERT(callIndex < arraysize(clothCalls));
@@ -219,6 +287,13 @@ namespace era_engine::animation
 
 	void performSkinning(compute_pass* computePass)
 	{
+		retiredSkinnedVertexBuffers[0] = {};
+		retiredSkinnedVertexBuffers[1] = {};
+		retiredCalls.clear();
+		retiredCalls.shrink_to_fit();
+
+		const uint32 callCapacity = (uint32)calls.size();
+
 		// TODO: We currently make no attempt to ensure that all draw calls have actually been written completely, if executed on another thread. 
 		if (numCalls > 0 || numClothCalls > 0)
 		{
@@ -226,12 +301,11 @@ namespace era_engine::animation
 			data.skinnedVertexBuffer = skinnedVertexBuffer[currentSkinnedVertexBuffer];
 			data.skinningMatricesBuffer = skinningMatricesBuffer;
 
-			data.skinningMatrices = skinningMatrices;
-			data.numSkinningMatrices = numSkinningMatricesThisFrame;
-			data.matrixOffset = dxContext.bufferedFrameID * MAX_NUM_SKINNING_MATRICES_PER_FRAME;
+			data.numSkinningMatrices = min((uint32)numSkinningMatricesThisFrame, skinningMatrixCapacity);
+			data.matrixOffset = dxContext.bufferedFrameID * skinningMatrixCapacity;
 
-			data.calls = calls;
-			data.numCalls = numCalls;
+			data.calls = calls.data();
+			data.numCalls = min((uint32)numCalls, callCapacity);
 
 			data.clothCalls = clothCalls;
 			data.numClothCalls = numClothCalls;
@@ -239,10 +313,13 @@ namespace era_engine::animation
 			computePass->addTask<skinning_pipeline>(compute_pass_frame_start, data);
 
 			currentSkinnedVertexBuffer = 1 - currentSkinnedVertexBuffer;
-			numCalls = 0;
-			numClothCalls = 0;
-			numSkinningMatricesThisFrame = 0;
-			totalNumVertices = 0;
 		}
+
+		growSkinningBuffers(numSkinningMatricesThisFrame, totalNumVertices, numCalls);
+
+		numCalls = 0;
+		numClothCalls = 0;
+		numSkinningMatricesThisFrame = 0;
+		totalNumVertices = 0;
 	}
 }
\ No newline at end of file
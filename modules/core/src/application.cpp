@@ -29,6 +29,7 @@
 #include "terrain/tree.h"
 
 #include "animation/skinning.h"
+#include "animation/animation_lod.h"
 
 #include "asset/model_asset.h"
 #include "asset/file_registry.h"
@@ -89,10 +90,9 @@ namespace era_engine
 
 		add_ray_tracing_data data = { entity, mesh };
 
+		// Runs as a continuation of the mesh load instead of waiting for it, so that no worker fiber is parked on it.
 		low_priority_job_queue.createJob<add_ray_tracing_data>([](add_ray_tracing_data& data, JobHandle)
 			{
-				data.mesh->loadJob.wait_for_completion();
-
 				struct create_component_data
 				{
 					Entity entity;
@@ -106,7 +106,7 @@ namespace era_engine
 						data.entity.add_component<RaytraceComponent>(data.blas);
 					}, createData).submit_now();
 
-			}, data).submit_now();
+			}, data).submit_after(mesh->loadJob);
 	}
 
 	//struct update_scripting_data
@@ -720,6 +720,12 @@ namespace era_engine
 
 		ref<World> world = world_scene->get_current_world();
 
+		if (animation::AnimationLodRootComponent* animation_lod_rc = world->get_root_component<animation::AnimationLodRootComponent>())
+		{
+			// Used by the next animation update, which runs before this one in the frame.
+			animation_lod_rc->set_viewer(camera);
+		}
+
 		float unscaledDt = dt;
 		dt *= world_scene->get_timestep_scale();
 
@@ -740,7 +746,7 @@ namespace era_engine
 		{
 			for (auto [entityHandle, transform, terrain] : world->group(components_group<TransformComponent, TerrainComponent>).each())
 			{
-				terrain.update();
+				terrain.update(transform.transform.position, camera.position);
 			}
 
 			scene_lighting lighting;
@@ -0,0 +1,371 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#pragma once
+
+#include "core_api.h"
+
+#include "core/sync.h"
+#include "core/memory_tracking.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace era_engine
+{
+	struct AssetCacheStats
+	{
+		uint64 hits = 0;
+		uint64 misses = 0;
+		uint64 in_flight_waits = 0; // Lookups that found the asset being loaded and waited for that load instead of starting another.
+		uint64 evictions = 0;
+
+		uint64 resident_size = 0;
+		uint64 budget = 0;
+	};
+
+	// Asset cache shared by all lookups of one asset type.
+	//
+	// Keys are spread over shards with their own lock, so lookups of different assets don't contend, and the loader runs outside of
+	// any lock. A key is only ever loaded once at a time: lookups that arrive while it is loading wait for that load.
+	//
+	// Every cached asset is tracked weakly, so it is found as long as anyone holds a reference. On top of that, the most recently used
+	// assets are kept alive by the cache until their total size exceeds the residency budget, after which the least recently used ones
+	// are released. The residency list is shared by all shards, so a single asset may use the whole budget. It has its own short lock,
+	// always taken after a shard lock. Sizes are measured on every hit. Assets which finish loading asynchronously are charged with
+	// their final size once their loader calls update_size; until then they may be counted with the size of their placeholder.
+	//
+	// The resident size is reported to memory tracking as committed memory of the cache's tag, and a limited budget as reserved memory.
+	template <typename Key_, typename Value_>
+	class AssetCache
+	{
+	public:
+		using SizeFunction = std::function<uint64(const Value_&)>;
+
+		static constexpr uint64 UNLIMITED_BUDGET = UINT64_MAX;
+
+		AssetCache(SizeFunction _size_function, uint64 _budget = UNLIMITED_BUDGET, MemoryTag _tag = memory_tag_general)
+			: size_function(std::move(_size_function)), budget(_budget), tag(_tag)
+		{
+			track_budget(_budget, 1);
+		}
+
+		~AssetCache()
+		{
+			track_committed(tag, -(int64)resident_size.load(std::memory_order_relaxed));
+			track_budget(budget.load(std::memory_order_relaxed), -1);
+		}
+
+		AssetCache(const AssetCache&) = delete;
+		AssetCache& operator=(const AssetCache&) = delete;
+
+		// Returns the cached asset, or calls loader (which returns ref<Value_>) to create it. Failed loads (nullptr) are not cached.
+		template <typename Loader_>
+		NODISCARD ref<Value_> get_or_load(const Key_& key, const Loader_& loader)
+		{
+			Shard& shard = get_shard(key);
+
+			{
+				std::unique_lock<std::mutex> lock(shard.sync);
+
+				auto it = shard.entries.find(key);
+				if (it != shard.entries.end() && it->second.loading)
+				{
+					++in_flight_waits;
+					shard.load_finished.wait(lock, [&shard, &key]()
+						{
+							auto it = shard.entries.find(key);
+							return it == shard.entries.end() || !it->second.loading;
+						});
+					it = shard.entries.find(key);
+				}
+
+				if (it != shard.entries.end())
+				{
+					if (ref<Value_> result = it->second.value.lock())
+					{
+						++hits;
+						touch(shard, key, it->second, result);
+						return result;
+					}
+				}
+
+				++misses;
+
+				Entry& entry = shard.entries[key];
+				entry.loading = true;
+			}
+
+			ref<Value_> result = loader();
+
+			{
+				std::unique_lock<std::mutex> lock(shard.sync);
+
+				auto it = shard.entries.find(key);
+				if (result)
+				{
+					Entry& entry = it->second;
+					entry.value = result;
+					entry.loading = false;
+					touch(shard, key, entry, result);
+				}
+				else
+				{
+					remove_resident(key);
+					shard.entries.erase(it);
+				}
+			}
+			shard.load_finished.notify_all();
+
+			return result;
+		}
+
+		// Returns the cached asset without loading it.
+		NODISCARD ref<Value_> find(const Key_& key)
+		{
+			Shard& shard = get_shard(key);
+			Lock lock{ shard.sync };
+
+			auto it = shard.entries.find(key);
+			if (it == shard.entries.end() || it->second.loading)
+			{
+				return nullptr;
+			}
+
+			ref<Value_> result = it->second.value.lock();
+			if (result)
+			{
+				++hits;
+				touch(shard, key, it->second, result);
+			}
+			return result;
+		}
+
+		// Puts an asset that was created outside of get_or_load into the cache.
+		void insert(const Key_& key, const ref<Value_>& value)
+		{
+			Shard& shard = get_shard(key);
+			Lock lock{ shard.sync };
+
+			Entry& entry = shard.entries[key];
+			ASSERT(!entry.loading);
+			entry.value = value;
+			touch(shard, key, entry, value);
+		}
+
+		// Forgets an asset. Anyone still holding a reference keeps it alive, but later lookups load it again.
+		void erase(const Key_& key)
+		{
+			Shard& shard = get_shard(key);
+			Lock lock{ shard.sync };
+
+			auto it = shard.entries.find(key);
+			if (it != shard.entries.end() && !it->second.loading)
+			{
+				remove_resident(key);
+				shard.entries.erase(it);
+			}
+		}
+
+		void clear()
+		{
+			for (Shard& shard : shards)
+			{
+				Lock lock{ shard.sync };
+
+				for (auto it = shard.entries.begin(); it != shard.entries.end();)
+				{
+					if (it->second.loading)
+					{
+						++it;
+						continue;
+					}
+
+					remove_resident(it->first);
+					it = shard.entries.erase(it);
+				}
+			}
+		}
+
+		// Measures a resident asset again, e.g. when an asynchronous load has created its GPU resources. Assets which are not resident
+		// (yet) are measured when they are inserted.
+		void update_size(const Key_& key)
+		{
+			std::vector<ref<Value_>> evicted;
+			{
+				Lock lock{ lru_sync };
+
+				auto it = resident_positions.find(key);
+				if (it == resident_positions.end())
+				{
+					return;
+				}
+
+				ResidentEntry& resident = *it->second;
+				const uint64 size = size_function ? size_function(*resident.value) : 0;
+				change_resident_size(size, resident.size);
+				resident.size = size;
+
+				evict_to_budget(evicted);
+			}
+		}
+
+		// Lowering the budget evicts right away.
+		void set_budget(uint64 _budget)
+		{
+			std::vector<ref<Value_>> evicted;
+			{
+				Lock lock{ lru_sync };
+
+				uint64 old_budget = budget.exchange(_budget, std::memory_order_relaxed);
+				track_budget(old_budget, -1);
+				track_budget(_budget, 1);
+
+				evict_to_budget(evicted);
+			}
+		}
+
+		NODISCARD AssetCacheStats get_stats() const
+		{
+			AssetCacheStats stats;
+			stats.hits = hits.load(std::memory_order_relaxed);
+			stats.misses = misses.load(std::memory_order_relaxed);
+			stats.in_flight_waits = in_flight_waits.load(std::memory_order_relaxed);
+			stats.evictions = evictions.load(std::memory_order_relaxed);
+			stats.resident_size = resident_size.load(std::memory_order_relaxed);
+			stats.budget = budget.load(std::memory_order_relaxed);
+			return stats;
+		}
+
+	private:
+		static constexpr uint32 NUM_SHARDS = 16;
+
+		struct Entry
+		{
+			weakref<Value_> value;
+			bool loading = false;
+		};
+
+		struct Shard
+		{
+			std::mutex sync;
+			std::condition_variable load_finished;
+
+			std::unordered_map<Key_, Entry> entries;
+		};
+
+		// Strong reference while the asset is within the residency budget.
+		struct ResidentEntry
+		{
+			Key_ key;
+			ref<Value_> value;
+			uint64 size = 0;
+		};
+
+		using ResidentList = std::list<ResidentEntry>;
+
+		Shard& get_shard(const Key_& key)
+		{
+			return shards[std::hash<Key_>()(key) % NUM_SHARDS];
+		}
+
+		// Called with the key's shard locked.
+		void touch(Shard& shard, const Key_& key, Entry& entry, const ref<Value_>& value)
+		{
+			const uint64 size = size_function ? size_function(*value) : 0;
+
+			// Evicted assets are released after unlocking the residency list, their destructors may be expensive.
+			std::vector<ref<Value_>> evicted;
+			{
+				Lock lock{ lru_sync };
+
+				auto it = resident_positions.find(key);
+				if (it != resident_positions.end())
+				{
+					ResidentEntry& resident = *it->second;
+					lru.splice(lru.begin(), lru, it->second);
+					change_resident_size(size, resident.size);
+					resident.size = size;
+				}
+				else if (size <= budget.load(std::memory_order_relaxed))
+				{
+					lru.push_front({ key, value, size });
+					resident_positions.emplace(key, lru.begin());
+					change_resident_size(size, 0);
+				}
+
+				evict_to_budget(evicted);
+			}
+		}
+
+		// Called with lru_sync locked.
+		void evict_to_budget(std::vector<ref<Value_>>& evicted)
+		{
+			const uint64 current_budget = budget.load(std::memory_order_relaxed);
+			while (resident_size.load(std::memory_order_relaxed) > current_budget && !lru.empty())
+			{
+				ResidentEntry& resident = lru.back();
+				evicted.push_back(std::move(resident.value));
+				change_resident_size(0, resident.size);
+				resident_positions.erase(resident.key);
+				lru.pop_back();
+				++evictions;
+			}
+		}
+
+		void remove_resident(const Key_& key)
+		{
+			ref<Value_> value;
+			{
+				Lock lock{ lru_sync };
+
+				auto it = resident_positions.find(key);
+				if (it == resident_positions.end())
+				{
+					return;
+				}
+
+				value = std::move(it->second->value);
+				change_resident_size(0, it->second->size);
+				lru.erase(it->second);
+				resident_positions.erase(it);
+			}
+		}
+
+		void change_resident_size(uint64 added, uint64 removed)
+		{
+			resident_size.fetch_add(added - removed, std::memory_order_relaxed);
+			track_committed(tag, (int64)added - (int64)removed);
+		}
+
+		void track_budget(uint64 _budget, int64 sign)
+		{
+			if (_budget != UNLIMITED_BUDGET)
+			{
+				track_reserved(tag, sign * (int64)_budget);
+			}
+		}
+
+		SizeFunction size_function;
+		Shard shards[NUM_SHARDS];
+
+		// Resident assets of all shards, most recently used first.
+		std::mutex lru_sync;
+		ResidentList lru;
+		std::unordered_map<Key_, typename ResidentList::iterator> resident_positions;
+
+		std::atomic<uint64> budget;
+		std::atomic<uint64> resident_size = 0;
+
+		MemoryTag tag;
+
+		std::atomic<uint64> hits = 0;
+		std::atomic<uint64> misses = 0;
+		std::atomic<uint64> in_flight_waits = 0;
+		std::atomic<uint64> evictions = 0;
+	};
+}
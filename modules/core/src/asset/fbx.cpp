@@ -1860,6 +1860,11 @@ namespace era_engine
 		}
 
 		generateNormalsAndTangents(mesh.submeshes, flags);
+
+		if (flags & mesh_flag_optimize_vertex_cache)
+		{
+			optimizeSubmeshes(mesh.submeshes, mesh.model ? name_to_string(mesh.model->name) : std::string("FBX mesh"));
+		}
 	}
 
 	static float sampleAnimationCurve(fbx_animation_curve* curve, int64 time, const std::vector<int64>& animationTimes, const std::vector<float>& animationValues)
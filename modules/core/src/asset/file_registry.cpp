@@ -14,17 +14,197 @@ namespace era_engine
 	typedef std::unordered_map<fs::path, AssetHandle> path_to_handle;
 	typedef std::unordered_map<AssetHandle, fs::path> handle_to_path;
 
+	struct FileInfo
+	{
+		uint64 size = 0;
+		int64 lastWriteTime = 0;
+	};
+
 	static path_to_handle pathToHandle;
 	static handle_to_path handleToPath;
+	static std::unordered_map<AssetHandle, FileInfo> handleToInfo;
+
+	// Last write time of every directory at the time it was scanned. A directory's last write time changes when entries are added to,
+	// removed from or renamed in it, so a directory whose time is unchanged on startup can reuse its files from the registry.
+	static std::unordered_map<fs::path, int64> directoryWriteTimes;
 
 	static std::mutex fileRegistryMutex;
-	static const fs::path registryPath = fs::path(get_asset_path(L"/resources/files.yaml")).lexically_normal();
+	static const fs::path assetsPath = fs::path(get_asset_path(L"/resources/assets")).lexically_normal();
+	static const fs::path registryPath = fs::path(get_asset_path(L"/resources/files.bin")).lexically_normal();
+	static const fs::path legacyRegistryPath = fs::path(get_asset_path(L"/resources/files.yaml")).lexically_normal();
+
+	// Binary registry layout: header, directory records, file records grouped by directory, then the UTF-8 paths (relative to the assets
+	// directory) the records point into.
+	static constexpr uint32 registryMagic = 0x47524645; // "EFRG"
+	static constexpr uint32 registryVersion = 1;
+
+	struct RegistryHeader
+	{
+		uint32 magic;
+		uint32 version;
+		uint32 numDirectories;
+		uint32 numFiles;
+		uint64 stringsSize;
+	};
+
+	struct RegistryDirectory
+	{
+		uint64 pathHash;
+		int64 lastWriteTime;
+		uint32 pathOffset;
+		uint32 pathLength;
+		uint32 firstFile;
+		uint32 numFiles;
+	};
+
+	struct RegistryFile
+	{
+		uint64 pathHash;
+		uint64 handle;
+		uint64 size;
+		int64 lastWriteTime;
+		uint32 pathOffset;
+		uint32 pathLength;
+	};
+
+	struct LoadedRegistry
+	{
+		std::vector<uint8> buffer;
+
+		const RegistryDirectory* directories = nullptr;
+		const RegistryFile* files = nullptr;
+		const char* strings = nullptr;
+
+		std::unordered_map<uint64, uint32> directoryByHash;
+		std::unordered_map<uint64, uint32> fileByHash;
+
+		// Directory indices by parent directory index.
+		std::vector<std::vector<uint32>> subdirectories;
+
+		fs::path getPath(uint32 offset, uint32 length) const
+		{
+			fs::path path = assetsPath / fs::path(std::u8string_view((const char8_t*)strings + offset, length));
+			return path.make_preferred();
+		}
+	};
+
+	static std::u8string getRelativePath(const fs::path& path)
+	{
+		return path.lexically_relative(assetsPath).generic_u8string();
+	}
+
+	static uint64 hashRelativePath(const std::u8string& relativePath)
+	{
+		return hash_string64((const char*)relativePath.c_str());
+	}
+
+	static int64 toRegistryTime(fs::file_time_type time)
+	{
+		return (int64)time.time_since_epoch().count();
+	}
+
+	static bool loadRegistryFromDisk(LoadedRegistry& registry)
+	{
+		std::ifstream stream(registryPath, std::ios::binary | std::ios::ate);
+		if (!stream)
+		{
+			return false;
+		}
+
+		const uint64 fileSize = (uint64)stream.tellg();
+		if (fileSize < sizeof(RegistryHeader))
+		{
+			return false;
+		}
+
+		registry.buffer.resize(fileSize);
+		stream.seekg(0);
+		stream.read((char*)registry.buffer.data(), fileSize);
+		if (!stream)
+		{
+			return false;
+		}
+
+		const RegistryHeader& header = *(const RegistryHeader*)registry.buffer.data();
+		if (header.magic != registryMagic || header.version != registryVersion)
+		{
+			LOG_WARNING("File registry '%ws' has an unknown format, rescanning all assets", registryPath.c_str());
+			return false;
+		}
+
+		const uint64 directoriesOffset = sizeof(RegistryHeader);
+		const uint64 filesOffset = directoriesOffset + header.numDirectories * sizeof(RegistryDirectory);
+		const uint64 stringsOffset = filesOffset + header.numFiles * sizeof(RegistryFile);
+		if (stringsOffset + header.stringsSize != fileSize)
+		{
+			LOG_WARNING("File registry '%ws' is truncated, rescanning all assets", registryPath.c_str());
+			return false;
+		}
+
+		registry.directories = (const RegistryDirectory*)(registry.buffer.data() + directoriesOffset);
+		registry.files = (const RegistryFile*)(registry.buffer.data() + filesOffset);
+		registry.strings = (const char*)(registry.buffer.data() + stringsOffset);
+
+		registry.directoryByHash.reserve(header.numDirectories);
+		registry.fileByHash.reserve(header.numFiles);
+		registry.subdirectories.resize(header.numDirectories);
+
+		for (uint32 i = 0; i < header.numDirectories; ++i)
+		{
+			const RegistryDirectory& directory = registry.directories[i];
+			if (directory.pathOffset + (uint64)directory.pathLength > header.stringsSize
+				|| directory.firstFile + (uint64)directory.numFiles > header.numFiles)
+			{
+				LOG_WARNING("File registry '%ws' is corrupt, rescanning all assets", registryPath.c_str());
+				return false;
+			}
+			registry.directoryByHash[directory.pathHash] = i;
+		}
+
+		for (uint32 i = 0; i < header.numFiles; ++i)
+		{
+			const RegistryFile& file = registry.files[i];
+			if (file.pathOffset + (uint64)file.pathLength > header.stringsSize)
+			{
+				LOG_WARNING("File registry '%ws' is corrupt, rescanning all assets", registryPath.c_str());
+				return false;
+			}
+			registry.fileByHash[file.pathHash] = i;
+		}
+
+		for (uint32 i = 0; i < header.numDirectories; ++i)
+		{
+			const RegistryDirectory& directory = registry.directories[i];
+			if (directory.pathLength == 0)
+			{
+				continue; // Assets directory.
+			}
+
+			std::u8string_view path((const char8_t*)registry.strings + directory.pathOffset, directory.pathLength);
+			size_t separator = path.find_last_of(u8'/');
+			std::u8string parent(separator == std::u8string_view::npos ? std::u8string_view() : path.substr(0, separator));
+
+			auto it = registry.directoryByHash.find(hashRelativePath(parent));
+			if (it != registry.directoryByHash.end())
+			{
+				registry.subdirectories[it->second].push_back(i);
+			}
+		}
+
+		return true;
+	}
 
-	static path_to_handle loadRegistryFromDisk()
+	// Registries written before the binary format. Only handles are taken over, everything is rescanned.
+	static path_to_handle loadLegacyRegistryFromDisk()
 	{
 		path_to_handle loadedRegistry;
 
-		std::ifstream stream(registryPath);
+		std::ifstream stream(legacyRegistryPath);
+		if (!stream)
+		{
+			return loadedRegistry;
+		}
+
 		YAML::Node n = YAML::Load(stream);
 
 		for (auto entryNode : n)
@@ -46,39 +226,190 @@ namespace era_engine
 
 	static void writeRegistryToDisk()
 	{
-		YAML::Node out;
+		std::unordered_map<fs::path, std::vector<std::pair<const fs::path*, AssetHandle>>> filesByDirectory;
+		filesByDirectory.reserve(directoryWriteTimes.size());
 
 		for (const auto& [path, handle] : pathToHandle)
 		{
-			YAML::Node n;
-			n["Handle"] = handle;
-			n["Path"] = path;
-			out.push_back(n);
+			filesByDirectory[path.parent_path()].emplace_back(&path, handle);
+		}
+
+		std::vector<RegistryDirectory> directories;
+		std::vector<RegistryFile> files;
+		std::string strings;
+
+		directories.reserve(filesByDirectory.size() + directoryWriteTimes.size());
+		files.reserve(pathToHandle.size());
+
+		auto addString = [&strings](const std::u8string& string, uint32& offset, uint32& length)
+		{
+			offset = (uint32)strings.size();
+			length = (uint32)string.size();
+			strings.append((const char*)string.data(), string.size());
+		};
+
+		auto addDirectory = [&](const fs::path& path, int64 lastWriteTime)
+		{
+			std::u8string relativePath = getRelativePath(path);
+			if (relativePath == u8".")
+			{
+				relativePath.clear();
+			}
+
+			RegistryDirectory& directory = directories.emplace_back();
+			directory.pathHash = hashRelativePath(relativePath);
+			directory.lastWriteTime = lastWriteTime;
+			addString(relativePath, directory.pathOffset, directory.pathLength);
+			directory.firstFile = (uint32)files.size();
+			directory.numFiles = 0;
+
+			auto it = filesByDirectory.find(path);
+			if (it == filesByDirectory.end())
+			{
+				return;
+			}
+
+			for (const auto& [filePath, handle] : it->second)
+			{
+				std::u8string relativeFilePath = getRelativePath(*filePath);
+
+				auto infoIt = handleToInfo.find(handle);
+				const FileInfo info = (infoIt != handleToInfo.end()) ? infoIt->second : FileInfo{};
+
+				RegistryFile& file = files.emplace_back();
+				file.pathHash = hashRelativePath(relativeFilePath);
+				file.handle = handle.value;
+				file.size = info.size;
+				file.lastWriteTime = info.lastWriteTime;
+				addString(relativeFilePath, file.pathOffset, file.pathLength);
+			}
+			directory.numFiles = (uint32)it->second.size();
+			filesByDirectory.erase(it);
+		};
+
+		for (const auto& [path, lastWriteTime] : directoryWriteTimes)
+		{
+			addDirectory(path, lastWriteTime);
+		}
+
+		// Directories that appeared after the scan. A zero time makes the next startup rescan them.
+		while (!filesByDirectory.empty())
+		{
+			fs::path path = filesByDirectory.begin()->first;
+			addDirectory(path, 0);
 		}
 
+		RegistryHeader header;
+		header.magic = registryMagic;
+		header.version = registryVersion;
+		header.numDirectories = (uint32)directories.size();
+		header.numFiles = (uint32)files.size();
+		header.stringsSize = strings.size();
+
 		fs::create_directories(registryPath.parent_path());
-		std::ofstream fout(registryPath);
-		fout << out;
+		std::ofstream fout(registryPath, std::ios::binary | std::ios::trunc);
+		fout.write((const char*)&header, sizeof(header));
+		fout.write((const char*)directories.data(), directories.size() * sizeof(RegistryDirectory));
+		fout.write((const char*)files.data(), files.size() * sizeof(RegistryFile));
+		fout.write(strings.data(), strings.size());
+	}
+
+	static void addFile(const fs::path& path, AssetHandle handle, const FileInfo& info)
+	{
+		pathToHandle.insert({ path, handle });
+		handleToPath.insert({ handle, path });
+		handleToInfo.insert({ handle, info });
 	}
 
-	static void readDirectory(const fs::path& path, const path_to_handle& loadedRegistry)
+	static FileInfo readFileInfo(const fs::path& path)
 	{
+		std::error_code error;
+		FileInfo info;
+		info.size = (uint64)fs::file_size(path, error);
+		info.lastWriteTime = toRegistryTime(fs::last_write_time(path, error));
+		return info;
+	}
+
+	static void readDirectory(const fs::path& path, const LoadedRegistry* loadedRegistry, const path_to_handle& legacyRegistry)
+	{
+		std::error_code error;
+		const int64 lastWriteTime = toRegistryTime(fs::last_write_time(path, error));
+		if (error)
+		{
+			return;
+		}
+
+		directoryWriteTimes[path] = lastWriteTime;
+
+		if (loadedRegistry)
+		{
+			std::u8string relativePath = getRelativePath(path);
+			if (relativePath == u8".")
+			{
+				relativePath.clear();
+			}
+
+			auto it = loadedRegistry->directoryByHash.find(hashRelativePath(relativePath));
+			if (it != loadedRegistry->directoryByHash.end())
+			{
+				const RegistryDirectory& directory = loadedRegistry->directories[it->second];
+				if (directory.lastWriteTime == lastWriteTime && lastWriteTime != 0)
+				{
+					// Nothing was added, removed or renamed here. Reuse the files and only check the subdirectories.
+					for (uint32 i = directory.firstFile; i < directory.firstFile + directory.numFiles; ++i)
+					{
+						const RegistryFile& file = loadedRegistry->files[i];
+						addFile(loadedRegistry->getPath(file.pathOffset, file.pathLength), AssetHandle(file.handle), FileInfo{ file.size, file.lastWriteTime });
+					}
+
+					for (uint32 subdirectory : loadedRegistry->subdirectories[it->second])
+					{
+						const RegistryDirectory& sub = loadedRegistry->directories[subdirectory];
+						readDirectory(loadedRegistry->getPath(sub.pathOffset, sub.pathLength), loadedRegistry, legacyRegistry);
+					}
+					return;
+				}
+			}
+		}
+
 		for (const auto& dirEntry : fs::directory_iterator(path))
 		{
 			const auto& path = dirEntry.path();
 			if (dirEntry.is_directory())
 			{
-				readDirectory(path, loadedRegistry);
+				readDirectory(path, loadedRegistry, legacyRegistry);
 			}
 			else
 			{
-				auto it = loadedRegistry.find(path);
-
 				// If already known, use the handle, otherwise generate one.
-				AssetHandle handle = (it != loadedRegistry.end()) ? it->second : AssetHandle::generate();
+				AssetHandle handle = {};
+				if (loadedRegistry)
+				{
+					auto it = loadedRegistry->fileByHash.find(hashRelativePath(getRelativePath(path)));
+					if (it != loadedRegistry->fileByHash.end())
+					{
+						handle = AssetHandle(loadedRegistry->files[it->second].handle);
+					}
+				}
+				else
+				{
+					auto it = legacyRegistry.find(path);
+					if (it != legacyRegistry.end())
+					{
+						handle = it->second;
+					}
+				}
+
+				if (!handle)
+				{
+					handle = AssetHandle::generate();
+				}
+
+				FileInfo info;
+				info.size = (uint64)dirEntry.file_size(error);
+				info.lastWriteTime = toRegistryTime(dirEntry.last_write_time(error));
 
-				pathToHandle.insert({ path, handle });
-				handleToPath.insert({ handle, path });
+				addFile(path, handle, info);
 			}
 		}
 	}
@@ -97,9 +428,7 @@ namespace era_engine
 
 					ASSERT(pathToHandle.find(e.path) == pathToHandle.end());
 
-					AssetHandle handle = AssetHandle::generate();
-					pathToHandle.insert({ e.path, handle });
-					handleToPath.insert({ handle, e.path });
+					addFile(e.path, AssetHandle::generate(), readFileInfo(e.path));
 				} break;
 
 				case FileSystemChange::Delete:
@@ -113,11 +442,18 @@ namespace era_engine
 					AssetHandle handle = it->second;
 					pathToHandle.erase(it);
 					handleToPath.erase(handle);
+					handleToInfo.erase(handle);
 				} break;
 
 				case FileSystemChange::Modify:
 				{
 					LOG_MESSAGE("Asset '%ws' modified", e.path.c_str());
+
+					auto it = pathToHandle.find(e.path);
+					if (it != pathToHandle.end())
+					{
+						handleToInfo[it->second] = readFileInfo(e.path);
+					}
 				} break;
 
 				case FileSystemChange::Rename:
@@ -169,11 +505,19 @@ namespace era_engine
 
 	void initializeFileRegistry()
 	{
-		auto loadedRegistry = loadRegistryFromDisk();
-		readDirectory(get_asset_path(L"/resources/assets"), loadedRegistry);
+		LoadedRegistry loadedRegistry;
+		path_to_handle legacyRegistry;
+
+		const bool loaded = loadRegistryFromDisk(loadedRegistry);
+		if (!loaded)
+		{
+			legacyRegistry = loadLegacyRegistryFromDisk();
+		}
+
+		readDirectory(assetsPath, loaded ? &loadedRegistry : nullptr, legacyRegistry);
 		writeRegistryToDisk();
 
-		observe_directory(get_asset_path(L"/resources/assets"), handleAssetChange);
+		observe_directory(assetsPath, handleAssetChange);
 	}
 
 }
\ No newline at end of file
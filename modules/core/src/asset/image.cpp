@@ -1,6 +1,7 @@
 // Copyright (c) 2023-present Eldar Muradov. All rights reserved.
 
 #include "asset/image.h"
+#include "asset/image_processing.h"
 
 #include "core/memory.h"
 #include "core/log.h"
@@ -14,6 +15,8 @@
 #include <nanosvg/nanosvgrast.h>
 #include <wincodec.h>
 
+#include <fstream>
+
 namespace era_engine
 {
 	bool isImageExtension(const fs::path& extension)
@@ -73,37 +76,39 @@ namespace era_engine
 		return format;
 	}
 
-	static bool tryLoadFromCache(const fs::path& filepath, uint32 flags, fs::path& cacheFilepath, DirectX::ScratchImage& scratchImage, DirectX::TexMetadata& metadata)
+	// Returns true if the DDS cache of filepath for these flags exists and is newer than the original.
+	static bool findUpToDateCache(const fs::path& filepath, uint32 flags, fs::path& cacheFilepath)
 	{
 		fs::path cachedFilename = filepath;
 		cachedFilename.replace_extension("." + std::to_string(flags) + ".cache.dds");
 
 		cacheFilepath = L"asset_cache" / cachedFilename;
 
-		bool fromCache = false;
+		if (flags & image_load_flags_always_load_from_source)
+		{
+			return false;
+		}
 
-		if (!(flags & image_load_flags_always_load_from_source))
+		WIN32_FILE_ATTRIBUTE_DATA cachedData;
+		if (!GetFileAttributesExW(cacheFilepath.c_str(), GetFileExInfoStandard, &cachedData))
 		{
-			// Look for cached.
+			return false;
+		}
 
-			WIN32_FILE_ATTRIBUTE_DATA cachedData;
-			if (GetFileAttributesExW(cacheFilepath.c_str(), GetFileExInfoStandard, &cachedData))
-			{
-				FILETIME cachedFiletime = cachedData.ftLastWriteTime;
+		FILETIME cachedFiletime = cachedData.ftLastWriteTime;
 
-				WIN32_FILE_ATTRIBUTE_DATA originalData;
-				ASSERT(GetFileAttributesExW(filepath.c_str(), GetFileExInfoStandard, &originalData));
-				FILETIME originalFiletime = originalData.ftLastWriteTime;
+		WIN32_FILE_ATTRIBUTE_DATA originalData;
+		ASSERT(GetFileAttributesExW(filepath.c_str(), GetFileExInfoStandard, &originalData));
+		FILETIME originalFiletime = originalData.ftLastWriteTime;
 
-				if (CompareFileTime(&cachedFiletime, &originalFiletime) >= 0)
-				{
-					// Cached file is newer than original, so load this.
-					fromCache = SUCCEEDED(DirectX::LoadFromDDSFile(cacheFilepath.c_str(), DirectX::DDS_FLAGS_NONE, &metadata, scratchImage));
-				}
-			}
-		}
+		return CompareFileTime(&cachedFiletime, &originalFiletime) >= 0;
+	}
 
-		return fromCache;
+	static bool tryLoadFromCache(const fs::path& filepath, uint32 flags, fs::path& cacheFilepath, DirectX::ScratchImage& scratchImage, DirectX::TexMetadata& metadata)
+	{
+		// Cached file is newer than original, so load this.
+		return findUpToDateCache(filepath, flags, cacheFilepath)
+			&& SUCCEEDED(DirectX::LoadFromDDSFile(cacheFilepath.c_str(), DirectX::DDS_FLAGS_NONE, &metadata, scratchImage));
 	}
 
 	static void createDesc(DirectX::TexMetadata& metadata, uint32 flags, D3D12_RESOURCE_DESC& textureDesc)
@@ -147,7 +152,10 @@ namespace era_engine
 		{
 			DirectX::ScratchImage mipchainImage;
 
-			checkResult(DirectX::GenerateMipMaps(scratchImage.GetImages(), scratchImage.GetImageCount(), metadata, DirectX::TEX_FILTER_DEFAULT, 0, mipchainImage));
+			if (!generateMipMapsParallel(scratchImage, mipchainImage))
+			{
+				checkResult(DirectX::GenerateMipMaps(scratchImage.GetImages(), scratchImage.GetImageCount(), metadata, DirectX::TEX_FILTER_DEFAULT, 0, mipchainImage));
+			}
 			scratchImage = std::move(mipchainImage);
 			metadata = scratchImage.GetMetadata();
 		}
@@ -189,6 +197,7 @@ namespace era_engine
 			if (metadata.width % 4 == 0 && metadata.height % 4 == 0)
 			{
 				uint32 numChannels = getNumberOfChannels(metadata.format);
+				image_compression_quality quality = getImageCompressionQuality();
 
 				DXGI_FORMAT compressedFormat;
 
@@ -206,15 +215,25 @@ namespace era_engine
 					}
 					else
 					{
-						compressedFormat = DirectX::IsSRGB(metadata.format) ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;  // 7 would be better, but takes forever to compress.
+						if (quality == image_compression_quality_high)
+						{
+							compressedFormat = DirectX::IsSRGB(metadata.format) ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+						}
+						else
+						{
+							compressedFormat = DirectX::IsSRGB(metadata.format) ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+						}
 					}
 				} break;
 				}
 
 				DirectX::ScratchImage compressedImage;
 
-				checkResult(DirectX::Compress(scratchImage.GetImages(), scratchImage.GetImageCount(), metadata,
-					compressedFormat, DirectX::TEX_COMPRESS_PARALLEL, DirectX::TEX_THRESHOLD_DEFAULT, compressedImage));
+				if (!compressImageParallel(scratchImage, compressedFormat, quality, compressedImage))
+				{
+					checkResult(DirectX::Compress(scratchImage.GetImages(), scratchImage.GetImageCount(), metadata,
+						compressedFormat, DirectX::TEX_COMPRESS_PARALLEL, DirectX::TEX_THRESHOLD_DEFAULT, compressedImage));
+				}
 				scratchImage = std::move(compressedImage);
 				metadata = scratchImage.GetMetadata();
 			}
@@ -358,6 +377,69 @@ namespace era_engine
 		return true;
 	}
 
+	bool loadImageMipsFromCache(const fs::path& filepath, uint32 flags, uint32 firstMip, uint32 numMips, DirectX::ScratchImage& scratchImage)
+	{
+		fs::path cacheFilepath;
+		if (!findUpToDateCache(filepath, flags, cacheFilepath))
+		{
+			return false;
+		}
+
+		DirectX::TexMetadata metadata;
+		if (FAILED(DirectX::GetMetadataFromDDSFile(cacheFilepath.c_str(), DirectX::DDS_FLAGS_NONE, metadata)))
+		{
+			return false;
+		}
+
+		if (metadata.dimension != DirectX::TEX_DIMENSION_TEXTURE2D || metadata.arraySize != 1 || metadata.IsCubemap()
+			|| numMips == 0 || firstMip + numMips > (uint32)metadata.mipLevels)
+		{
+			return false;
+		}
+
+		std::ifstream stream(cacheFilepath, std::ios::binary);
+		if (!stream)
+		{
+			return false;
+		}
+
+		// Magic number and DDS_HEADER, followed by a DDS_HEADER_DXT10 if the pixel format's four CC is 'DX10'. The mips follow tightly
+		// packed, most detailed first.
+		constexpr uint32 headerSize = 4 + 124;
+		constexpr uint32 fourCCOffset = 4 + 72 + 8;
+		constexpr uint32 dx10HeaderSize = 20;
+
+		uint8 header[headerSize];
+		if (!stream.read((char*)header, headerSize))
+		{
+			return false;
+		}
+
+		uint32 fourCC;
+		memcpy(&fourCC, header + fourCCOffset, sizeof(fourCC));
+		constexpr uint32 dx10FourCC = 'D' | ('X' << 8) | ('1' << 16) | ('0' << 24);
+		uint64 offset = headerSize + ((fourCC == dx10FourCC) ? dx10HeaderSize : 0);
+
+		for (uint32 mip = 0; mip < firstMip; ++mip)
+		{
+			size_t rowPitch, slicePitch;
+			if (FAILED(DirectX::ComputePitch(metadata.format, max(1u, (uint32)metadata.width >> mip), max(1u, (uint32)metadata.height >> mip), rowPitch, slicePitch)))
+			{
+				return false;
+			}
+			offset += slicePitch;
+		}
+
+		if (FAILED(scratchImage.Initialize2D(metadata.format, max(1u, (uint32)metadata.width >> firstMip), max(1u, (uint32)metadata.height >> firstMip), 1, numMips)))
+		{
+			return false;
+		}
+
+		// ScratchImage uses the same tight pitches as the file, so the requested mips are read in one go.
+		stream.seekg((std::streamoff)offset);
+		return (bool)stream.read((char*)scratchImage.GetPixels(), (std::streamsize)scratchImage.GetPixelsSize());
+	}
+
 	bool loadImageFromFile(const fs::path& filepath, uint32 flags, DirectX::ScratchImage& scratchImage, D3D12_RESOURCE_DESC& textureDesc)
 	{
 		fs::path cacheFilepath;
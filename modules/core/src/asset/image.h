@@ -48,6 +48,10 @@ namespace era_engine
 	bool loadImageFromFile(const fs::path& filepath, uint32 flags, DirectX::ScratchImage& scratchImage, D3D12_RESOURCE_DESC& textureDesc);
 	bool loadSVGFromFile(const fs::path& filepath, uint32 flags, DirectX::ScratchImage& scratchImage, D3D12_RESOURCE_DESC& textureDesc);
 
+	// Reads mips firstMip..firstMip+numMips-1 of a 2D image from its up to date DDS cache, without reading the rest of the file. Fails if
+	// there is no such cache. Used by mip streaming.
+	bool loadImageMipsFromCache(const fs::path& filepath, uint32 flags, uint32 firstMip, uint32 numMips, DirectX::ScratchImage& scratchImage);
+
 	bool saveImageToFile(const fs::path& filepath, DirectX::Image image);
 
 	NODISCARD inline constexpr bool isUAVCompatibleFormat(DXGI_FORMAT format)
@@ -0,0 +1,890 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#include "asset/image_processing.h"
+
+#include "core/job_system.h"
+#include "core/simd.h"
+
+#include <DirectXTex/DirectXTex.h>
+
+#include <array>
+#include <functional>
+
+namespace era_engine
+{
+	static std::atomic<image_compression_quality> compressionQuality = image_compression_quality_normal;
+
+	void setImageCompressionQuality(image_compression_quality quality)
+	{
+		compressionQuality.store(quality, std::memory_order_relaxed);
+	}
+
+	image_compression_quality getImageCompressionQuality()
+	{
+		return compressionQuality.load(std::memory_order_relaxed);
+	}
+
+	// Calls function(first, count) for consecutive ranges of [0, count), spread over the low priority job queue.
+	static void parallelFor(uint32 count, uint32 minCountPerJob, const std::function<void(uint32, uint32)>& function)
+	{
+		const uint32 maxNumJobs = get_num_job_threads() * 4;
+		const uint32 numJobs = min(maxNumJobs, count / max(minCountPerJob, 1u));
+
+		if (numJobs <= 1)
+		{
+			function(0, count);
+			return;
+		}
+
+		struct parallel_for_data
+		{
+			const std::function<void(uint32, uint32)>* function;
+			uint32 first;
+			uint32 count;
+			uint32 numJobs;
+		};
+
+		parallel_for_data data = { &function, 0, count, numJobs };
+
+		JobHandle parentJob = low_priority_job_queue.createJob<parallel_for_data>([](parallel_for_data& data, JobHandle parent)
+			{
+				uint32 first = 0;
+				for (uint32 i = 0; i < data.numJobs; ++i)
+				{
+					uint32 end = (uint32)((uint64)data.count * (i + 1) / data.numJobs);
+
+					parallel_for_data range = { data.function, first, end - first, 1 };
+					low_priority_job_queue.createJob<parallel_for_data>([](parallel_for_data& range, JobHandle)
+						{
+							(*range.function)(range.first, range.count);
+						}, range, parent).submit_now();
+
+					first = end;
+				}
+			}, data);
+
+		parentJob.submit_now();
+
+		// Called from texture loading jobs, which may hold thread-affine state across this call.
+		parentJob.wait_for_completion_on_this_thread();
+	}
+
+	// Byte offsets of R, G, B and A in a pixel, or -1 if the format doesn't have the channel.
+	struct pixel_layout
+	{
+		uint32 bytesPerPixel = 0;
+		int32 offsets[4] = { -1, -1, -1, -1 };
+		bool srgb = false;
+	};
+
+	static bool getPixelLayout(DXGI_FORMAT format, pixel_layout& layout)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_R8G8B8A8_UNORM:
+		case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+			layout = { 4, { 0, 1, 2, 3 }, DirectX::IsSRGB(format) };
+			return true;
+
+		case DXGI_FORMAT_B8G8R8A8_UNORM:
+		case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		case DXGI_FORMAT_B8G8R8X8_UNORM:
+		case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+			layout = { 4, { 2, 1, 0, 3 }, DirectX::IsSRGB(format) };
+			return true;
+
+		case DXGI_FORMAT_R8G8_UNORM:
+			layout = { 2, { 0, 1, -1, -1 }, false };
+			return true;
+
+		case DXGI_FORMAT_R8_UNORM:
+			layout = { 1, { 0, -1, -1, -1 }, false };
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
+	// ----------------------------------------
+	// Mip generation.
+	// ----------------------------------------
+
+	static const float* getSRGBToLinearTable()
+	{
+		static const auto table = []()
+		{
+			std::array<float, 256> result;
+			for (uint32 i = 0; i < 256; ++i)
+			{
+				float c = i / 255.f;
+				result[i] = (c <= 0.04045f) ? (c / 12.92f) : powf((c + 0.055f) / 1.055f, 2.4f);
+			}
+			return result;
+		}();
+		return table.data();
+	}
+
+	static constexpr uint32 LINEAR_TO_SRGB_TABLE_SIZE = 16384;
+
+	static const uint8* getLinearToSRGBTable()
+	{
+		static const auto table = []()
+		{
+			std::array<uint8, LINEAR_TO_SRGB_TABLE_SIZE> result;
+			for (uint32 i = 0; i < LINEAR_TO_SRGB_TABLE_SIZE; ++i)
+			{
+				float c = i / (float)(LINEAR_TO_SRGB_TABLE_SIZE - 1);
+				float s = (c <= 0.0031308f) ? (c * 12.92f) : (1.055f * powf(c, 1.f / 2.4f) - 0.055f);
+				result[i] = (uint8)(s * 255.f + 0.5f);
+			}
+			return result;
+		}();
+		return table.data();
+	}
+
+	static void downsampleRows(const DirectX::Image& source, const DirectX::Image& destination, const pixel_layout& layout, uint32 firstRow, uint32 numRows)
+	{
+		const float* toLinear = getSRGBToLinearTable();
+		const uint8* toSRGB = getLinearToSRGBTable();
+
+		const uint32 bpp = layout.bytesPerPixel;
+		const uint32 sourceWidth = (uint32)source.width;
+		const uint32 sourceHeight = (uint32)source.height;
+
+		for (uint32 y = firstRow; y < firstRow + numRows; ++y)
+		{
+			const uint8* row0 = source.pixels + min(2 * y, sourceHeight - 1) * source.rowPitch;
+			const uint8* row1 = source.pixels + min(2 * y + 1, sourceHeight - 1) * source.rowPitch;
+			uint8* out = destination.pixels + y * destination.rowPitch;
+
+			for (uint32 x = 0; x < (uint32)destination.width; ++x)
+			{
+				const uint32 x0 = min(2 * x, sourceWidth - 1) * bpp;
+				const uint32 x1 = min(2 * x + 1, sourceWidth - 1) * bpp;
+
+				for (uint32 c = 0; c < bpp; ++c)
+				{
+					// The alpha channel of sRGB formats is linear.
+					if (layout.srgb && c != (uint32)layout.offsets[3])
+					{
+						float sum = toLinear[row0[x0 + c]] + toLinear[row0[x1 + c]] + toLinear[row1[x0 + c]] + toLinear[row1[x1 + c]];
+						out[x * bpp + c] = toSRGB[(uint32)(sum * 0.25f * (LINEAR_TO_SRGB_TABLE_SIZE - 1) + 0.5f)];
+					}
+					else
+					{
+						uint32 sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+						out[x * bpp + c] = (uint8)((sum + 2) / 4);
+					}
+				}
+			}
+		}
+	}
+
+	bool generateMipMapsParallel(const DirectX::ScratchImage& image, DirectX::ScratchImage& mipchain)
+	{
+		const DirectX::TexMetadata& metadata = image.GetMetadata();
+
+		pixel_layout layout;
+		if (metadata.dimension != DirectX::TEX_DIMENSION_TEXTURE2D || !getPixelLayout(metadata.format, layout))
+		{
+			return false;
+		}
+
+		DirectX::ScratchImage result;
+		if (FAILED(result.Initialize2D(metadata.format, metadata.width, metadata.height, metadata.arraySize, 0)))
+		{
+			return false;
+		}
+
+		const uint32 numMips = (uint32)result.GetMetadata().mipLevels;
+
+		for (uint32 item = 0; item < (uint32)metadata.arraySize; ++item)
+		{
+			const DirectX::Image* source = image.GetImage(0, item, 0);
+			const DirectX::Image* destination = result.GetImage(0, item, 0);
+
+			const uint64 rowSize = min(source->rowPitch, destination->rowPitch);
+			for (uint32 y = 0; y < (uint32)source->height; ++y)
+			{
+				memcpy(destination->pixels + y * destination->rowPitch, source->pixels + y * source->rowPitch, rowSize);
+			}
+
+			// Each mip is filtered from the previous one, rows of one mip in parallel.
+			for (uint32 mip = 1; mip < numMips; ++mip)
+			{
+				const DirectX::Image& sourceMip = *result.GetImage(mip - 1, item, 0);
+				const DirectX::Image& destinationMip = *result.GetImage(mip, item, 0);
+
+				parallelFor((uint32)destinationMip.height, 32, [&](uint32 first, uint32 count)
+				{
+					downsampleRows(sourceMip, destinationMip, layout, first, count);
+				});
+			}
+		}
+
+		mipchain = std::move(result);
+		return true;
+	}
+
+	// ----------------------------------------
+	// Block compression.
+	// ----------------------------------------
+
+	// The 16 pixels of a 4x4 block, one array per channel, in the range [0, 255].
+	struct block_pixels
+	{
+		alignas(16) float channels[4][16];
+	};
+
+	// Colors a block can be decoded to. weights[i] is the position of colors[i] between the two endpoints.
+	template <uint32 numChannels>
+	struct block_palette
+	{
+		float colors[16][numChannels];
+		float weights[16];
+		uint32 size;
+	};
+
+	static void loadBlock(const DirectX::Image& image, const pixel_layout& layout, uint32 blockX, uint32 blockY, const uint32* channels, uint32 numChannels, block_pixels& block)
+	{
+		for (uint32 y = 0; y < 4; ++y)
+		{
+			// Blocks of mips smaller than 4x4 repeat the edge pixels.
+			const uint8* row = image.pixels + min(blockY * 4 + y, (uint32)image.height - 1) * image.rowPitch;
+			for (uint32 x = 0; x < 4; ++x)
+			{
+				const uint8* pixel = row + min(blockX * 4 + x, (uint32)image.width - 1) * layout.bytesPerPixel;
+				for (uint32 c = 0; c < numChannels; ++c)
+				{
+					int32 offset = layout.offsets[channels[c]];
+					block.channels[c][y * 4 + x] = (offset >= 0) ? (float)pixel[offset] : ((channels[c] == 3) ? 255.f : 0.f);
+				}
+			}
+		}
+	}
+
+	static float horizontalSum(w4_float v)
+	{
+		float f[4];
+		v.store(f);
+		return (f[0] + f[1]) + (f[2] + f[3]);
+	}
+
+	static float horizontalMin(w4_float v)
+	{
+		float f[4];
+		v.store(f);
+		return min(min(f[0], f[1]), min(f[2], f[3]));
+	}
+
+	static float horizontalMax(w4_float v)
+	{
+		float f[4];
+		v.store(f);
+		return max(max(f[0], f[1]), max(f[2], f[3]));
+	}
+
+	// Endpoints of the line through the block's colors, either along the principal axis or along the (sign corrected) diagonal of the
+	// bounding box.
+	template <uint32 numChannels>
+	static void fitEndpoints(const block_pixels& block, bool principalAxis, float (&e0)[numChannels], float (&e1)[numChannels])
+	{
+		float mean[numChannels];
+		float extent[numChannels];
+
+		for (uint32 c = 0; c < numChannels; ++c)
+		{
+			w4_float sum = 0.f;
+			w4_float minimum_ = FLT_MAX;
+			w4_float maximum_ = -FLT_MAX;
+			for (uint32 g = 0; g < 16; g += 4)
+			{
+				w4_float v = block.channels[c] + g;
+				sum += v;
+				minimum_ = minimum(minimum_, v);
+				maximum_ = maximum(maximum_, v);
+			}
+			mean[c] = horizontalSum(sum) / 16.f;
+			extent[c] = horizontalMax(maximum_) - horizontalMin(minimum_);
+		}
+
+		float covariance[numChannels][numChannels];
+		for (uint32 c0 = 0; c0 < numChannels; ++c0)
+		{
+			for (uint32 c1 = c0; c1 < numChannels; ++c1)
+			{
+				w4_float sum = 0.f;
+				for (uint32 g = 0; g < 16; g += 4)
+				{
+					w4_float a = w4_float(block.channels[c0] + g) - mean[c0];
+					w4_float b = w4_float(block.channels[c1] + g) - mean[c1];
+					sum = fmadd(a, b, sum);
+				}
+				covariance[c0][c1] = covariance[c1][c0] = horizontalSum(sum);
+			}
+		}
+
+		// Channels that fall while the dominant one rises run in the other direction.
+		uint32 dominant = 0;
+		for (uint32 c = 1; c < numChannels; ++c)
+		{
+			if (covariance[c][c] > covariance[dominant][dominant])
+			{
+				dominant = c;
+			}
+		}
+
+		float axis[numChannels];
+		for (uint32 c = 0; c < numChannels; ++c)
+		{
+			axis[c] = (covariance[dominant][c] < 0.f) ? -extent[c] : extent[c];
+		}
+
+		if (principalAxis)
+		{
+			for (uint32 iteration = 0; iteration < 8; ++iteration)
+			{
+				float next[numChannels];
+				float largest = 0.f;
+				for (uint32 c0 = 0; c0 < numChannels; ++c0)
+				{
+					next[c0] = 0.f;
+					for (uint32 c1 = 0; c1 < numChannels; ++c1)
+					{
+						next[c0] += covariance[c0][c1] * axis[c1];
+					}
+					largest = max(largest, fabsf(next[c0]));
+				}
+
+				if (largest < 1e-6f)
+				{
+					break;
+				}
+
+				for (uint32 c = 0; c < numChannels; ++c)
+				{
+					axis[c] = next[c] / largest;
+				}
+			}
+		}
+
+		float axisLengthSquared = 0.f;
+		for (uint32 c = 0; c < numChannels; ++c)
+		{
+			axisLengthSquared += axis[c] * axis[c];
+		}
+
+		if (axisLengthSquared < 1e-6f)
+		{
+			for (uint32 c = 0; c < numChannels; ++c)
+			{
+				e0[c] = e1[c] = mean[c];
+			}
+			return;
+		}
+
+		w4_float tMin = FLT_MAX;
+		w4_float tMax = -FLT_MAX;
+		for (uint32 g = 0; g < 16; g += 4)
+		{
+			w4_float t = 0.f;
+			for (uint32 c = 0; c < numChannels; ++c)
+			{
+				t = fmadd(w4_float(block.channels[c] + g) - mean[c], axis[c], t);
+			}
+			tMin = minimum(tMin, t);
+			tMax = maximum(tMax, t);
+		}
+
+		const float t0 = horizontalMin(tMin) / axisLengthSquared;
+		const float t1 = horizontalMax(tMax) / axisLengthSquared;
+
+		for (uint32 c = 0; c < numChannels; ++c)
+		{
+			e0[c] = clamp(mean[c] + axis[c] * t0, 0.f, 255.f);
+			e1[c] = clamp(mean[c] + axis[c] * t1, 0.f, 255.f);
+		}
+	}
+
+	// Picks the closest palette entry for every pixel. Returns the summed squared error.
+	template <uint32 numChannels>
+	static float findClosestColors(const block_pixels& block, const block_palette<numChannels>& palette, uint8* indices)
+	{
+		float error = 0.f;
+		for (uint32 g = 0; g < 16; g += 4)
+		{
+			w4_float pixels[numChannels];
+			for (uint32 c = 0; c < numChannels; ++c)
+			{
+				pixels[c] = block.channels[c] + g;
+			}
+
+			w4_float bestError = FLT_MAX;
+			w4_float bestIndex = 0.f;
+			for (uint32 i = 0; i < palette.size; ++i)
+			{
+				w4_float e = 0.f;
+				for (uint32 c = 0; c < numChannels; ++c)
+				{
+					w4_float d = pixels[c] - palette.colors[i][c];
+					e = fmadd(d, d, e);
+				}
+
+				bestIndex = if_then(e < bestError, w4_float((float)i), bestIndex);
+				bestError = minimum(e, bestError);
+			}
+
+			float bestIndices[4];
+			bestIndex.store(bestIndices);
+			for (uint32 i = 0; i < 4; ++i)
+			{
+				indices[g + i] = (uint8)bestIndices[i];
+			}
+
+			error += horizontalSum(bestError);
+		}
+		return error;
+	}
+
+	// Least squares endpoints for the given palette positions of the pixels.
+	template <uint32 numChannels>
+	static bool solveEndpoints(const block_pixels& block, const block_palette<numChannels>& palette, const uint8* indices,
+		float (&e0)[numChannels], float (&e1)[numChannels])
+	{
+		float aa = 0.f, ab = 0.f, bb = 0.f;
+		float ax[numChannels] = {};
+		float bx[numChannels] = {};
+
+		for (uint32 i = 0; i < 16; ++i)
+		{
+			const float b = palette.weights[indices[i]];
+			const float a = 1.f - b;
+
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+
+			for (uint32 c = 0; c < numChannels; ++c)
+			{
+				ax[c] += a * block.channels[c][i];
+				bx[c] += b * block.channels[c][i];
+			}
+		}
+
+		const float determinant = aa * bb - ab * ab;
+		if (fabsf(determinant) < 1e-6f)
+		{
+			return false;
+		}
+
+		const float invDeterminant = 1.f / determinant;
+		for (uint32 c = 0; c < numChannels; ++c)
+		{
+			e0[c] = clamp((bb * ax[c] - ab * bx[c]) * invDeterminant, 0.f, 255.f);
+			e1[c] = clamp((aa * bx[c] - ab * ax[c]) * invDeterminant, 0.f, 255.f);
+		}
+		return true;
+	}
+
+	static uint32 getNumRefinements(image_compression_quality quality)
+	{
+		switch (quality)
+		{
+		case image_compression_quality_fast: return 0;
+		case image_compression_quality_normal: return 1;
+		default: return 8;
+		}
+	}
+
+	// Fits endpoints, then moves them to the least squares solution of the chosen indices as long as this lowers the error. encode
+	// quantizes a pair of endpoints, fills the palette and returns the error.
+	template <uint32 numChannels, typename candidate_t, typename encode_t>
+	static void compressBlock(const block_pixels& block, image_compression_quality quality, block_palette<numChannels>& palette, candidate_t& best, const encode_t& encode)
+	{
+		float e0[numChannels], e1[numChannels];
+		fitEndpoints<numChannels>(block, quality != image_compression_quality_fast, e0, e1);
+
+		float bestError = encode(e0, e1, best);
+
+		const uint32 numRefinements = getNumRefinements(quality);
+		for (uint32 i = 0; i < numRefinements && bestError > 0.f; ++i)
+		{
+			if (!solveEndpoints<numChannels>(block, palette, best.indices, e0, e1))
+			{
+				break;
+			}
+
+			candidate_t candidate;
+			float error = encode(e0, e1, candidate);
+			if (error >= bestError)
+			{
+				break;
+			}
+
+			best = candidate;
+			bestError = error;
+		}
+	}
+
+	// BC1: two RGB565 endpoints and 2 bit indices. Always uses the 4 color mode.
+
+	struct bc1_candidate
+	{
+		uint16 color0, color1;
+		uint8 indices[16];
+	};
+
+	static uint16 quantizeRGB565(const float (&color)[3], float (&quantized)[3])
+	{
+		uint32 r = (uint32)(color[0] * (31.f / 255.f) + 0.5f);
+		uint32 g = (uint32)(color[1] * (63.f / 255.f) + 0.5f);
+		uint32 b = (uint32)(color[2] * (31.f / 255.f) + 0.5f);
+
+		quantized[0] = (float)((r << 3) | (r >> 2));
+		quantized[1] = (float)((g << 2) | (g >> 4));
+		quantized[2] = (float)((b << 3) | (b >> 2));
+
+		return (uint16)((r << 11) | (g << 5) | b);
+	}
+
+	static void encodeBC1Block(const block_pixels& block, image_compression_quality quality, uint8* out)
+	{
+		block_palette<3> palette;
+		palette.size = 4;
+		palette.weights[0] = 0.f;
+		palette.weights[1] = 1.f;
+		palette.weights[2] = 1.f / 3.f;
+		palette.weights[3] = 2.f / 3.f;
+
+		bc1_candidate best;
+		compressBlock<3>(block, quality, palette, best, [&block, &palette](const float (&e0)[3], const float (&e1)[3], bc1_candidate& candidate)
+		{
+			float q0[3], q1[3];
+			candidate.color0 = quantizeRGB565(e0, q0);
+			candidate.color1 = quantizeRGB565(e1, q1);
+
+			for (uint32 c = 0; c < 3; ++c)
+			{
+				palette.colors[0][c] = q0[c];
+				palette.colors[1][c] = q1[c];
+				palette.colors[2][c] = (2.f * q0[c] + q1[c]) / 3.f;
+				palette.colors[3][c] = (q0[c] + 2.f * q1[c]) / 3.f;
+			}
+
+			return findClosestColors<3>(block, palette, candidate.indices);
+		});
+
+		uint32 indexBits = 0;
+		if (best.color0 != best.color1)
+		{
+			// color0 > color1 selects the 4 color mode. Swapping the endpoints swaps indices 0 and 1, and 2 and 3.
+			const bool swap = best.color0 < best.color1;
+			if (swap)
+			{
+				std::swap(best.color0, best.color1);
+			}
+
+			for (uint32 i = 0; i < 16; ++i)
+			{
+				indexBits |= (uint32)(swap ? (best.indices[i] ^ 1) : best.indices[i]) << (2 * i);
+			}
+		}
+
+		memcpy(out + 0, &best.color0, 2);
+		memcpy(out + 2, &best.color1, 2);
+		memcpy(out + 4, &indexBits, 4);
+	}
+
+	// BC4: two 8 bit endpoints and 3 bit indices. Always uses the 8 value mode. Used for single channels, BC3 alpha and BC5.
+
+	struct bc4_candidate
+	{
+		uint8 value0, value1;
+		uint8 indices[16];
+	};
+
+	static void encodeBC4Block(const block_pixels& block, uint32 channel, image_compression_quality quality, uint8* out)
+	{
+		block_pixels channelBlock;
+		memcpy(channelBlock.channels[0], block.channels[channel], sizeof(channelBlock.channels[0]));
+
+		block_palette<1> palette;
+		palette.size = 8;
+		palette.weights[0] = 0.f;
+		palette.weights[1] = 1.f;
+		for (uint32 i = 2; i < 8; ++i)
+		{
+			palette.weights[i] = (i - 1) / 7.f;
+		}
+
+		bc4_candidate best;
+		compressBlock<1>(channelBlock, quality, palette, best, [&channelBlock, &palette](const float (&e0)[1], const float (&e1)[1], bc4_candidate& candidate)
+		{
+			// value0 > value1 selects the 8 value mode.
+			uint32 v0 = (uint32)(max(e0[0], e1[0]) + 0.5f);
+			uint32 v1 = (uint32)(min(e0[0], e1[0]) + 0.5f);
+			candidate.value0 = (uint8)v0;
+			candidate.value1 = (uint8)v1;
+
+			palette.colors[0][0] = (float)v0;
+			palette.colors[1][0] = (float)v1;
+			for (uint32 i = 2; i < 8; ++i)
+			{
+				palette.colors[i][0] = (float)(((8 - i) * v0 + (i - 1) * v1) / 7);
+			}
+
+			return findClosestColors<1>(channelBlock, palette, candidate.indices);
+		});
+
+		uint64 indexBits = 0;
+		if (best.value0 != best.value1)
+		{
+			for (uint32 i = 0; i < 16; ++i)
+			{
+				indexBits |= (uint64)best.indices[i] << (3 * i);
+			}
+		}
+
+		out[0] = best.value0;
+		out[1] = best.value1;
+		memcpy(out + 2, &indexBits, 6);
+	}
+
+	// BC7 mode 6: one subset, two RGBA 7 bit endpoints with a p-bit each and 4 bit indices.
+
+	static constexpr uint32 bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct bc7_candidate
+	{
+		uint8 endpoints[2][4];	// 7 bit.
+		uint8 pbits[2];
+		uint8 indices[16];
+	};
+
+	// Picks the p-bit that reproduces the endpoint best.
+	static void quantizeBC7Mode6Endpoint(const float (&color)[4], uint8 (&endpoint)[4], uint8& pbit, uint32 (&expanded)[4])
+	{
+		float bestError = FLT_MAX;
+		for (uint32 p = 0; p < 2; ++p)
+		{
+			float error = 0.f;
+			uint8 quantized[4];
+			for (uint32 c = 0; c < 4; ++c)
+			{
+				int32 q = clamp((int32)((color[c] - p) * 0.5f + 0.5f), 0, 127);
+				quantized[c] = (uint8)q;
+
+				float d = (float)((q << 1) | p) - color[c];
+				error += d * d;
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				pbit = (uint8)p;
+				for (uint32 c = 0; c < 4; ++c)
+				{
+					endpoint[c] = quantized[c];
+					expanded[c] = ((uint32)quantized[c] << 1) | p;
+				}
+			}
+		}
+	}
+
+	struct bc7_bit_writer
+	{
+		void write(uint64 value, uint32 count)
+		{
+			for (uint32 i = 0; i < count; ++i, ++position)
+			{
+				bits[position / 64] |= ((value >> i) & 1) << (position % 64);
+			}
+		}
+
+		uint64 bits[2] = {};
+		uint32 position = 0;
+	};
+
+	static void encodeBC7Block(const block_pixels& block, image_compression_quality quality, uint8* out)
+	{
+		block_palette<4> palette;
+		palette.size = 16;
+		for (uint32 i = 0; i < 16; ++i)
+		{
+			palette.weights[i] = bc7Weights4[i] / 64.f;
+		}
+
+		bc7_candidate best;
+		compressBlock<4>(block, quality, palette, best, [&block, &palette](const float (&e0)[4], const float (&e1)[4], bc7_candidate& candidate)
+		{
+			uint32 x0[4], x1[4];
+			quantizeBC7Mode6Endpoint(e0, candidate.endpoints[0], candidate.pbits[0], x0);
+			quantizeBC7Mode6Endpoint(e1, candidate.endpoints[1], candidate.pbits[1], x1);
+
+			for (uint32 i = 0; i < 16; ++i)
+			{
+				const uint32 w = bc7Weights4[i];
+				for (uint32 c = 0; c < 4; ++c)
+				{
+					palette.colors[i][c] = (float)(((64 - w) * x0[c] + w * x1[c] + 32) >> 6);
+				}
+			}
+
+			return findClosestColors<4>(block, palette, candidate.indices);
+		});
+
+		// The most significant index bit of the first pixel is implied to be 0.
+		if (best.indices[0] & 8)
+		{
+			for (uint32 c = 0; c < 4; ++c)
+			{
+				std::swap(best.endpoints[0][c], best.endpoints[1][c]);
+			}
+			std::swap(best.pbits[0], best.pbits[1]);
+
+			for (uint32 i = 0; i < 16; ++i)
+			{
+				best.indices[i] = 15 - best.indices[i];
+			}
+		}
+
+		bc7_bit_writer writer;
+		writer.write(1 << 6, 7); // Mode 6.
+		for (uint32 c = 0; c < 4; ++c)
+		{
+			writer.write(best.endpoints[0][c], 7);
+			writer.write(best.endpoints[1][c], 7);
+		}
+		writer.write(best.pbits[0], 1);
+		writer.write(best.pbits[1], 1);
+
+		writer.write(best.indices[0], 3);
+		for (uint32 i = 1; i < 16; ++i)
+		{
+			writer.write(best.indices[i], 4);
+		}
+
+		ASSERT(writer.position == 128);
+		memcpy(out, writer.bits, 16);
+	}
+
+	static void compressBlockRows(const DirectX::Image& source, const DirectX::Image& destination, const pixel_layout& layout, DXGI_FORMAT format,
+		image_compression_quality quality, uint32 firstBlockRow, uint32 numBlockRows)
+	{
+		static const uint32 rgba[4] = { 0, 1, 2, 3 };
+
+		const uint32 numBlocksX = max(1u, ((uint32)source.width + 3) / 4);
+		const uint32 blockSize = (uint32)DirectX::BitsPerPixel(format) * 2; // 16 pixels per block.
+
+		block_pixels block;
+		for (uint32 blockY = firstBlockRow; blockY < firstBlockRow + numBlockRows; ++blockY)
+		{
+			uint8* out = destination.pixels + blockY * destination.rowPitch;
+			for (uint32 blockX = 0; blockX < numBlocksX; ++blockX, out += blockSize)
+			{
+				switch (format)
+				{
+				case DXGI_FORMAT_BC1_UNORM:
+				case DXGI_FORMAT_BC1_UNORM_SRGB:
+					loadBlock(source, layout, blockX, blockY, rgba, 3, block);
+					encodeBC1Block(block, quality, out);
+					break;
+
+				case DXGI_FORMAT_BC3_UNORM:
+				case DXGI_FORMAT_BC3_UNORM_SRGB:
+					loadBlock(source, layout, blockX, blockY, rgba, 4, block);
+					encodeBC4Block(block, 3, quality, out);
+					encodeBC1Block(block, quality, out + 8);
+					break;
+
+				case DXGI_FORMAT_BC4_UNORM:
+					loadBlock(source, layout, blockX, blockY, rgba, 1, block);
+					encodeBC4Block(block, 0, quality, out);
+					break;
+
+				case DXGI_FORMAT_BC5_UNORM:
+					loadBlock(source, layout, blockX, blockY, rgba, 2, block);
+					encodeBC4Block(block, 0, quality, out);
+					encodeBC4Block(block, 1, quality, out + 8);
+					break;
+
+				case DXGI_FORMAT_BC7_UNORM:
+				case DXGI_FORMAT_BC7_UNORM_SRGB:
+					loadBlock(source, layout, blockX, blockY, rgba, 4, block);
+					encodeBC7Block(block, quality, out);
+					break;
+				}
+			}
+		}
+	}
+
+	bool compressImageParallel(const DirectX::ScratchImage& image, DXGI_FORMAT compressedFormat, image_compression_quality quality,
+		DirectX::ScratchImage& compressed)
+	{
+		const DirectX::TexMetadata& metadata = image.GetMetadata();
+
+		pixel_layout layout;
+		if (metadata.dimension != DirectX::TEX_DIMENSION_TEXTURE2D || !getPixelLayout(metadata.format, layout))
+		{
+			return false;
+		}
+
+		switch (compressedFormat)
+		{
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+		case DXGI_FORMAT_BC4_UNORM:
+		case DXGI_FORMAT_BC5_UNORM:
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			break;
+		default:
+			return false;
+		}
+
+		DirectX::TexMetadata compressedMetadata = metadata;
+		compressedMetadata.format = compressedFormat;
+
+		DirectX::ScratchImage result;
+		if (FAILED(result.Initialize(compressedMetadata)))
+		{
+			return false;
+		}
+
+		// All block rows of all mips and array slices are one range, so that small mips don't get their own round of jobs.
+		const uint32 numImages = (uint32)image.GetImageCount();
+		std::vector<uint32> firstRowOfImage(numImages + 1);
+		for (uint32 i = 0; i < numImages; ++i)
+		{
+			firstRowOfImage[i + 1] = firstRowOfImage[i] + max(1u, ((uint32)image.GetImages()[i].height + 3) / 4);
+		}
+
+		const DirectX::Image* sourceImages = image.GetImages();
+		const DirectX::Image* destinationImages = result.GetImages();
+
+		parallelFor(firstRowOfImage[numImages], 4, [&](uint32 first, uint32 count)
+		{
+			const uint32 end = first + count;
+
+			uint32 i = 0;
+			while (firstRowOfImage[i + 1] <= first)
+			{
+				++i;
+			}
+
+			for (; first < end; ++i)
+			{
+				const uint32 rowEnd = min(end, firstRowOfImage[i + 1]);
+				compressBlockRows(sourceImages[i], destinationImages[i], layout, compressedFormat, quality,
+					first - firstRowOfImage[i], rowEnd - first);
+				first = rowEnd;
+			}
+		});
+
+		compressed = std::move(result);
+		return true;
+	}
+}
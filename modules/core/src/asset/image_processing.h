@@ -0,0 +1,38 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#pragma once
+
+#include "core_api.h"
+
+#include <dx/d3dx12.h>
+
+namespace DirectX
+{
+	class ScratchImage;
+}
+
+namespace era_engine
+{
+	// CPU image processing for the import of textures. Work is split into rows and spread over the low priority job queue, so a
+	// single large texture uses all cores.
+
+	enum image_compression_quality
+	{
+		image_compression_quality_fast,		// Endpoints from the bounding box of each block.
+		image_compression_quality_normal,	// Endpoints along the principal axis of each block, refined once.
+		image_compression_quality_high,		// Like normal, but refined until the error stops improving. Textures with alpha use BC7 instead of BC3.
+	};
+
+	// Used by all image imports. Delete the texture cache after changing this, cached textures are not imported again.
+	ERA_CORE_API void setImageCompressionQuality(image_compression_quality quality);
+	NODISCARD ERA_CORE_API image_compression_quality getImageCompressionQuality();
+
+	// Generates the full mip chain of a 2D image with a box filter. sRGB images are filtered in linear space. Returns false (and
+	// leaves mipchain untouched) if the format is not an 8 bit per channel format, in which case the caller should fall back to DirectXTex.
+	NODISCARD ERA_CORE_API bool generateMipMapsParallel(const DirectX::ScratchImage& image, DirectX::ScratchImage& mipchain);
+
+	// Compresses all images of a 2D image to BC1, BC3, BC4, BC5 or BC7 (mode 6 only). The source must have 8 bits per channel.
+	// Returns false if the combination of formats is not supported.
+	NODISCARD ERA_CORE_API bool compressImageParallel(const DirectX::ScratchImage& image, DXGI_FORMAT compressedFormat, image_compression_quality quality,
+		DirectX::ScratchImage& compressed);
+}
@@ -3,6 +3,7 @@
 #include "asset/mesh_postprocessing.h"
 
 #include "core/cpu_profiling.h"
+#include "core/log.h"
 
 namespace era_engine
 {
@@ -256,4 +257,355 @@ namespace era_engine
 		else
 			return { it->second, true };
 	}
-}
\ No newline at end of file
+
+	vertex_cache_stats analyzeVertexCache(const SubmeshAsset& submesh, uint32 cacheSize)
+	{
+		uint32 numVertices = (uint32)submesh.positions.size();
+		uint32 numTriangles = (uint32)submesh.triangles.size();
+		if (numVertices == 0 || numTriangles == 0)
+		{
+			return { 0.f, 0.f };
+		}
+
+		// FIFO cache. A vertex is a hit, if it was inserted less than cacheSize insertions ago.
+		std::vector<uint32> insertionTime(numVertices, 0);
+		uint32 time = cacheSize + 1;
+		uint32 numTransformed = 0;
+
+		for (const indexed_triangle16& tri : submesh.triangles)
+		{
+			const uint16 indices[3] = { tri.a, tri.b, tri.c };
+			for (uint16 v : indices)
+			{
+				if (time - insertionTime[v] > cacheSize)
+				{
+					insertionTime[v] = time++;
+					++numTransformed;
+				}
+			}
+		}
+
+		return { (float)numTransformed / (float)numTriangles, (float)numTransformed / (float)numVertices };
+	}
+
+	// [Fast Triangle Reordering for Vertex Locality and Reduced Overdraw, Sander et al. 2007]
+	// Returns the reordered triangles and the start of every cluster. Clusters end where the fan runs into a dead end.
+	static void tipsify(const SubmeshAsset& submesh, uint32 cacheSize, std::vector<indexed_triangle16>& outTriangles, std::vector<uint32>& outClusterStarts)
+	{
+		uint32 numVertices = (uint32)submesh.positions.size();
+		uint32 numTriangles = (uint32)submesh.triangles.size();
+
+		// Vertex to triangle adjacency in CSR layout.
+		std::vector<uint32> liveTriangles(numVertices, 0);
+		for (const indexed_triangle16& tri : submesh.triangles)
+		{
+			++liveTriangles[tri.a];
+			++liveTriangles[tri.b];
+			++liveTriangles[tri.c];
+		}
+
+		std::vector<uint32> adjacencyOffsets(numVertices + 1, 0);
+		for (uint32 v = 0; v < numVertices; ++v)
+		{
+			adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+		}
+
+		std::vector<uint32> adjacency(adjacencyOffsets[numVertices]);
+		{
+			std::vector<uint32> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (uint32 t = 0; t < numTriangles; ++t)
+			{
+				const indexed_triangle16& tri = submesh.triangles[t];
+				adjacency[fill[tri.a]++] = t;
+				adjacency[fill[tri.b]++] = t;
+				adjacency[fill[tri.c]++] = t;
+			}
+		}
+
+		std::vector<uint32> cacheTime(numVertices, 0);
+		std::vector<bool> emitted(numTriangles, false);
+		std::vector<uint16> deadEndStack;
+		std::vector<uint16> candidates;
+
+		outTriangles.clear();
+		outTriangles.reserve(numTriangles);
+		outClusterStarts.clear();
+
+		uint32 time = cacheSize + 1;
+		uint32 cursor = 0; // Scan position for vertices with remaining triangles.
+		int32 fanningVertex = 0;
+		bool newCluster = true;
+
+		while (fanningVertex >= 0)
+		{
+			if (newCluster)
+			{
+				outClusterStarts.push_back((uint32)outTriangles.size());
+				newCluster = false;
+			}
+
+			candidates.clear();
+
+			for (uint32 i = adjacencyOffsets[fanningVertex]; i < adjacencyOffsets[fanningVertex + 1]; ++i)
+			{
+				uint32 t = adjacency[i];
+				if (emitted[t])
+				{
+					continue;
+				}
+
+				const indexed_triangle16& tri = submesh.triangles[t];
+				const uint16 indices[3] = { tri.a, tri.b, tri.c };
+				for (uint16 v : indices)
+				{
+					deadEndStack.push_back(v);
+					candidates.push_back(v);
+					--liveTriangles[v];
+
+					if (time - cacheTime[v] > cacheSize)
+					{
+						cacheTime[v] = time++;
+					}
+				}
+
+				outTriangles.push_back(tri);
+				emitted[t] = true;
+			}
+
+			// Pick the candidate that will still be in the cache after its remaining triangles are emitted, preferring the oldest one.
+			int32 next = -1;
+			int32 bestPriority = -1;
+			for (uint16 v : candidates)
+			{
+				if (liveTriangles[v] == 0)
+				{
+					continue;
+				}
+
+				int32 priority = 0;
+				if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+				{
+					priority = (int32)(time - cacheTime[v]);
+				}
+
+				if (priority > bestPriority)
+				{
+					bestPriority = priority;
+					next = v;
+				}
+			}
+
+			if (next == -1)
+			{
+				// Dead end. Prefer recently touched vertices, otherwise continue with the next unfinished vertex in input order.
+				while (!deadEndStack.empty() && next == -1)
+				{
+					uint16 v = deadEndStack.back();
+					deadEndStack.pop_back();
+					if (liveTriangles[v] > 0)
+					{
+						next = v;
+					}
+				}
+
+				while (next == -1 && cursor < numVertices)
+				{
+					if (liveTriangles[cursor] > 0)
+					{
+						next = (int32)cursor;
+					}
+					++cursor;
+				}
+
+				newCluster = true;
+			}
+
+			fanningVertex = next;
+		}
+
+		ASSERT(outTriangles.size() == numTriangles);
+	}
+
+	static void orderClustersForOverdraw(const SubmeshAsset& submesh, std::vector<indexed_triangle16>& triangles, const std::vector<uint32>& clusterStarts)
+	{
+		uint32 numClusters = (uint32)clusterStarts.size();
+		if (numClusters <= 1)
+		{
+			return;
+		}
+
+		struct cluster
+		{
+			uint32 first;
+			uint32 count;
+			float sortKey;
+		};
+
+		std::vector<cluster> clusters(numClusters);
+		std::vector<vec3> clusterCentroids(numClusters);
+		std::vector<vec3> clusterNormals(numClusters);
+
+		vec3 meshCentroid(0.f);
+		float meshArea = 0.f;
+
+		for (uint32 c = 0; c < numClusters; ++c)
+		{
+			uint32 first = clusterStarts[c];
+			uint32 end = (c + 1 < numClusters) ? clusterStarts[c + 1] : (uint32)triangles.size();
+
+			vec3 centroid(0.f);
+			vec3 normal(0.f);
+			float area = 0.f;
+
+			for (uint32 t = first; t < end; ++t)
+			{
+				vec3 pa = submesh.positions[triangles[t].a];
+				vec3 pb = submesh.positions[triangles[t].b];
+				vec3 pc = submesh.positions[triangles[t].c];
+
+				vec3 n = cross(pb - pa, pc - pa); // Length is twice the area.
+				float triArea = length(n) * 0.5f;
+
+				centroid += (pa + pb + pc) * (triArea / 3.f);
+				normal += n;
+				area += triArea;
+			}
+
+			meshCentroid += centroid;
+			meshArea += area;
+
+			clusters[c] = { first, end - first, 0.f };
+			clusterCentroids[c] = (area > 0.f) ? centroid / area : submesh.positions[triangles[first].a];
+			clusterNormals[c] = normal;
+		}
+
+		if (meshArea > 0.f)
+		{
+			meshCentroid /= meshArea;
+		}
+
+		// Clusters facing away from the center are likely to occlude the others, so they go first.
+		for (uint32 c = 0; c < numClusters; ++c)
+		{
+			float normalLength = length(clusterNormals[c]);
+			clusters[c].sortKey = (normalLength > 0.f) ? dot(clusterCentroids[c] - meshCentroid, clusterNormals[c] / normalLength) : 0.f;
+		}
+
+		std::stable_sort(clusters.begin(), clusters.end(), [](const cluster& a, const cluster& b) { return a.sortKey > b.sortKey; });
+
+		std::vector<indexed_triangle16> sorted;
+		sorted.reserve(triangles.size());
+		for (const cluster& c : clusters)
+		{
+			sorted.insert(sorted.end(), triangles.begin() + c.first, triangles.begin() + c.first + c.count);
+		}
+		triangles = std::move(sorted);
+	}
+
+	template <typename T>
+	static void remapVertexAttribute(std::vector<T>& attribute, const std::vector<uint32>& newToOld)
+	{
+		if (attribute.empty())
+		{
+			return;
+		}
+
+		std::vector<T> remapped(newToOld.size());
+		for (uint32 i = 0; i < (uint32)newToOld.size(); ++i)
+		{
+			remapped[i] = attribute[newToOld[i]];
+		}
+		attribute = std::move(remapped);
+	}
+
+	static void optimizeVertexFetch(SubmeshAsset& submesh)
+	{
+		uint32 numVertices = (uint32)submesh.positions.size();
+
+		// 32 bit, since a submesh may use all 65536 16 bit indices, and UINT16_MAX is a valid one then.
+		const uint32 unassigned = UINT32_MAX;
+		std::vector<uint32> oldToNew(numVertices, unassigned);
+		std::vector<uint32> newToOld;
+		newToOld.reserve(numVertices);
+
+		auto remap = [&](uint16& index)
+		{
+			if (oldToNew[index] == unassigned)
+			{
+				oldToNew[index] = (uint32)newToOld.size();
+				newToOld.push_back(index);
+			}
+			index = (uint16)oldToNew[index];
+		};
+
+		for (indexed_triangle16& tri : submesh.triangles)
+		{
+			remap(tri.a);
+			remap(tri.b);
+			remap(tri.c);
+		}
+
+		// Unreferenced vertices are kept at the end.
+		for (uint32 v = 0; v < numVertices; ++v)
+		{
+			if (oldToNew[v] == unassigned)
+			{
+				newToOld.push_back(v);
+			}
+		}
+
+		remapVertexAttribute(submesh.positions, newToOld);
+		remapVertexAttribute(submesh.uvs, newToOld);
+		remapVertexAttribute(submesh.normals, newToOld);
+		remapVertexAttribute(submesh.tangents, newToOld);
+		remapVertexAttribute(submesh.colors, newToOld);
+		remapVertexAttribute(submesh.skin, newToOld);
+	}
+
+	void optimizeSubmesh(SubmeshAsset& submesh, uint32 cacheSize)
+	{
+		if (submesh.triangles.empty())
+		{
+			return;
+		}
+
+		std::vector<indexed_triangle16> triangles;
+		std::vector<uint32> clusterStarts;
+		tipsify(submesh, cacheSize, triangles, clusterStarts);
+		orderClustersForOverdraw(submesh, triangles, clusterStarts);
+
+		submesh.triangles = std::move(triangles);
+
+		optimizeVertexFetch(submesh);
+	}
+
+	void optimizeSubmeshes(std::vector<SubmeshAsset>& submeshes, const std::string& meshName)
+	{
+		CPU_PRINT_PROFILE_BLOCK("Optimizing vertex cache");
+
+		uint32 numTriangles = 0;
+		float transformedBefore = 0.f, transformedAfter = 0.f;
+		float verticesBefore = 0.f;
+
+		for (SubmeshAsset& sub : submeshes)
+		{
+			uint32 subTriangles = (uint32)sub.triangles.size();
+			float subVertices = (float)sub.positions.size();
+
+			vertex_cache_stats before = analyzeVertexCache(sub);
+			optimizeSubmesh(sub);
+			vertex_cache_stats after = analyzeVertexCache(sub);
+
+			numTriangles += subTriangles;
+			transformedBefore += before.acmr * subTriangles;
+			transformedAfter += after.acmr * subTriangles;
+			verticesBefore += subVertices;
+		}
+
+		if (numTriangles > 0 && verticesBefore > 0.f)
+		{
+			LOG_MESSAGE("Vertex cache optimization of '%s': ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", meshName.c_str(),
+				transformedBefore / numTriangles, transformedAfter / numTriangles, transformedBefore / verticesBefore, transformedAfter / verticesBefore);
+		}
+	}
+}
@@ -76,11 +76,13 @@ namespace era_engine
 		mesh_flag_gen_tangents = (1 << 5), // Only if mesh has no tangents.
 		mesh_flag_load_colors = (1 << 6), // Only if mesh has no tangents.
 		mesh_flag_load_skin = (1 << 7),
+		mesh_flag_optimize_vertex_cache = (1 << 8), // Vertex cache, overdraw and vertex fetch ordering. Done once at import, the result is cached.
 
 		mesh_flag_default = mesh_flag_load_uvs | mesh_flag_flip_uvs_vertically |
 		mesh_flag_load_normals | mesh_flag_gen_normals |
 		mesh_flag_load_tangents | mesh_flag_gen_tangents |
-		mesh_flag_load_colors | mesh_flag_load_skin,
+		mesh_flag_load_colors | mesh_flag_load_skin |
+		mesh_flag_optimize_vertex_cache,
 	};
 
 	NODISCARD ModelAsset load_3d_model_from_file(const fs::path& path, uint32 mesh_flags = mesh_flag_default);
@@ -458,6 +458,11 @@ namespace era_engine
 		free_file(file);
 		generateNormalsAndTangents(submeshes, flags);
 
+		if (flags & mesh_flag_optimize_vertex_cache)
+		{
+			optimizeSubmeshes(submeshes, path.filename().string());
+		}
+
 		ModelAsset result;
 		result.flags = flags;
 		result.meshes.push_back({ path.filename().string(), std::move(submeshes), -1 });
@@ -9,11 +9,18 @@
 #include "audio/audio.h"
 #include "audio/sound.h"
 #include "audio/channel.h"
+#include "audio/audio_mixer.h"
+#include "audio/audio_streaming.h"
 
 #include "core/cpu_profiling.h"
 
 #include <x3daudio.h>
 
+#include <algorithm>
+
+// Real voices get a small bonus, so that sounds of similar audibility don't keep swapping.
+#define REAL_VOICE_SCORE_BONUS 1.1f
+
 namespace era_engine
 {
 	master_audio_settings masterAudioSettings;
@@ -25,6 +32,8 @@ namespace era_engine
 	static float oldSoundTypeVolumes[sound_type_count];
 	static property_fader soundTypeVolumeFaders[sound_type_count];
 
+	voice_management_settings voiceManagementSettings;
+
 	static audio_context context;
 
 	typedef std::unordered_map<uint32, ref<audio_channel>> channel_map;
@@ -77,6 +86,13 @@ namespace era_engine
 	{
 		bool reverbOn = masterAudioSettings.reverbEnabled && masterAudioSettings.reverbPreset != reverb_none;
 
+		if (context.mixer)
+		{
+			// The CPU mixer has a single reverb setting.
+			context.mixer->setReverbEnabled(reverbOn);
+			return;
+		}
+
 		if (reverbOn)
 		{
 			XAUDIO2FX_REVERB_PARAMETERS reverbParameters;
@@ -101,8 +117,93 @@ namespace era_engine
 		}
 	}
 
-	bool initializeAudio()
+	struct scored_channel
+	{
+		audio_channel* channel;
+		float score;
+	};
+
+	static std::vector<scored_channel> scoredChannels;
+
+	static void manageVoices()
+	{
+		CPU_PROFILE_BLOCK("Manage voices");
+
+		uint32 maxRealVoices = voiceManagementSettings.maxRealVoices;
+		if (context.mixer)
+		{
+			maxRealVoices = min(maxRealVoices, (uint32)AUDIO_MIXER_MAX_VOICES);
+		}
+
+		scoredChannels.clear();
+		for (auto& [id, channel] : channels)
+		{
+			// Stopping channels keep their voice until they have faded out.
+			if (channel->isStopping())
+			{
+				continue;
+			}
+
+			sound_type type = channel->sound->type;
+			float audibility = channel->getAudibility(context) * soundTypeVolumes[type];
+			if (audibility < voiceManagementSettings.minAudibility)
+			{
+				channel->setVirtual(true);
+				continue;
+			}
+
+			float score = audibility * voiceManagementSettings.soundTypePriorities[type];
+			if (!channel->isVirtual())
+			{
+				score *= REAL_VOICE_SCORE_BONUS;
+			}
+
+			scoredChannels.push_back({ channel.get(), score });
+		}
+
+		auto byScore = [](const scored_channel& a, const scored_channel& b) { return a.score > b.score; };
+
+		uint32 numReal = min((uint32)scoredChannels.size(), maxRealVoices);
+		if (numReal < scoredChannels.size())
+		{
+			std::nth_element(scoredChannels.begin(), scoredChannels.begin() + numReal, scoredChannels.end(), byScore);
+		}
+
+		for (uint32 i = 0; i < (uint32)scoredChannels.size(); ++i)
+		{
+			scoredChannels[i].channel->setVirtual(i >= numReal);
+		}
+	}
+
+	static bool initializeMixer(const ref<audio_output>& output)
+	{
+		context.mixer = make_ref<audio_mixer>(output);
+
+		masterVolumeFader.initialize(masterAudioSettings.volume);
+		context.mixer->setMasterVolume(masterAudioSettings.volume);
+
+		for (uint32 i = 0; i < sound_type_count; ++i)
+		{
+			soundTypeVolumes[i] = oldSoundTypeVolumes[i] = 1.f;
+			soundTypeVolumeFaders[i].initialize(soundTypeVolumes[i]);
+			context.mixer->setSoundTypeVolume((sound_type)i, soundTypeVolumes[i]);
+		}
+
+		setReverb();
+
+		initializeAudioStreaming();
+		loadSoundRegistry();
+
+		return true;
+	}
+
+	bool initializeAudio(const ref<audio_output>& output)
 	{
+		if (output)
+		{
+			return initializeMixer(output);
+		}
+
 		uint32 flags = 0;
 #ifdef _DEBUG
 		flags |= XAUDIO2_DEBUG_ENGINE;
@@ -157,6 +258,7 @@ namespace era_engine
 		context.listener.OrientTop = { 0.f, 1.f, 0.f };
 		context.listener.pCone = (X3DAUDIO_CONE*)&X3DAudioDefault_DirectionalCone;
 
+		initializeAudioStreaming();
 		loadSoundRegistry();
 
 		return true;
@@ -166,6 +268,9 @@ namespace era_engine
 	{
 		channels.clear();
 
+		shutdownAudioStreaming();
+		context.mixer.reset();
+
 		if (context.xaudio)
 		{
 			context.xaudio->StopEngine();
@@ -173,8 +278,34 @@ namespace era_engine
 		}
 	}
 
+	NODISCARD audio_mixer_stats getAudioMixerStats()
+	{
+		return context.mixer ? context.mixer->getStats() : audio_mixer_stats{};
+	}
+
+	NODISCARD audio_voice_stats getAudioVoiceStats()
+	{
+		audio_voice_stats result = {};
+		result.numChannels = (uint32)channels.size();
+		for (auto& [id, channel] : channels)
+		{
+			if (channel->hasVoice())
+			{
+				++result.numRealVoices;
+			}
+			else
+			{
+				++result.numVirtualChannels;
+			}
+		}
+		return result;
+	}
+
 	void setAudioListener(vec3 position, quat rotation, vec3 velocity)
 	{
+		context.listenerPosition = position;
+		context.listenerRotation = rotation;
+
 		vec3 forward = rotation * vec3(0.f, 0.f, -1.f);
 		vec3 up = rotation * vec3(0.f, 1.f, 0.f);
 
@@ -204,7 +335,14 @@ namespace era_engine
 		oldMasterAudioSettings = masterAudioSettings;
 
 		masterVolumeFader.update(dt);
-		context.masterVoice->SetVolume(masterVolumeFader.current);
+		if (context.mixer)
+		{
+			context.mixer->setMasterVolume(masterVolumeFader.current);
+		}
+		else
+		{
+			context.masterVoice->SetVolume(masterVolumeFader.current);
+		}
 
 		for (uint32 i = 0; i < sound_type_count; ++i)
 		{
@@ -218,25 +356,32 @@ namespace era_engine
 			oldSoundTypeVolumes[i] = soundTypeVolumes[i];
 
 			soundTypeVolumeFaders[i].update(dt);
-			context.soundTypeSubmixVoices[i]->SetVolume(soundTypeVolumeFaders[i].current);
+			if (context.mixer)
+			{
+				context.mixer->setSoundTypeVolume((sound_type)i, soundTypeVolumeFaders[i].current);
+			}
+			else
+			{
+				context.soundTypeSubmixVoices[i]->SetVolume(soundTypeVolumeFaders[i].current);
+			}
 		}
 
-		channel_map::iterator stoppedChannels[64];
-		uint32 numStoppedChannels = 0;
+		updateAudioStreaming();
 
-		for (auto it = channels.begin(), end = channels.end(); it != end; ++it)
+		manageVoices();
+
+		for (auto it = channels.begin(); it != channels.end();)
 		{
 			it->second->update(context, dt);
 			if (it->second->hasStopped())
 			{
-				stoppedChannels[numStoppedChannels++] = it;
 				//LOG_MESSAGE("Deleting channel");
+				it = channels.erase(it);
+			}
+			else
+			{
+				++it;
 			}
-		}
-
-		for (uint32 i = 0; i < numStoppedChannels; ++i)
-		{
-			channels.erase(stoppedChannels[i]);
 		}
 	}
 
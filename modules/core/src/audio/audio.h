@@ -24,9 +24,38 @@ namespace era_engine
 	extern master_audio_settings masterAudioSettings;
 	extern float soundTypeVolumes[sound_type_count];
 
-	bool initializeAudio();
+	// Each frame, all playing sounds are ranked by audibility times the priority of their sound type. Only the top maxRealVoices
+	// get a voice. The others are virtual: they are silent and cost no mixing, but their playback position keeps advancing, so
+	// they fade back in at the right spot once they rank high enough again.
+	struct ERA_CORE_API voice_management_settings
+	{
+		uint32 maxRealVoices = 32;
+		float minAudibility = 0.001f; // Quieter sounds are always virtual.
+		float soundTypePriorities[sound_type_count] = { 4.f, 1.f };
+	};
+
+	extern voice_management_settings voiceManagementSettings;
+
+	struct ERA_CORE_API audio_voice_stats
+	{
+		uint32 numChannels;
+		uint32 numRealVoices; // Channels which currently hold a voice, including ones fading in or out.
+		uint32 numVirtualChannels;
+	};
+
+	struct audio_output;
+	struct audio_mixer_stats;
+
+	// Plays through XAudio2 by default. If an output is passed, audio is mixed on the CPU and written to the output instead, e.g. a
+	// null_audio_output or wav_audio_output for headless runs.
+	bool initializeAudio(const ref<audio_output>& output = nullptr);
 	void shutdownAudio();
 
+	// Zero, if audio is not mixed on the CPU.
+	NODISCARD audio_mixer_stats getAudioMixerStats();
+
+	NODISCARD audio_voice_stats getAudioVoiceStats();
+
 	void setAudioListener(vec3 position, quat rotation, vec3 velocity = vec3(0.f));
 
 	void updateAudio(float dt);
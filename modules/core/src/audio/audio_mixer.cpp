@@ -0,0 +1,866 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#include "audio/audio_mixer.h"
+
+#include "core/simd.h"
+#include "core/sync.h"
+#include "core/cpu_profiling.h"
+
+#define AUDIO_MIXER_MAX_RESAMPLE_STEP 4.f // Source frames per output frame, including pitch.
+#define AUDIO_MIXER_MAX_SOURCE_FRAMES ((uint32)(AUDIO_MIXER_MAX_RESAMPLE_STEP * AUDIO_MIXER_BLOCK_SIZE) + 4)
+
+namespace era_engine
+{
+#if defined(SIMD_AVX_2)
+	typedef w8_float mix_float;
+	typedef w8_int mix_int;
+	static const uint32 mixWidth = 8;
+
+	static mix_float laneOffsets() { return mix_float(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f); }
+	static mix_float loadInt16(const int16* samples) { return convert(w8_int(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)samples)))); }
+#else
+	typedef w4_float mix_float;
+	typedef w4_int mix_int;
+	static const uint32 mixWidth = 4;
+
+	static mix_float laneOffsets() { return mix_float(0.f, 1.f, 2.f, 3.f); }
+	static mix_float loadInt16(const int16* samples) { return convert(w4_int(_mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i*)samples)))); }
+#endif
+
+	static_assert(AUDIO_MIXER_BLOCK_SIZE % 8 == 0, "Block size must be a multiple of the SIMD width.");
+
+	struct audio_mixer_voice
+	{
+		bool active;
+		bool playing;
+		bool ended;
+		bool reverbSend;
+		bool firstBlock;
+
+		sound_type type;
+		audio_mixer_voice_callback* callback;
+
+		uint32 numChannels;
+		uint32 sampleRate;
+		uint32 bytesPerFrame;
+		bool isFloat;
+
+		audio_mixer_buffer buffers[AUDIO_MIXER_MAX_QUEUED_BUFFERS];
+		uint32 firstBuffer;
+		uint32 numBuffers;
+
+		uint32 framePosition; // In the first buffer.
+		uint64 framesPlayed;
+		float fraction;
+
+		float volume;
+		float frequencyRatio;
+		float matrix[AUDIO_MIXER_NUM_OUTPUT_CHANNELS * AUDIO_MIXER_MAX_SOURCE_CHANNELS];
+		float reverbLevel;
+
+		// Gains at the end of the last block. Gains are ramped from these to the current ones over a block.
+		float oldGains[AUDIO_MIXER_NUM_OUTPUT_CHANNELS * AUDIO_MIXER_MAX_SOURCE_CHANNELS];
+		float oldReverbGain;
+	};
+
+	struct audio_mixer_scratch
+	{
+		float source[AUDIO_MIXER_MAX_SOURCE_FRAMES * AUDIO_MIXER_MAX_SOURCE_CHANNELS]; // Interleaved.
+		float resampled[AUDIO_MIXER_MAX_SOURCE_CHANNELS][AUDIO_MIXER_BLOCK_SIZE];
+
+		float buses[sound_type_count][AUDIO_MIXER_NUM_OUTPUT_CHANNELS][AUDIO_MIXER_BLOCK_SIZE];
+		float reverbInput[sound_type_count][AUDIO_MIXER_BLOCK_SIZE];
+		float master[AUDIO_MIXER_NUM_OUTPUT_CHANNELS][AUDIO_MIXER_BLOCK_SIZE];
+	};
+
+	// Small Schroeder reverb (Freeverb tuning, half the comb filters). Mono in, stereo out.
+	struct audio_mixer_comb_filter
+	{
+		float process(float input)
+		{
+			float output = buffer[index];
+			filterStore = output * (1.f - damping) + filterStore * damping;
+			buffer[index] = input + filterStore * feedback;
+			if (++index == (uint32)buffer.size())
+			{
+				index = 0;
+			}
+			return output;
+		}
+
+		std::vector<float> buffer;
+		uint32 index = 0;
+		float filterStore = 0.f;
+
+		static constexpr float feedback = 0.84f;
+		static constexpr float damping = 0.2f;
+	};
+
+	struct audio_mixer_allpass_filter
+	{
+		float process(float input)
+		{
+			float buffered = buffer[index];
+			buffer[index] = input + buffered * 0.5f;
+			if (++index == (uint32)buffer.size())
+			{
+				index = 0;
+			}
+			return buffered - input;
+		}
+
+		std::vector<float> buffer;
+		uint32 index = 0;
+	};
+
+	struct audio_mixer_reverb
+	{
+		void initialize(uint32 sampleRate)
+		{
+			static const uint32 combSizes[] = { 1116, 1188, 1277, 1356 };
+			static const uint32 allpassSizes[] = { 556, 441 };
+			static const uint32 stereoSpread = 23;
+
+			float scale = sampleRate / 44100.f;
+			for (uint32 c = 0; c < AUDIO_MIXER_NUM_OUTPUT_CHANNELS; ++c)
+			{
+				for (uint32 i = 0; i < arraysize(combSizes); ++i)
+				{
+					combs[c][i].buffer.resize((uint32)((combSizes[i] + c * stereoSpread) * scale));
+				}
+				for (uint32 i = 0; i < arraysize(allpassSizes); ++i)
+				{
+					allpasses[c][i].buffer.resize((uint32)((allpassSizes[i] + c * stereoSpread) * scale));
+				}
+			}
+			reset();
+		}
+
+		void reset()
+		{
+			for (uint32 c = 0; c < AUDIO_MIXER_NUM_OUTPUT_CHANNELS; ++c)
+			{
+				for (audio_mixer_comb_filter& comb : combs[c])
+				{
+					std::fill(comb.buffer.begin(), comb.buffer.end(), 0.f);
+					comb.filterStore = 0.f;
+				}
+				for (audio_mixer_allpass_filter& allpass : allpasses[c])
+				{
+					std::fill(allpass.buffer.begin(), allpass.buffer.end(), 0.f);
+				}
+			}
+		}
+
+		// Adds the wet signal to the outputs.
+		void process(const float* input, float* const* outputs)
+		{
+			for (uint32 c = 0; c < AUDIO_MIXER_NUM_OUTPUT_CHANNELS; ++c)
+			{
+				float* output = outputs[c];
+				for (uint32 i = 0; i < AUDIO_MIXER_BLOCK_SIZE; ++i)
+				{
+					float in = input[i] * inputGain;
+
+					float wet = 0.f;
+					for (audio_mixer_comb_filter& comb : combs[c])
+					{
+						wet += comb.process(in);
+					}
+					for (audio_mixer_allpass_filter& allpass : allpasses[c])
+					{
+						wet = allpass.process(wet);
+					}
+					output[i] += wet;
+				}
+			}
+		}
+
+		audio_mixer_comb_filter combs[AUDIO_MIXER_NUM_OUTPUT_CHANNELS][4];
+		audio_mixer_allpass_filter allpasses[AUDIO_MIXER_NUM_OUTPUT_CHANNELS][2];
+
+		static constexpr float inputGain = 0.03f;
+	};
+
+	// Converts interleaved source samples to float.
+	static void convertSamples(const void* data, bool isFloat, uint32 numSamples, float* output)
+	{
+		if (isFloat)
+		{
+			memcpy(output, data, numSamples * sizeof(float));
+			return;
+		}
+
+		const int16* samples = (const int16*)data;
+		const mix_float scale = 1.f / 32768.f;
+
+		uint32 i = 0;
+		for (; i + mixWidth <= numSamples; i += mixWidth)
+		{
+			(loadInt16(samples + i) * scale).store(output + i);
+		}
+		for (; i < numSamples; ++i)
+		{
+			output[i] = samples[i] * (1.f / 32768.f);
+		}
+	}
+
+	// Reads frames from the buffer queue without consuming them. Missing frames are filled with silence.
+	static void peekFrames(const audio_mixer_voice& voice, uint32 numFrames, float* output)
+	{
+		uint32 numWritten = 0;
+		uint32 position = voice.framePosition;
+
+		for (uint32 b = 0; b < voice.numBuffers && numWritten < numFrames; )
+		{
+			const audio_mixer_buffer& buffer = voice.buffers[(voice.firstBuffer + b) % AUDIO_MIXER_MAX_QUEUED_BUFFERS];
+			uint32 bufferFrames = buffer.numBytes / voice.bytesPerFrame;
+
+			if (position >= bufferFrames)
+			{
+				if (!buffer.loop || bufferFrames == 0)
+				{
+					++b;
+				}
+				position = 0;
+				continue;
+			}
+
+			uint32 count = min(numFrames - numWritten, bufferFrames - position);
+			convertSamples((const uint8*)buffer.data + position * voice.bytesPerFrame, voice.isFloat, count * voice.numChannels,
+				output + numWritten * voice.numChannels);
+
+			numWritten += count;
+			position += count;
+		}
+
+		memset(output + numWritten * voice.numChannels, 0, (numFrames - numWritten) * voice.numChannels * sizeof(float));
+	}
+
+	// Consumes frames and retires finished buffers. Returns true, if the voice ran out of data before the end of its stream.
+	static bool advanceFrames(audio_mixer_voice& voice, uint32 numFrames)
+	{
+		voice.framesPlayed += numFrames;
+
+		while (numFrames > 0 && voice.numBuffers > 0)
+		{
+			const audio_mixer_buffer& buffer = voice.buffers[voice.firstBuffer];
+			uint32 bufferFrames = buffer.numBytes / voice.bytesPerFrame;
+
+			uint32 remaining = bufferFrames - voice.framePosition;
+			if (numFrames < remaining)
+			{
+				voice.framePosition += numFrames;
+				return false;
+			}
+
+			numFrames -= remaining;
+			voice.framePosition = 0;
+
+			if (buffer.loop && bufferFrames > 0)
+			{
+				numFrames %= bufferFrames;
+				continue;
+			}
+
+			audio_mixer_buffer finished = buffer;
+			voice.firstBuffer = (voice.firstBuffer + 1) % AUDIO_MIXER_MAX_QUEUED_BUFFERS;
+			--voice.numBuffers;
+
+			if (voice.callback)
+			{
+				voice.callback->onBufferEnd(finished.context);
+			}
+
+			if (finished.endOfStream)
+			{
+				voice.ended = true;
+				voice.playing = false;
+				if (voice.callback)
+				{
+					voice.callback->onStreamEnd();
+				}
+				return false;
+			}
+		}
+
+		return numFrames > 0;
+	}
+
+	static void resample(const audio_mixer_voice& voice, float step, const float* source, float (*output)[AUDIO_MIXER_BLOCK_SIZE])
+	{
+		const mix_float offsets = laneOffsets();
+		const int numChannels = (int)voice.numChannels;
+
+		for (uint32 i = 0; i < AUDIO_MIXER_BLOCK_SIZE; i += mixWidth)
+		{
+			mix_float position = fmadd(mix_float((float)i) + offsets, step, voice.fraction);
+			mix_float index = floor(position);
+			mix_float t = position - index;
+
+			mix_int sampleIndex = convert(index);
+			if (numChannels == 2)
+			{
+				sampleIndex = sampleIndex << 1;
+			}
+
+			for (int c = 0; c < numChannels; ++c)
+			{
+				mix_float a(source, sampleIndex + mix_int(c));
+				mix_float b(source, sampleIndex + mix_int(c + numChannels));
+				lerp(a, b, t).store(output[c] + i);
+			}
+		}
+	}
+
+	// output += input * gain, with the gain linearly ramped over the block.
+	static void mixWithRamp(const float* input, float* output, float gainFrom, float gainTo)
+	{
+		if (gainFrom == 0.f && gainTo == 0.f)
+		{
+			return;
+		}
+
+		const mix_float offsets = laneOffsets();
+		const float delta = (gainTo - gainFrom) / AUDIO_MIXER_BLOCK_SIZE;
+
+		for (uint32 i = 0; i < AUDIO_MIXER_BLOCK_SIZE; i += mixWidth)
+		{
+			mix_float gain = fmadd(mix_float((float)i) + offsets, delta, gainFrom);
+			fmadd(mix_float(input + i), gain, mix_float(output + i)).store(output + i);
+		}
+	}
+
+	static void applyRamp(float* samples, float gainFrom, float gainTo)
+	{
+		const mix_float offsets = laneOffsets();
+		const float delta = (gainTo - gainFrom) / AUDIO_MIXER_BLOCK_SIZE;
+
+		for (uint32 i = 0; i < AUDIO_MIXER_BLOCK_SIZE; i += mixWidth)
+		{
+			mix_float gain = fmadd(mix_float((float)i) + offsets, delta, gainFrom);
+			(mix_float(samples + i) * gain).store(samples + i);
+		}
+	}
+
+	// Returns true, if the voice was starved.
+	static bool mixVoice(audio_mixer_voice& voice, audio_mixer_scratch& scratch, uint32 outputSampleRate)
+	{
+		const uint32 numGains = AUDIO_MIXER_NUM_OUTPUT_CHANNELS * voice.numChannels;
+
+		float gains[AUDIO_MIXER_NUM_OUTPUT_CHANNELS * AUDIO_MIXER_MAX_SOURCE_CHANNELS];
+		bool silent = true;
+		for (uint32 i = 0; i < numGains; ++i)
+		{
+			gains[i] = voice.matrix[i] * voice.volume;
+			silent &= (gains[i] == 0.f && voice.oldGains[i] == 0.f);
+		}
+		float reverbGain = voice.reverbSend ? (voice.reverbLevel * voice.volume / voice.numChannels) : 0.f;
+		silent &= (reverbGain == 0.f && voice.oldReverbGain == 0.f);
+
+		if (voice.firstBlock)
+		{
+			memcpy(voice.oldGains, gains, sizeof(gains));
+			voice.oldReverbGain = reverbGain;
+			voice.firstBlock = false;
+		}
+
+		float step = clamp((float)voice.sampleRate / (float)outputSampleRate * voice.frequencyRatio, 0.f, AUDIO_MIXER_MAX_RESAMPLE_STEP);
+
+		// Silent voices only advance. This keeps virtualized and distant sounds in sync at almost no cost.
+		if (!silent)
+		{
+			uint32 numSourceFrames = (uint32)(voice.fraction + step * (AUDIO_MIXER_BLOCK_SIZE - 1)) + 2;
+			peekFrames(voice, numSourceFrames, scratch.source);
+			resample(voice, step, scratch.source, scratch.resampled);
+
+			float (*bus)[AUDIO_MIXER_BLOCK_SIZE] = scratch.buses[voice.type];
+			for (uint32 d = 0; d < AUDIO_MIXER_NUM_OUTPUT_CHANNELS; ++d)
+			{
+				for (uint32 s = 0; s < voice.numChannels; ++s)
+				{
+					uint32 g = d * voice.numChannels + s;
+					mixWithRamp(scratch.resampled[s], bus[d], voice.oldGains[g], gains[g]);
+				}
+			}
+
+			for (uint32 s = 0; s < voice.numChannels; ++s)
+			{
+				mixWithRamp(scratch.resampled[s], scratch.reverbInput[voice.type], voice.oldReverbGain, reverbGain);
+			}
+		}
+
+		memcpy(voice.oldGains, gains, sizeof(gains));
+		voice.oldReverbGain = reverbGain;
+
+		float end = voice.fraction + step * AUDIO_MIXER_BLOCK_SIZE;
+		uint32 numAdvancedFrames = (uint32)end;
+		voice.fraction = end - numAdvancedFrames;
+
+		return advanceFrames(voice, numAdvancedFrames);
+	}
+
+	static bool getSourceFormat(const audio_mixer_format& format, uint32& outNumChannels, uint32& outBytesPerFrame, bool& outIsFloat)
+	{
+		if (format.numChannels == 0 || format.numChannels > AUDIO_MIXER_MAX_SOURCE_CHANNELS || format.sampleRate == 0)
+		{
+			return false;
+		}
+
+		bool supported = (!format.isFloat && format.bitsPerSample == 16) || (format.isFloat && format.bitsPerSample == 32);
+		if (!supported)
+		{
+			return false;
+		}
+
+		outNumChannels = format.numChannels;
+		outBytesPerFrame = format.numChannels * format.bitsPerSample / 8;
+		outIsFloat = format.isFloat;
+		return true;
+	}
+
+	audio_mixer::audio_mixer(const ref<audio_output>& output, bool startThread)
+		: output(output)
+	{
+		voices = new audio_mixer_voice[AUDIO_MIXER_MAX_VOICES]();
+		reverbs = new audio_mixer_reverb[sound_type_count];
+		scratch = new audio_mixer_scratch;
+
+		for (uint32 i = 0; i < sound_type_count; ++i)
+		{
+			reverbs[i].initialize(output->sampleRate);
+			soundTypeVolumes[i] = oldSoundTypeVolumes[i] = 1.f;
+		}
+
+		stats.blockDuration = AUDIO_MIXER_BLOCK_SIZE * 1000.f / output->sampleRate;
+
+		if (startThread)
+		{
+			running = true;
+			thread = std::thread([this]() { mixThread(); });
+		}
+	}
+
+	audio_mixer::~audio_mixer()
+	{
+		running = false;
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+
+		delete[] voices;
+		delete[] reverbs;
+		delete scratch;
+	}
+
+	void audio_mixer::mixThread()
+	{
+		// Reverb tails decay into denormals, which are very slow.
+		_MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
+		_MM_SET_DENORMALS_ZERO_MODE(_MM_DENORMALS_ZERO_ON);
+
+#ifdef _WIN32
+		SetThreadDescription(GetCurrentThread(), L"Audio mixer");
+		SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+#endif
+
+		float samples[AUDIO_MIXER_BLOCK_SIZE * AUDIO_MIXER_NUM_OUTPUT_CHANNELS];
+
+		while (running)
+		{
+			{
+				Lock lock{ mutex };
+				mixBlock(samples);
+			}
+			output->write(samples, AUDIO_MIXER_BLOCK_SIZE);
+		}
+	}
+
+	void audio_mixer::render(uint32 numBlocks)
+	{
+		ASSERT(!thread.joinable());
+
+		uint32 csr = _mm_getcsr();
+		_MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
+		_MM_SET_DENORMALS_ZERO_MODE(_MM_DENORMALS_ZERO_ON);
+
+		float samples[AUDIO_MIXER_BLOCK_SIZE * AUDIO_MIXER_NUM_OUTPUT_CHANNELS];
+
+		for (uint32 i = 0; i < numBlocks; ++i)
+		{
+			{
+				Lock lock{ mutex };
+				mixBlock(samples);
+			}
+			output->write(samples, AUDIO_MIXER_BLOCK_SIZE);
+		}
+
+		_mm_setcsr(csr);
+	}
+
+	void audio_mixer::mixBlock(float* outSamples)
+	{
+		CPU_PROFILE_BLOCK("Mix audio block");
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		memset(scratch->buses, 0, sizeof(scratch->buses));
+		memset(scratch->reverbInput, 0, sizeof(scratch->reverbInput));
+		memset(scratch->master, 0, sizeof(scratch->master));
+
+		uint32 numActiveVoices = 0;
+		uint32 numPlayingVoices = 0;
+		bool starved = false;
+
+		for (uint32 i = 0; i < AUDIO_MIXER_MAX_VOICES; ++i)
+		{
+			audio_mixer_voice& voice = voices[i];
+			if (!voice.active)
+			{
+				continue;
+			}
+
+			++numActiveVoices;
+			if (voice.playing)
+			{
+				++numPlayingVoices;
+				starved |= mixVoice(voice, *scratch, output->sampleRate);
+			}
+		}
+
+		for (uint32 t = 0; t < sound_type_count; ++t)
+		{
+			float* bus[AUDIO_MIXER_NUM_OUTPUT_CHANNELS];
+			for (uint32 d = 0; d < AUDIO_MIXER_NUM_OUTPUT_CHANNELS; ++d)
+			{
+				bus[d] = scratch->buses[t][d];
+			}
+
+			if (reverbEnabled)
+			{
+				reverbs[t].process(scratch->reverbInput[t], bus);
+			}
+
+			for (uint32 d = 0; d < AUDIO_MIXER_NUM_OUTPUT_CHANNELS; ++d)
+			{
+				mixWithRamp(bus[d], scratch->master[d], oldSoundTypeVolumes[t], soundTypeVolumes[t]);
+			}
+			oldSoundTypeVolumes[t] = soundTypeVolumes[t];
+		}
+
+		for (uint32 d = 0; d < AUDIO_MIXER_NUM_OUTPUT_CHANNELS; ++d)
+		{
+			applyRamp(scratch->master[d], oldMasterVolume, masterVolume);
+		}
+		oldMasterVolume = masterVolume;
+
+		for (uint32 i = 0; i < AUDIO_MIXER_BLOCK_SIZE; ++i)
+		{
+			for (uint32 d = 0; d < AUDIO_MIXER_NUM_OUTPUT_CHANNELS; ++d)
+			{
+				outSamples[i * AUDIO_MIXER_NUM_OUTPUT_CHANNELS + d] = clamp(scratch->master[d][i], -1.f, 1.f);
+			}
+		}
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+
+		stats.numActiveVoices = numActiveVoices;
+		stats.numPlayingVoices = numPlayingVoices;
+		++stats.numMixedBlocks;
+		stats.numStarvedBlocks += starved;
+		stats.lastBlockMixTime = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+		stats.maxBlockMixTime = max(stats.maxBlockMixTime, stats.lastBlockMixTime);
+	}
+
+	uint32 audio_mixer::createVoice(const audio_mixer_format& format, sound_type type, bool reverbSend, audio_mixer_voice_callback* callback)
+	{
+		uint32 numChannels, bytesPerFrame;
+		bool isFloat;
+		if (!getSourceFormat(format, numChannels, bytesPerFrame, isFloat))
+		{
+			return AUDIO_MIXER_INVALID_VOICE;
+		}
+
+		Lock lock{ mutex };
+
+		for (uint32 i = 0; i < AUDIO_MIXER_MAX_VOICES; ++i)
+		{
+			audio_mixer_voice& voice = voices[i];
+			if (voice.active)
+			{
+				continue;
+			}
+
+			voice = {};
+			voice.active = true;
+			voice.playing = true;
+			voice.reverbSend = reverbSend;
+			voice.firstBlock = true;
+			voice.type = type;
+			voice.callback = callback;
+			voice.numChannels = numChannels;
+			voice.sampleRate = format.sampleRate;
+			voice.bytesPerFrame = bytesPerFrame;
+			voice.isFloat = isFloat;
+			voice.volume = 1.f;
+			voice.frequencyRatio = 1.f;
+
+			// Like XAudio2, mono goes to both outputs and stereo maps straight through.
+			for (uint32 d = 0; d < AUDIO_MIXER_NUM_OUTPUT_CHANNELS; ++d)
+			{
+				for (uint32 s = 0; s < numChannels; ++s)
+				{
+					voice.matrix[d * numChannels + s] = (numChannels == 1 || s == d) ? 1.f : 0.f;
+				}
+			}
+
+			return i;
+		}
+
+		return AUDIO_MIXER_INVALID_VOICE;
+	}
+
+	void audio_mixer::destroyVoice(uint32 voice)
+	{
+		Lock lock{ mutex };
+		ASSERT(voice < AUDIO_MIXER_MAX_VOICES && voices[voice].active);
+		voices[voice] = {};
+	}
+
+	bool audio_mixer::submitBuffer(uint32 voice, const audio_mixer_buffer& buffer)
+	{
+		Lock lock{ mutex };
+		audio_mixer_voice& v = voices[voice];
+		ASSERT(v.active);
+
+		if (v.numBuffers == AUDIO_MIXER_MAX_QUEUED_BUFFERS)
+		{
+			return false;
+		}
+
+		if (v.numBuffers == 0)
+		{
+			v.framePosition = min(buffer.playBegin, buffer.numBytes / v.bytesPerFrame);
+			v.fraction = 0.f;
+		}
+
+		v.buffers[(v.firstBuffer + v.numBuffers) % AUDIO_MIXER_MAX_QUEUED_BUFFERS] = buffer;
+		++v.numBuffers;
+		return true;
+	}
+
+	uint32 audio_mixer::getNumQueuedBuffers(uint32 voice)
+	{
+		Lock lock{ mutex };
+		return voices[voice].numBuffers;
+	}
+
+	uint64 audio_mixer::getVoiceFramesPlayed(uint32 voice)
+	{
+		Lock lock{ mutex };
+		return voices[voice].framesPlayed;
+	}
+
+	void audio_mixer::stopVoice(uint32 voice)
+	{
+		Lock lock{ mutex };
+		voices[voice].playing = false;
+	}
+
+	void audio_mixer::setVoiceVolume(uint32 voice, float volume)
+	{
+		Lock lock{ mutex };
+		voices[voice].volume = volume;
+	}
+
+	void audio_mixer::setVoiceFrequencyRatio(uint32 voice, float ratio)
+	{
+		Lock lock{ mutex };
+		voices[voice].frequencyRatio = ratio;
+	}
+
+	void audio_mixer::setVoiceOutputMatrix(uint32 voice, const float* matrix, float reverbLevel)
+	{
+		Lock lock{ mutex };
+		audio_mixer_voice& v = voices[voice];
+		memcpy(v.matrix, matrix, AUDIO_MIXER_NUM_OUTPUT_CHANNELS * v.numChannels * sizeof(float));
+		v.reverbLevel = reverbLevel;
+	}
+
+	void audio_mixer::setMasterVolume(float volume)
+	{
+		Lock lock{ mutex };
+		masterVolume = volume;
+	}
+
+	void audio_mixer::setSoundTypeVolume(sound_type type, float volume)
+	{
+		Lock lock{ mutex };
+		soundTypeVolumes[type] = volume;
+	}
+
+	void audio_mixer::setReverbEnabled(bool enabled)
+	{
+		Lock lock{ mutex };
+		if (reverbEnabled && !enabled)
+		{
+			for (uint32 i = 0; i < sound_type_count; ++i)
+			{
+				reverbs[i].reset();
+			}
+		}
+		reverbEnabled = enabled;
+	}
+
+	audio_mixer_stats audio_mixer::getStats()
+	{
+		Lock lock{ mutex };
+		return stats;
+	}
+
+	void calculate3DAudio(vec3 listenerPosition, quat listenerRotation, vec3 emitterPosition, float radius, uint32 numSourceChannels,
+		float* outMatrix, float& outReverbLevel)
+	{
+		// Listener space: x points right, -z forward.
+		vec3 toEmitter = conjugate(listenerRotation) * (emitterPosition - listenerPosition);
+		float distance = length(toEmitter);
+		float attenuation = (radius > 0.f) ? clamp01(1.f - distance / radius) : 0.f;
+
+		// Equal power panning. Inside the inner radius, the sound moves to the center, so that it doesn't jump from side to side when
+		// passing through the listener.
+		const float innerRadius = 2.f;
+		float pan = (distance > 1e-4f) ? clamp(toEmitter.x / distance, -1.f, 1.f) : 0.f;
+		pan *= clamp01(distance / innerRadius);
+
+		float angle = (pan + 1.f) * (M_PI * 0.25f);
+		float gains[AUDIO_MIXER_NUM_OUTPUT_CHANNELS] = { cos(angle) * attenuation, sin(angle) * attenuation };
+
+		// All source channels are emitted from the same position.
+		for (uint32 d = 0; d < AUDIO_MIXER_NUM_OUTPUT_CHANNELS; ++d)
+		{
+			for (uint32 s = 0; s < numSourceChannels; ++s)
+			{
+				outMatrix[d * numSourceChannels + s] = gains[d] / numSourceChannels;
+			}
+		}
+
+		outReverbLevel = attenuation;
+	}
+
+	null_audio_output::null_audio_output(uint32 sampleRate, bool realtime)
+		: realtime(realtime)
+	{
+		this->sampleRate = sampleRate;
+	}
+
+	void null_audio_output::write(const float* samples, uint32 numFrames)
+	{
+		if (!realtime)
+		{
+			return;
+		}
+
+		auto now = std::chrono::steady_clock::now();
+
+		// Start over after stalls (e.g. a debugger break), instead of mixing as fast as possible to catch up.
+		if (!started || now > nextBlockTime + std::chrono::milliseconds(100))
+		{
+			nextBlockTime = now;
+			started = true;
+		}
+
+		nextBlockTime += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>((double)numFrames / sampleRate));
+		std::this_thread::sleep_until(nextBlockTime);
+	}
+
+	struct wav_file_header
+	{
+		char riff[4];
+		uint32 riffSize;
+		char wave[4];
+
+		char fmt[4];
+		uint32 fmtSize;
+		uint16 formatTag;
+		uint16 numChannels;
+		uint32 sampleRate;
+		uint32 bytesPerSecond;
+		uint16 blockAlign;
+		uint16 bitsPerSample;
+
+		char data[4];
+		uint32 dataSize;
+	};
+
+	static_assert(sizeof(wav_file_header) == 44);
+
+	static wav_file_header getWavFileHeader(uint32 sampleRate, uint32 numDataBytes)
+	{
+		const uint32 blockAlign = AUDIO_MIXER_NUM_OUTPUT_CHANNELS * sizeof(int16);
+		const uint16 pcmFormatTag = 1;
+
+		wav_file_header header = {
+			{ 'R', 'I', 'F', 'F' }, 36 + numDataBytes, { 'W', 'A', 'V', 'E' },
+			{ 'f', 'm', 't', ' ' }, 16, pcmFormatTag, AUDIO_MIXER_NUM_OUTPUT_CHANNELS, sampleRate, sampleRate * blockAlign, blockAlign, 16,
+			{ 'd', 'a', 't', 'a' }, numDataBytes,
+		};
+		return header;
+	}
+
+	wav_audio_output::wav_audio_output(const fs::path& path, uint32 sampleRate, bool realtime)
+		: pacing(sampleRate, realtime)
+	{
+		this->sampleRate = sampleRate;
+
+		file = fopen(path.string().c_str(), "wb");
+		if (file)
+		{
+			wav_file_header header = getWavFileHeader(sampleRate, 0);
+			fwrite(&header, sizeof(header), 1, file);
+		}
+	}
+
+	wav_audio_output::~wav_audio_output()
+	{
+		if (file)
+		{
+			wav_file_header header = getWavFileHeader(sampleRate, (uint32)min(numDataBytes, (uint64)UINT32_MAX - 36));
+			fseek(file, 0, SEEK_SET);
+			fwrite(&header, sizeof(header), 1, file);
+			fclose(file);
+		}
+	}
+
+	void wav_audio_output::write(const float* samples, uint32 numFrames)
+	{
+		if (file)
+		{
+			int16 converted[1024];
+
+			uint32 numSamples = numFrames * AUDIO_MIXER_NUM_OUTPUT_CHANNELS;
+			for (uint32 offset = 0; offset < numSamples; offset += arraysize(converted))
+			{
+				uint32 count = min(numSamples - offset, (uint32)arraysize(converted));
+				const float* in = samples + offset;
+
+				uint32 i = 0;
+				for (; i + 8 <= count; i += 8)
+				{
+					w4_int a = convert(clamp(w4_float(in + i), -1.f, 1.f) * 32767.f);
+					w4_int b = convert(clamp(w4_float(in + i + 4), -1.f, 1.f) * 32767.f);
+					_mm_storeu_si128((__m128i*)(converted + i), _mm_packs_epi32(a, b));
+				}
+				for (; i < count; ++i)
+				{
+					converted[i] = (int16)lroundf(clamp(in[i], -1.f, 1.f) * 32767.f);
+				}
+
+				fwrite(converted, sizeof(int16), count, file);
+				numDataBytes += count * sizeof(int16);
+			}
+		}
+
+		pacing.write(samples, numFrames);
+	}
+}
@@ -0,0 +1,189 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#pragma once
+
+#include "core_api.h"
+
+#include "audio/sound_type.h"
+
+#include "core/math.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#define AUDIO_MIXER_MAX_VOICES 64
+#define AUDIO_MIXER_MAX_QUEUED_BUFFERS 4
+#define AUDIO_MIXER_MAX_SOURCE_CHANNELS 2
+#define AUDIO_MIXER_NUM_OUTPUT_CHANNELS 2
+#define AUDIO_MIXER_BLOCK_SIZE 512 // Frames per block. Multiple of the SIMD width.
+
+#define AUDIO_MIXER_INVALID_VOICE UINT32_MAX
+
+namespace era_engine
+{
+	/*
+		CPU mixer, which replaces the XAudio2 graph when audio is initialized with an audio_output. The mix thread produces blocks of
+		AUDIO_MIXER_BLOCK_SIZE interleaved stereo frames and hands them to the output, which paces the thread.
+
+		The graph matches the XAudio2 one:
+
+		[Voice(s)] ----> [Sound type bus] ----> [Master] ----> [Output]
+			 `-> [Sound type reverb] -^
+
+		Voices mirror XAudio2 source voices: they play a queue of buffers owned by the caller, and report finished buffers through a
+		callback on the mix thread. The mixer itself uses no XAudio2 or other platform API, so it also runs off Windows.
+
+		The cost per block is one resampling and panning pass per playing voice plus a fixed cost for the buses and reverbs. It grows
+		with the number of playing voices, up to AUDIO_MIXER_MAX_VOICES, which bounds it. Virtual channels hold no voice.
+	*/
+
+	// Sink for mixed audio. Called from the mix thread.
+	struct ERA_CORE_API audio_output
+	{
+		virtual ~audio_output() {}
+
+		// Samples are interleaved, AUDIO_MIXER_NUM_OUTPUT_CHANNELS per frame, in [-1, 1]. Returns once the output is ready for the next block.
+		virtual void write(const float* samples, uint32 numFrames) = 0;
+
+		uint32 sampleRate = 48000;
+	};
+
+	// Discards all audio. If realtime is set, writes take as long as playing the block would, like a real device.
+	struct ERA_CORE_API null_audio_output : audio_output
+	{
+		null_audio_output(uint32 sampleRate = 48000, bool realtime = true);
+
+		void write(const float* samples, uint32 numFrames) override;
+
+	private:
+		bool realtime;
+		std::chrono::steady_clock::time_point nextBlockTime;
+		bool started = false;
+	};
+
+	// Writes 16 bit PCM to a WAV file. The header is completed when the output is destroyed.
+	struct ERA_CORE_API wav_audio_output : audio_output
+	{
+		wav_audio_output(const fs::path& path, uint32 sampleRate = 48000, bool realtime = true);
+		~wav_audio_output();
+
+		void write(const float* samples, uint32 numFrames) override;
+
+		NODISCARD bool isOpen() const { return file != 0; }
+
+	private:
+		FILE* file = 0;
+		uint64 numDataBytes = 0;
+
+		null_audio_output pacing;
+	};
+
+	// Called on the mix thread, while the mixer is locked. Don't call back into the mixer.
+	struct ERA_CORE_API audio_mixer_voice_callback
+	{
+		virtual ~audio_mixer_voice_callback() {}
+
+		virtual void onBufferEnd(void* bufferContext) {}
+		virtual void onStreamEnd() {}
+	};
+
+	// Source format of a voice. Sample data is interleaved.
+	struct ERA_CORE_API audio_mixer_format
+	{
+		uint32 sampleRate;
+		uint32 numChannels;
+		uint32 bitsPerSample;
+		bool isFloat;
+	};
+
+	struct ERA_CORE_API audio_mixer_buffer
+	{
+		const void* data;
+		uint32 numBytes;
+		void* context = 0; // Passed to onBufferEnd.
+		uint32 playBegin = 0; // First frame played, if the voice has nothing queued. Loops restart at frame 0.
+		bool loop = false;
+		bool endOfStream = false;
+	};
+
+	struct ERA_CORE_API audio_mixer_stats
+	{
+		uint32 numActiveVoices;
+		uint32 numPlayingVoices;
+		uint64 numMixedBlocks;
+		uint64 numStarvedBlocks; // Blocks in which a playing voice ran out of queued data before the end of its stream.
+
+		float lastBlockMixTime; // In milliseconds.
+		float maxBlockMixTime;
+		float blockDuration;
+	};
+
+	struct audio_mixer_voice;
+	struct audio_mixer_reverb;
+	struct audio_mixer_scratch;
+
+	struct ERA_CORE_API audio_mixer
+	{
+		// If no thread is started, blocks are only mixed by calls to render, which makes the output deterministic.
+		audio_mixer(const ref<audio_output>& output, bool startThread = true);
+		~audio_mixer();
+
+		// Formats are 16 bit PCM or 32 bit float, with one or two channels. Returns AUDIO_MIXER_INVALID_VOICE if the format is not
+		// supported or all voices are in use. Voices start playing immediately.
+		NODISCARD uint32 createVoice(const audio_mixer_format& format, sound_type type, bool reverbSend, audio_mixer_voice_callback* callback);
+		void destroyVoice(uint32 voice);
+
+		bool submitBuffer(uint32 voice, const audio_mixer_buffer& buffer);
+		NODISCARD uint32 getNumQueuedBuffers(uint32 voice);
+
+		// Source frames consumed since the voice was created, like XAUDIO2_VOICE_STATE::SamplesPlayed.
+		NODISCARD uint64 getVoiceFramesPlayed(uint32 voice);
+
+		void stopVoice(uint32 voice);
+
+		void setVoiceVolume(uint32 voice, float volume);
+		void setVoiceFrequencyRatio(uint32 voice, float ratio);
+
+		// Layout as in XAudio2: the level of source channel s in output channel d is at matrix[d * numSourceChannels + s].
+		void setVoiceOutputMatrix(uint32 voice, const float* matrix, float reverbLevel);
+
+		void setMasterVolume(float volume);
+		void setSoundTypeVolume(sound_type type, float volume);
+		void setReverbEnabled(bool enabled);
+
+		// Mixes numBlocks blocks on the calling thread. Only valid if no thread was started.
+		void render(uint32 numBlocks);
+
+		NODISCARD audio_mixer_stats getStats();
+
+		NODISCARD uint32 getSampleRate() const { return output->sampleRate; }
+
+	private:
+		void mixThread();
+		void mixBlock(float* outSamples);
+
+		ref<audio_output> output;
+
+		std::mutex mutex;
+		std::thread thread;
+		std::atomic<bool> running = false;
+
+		audio_mixer_voice* voices;
+		audio_mixer_reverb* reverbs;
+		audio_mixer_scratch* scratch;
+
+		float masterVolume = 1.f;
+		float oldMasterVolume = 1.f;
+		float soundTypeVolumes[sound_type_count];
+		float oldSoundTypeVolumes[sound_type_count];
+		bool reverbEnabled = true;
+
+		audio_mixer_stats stats = {};
+	};
+
+	// Replacement for X3DAudioCalculate with a linear distance curve. Fills an XAudio2 style matrix for the mixer's output channels.
+	void calculate3DAudio(vec3 listenerPosition, quat listenerRotation, vec3 emitterPosition, float radius, uint32 numSourceChannels,
+		float* outMatrix, float& outReverbLevel);
+}
@@ -0,0 +1,457 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#include "audio/audio_streaming.h"
+#include "audio/channel.h"
+
+#include "core/sync.h"
+#include "core/job_system.h"
+#include "core/cpu_profiling.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <queue>
+
+#define AUDIO_STREAM_NUM_BUFFERS 2
+#define AUDIO_STREAM_BUFFER_SIZE (1024 * 8 * 6)
+
+namespace era_engine
+{
+	struct audio_stream_buffer
+	{
+		audio_stream* stream;
+		uint8* data;
+	};
+
+	struct audio_stream : std::enable_shared_from_this<audio_stream>
+	{
+		~audio_stream();
+
+		audio_channel* channel;
+		ref<audio_sound> sound;
+
+		audio_stream_buffer buffers[AUDIO_STREAM_NUM_BUFFERS];
+		uint8* memory = 0;
+
+		// Only touched by the fill in flight, of which there is at most one per stream.
+		uint32 readPosition = 0;
+		audio_synth* synth = 0;
+		alignas(16) uint8 synthStorage[MAX_SYNTH_SIZE];
+
+		// Scheduling state. Protected by the service mutex.
+		uint32 nextBuffer = 0;
+		uint32 numFreeBuffers = AUDIO_STREAM_NUM_BUFFERS;
+		bool queued = false;
+		bool inFlight = false;
+		bool primed = false;
+		double queuedEndTime = 0.0; // Time at which all submitted buffers will have played. Infinite while paused.
+		float frequencyRatio = 1.f; // Of the channel's voice. Zero while paused.
+		double pausedSeconds = 0.0; // Playback time of the submitted buffers, while paused.
+
+		// Serializes submitting buffers against stopping the stream.
+		std::mutex submitMutex;
+		std::atomic<bool> cancelled = false;
+		std::atomic<bool> finished = false;
+		std::atomic<bool> loop = false; // Copied from the channel, which may be gone by the time a fill runs.
+	};
+
+	struct audio_stream_request
+	{
+		double deadline;
+		ref<audio_stream> stream;
+
+		// Earliest deadline at the top of the priority queue.
+		bool operator<(const audio_stream_request& other) const { return deadline > other.deadline; }
+	};
+
+	static std::mutex serviceMutex;
+	static std::condition_variable serviceCondition;
+	static std::vector<std::thread> ioThreads;
+	static bool serviceRunning = false;
+
+	static std::priority_queue<audio_stream_request> fileRequests;
+	static std::vector<audio_stream_request> synthRequests;
+	static std::atomic<bool> synthJobRunning = false;
+
+	static std::atomic<uint32> numStreams = 0;
+	static audio_streaming_stats stats = {};
+
+	audio_stream::~audio_stream()
+	{
+		delete[] memory;
+		--numStreams;
+	}
+
+	static double getStreamingTime()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Service mutex must be held.
+	static void scheduleFill(const ref<audio_stream>& stream)
+	{
+		if (stream->queued || stream->inFlight || stream->numFreeBuffers == 0 || stream->cancelled || stream->finished)
+		{
+			return;
+		}
+
+		stream->queued = true;
+
+		audio_stream_request request = { stream->queuedEndTime, stream };
+		if (stream->sound->isSynth)
+		{
+			synthRequests.push_back(std::move(request));
+		}
+		else
+		{
+			fileRequests.push(std::move(request));
+			serviceCondition.notify_one();
+		}
+	}
+
+	// Service mutex must be held. Submitted audio of the given length at normal pitch moves the end time by its length at the voice's
+	// actual playback rate.
+	static void queueStreamTime(audio_stream& stream, double seconds, double now)
+	{
+		if (stream.frequencyRatio > 0.f)
+		{
+			stream.queuedEndTime = max(stream.queuedEndTime, now) + seconds / stream.frequencyRatio;
+		}
+		else
+		{
+			stream.pausedSeconds += seconds;
+		}
+	}
+
+	static uint32 readFileData(audio_stream& stream, uint8* data, bool loop, bool& outEnd)
+	{
+		const audio_sound& sound = *stream.sound;
+		const uint32 blockAlign = max((uint32)sound.wfx.Format.nBlockAlign, 1u);
+		const uint32 capacity = AUDIO_STREAM_BUFFER_SIZE / blockAlign * blockAlign;
+
+		uint32 numBytes = 0;
+		while (numBytes < capacity)
+		{
+			if (stream.readPosition >= sound.chunkSize)
+			{
+				if (!loop || sound.chunkSize == 0)
+				{
+					outEnd = true;
+					break;
+				}
+				stream.readPosition = 0;
+			}
+
+			// Positional reads, so that channels can share the file handle of a sound.
+			uint64 filePosition = (uint64)sound.chunkPosition + stream.readPosition;
+			OVERLAPPED overlapped = {};
+			overlapped.Offset = (DWORD)filePosition;
+			overlapped.OffsetHigh = (DWORD)(filePosition >> 32);
+
+			DWORD numRead = 0;
+			DWORD numToRead = min(capacity - numBytes, sound.chunkSize - stream.readPosition);
+			if (!ReadFile(sound.fileHandle, data + numBytes, numToRead, &numRead, &overlapped) || numRead == 0)
+			{
+				outEnd = true;
+				break;
+			}
+
+			numBytes += numRead;
+			stream.readPosition += numRead;
+		}
+		return numBytes;
+	}
+
+	static uint32 generateSynthData(audio_stream& stream, uint8* data, bool loop, bool& outEnd)
+	{
+		const uint32 numChannels = max((uint32)stream.sound->wfx.Format.nChannels, 1u);
+		const uint32 capacity = AUDIO_STREAM_BUFFER_SIZE / sizeof(float) / numChannels * numChannels;
+
+		float* samples = (float*)data;
+		uint32 numSamples = 0;
+		bool restarted = false;
+
+		while (numSamples < capacity)
+		{
+			if (!stream.synth)
+			{
+				stream.synth = stream.sound->createSynth(stream.synthStorage);
+				restarted = true;
+			}
+
+			uint32 count = stream.synth->getSamples(samples + numSamples, capacity - numSamples);
+			numSamples += count;
+
+			if (count == 0)
+			{
+				// A restarted synth which produces nothing would loop forever.
+				if (!loop || restarted)
+				{
+					outEnd = true;
+					break;
+				}
+				stream.synth = 0;
+			}
+			else
+			{
+				restarted = false;
+			}
+		}
+		return numSamples * sizeof(float);
+	}
+
+	static void fillStream(const ref<audio_stream>& stream)
+	{
+		uint32 bufferIndex;
+		{
+			Lock lock{ serviceMutex };
+			stream->queued = false;
+			stream->inFlight = true;
+			bufferIndex = stream->nextBuffer;
+		}
+
+		audio_stream_buffer& buffer = stream->buffers[bufferIndex];
+		bool loop = stream->loop;
+		bool end = false;
+
+		uint32 numBytes = 0;
+		if (!stream->cancelled)
+		{
+			numBytes = stream->sound->isSynth
+				? generateSynthData(*stream, buffer.data, loop, end)
+				: readFileData(*stream, buffer.data, loop, end);
+		}
+
+		{
+			Lock lock{ stream->submitMutex };
+			if (!stream->cancelled && numBytes > 0)
+			{
+				stream->channel->submitBuffer(buffer.data, numBytes, &buffer, false, false);
+			}
+		}
+
+		Lock lock{ serviceMutex };
+
+		double now = getStreamingTime();
+		++stats.numFills;
+		stats.numMissedDeadlines += (stream->primed && stream->frequencyRatio > 0.f && now > stream->queuedEndTime);
+		stats.numBytesRead += stream->sound->isSynth ? 0 : numBytes;
+
+		if (numBytes > 0)
+		{
+			double duration = (double)numBytes / max((uint32)stream->sound->wfx.Format.nAvgBytesPerSec, 1u);
+			queueStreamTime(*stream, duration, now);
+			stream->nextBuffer = (bufferIndex + 1) % AUDIO_STREAM_NUM_BUFFERS;
+			--stream->numFreeBuffers;
+			stream->primed = true;
+		}
+
+		stream->inFlight = false;
+		if (end)
+		{
+			stream->finished = true;
+		}
+
+		scheduleFill(stream);
+	}
+
+	static void ioThread()
+	{
+		while (true)
+		{
+			audio_stream_request request;
+			{
+				std::unique_lock<std::mutex> lock(serviceMutex);
+				serviceCondition.wait(lock, []() { return !serviceRunning || !fileRequests.empty(); });
+
+				if (!serviceRunning)
+				{
+					return;
+				}
+
+				request = fileRequests.top();
+				fileRequests.pop();
+			}
+
+			fillStream(request.stream);
+		}
+	}
+
+	void initializeAudioStreaming(uint32 numIOThreads)
+	{
+		serviceRunning = true;
+		for (uint32 i = 0; i < numIOThreads; ++i)
+		{
+			ioThreads.emplace_back([]()
+			{
+				SetThreadDescription(GetCurrentThread(), L"Audio streaming");
+				ioThread();
+			});
+		}
+	}
+
+	void shutdownAudioStreaming()
+	{
+		{
+			Lock lock{ serviceMutex };
+			serviceRunning = false;
+		}
+		serviceCondition.notify_all();
+
+		for (std::thread& thread : ioThreads)
+		{
+			thread.join();
+		}
+		ioThreads.clear();
+
+		while (synthJobRunning)
+		{
+			std::this_thread::yield();
+		}
+
+		fileRequests = {};
+		synthRequests.clear();
+	}
+
+	void updateAudioStreaming()
+	{
+		CPU_PROFILE_BLOCK("Update audio streaming");
+
+		if (synthJobRunning)
+		{
+			return;
+		}
+
+		struct synth_job_data
+		{
+			std::vector<audio_stream_request> requests;
+		};
+
+		synth_job_data data;
+		{
+			Lock lock{ serviceMutex };
+			data.requests.swap(synthRequests);
+		}
+
+		if (data.requests.empty())
+		{
+			return;
+		}
+
+		std::sort(data.requests.begin(), data.requests.end(), [](const audio_stream_request& a, const audio_stream_request& b) { return a.deadline < b.deadline; });
+
+		synthJobRunning = true;
+
+		JobHandle job = high_priority_job_queue.createJob<synth_job_data>([](synth_job_data& data, JobHandle)
+		{
+			CPU_PROFILE_BLOCK("Fill synth streams");
+
+			for (const audio_stream_request& request : data.requests)
+			{
+				fillStream(request.stream);
+			}
+
+			synthJobRunning = false;
+		}, data);
+		job.submit_now();
+	}
+
+	ref<audio_stream> startAudioStream(audio_channel* channel, uint32 startByte, float frequencyRatio)
+	{
+		ref<audio_stream> stream = make_ref<audio_stream>();
+		stream->channel = channel;
+		stream->sound = channel->sound;
+		stream->loop = channel->getSettings()->loop;
+
+		if (!stream->sound->isSynth)
+		{
+			const uint32 blockAlign = max((uint32)stream->sound->wfx.Format.nBlockAlign, 1u);
+			stream->readPosition = min(startByte / blockAlign * blockAlign, stream->sound->chunkSize);
+		}
+
+		stream->memory = new uint8[AUDIO_STREAM_NUM_BUFFERS * AUDIO_STREAM_BUFFER_SIZE];
+		for (uint32 i = 0; i < AUDIO_STREAM_NUM_BUFFERS; ++i)
+		{
+			stream->buffers[i].stream = stream.get();
+			stream->buffers[i].data = stream->memory + i * AUDIO_STREAM_BUFFER_SIZE;
+		}
+
+		++numStreams;
+
+		Lock lock{ serviceMutex };
+		stream->frequencyRatio = max(frequencyRatio, 0.f);
+		stream->queuedEndTime = (stream->frequencyRatio > 0.f) ? getStreamingTime() : std::numeric_limits<double>::infinity();
+		scheduleFill(stream);
+
+		return stream;
+	}
+
+	void stopAudioStream(audio_stream* stream)
+	{
+		Lock lock{ stream->submitMutex };
+		stream->cancelled = true;
+	}
+
+	void setAudioStreamLoop(audio_stream* stream, bool loop)
+	{
+		stream->loop = loop;
+	}
+
+	void setAudioStreamFrequencyRatio(audio_stream* stream, float frequencyRatio)
+	{
+		frequencyRatio = max(frequencyRatio, 0.f);
+
+		Lock lock{ serviceMutex };
+		if (frequencyRatio == stream->frequencyRatio)
+		{
+			return;
+		}
+
+		// Queued playback time at normal pitch, which is then spread over the new rate.
+		double now = getStreamingTime();
+		double remaining = (stream->frequencyRatio > 0.f)
+			? max(stream->queuedEndTime - now, 0.0) * stream->frequencyRatio
+			: stream->pausedSeconds;
+
+		stream->frequencyRatio = frequencyRatio;
+		stream->pausedSeconds = 0.0;
+		stream->queuedEndTime = now;
+		if (frequencyRatio > 0.f)
+		{
+			queueStreamTime(*stream, remaining, now);
+		}
+		else
+		{
+			stream->pausedSeconds = remaining;
+			stream->queuedEndTime = std::numeric_limits<double>::infinity();
+		}
+	}
+
+	bool isAudioStreamFinished(const audio_stream* stream)
+	{
+		return stream->finished;
+	}
+
+	void onAudioStreamBufferEnd(void* bufferContext)
+	{
+		audio_stream* stream = ((audio_stream_buffer*)bufferContext)->stream;
+		if (stream->cancelled)
+		{
+			return;
+		}
+
+		Lock lock{ serviceMutex };
+		++stream->numFreeBuffers;
+		scheduleFill(stream->shared_from_this());
+	}
+
+	audio_streaming_stats getAudioStreamingStats()
+	{
+		Lock lock{ serviceMutex };
+
+		audio_streaming_stats result = stats;
+		result.numStreams = numStreams;
+		result.numPendingFileRequests = (uint32)fileRequests.size();
+		result.numPendingSynthRequests = (uint32)synthRequests.size();
+		return result;
+	}
+}
@@ -0,0 +1,54 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#pragma once
+
+#include "core_api.h"
+
+namespace era_engine
+{
+	struct audio_channel;
+	struct audio_stream;
+
+	/*
+		Streamed sounds share one service instead of running a thread per channel. Each stream has two buffers. Whenever one finishes
+		playing, a refill is scheduled with the time at which the stream would run dry as its deadline. File reads are handled by a
+		small pool of I/O threads, earliest deadline first. Synth streams are filled together by one job per frame.
+	*/
+
+	struct ERA_CORE_API audio_streaming_stats
+	{
+		uint32 numStreams;
+		uint32 numPendingFileRequests;
+		uint32 numPendingSynthRequests;
+
+		uint64 numFills;
+		uint64 numMissedDeadlines; // Fills which completed after the stream had run dry.
+		uint64 numBytesRead;
+	};
+
+	void initializeAudioStreaming(uint32 numIOThreads = 2);
+	void shutdownAudioStreaming();
+
+	// Called once per frame. Launches the synth job.
+	void updateAudioStreaming();
+
+	// File streams start reading at startByte, e.g. when a virtual channel becomes real again. Synth streams always start at the beginning.
+	// The frequency ratio is the one of the channel's voice, see setAudioStreamFrequencyRatio.
+	NODISCARD ref<audio_stream> startAudioStream(audio_channel* channel, uint32 startByte = 0, float frequencyRatio = 1.f);
+
+	// No buffers are submitted to the channel's voice after this returns. The buffers stay valid as long as the stream is referenced.
+	void stopAudioStream(audio_stream* stream);
+
+	void setAudioStreamLoop(audio_stream* stream, bool loop);
+
+	// Playback rate of the channel's voice, zero while paused. Deadlines are the time at which the stream runs dry at this rate.
+	void setAudioStreamFrequencyRatio(audio_stream* stream, float frequencyRatio);
+
+	// True, once the end of a non-looping sound has been submitted.
+	NODISCARD bool isAudioStreamFinished(const audio_stream* stream);
+
+	// Buffer end callback of voices. The context is the one passed to audio_channel::submitBuffer.
+	void onAudioStreamBufferEnd(void* bufferContext);
+
+	NODISCARD audio_streaming_stats getAudioStreamingStats();
+}
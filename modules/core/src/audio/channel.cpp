@@ -2,16 +2,11 @@
 
 #include "audio/channel.h"
 
-#define MAX_BUFFER_COUNT 3
-#define STREAMING_BUFFER_SIZE (1024 * 8 * 6)
 #define UPDATE_3D_PERIOD 3 // > 0.
 #define VIRTUALIZE_FADE_TIME 0.1f
 
 namespace era_engine
 {
-	DWORD WINAPI streamFileAudio(void* parameter);
-	DWORD WINAPI streamSynthAudio(void* parameter);
-
 	audio_channel::audio_channel(const audio_context& context, const ref<audio_sound>& sound, const sound_settings& settings)
 	{
 		initialize(context, sound, settings, false);
@@ -26,6 +21,8 @@ namespace era_engine
 	{
 		this->sound = sound;
 		this->voiceCallback.channel = this;
+		this->mixerVoiceCallback.channel = this;
+		this->mixer = context.mixer.get();
 
 		userSettings = settings;
 
@@ -36,80 +33,181 @@ namespace era_engine
 		this->positioned = positioned;
 		this->position = position;
 
-		XAUDIO2_SEND_DESCRIPTOR sendDescriptors[2];
+		sampleRate = sound->wfx.Format.nSamplesPerSec;
+		totalFrames = (sound->stream && sound->isSynth) ? 0 : sound->chunkSize / max((uint32)sound->wfx.Format.nBlockAlign, 1u);
 
-		// Direct
-		sendDescriptors[0].Flags = XAUDIO2_SEND_USEFILTER;
-		sendDescriptors[0].pOutputVoice = context.soundTypeSubmixVoices[sound->type];
+		volumeFader.initialize(settings.volume);
+		pitchFader.initialize(settings.pitch);
 
-		// Reverb
-		sendDescriptors[1].Flags = XAUDIO2_SEND_USEFILTER;
-		sendDescriptors[1].pOutputVoice = context.reverbSubmixVoices[sound->type];
+		upDownFader.initialize(1.f);
 
-		// Reverb only for positioned voices
-		const XAUDIO2_VOICE_SENDS sendList = { positioned ? 2u : 1u, sendDescriptors };
+		// The voice is created in the first update, once the voice management has decided whether the channel starts out virtual.
+	}
 
-		checkResult(context.xaudio->CreateSourceVoice(&voice, (WAVEFORMATEX*)&sound->wfx, 0, XAUDIO2_DEFAULT_FREQ_RATIO, &voiceCallback, &sendList));
-		checkResult(voice->Start());
+	audio_channel::~audio_channel()
+	{
+		// Stop submitting before the voice goes away. The stream's buffers stay alive until the voice is destroyed.
+		if (stream)
+		{
+			stopAudioStream(stream.get());
+		}
 
-		XAUDIO2_VOICE_DETAILS voiceDetails;
-		voice->GetVoiceDetails(&voiceDetails);
-		srcChannels = voiceDetails.InputChannels;
+		destroyVoice();
+	}
 
-		volumeFader.initialize(settings.volume);
-		pitchFader.initialize(settings.pitch);
+	static audio_mixer_format getMixerFormat(const WAVEFORMATEXTENSIBLE& wfx)
+	{
+		const WAVEFORMATEX& f = wfx.Format;
 
-		upDownFader.initialize(1.f);
+		// The sub format GUIDs of extensible formats start with the format tag.
+		uint32 tag = (f.wFormatTag == WAVE_FORMAT_EXTENSIBLE) ? (uint32)wfx.SubFormat.Data1 : f.wFormatTag;
 
-		updateSoundSettings(context, 0.f);
+		audio_mixer_format format;
+		format.sampleRate = f.nSamplesPerSec;
+		format.numChannels = f.nChannels;
+		format.bitsPerSample = (tag == WAVE_FORMAT_PCM || tag == WAVE_FORMAT_IEEE_FLOAT) ? f.wBitsPerSample : 0; // Zero is rejected.
+		format.isFloat = (tag == WAVE_FORMAT_IEEE_FLOAT);
+		return format;
+	}
 
-		if (sound->stream)
+	bool audio_channel::createVoice(const audio_context& context, uint32 startFrame)
+	{
+		if (mixer)
 		{
-			threadStopped = false;
-			bufferEndSemaphore = CreateSemaphore(0, 0, MAX_BUFFER_COUNT, 0);
+			// Reverb only for positioned voices
+			mixerVoice = mixer->createVoice(getMixerFormat(sound->wfx), sound->type, positioned, &mixerVoiceCallback);
+			if (mixerVoice == AUDIO_MIXER_INVALID_VOICE)
+			{
+				// Unsupported format or out of voices.
+				return false;
+			}
 
-			auto func = (sound->isSynth) ? streamSynthAudio : streamFileAudio;
-			threadHandle = CreateThread(0, 0, func, this, 0, 0);
+			srcChannels = sound->wfx.Format.nChannels;
 		}
 		else
 		{
-			XAUDIO2_BUFFER buffer = { 0 };
-			buffer.AudioBytes = sound->chunkSize;
-			buffer.pAudioData = sound->dataBuffer;
-			if (settings.loop)
-			{
-				buffer.LoopCount = XAUDIO2_LOOP_INFINITE;
-			}
-			else
+			XAUDIO2_SEND_DESCRIPTOR sendDescriptors[2];
+
+			// Direct
+			sendDescriptors[0].Flags = XAUDIO2_SEND_USEFILTER;
+			sendDescriptors[0].pOutputVoice = context.soundTypeSubmixVoices[sound->type];
+
+			// Reverb
+			sendDescriptors[1].Flags = XAUDIO2_SEND_USEFILTER;
+			sendDescriptors[1].pOutputVoice = context.reverbSubmixVoices[sound->type];
+
+			// Reverb only for positioned voices
+			const XAUDIO2_VOICE_SENDS sendList = { positioned ? 2u : 1u, sendDescriptors };
+
+			if (FAILED(context.xaudio->CreateSourceVoice(&voice, (WAVEFORMATEX*)&sound->wfx, 0, XAUDIO2_DEFAULT_FREQ_RATIO, &voiceCallback, &sendList)))
 			{
-				buffer.Flags = XAUDIO2_END_OF_STREAM;
+				voice = 0;
+				return false;
 			}
+			checkResult(voice->Start());
 
-			checkResult(voice->SubmitSourceBuffer(&buffer));
+			XAUDIO2_VOICE_DETAILS voiceDetails;
+			voice->GetVoiceDetails(&voiceDetails);
+			srcChannels = voiceDetails.InputChannels;
+		}
+
+		// Push all settings to the new voice before it gets any data.
+		oldVolume = -1.f;
+		oldPitch = -1.f;
+		update3DTimer = 0;
+		updateSoundSettings(context, 0.f);
+
+		this->startFrame = startFrame;
+
+		if (sound->stream)
+		{
+			stream = startAudioStream(this, startFrame * sound->wfx.Format.nBlockAlign, oldPitch);
 		}
+		else
+		{
+			submitBuffer(sound->dataBuffer, sound->chunkSize, 0, userSettings.loop, !userSettings.loop, startFrame);
+		}
+
+		return true;
 	}
 
-	audio_channel::~audio_channel()
+	void audio_channel::releaseVoice()
 	{
-		voice->DestroyVoice();
-		if (sound->stream)
+		uint64 frame = startFrame + getFramesPlayed();
+		if (userSettings.loop && totalFrames > 0)
 		{
-			CloseHandle(bufferEndSemaphore);
-			CloseHandle(threadHandle);
+			frame %= totalFrames;
+		}
+		virtualFrame = (double)frame;
+
+		if (stream)
+		{
+			stopAudioStream(stream.get());
+		}
+
+		destroyVoice();
+		stream.reset();
+	}
+
+	void audio_channel::destroyVoice()
+	{
+		if (voice)
+		{
+			voice->DestroyVoice();
+			voice = 0;
+		}
+		if (mixerVoice != AUDIO_MIXER_INVALID_VOICE)
+		{
+			mixer->destroyVoice(mixerVoice);
+			mixerVoice = AUDIO_MIXER_INVALID_VOICE;
 		}
 	}
 
 	void audio_channel::update(const audio_context& context, float dt)
 	{
+		if (stream)
+		{
+			setAudioStreamLoop(stream.get(), userSettings.loop);
+
+			// Non-looping streams stop once the last buffer has played.
+			if (isAudioStreamFinished(stream.get()) && getNumQueuedBuffers() == 0)
+			{
+				stop(0.f);
+			}
+		}
+
 		switch (state)
 		{
 		case channel_state_to_play:
 		{
-			state = channel_state_playing;
-			if (shouldBeVirtual())
+			bool startVirtual = shouldBeVirtual();
+			if (startVirtual)
+			{
+				upDownFader.initialize(0.f);
+			}
+
+			if (startVirtual && canReleaseVoice())
+			{
+				virtualFrame = 0.0;
+				state = channel_state_virtual;
+			}
+			else if (createVoice(context, 0))
+			{
+				state = startVirtual ? channel_state_virtual : channel_state_playing;
+			}
+			else if (canReleaseVoice())
 			{
+				// Out of voices, e.g. while fading or stopping channels still hold them. Continue virtually, the virtual state picks
+				// up a voice once one is free.
+				upDownFader.initialize(0.f);
+				virtualFrame = 0.0;
 				state = channel_state_virtual;
 			}
+			else
+			{
+				// Synthesized sounds have no position to resume from, so they can't wait for a voice.
+				state = channel_state_stopped;
+			}
 		} break;
 
 		case channel_state_playing:
@@ -127,12 +225,12 @@ namespace era_engine
 			updateSoundSettings(context, dt);
 			if (upDownFader.current <= 0.f)
 			{
-				voice->Stop();
+				stopVoice();
 				state = channel_state_stopped;
 
-				if (sound->stream)
+				if (stream)
 				{
-					ReleaseSemaphore(bufferEndSemaphore, 1, 0);
+					stopAudioStream(stream.get());
 				}
 			}
 		} break;
@@ -150,16 +248,46 @@ namespace era_engine
 				upDownFader.startFade(1.f, VIRTUALIZE_FADE_TIME);
 				state = channel_state_playing;
 			}
-			if (upDownFader.current <= 0.f)
+			else if (upDownFader.current <= 0.f)
 			{
+				if (canReleaseVoice())
+				{
+					releaseVoice();
+				}
 				state = channel_state_virtual;
 			}
 		} break;
 
 		case channel_state_virtual:
 		{
+			if (!hasVoice())
+			{
+				// Keep the playback position moving, so that the sound picks up where it would be, had it been audible all along.
+				virtualFrame += (double)dt * sampleRate * clamp(userSettings.pitch, 0.f, XAUDIO2_DEFAULT_FREQ_RATIO);
+				if (totalFrames == 0)
+				{
+					// Unknown length, nothing to wrap or end at.
+				}
+				else if (userSettings.loop)
+				{
+					virtualFrame = fmod(virtualFrame, (double)totalFrames);
+				}
+				else if (virtualFrame >= totalFrames)
+				{
+					// The sound would have ended while inaudible.
+					state = channel_state_stopped;
+					break;
+				}
+			}
+
 			if (!shouldBeVirtual())
 			{
+				// If no voice is free right now, try again next frame.
+				if (!hasVoice() && !createVoice(context, (uint32)virtualFrame))
+				{
+					break;
+				}
+
 				upDownFader.startFade(1.f, VIRTUALIZE_FADE_TIME);
 				state = channel_state_playing;
 			}
@@ -174,14 +302,27 @@ namespace era_engine
 	{
 		if (state != channel_state_stopping && state != channel_state_stopped)
 		{
-			state = channel_state_stopping;
+			// Virtual channels without a voice have nothing to fade out.
+			state = hasVoice() ? channel_state_stopping : channel_state_stopped;
 			upDownFader.startFade(0.f, fadeOutTime);
 		}
 	}
 
 	bool audio_channel::hasStopped()
 	{
-		return state == channel_state_stopped && threadStopped;
+		return state == channel_state_stopped;
+	}
+
+	float audio_channel::getAudibility(const audio_context& context) const
+	{
+		float audibility = userSettings.volume;
+		if (positioned)
+		{
+			// Linear curve, like the one used for 3D voices.
+			float distance = length(position - context.listenerPosition);
+			audibility *= 1.f - clamp01(distance / max(userSettings.radius, 1e-3f));
+		}
+		return audibility;
 	}
 
 	void audio_channel::updateSoundSettings(const audio_context& context, float dt)
@@ -206,18 +347,32 @@ namespace era_engine
 		float v = volumeFader.current * upDownFader.current;
 		if (v != oldVolume)
 		{
-			voice->SetVolume(v);
+			setVoiceVolume(v);
 			oldVolume = v;
 		}
 
 		float p = pitchFader.current;
 		if (p != oldPitch)
 		{
-			voice->SetFrequencyRatio(p);
+			setVoiceFrequencyRatio(p);
 			oldPitch = p;
 		}
 
-		if (positioned)
+		if (positioned && mixer)
+		{
+			if (update3DTimer == 0)
+			{
+				float matrix[AUDIO_MIXER_NUM_OUTPUT_CHANNELS * AUDIO_MIXER_MAX_SOURCE_CHANNELS];
+				float reverbLevel;
+				calculate3DAudio(context.listenerPosition, context.listenerRotation, position, userSettings.radius, srcChannels, matrix, reverbLevel);
+				mixer->setVoiceOutputMatrix(mixerVoice, matrix, reverbLevel);
+
+				update3DTimer = UPDATE_3D_PERIOD;
+			}
+
+			--update3DTimer;
+		}
+		else if (positioned)
 		{
 			if (update3DTimer == 0)
 			{
@@ -291,147 +446,104 @@ namespace era_engine
 
 	bool audio_channel::shouldBeVirtual()
 	{
-		return false;
+		return virtualRequested;
 	}
 
-	static DWORD WINAPI streamFileAudio(void* parameter)
+	void audio_channel::setVoiceVolume(float volume)
 	{
-		audio_channel* channel = (audio_channel*)parameter;
-		auto& sound = channel->sound;
-		auto voice = channel->voice;
-
-		BYTE buffers[MAX_BUFFER_COUNT][STREAMING_BUFFER_SIZE];
-
-		uint32 currentBufferIndex = 0;
-
-		bool quit = false;
+		if (mixer)
+		{
+			mixer->setVoiceVolume(mixerVoice, volume);
+		}
+		else
+		{
+			voice->SetVolume(volume);
+		}
+	}
 
-		while (!quit)
+	void audio_channel::setVoiceFrequencyRatio(float ratio)
+	{
+		if (mixer)
 		{
-			uint32 currentPosition = 0;
+			mixer->setVoiceFrequencyRatio(mixerVoice, ratio);
+		}
+		else
+		{
+			voice->SetFrequencyRatio(ratio);
+		}
 
-			if (SetFilePointer(sound->fileHandle, sound->chunkPosition, NULL, FILE_BEGIN) == INVALID_SET_FILE_POINTER)
-				break;
+		if (stream)
+		{
+			setAudioStreamFrequencyRatio(stream.get(), ratio);
+		}
+	}
 
-			while (!quit && currentPosition < sound->chunkSize)
+	void audio_channel::submitBuffer(const void* data, uint32 numBytes, void* bufferContext, bool loop, bool endOfStream, uint32 playBegin)
+	{
+		if (mixer)
+		{
+			audio_mixer_buffer buffer;
+			buffer.data = data;
+			buffer.numBytes = numBytes;
+			buffer.context = bufferContext;
+			buffer.loop = loop;
+			buffer.endOfStream = endOfStream;
+			buffer.playBegin = playBegin;
+			mixer->submitBuffer(mixerVoice, buffer);
+		}
+		else
+		{
+			XAUDIO2_BUFFER buffer = { 0 };
+			buffer.AudioBytes = numBytes;
+			buffer.pAudioData = (const BYTE*)data;
+			buffer.pContext = bufferContext;
+			buffer.PlayBegin = playBegin;
+			if (loop)
 			{
-				DWORD size = STREAMING_BUFFER_SIZE;
-				if (ReadFile(sound->fileHandle, buffers[currentBufferIndex], size, &size, 0) == 0)
-				{
-					quit = true;
-					break;
-				}
-
-				currentPosition += size;
-
-				XAUDIO2_BUFFER buffer = { 0 };
-				buffer.AudioBytes = size;
-				buffer.pAudioData = buffers[currentBufferIndex];
-				buffer.pContext = channel->bufferEndSemaphore;
-
-				checkResult(voice->SubmitSourceBuffer(&buffer));
-
-				XAUDIO2_VOICE_STATE state;
-				voice->GetState(&state, XAUDIO2_VOICE_NOSAMPLESPLAYED);
-				while (!quit && state.BuffersQueued > MAX_BUFFER_COUNT - 1)
-				{
-					WaitForSingleObject(channel->bufferEndSemaphore, INFINITE);
-					voice->GetState(&state, XAUDIO2_VOICE_NOSAMPLESPLAYED);
-
-					if (channel->state == channel_state_stopped)
-					{
-						quit = true;
-					}
-				}
-				currentBufferIndex++;
-				currentBufferIndex %= MAX_BUFFER_COUNT;
+				buffer.LoopCount = XAUDIO2_LOOP_INFINITE;
+			}
+			if (endOfStream)
+			{
+				buffer.Flags = XAUDIO2_END_OF_STREAM;
 			}
 
-			if (!channel->userSettings.loop)
-				break;
+			checkResult(voice->SubmitSourceBuffer(&buffer));
 		}
+	}
 
-		if (!quit)
+	uint32 audio_channel::getNumQueuedBuffers()
+	{
+		if (mixer)
 		{
-			XAUDIO2_VOICE_STATE state;
-			while (voice->GetState(&state, XAUDIO2_VOICE_NOSAMPLESPLAYED), state.BuffersQueued > 0)
-			{
-				WaitForSingleObject(channel->bufferEndSemaphore, INFINITE);
-			}
+			return mixer->getNumQueuedBuffers(mixerVoice);
 		}
 
-		channel->stop(0.f);
-
-		channel->threadStopped = true;
-
-		return 0;
+		XAUDIO2_VOICE_STATE state;
+		voice->GetState(&state, XAUDIO2_VOICE_NOSAMPLESPLAYED);
+		return state.BuffersQueued;
 	}
 
-	static DWORD WINAPI streamSynthAudio(void* parameter)
+	void audio_channel::stopVoice()
 	{
-		audio_channel* channel = (audio_channel*)parameter;
-		auto& sound = channel->sound;
-		auto voice = channel->voice;
-
-		float buffers[MAX_BUFFER_COUNT][STREAMING_BUFFER_SIZE];
-
-		uint32 currentBufferIndex = 0;
-
-		bool quit = false;
-
-		while (!quit)
+		if (mixer)
 		{
-			uint8 synthBuffer[MAX_SYNTH_SIZE];
-			audio_synth* synth = sound->createSynth(synthBuffer);
-
-			while (true)
-			{
-				uint32 size = STREAMING_BUFFER_SIZE;
-				size = synth->getSamples(buffers[currentBufferIndex], size);
-
-				if (size == 0)
-					break;
-
-				XAUDIO2_BUFFER buffer = { 0 };
-				buffer.AudioBytes = size * sizeof(float);
-				buffer.pAudioData = (BYTE*)buffers[currentBufferIndex];
-				buffer.pContext = channel->bufferEndSemaphore;
-
-				checkResult(voice->SubmitSourceBuffer(&buffer));
-
-				XAUDIO2_VOICE_STATE state;
-				voice->GetState(&state, XAUDIO2_VOICE_NOSAMPLESPLAYED);
-				while (!quit && state.BuffersQueued > MAX_BUFFER_COUNT - 1)
-				{
-					WaitForSingleObject(channel->bufferEndSemaphore, INFINITE);
-					voice->GetState(&state, XAUDIO2_VOICE_NOSAMPLESPLAYED);
-
-					if (channel->state == channel_state_stopped)
-					{
-						quit = true;
-					}
-				}
-				currentBufferIndex++;
-				currentBufferIndex %= MAX_BUFFER_COUNT;
-			}
-
-			if (!channel->userSettings.loop)
-				break;
+			mixer->stopVoice(mixerVoice);
 		}
-
-		if (!quit)
+		else
 		{
-			XAUDIO2_VOICE_STATE state;
-			while (voice->GetState(&state, XAUDIO2_VOICE_NOSAMPLESPLAYED), state.BuffersQueued > 0)
-			{
-				WaitForSingleObject(channel->bufferEndSemaphore, INFINITE);
-			}
+			voice->Stop();
 		}
+	}
 
-		channel->stop(0.f);
-
-		channel->threadStopped = true;
+	uint64 audio_channel::getFramesPlayed()
+	{
+		if (mixer)
+		{
+			return mixer->getVoiceFramesPlayed(mixerVoice);
+		}
 
-		return 0;
+		XAUDIO2_VOICE_STATE state;
+		voice->GetState(&state, 0);
+		return state.SamplesPlayed;
 	}
 }
\ No newline at end of file
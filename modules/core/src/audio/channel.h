@@ -5,6 +5,8 @@
 #include "core_api.h"
 
 #include "audio/sound.h"
+#include "audio/audio_mixer.h"
+#include "audio/audio_streaming.h"
 
 #include "core/math.h"
 
@@ -74,6 +76,11 @@ namespace era_engine
 
 		X3DAUDIO_HANDLE xaudio3D;
 		X3DAUDIO_LISTENER listener;
+
+		// Set, if audio is mixed on the CPU. The XAudio2 objects above are unused in that case.
+		ref<audio_mixer> mixer;
+		vec3 listenerPosition = vec3(0.f);
+		quat listenerRotation = quat::identity;
 	};
 
 	struct ERA_CORE_API audio_channel
@@ -88,6 +95,19 @@ namespace era_engine
 		sound_settings* getSettings() { return &userSettings; }
 
 		bool hasStopped();
+		NODISCARD bool isStopping() const { return state == channel_state_stopping || state == channel_state_stopped; }
+
+		// Set by the voice management in updateAudio. Virtual channels release their voice, but their playback position keeps advancing.
+		void setVirtual(bool isVirtual) { virtualRequested = isVirtual; }
+		NODISCARD bool isVirtual() const { return virtualRequested; }
+		NODISCARD bool hasVoice() const { return voice || mixerVoice != AUDIO_MIXER_INVALID_VOICE; }
+
+		// Volume after distance attenuation, in [0, volume]. Sound type volumes are not included.
+		NODISCARD float getAudibility(const audio_context& context) const;
+
+		// Thread safe. Used by audio streaming.
+		void submitBuffer(const void* data, uint32 numBytes, void* bufferContext, bool loop, bool endOfStream, uint32 playBegin = 0);
+		NODISCARD uint32 getNumQueuedBuffers();
 
 		ref<audio_sound> sound;
 		bool positioned;
@@ -100,6 +120,21 @@ namespace era_engine
 
 		bool shouldBeVirtual();
 
+		// Creates the voice and starts playback at startFrame. Returns false, if no voice is available.
+		bool createVoice(const audio_context& context, uint32 startFrame);
+		// Remembers the playback position in virtualFrame and destroys the voice.
+		void releaseVoice();
+		void destroyVoice();
+
+		// Synth streams can't seek, so they keep their (silent) voice while virtual.
+		NODISCARD bool canReleaseVoice() const { return totalFrames > 0; }
+
+		// Forward to either the XAudio2 voice or the mixer voice. submitBuffer and getNumQueuedBuffers above do the same.
+		void setVoiceVolume(float volume);
+		void setVoiceFrequencyRatio(float ratio);
+		void stopVoice();
+		NODISCARD uint64 getFramesPlayed();
+
 		uint32 update3DTimer = 0;
 
 		volatile channel_state state = channel_state_to_play;
@@ -108,10 +143,19 @@ namespace era_engine
 		property_fader volumeFader;
 		property_fader pitchFader;
 
-		IXAudio2SourceVoice* voice;
+		IXAudio2SourceVoice* voice = 0;
+
+		audio_mixer* mixer = 0;
+		uint32 mixerVoice = AUDIO_MIXER_INVALID_VOICE;
 
 		uint32 srcChannels;
 
+		uint32 sampleRate;
+		uint32 totalFrames; // Zero, if unknown.
+		uint32 startFrame = 0; // Frame at which the current voice started playing.
+		double virtualFrame = 0.0; // Playback position while the channel has no voice.
+		bool virtualRequested = false;
+
 		sound_settings userSettings;
 		sound_settings oldUserSettings;
 
@@ -127,20 +171,23 @@ namespace era_engine
 			virtual void __stdcall OnStreamEnd() override { /*std::cout << "Stream end\n";*/ channel->stop(0.f); }
 			virtual void __stdcall OnVoiceError(void* bufferContext, HRESULT error) override { std::cerr << "Error!\n"; }
 			virtual void __stdcall OnBufferStart(void* bufferContext) override {}
-			virtual void __stdcall OnBufferEnd(void* bufferContext) override { /*std::cout << "Buffer end\n";*/ if (bufferContext) { ReleaseSemaphore((HANDLE)bufferContext, 1, 0); } }
+			virtual void __stdcall OnBufferEnd(void* bufferContext) override { /*std::cout << "Buffer end\n";*/ if (bufferContext) { onAudioStreamBufferEnd(bufferContext); } }
 			virtual void __stdcall OnLoopEnd(void* bufferContext) override {}
 		};
 
 		voice_callback voiceCallback;
 
-		HANDLE threadHandle = INVALID_HANDLE_VALUE;
+		struct mixer_voice_callback : audio_mixer_voice_callback
+		{
+			audio_channel* channel;
 
-		HANDLE bufferEndSemaphore;
+			virtual void onBufferEnd(void* bufferContext) override { if (bufferContext) { onAudioStreamBufferEnd(bufferContext); } }
+			virtual void onStreamEnd() override { channel->stop(0.f); }
+		};
 
-		bool threadStopped = true;
+		mixer_voice_callback mixerVoiceCallback;
 
-		friend DWORD WINAPI streamFileAudio(void* parameter);
-		friend DWORD WINAPI streamSynthAudio(void* parameter);
+		ref<audio_stream> stream;
 	};
 
 }
\ No newline at end of file
@@ -23,15 +23,16 @@ namespace era_engine
     static bool findChunk(HANDLE fileHandle, uint32 fourcc, uint32& chunkSize, uint32& chunkDataPosition);
     static bool readChunkData(HANDLE fileHandle, void* buffer, uint32 buffersize, uint32 bufferoffset);
 
-    static std::unordered_map<uint64, ref<audio_sound>> fileSounds;
-    static std::unordered_map<uint64, ref<audio_sound>> synthSounds;
-
-    static bool checkForExistingFileSound(sound_id id)
+    static uint64 getSoundMemorySize(const audio_sound& sound)
     {
-        auto it = fileSounds.find(id.hash);
-        return (it != fileSounds.end()) && it->second != 0;
+        // Streamed sounds only keep the file open.
+        return sound.dataBuffer ? sound.chunkSize : 0;
     }
 
+    // File sounds stay loaded until they are unloaded explicitly, unless a budget is set.
+    static AssetCache<uint64, audio_sound> fileSounds(getSoundMemorySize, AssetCache<uint64, audio_sound>::UNLIMITED_BUDGET, memory_tag_audio);
+    static std::unordered_map<uint64, ref<audio_sound>> synthSounds;
+
     static bool checkForExistingSynthSound(sound_id id)
     {
         auto it = synthSounds.find(id.hash);
@@ -42,7 +43,7 @@ namespace era_engine
     {
         if (!sound->isSynth)
         {
-            fileSounds[id.hash] = sound;
+            fileSounds.insert(id.hash, sound);
         }
         else
         {
@@ -50,74 +51,75 @@ namespace era_engine
         }
     }
 
-    bool loadFileSound(sound_id id)
+    static ref<audio_sound> loadFileSoundInternal(sound_id id)
     {
-        if (checkForExistingFileSound(id))
-            return true;
-        else
-        {
-            const sound_spec& spec = getSoundSpec(id);
+        const sound_spec& spec = getSoundSpec(id);
 
-            fs::path path = getPathFromAssetHandle(spec.asset);
-            if (!path.empty())
+        fs::path path = getPathFromAssetHandle(spec.asset);
+        if (!path.empty())
+        {
+            HANDLE fileHandle = openFile(path);
+            if (fileHandle != INVALID_HANDLE_VALUE)
             {
-                HANDLE fileHandle = openFile(path);
-                if (fileHandle != INVALID_HANDLE_VALUE)
-                {
-                    WAVEFORMATEXTENSIBLE wfx;
-                    uint32 chunkSize, chunkPosition;
+                WAVEFORMATEXTENSIBLE wfx;
+                uint32 chunkSize, chunkPosition;
 
-                    bool success = false;
-                    BYTE* dataBuffer = 0;
+                bool success = false;
+                BYTE* dataBuffer = 0;
 
-                    // Find and retrieve format chunk
-                    if (getWFX(fileHandle, path, wfx))
+                // Find and retrieve format chunk
+                if (getWFX(fileHandle, path, wfx))
+                {
+                    // Find data chunk
+                    if (findChunk(fileHandle, fourccDATA, chunkSize, chunkPosition))
                     {
-                        // Find data chunk
-                        if (findChunk(fileHandle, fourccDATA, chunkSize, chunkPosition))
-                        {
-                            success = true;
+                        success = true;
 
-                            if (!spec.stream)
+                        if (!spec.stream)
+                        {
+                            dataBuffer = new BYTE[chunkSize];
+                            success = readChunkData(fileHandle, dataBuffer, chunkSize, chunkPosition);
+                            if (!success)
                             {
-                                dataBuffer = new BYTE[chunkSize];
-                                success = readChunkData(fileHandle, dataBuffer, chunkSize, chunkPosition);
-                                if (!success)
-                                {
-                                    delete[] dataBuffer;
-                                }
-
-                                closeFile(fileHandle);
+                                delete[] dataBuffer;
                             }
+
+                            closeFile(fileHandle);
                         }
                     }
-                    if (success)
-                    {
-                        ref<audio_sound> sound = make_ref<audio_sound>();
-                        sound->id = id;
-                        sound->path = path;
-                        sound->stream = spec.stream;
-                        sound->fileHandle = fileHandle;
-                        sound->wfx = wfx;
-                        sound->chunkSize = chunkSize;
-                        sound->chunkPosition = chunkPosition;
-                        sound->dataBuffer = dataBuffer;
-                        sound->isSynth = false;
-                        sound->type = spec.type;
-
-                        registerSound(id, sound);
-                    }
-                    else
-                    {
-                        closeFile(fileHandle);
-                    }
-
-                    return success;
                 }
-            }
+                if (success)
+                {
+                    ref<audio_sound> sound = make_ref<audio_sound>();
+                    sound->id = id;
+                    sound->path = path;
+                    sound->stream = spec.stream;
+                    sound->fileHandle = fileHandle;
+                    sound->wfx = wfx;
+                    sound->chunkSize = chunkSize;
+                    sound->chunkPosition = chunkPosition;
+                    sound->dataBuffer = dataBuffer;
+                    sound->isSynth = false;
+                    sound->type = spec.type;
+
+                    return sound;
+                }
 
-            return false;
+                closeFile(fileHandle);
+                return nullptr;
+            }
         }
+
+        return nullptr;
+    }
+
+    bool loadFileSound(sound_id id)
+    {
+        ref<audio_sound> sound = fileSounds.get_or_load(id.hash, [id]()
+            {
+                return loadFileSoundInternal(id);
+            });
+        return sound != nullptr;
     }
 
     void unloadSound(sound_id id)
@@ -132,14 +134,23 @@ namespace era_engine
         synthSounds.clear();
     }
 
+    void setSoundCacheBudget(uint64 budget)
+    {
+        fileSounds.set_budget(budget);
+    }
+
+    NODISCARD AssetCacheStats getSoundCacheStats()
+    {
+        return fileSounds.get_stats();
+    }
+
     NODISCARD ref<audio_sound> getSound(sound_id id)
     {
-        auto it = fileSounds.find(id.hash);
-        ref<audio_sound> result = (it != fileSounds.end()) ? it->second : 0;
+        ref<audio_sound> result = fileSounds.find(id.hash);
         if (result)
             return result;
 
-        it = synthSounds.find(id.hash);
+        auto it = synthSounds.find(id.hash);
         result = (it != synthSounds.end()) ? it->second : 0;
         return result;
     }
@@ -5,8 +5,10 @@
 #include "core_api.h"
 
 #include "audio/synth.h"
+#include "audio/sound_type.h"
 #include "core/string.h"
 #include "asset/asset.h"
+#include "asset/asset_cache.h"
 
 #include <xaudio2.h>
 #include <functional>
@@ -21,19 +23,6 @@ namespace era_engine
         uint64 hash;
     };
 
-    enum sound_type
-    {
-        sound_type_music,
-        sound_type_sfx,
-        sound_type_count,
-    };
-
-    static const char* soundTypeNames[] =
-    {
-        "Music",
-        "Effects",
-    };
-
     struct ERA_CORE_API sound_spec
     {
         std::string name;
@@ -79,6 +68,10 @@ namespace era_engine
     void unloadSound(sound_id id);
     void unloadAllSounds();
 
+    // Budget for keeping non-streamed file sounds loaded. Unlimited by default, so sounds stay loaded until unloaded.
+    void setSoundCacheBudget(uint64 budget);
+    NODISCARD AssetCacheStats getSoundCacheStats();
+
     bool loadFileSound(sound_id id);
 
     template <typename Synth_, typename... Args_>
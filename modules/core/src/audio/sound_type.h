@@ -0,0 +1,19 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#pragma once
+
+namespace era_engine
+{
+    enum sound_type
+    {
+        sound_type_music,
+        sound_type_sfx,
+        sound_type_count,
+    };
+
+    static const char* soundTypeNames[] =
+    {
+        "Music",
+        "Effects",
+    };
+}
@@ -2,116 +2,375 @@
 
 namespace era_engine
 {
-	void BlockAllocator::initialize(uint64_t capacity)
+	static uint32_t index_of_highest_bit(uint64_t v)
 	{
-		available_size = capacity;
-		add_new_block(0, capacity);
+		unsigned long result;
+		_BitScanReverse64(&result, v);
+		return result;
 	}
 
-	uint64_t BlockAllocator::allocate(uint64_t requested_size)
+	static uint32_t index_of_lowest_bit(uint64_t v)
 	{
-		auto smallest_block_it = blocks_by_size.lower_bound(requested_size);
-		if (smallest_block_it == blocks_by_size.end())
+		unsigned long result;
+		_BitScanForward64(&result, v);
+		return result;
+	}
+
+	static uint64_t hash_offset(uint64_t key)
+	{
+		key ^= key >> 33;
+		key *= 0xFF51AFD7ED558CCDull;
+		key ^= key >> 33;
+		return key;
+	}
+
+	void BlockAllocator::HashTable::initialize(uint32_t capacity)
+	{
+		// At most half full, so that probe sequences stay short.
+		uint32_t size = 16;
+		while (size < capacity * 2)
 		{
-			return UINT64_MAX;
+			size *= 2;
 		}
 
-		SizeValue size_value = smallest_block_it->second;
+		slots.assign(size, HashSlot{ 0, invalid_node });
+		mask = size - 1;
+	}
 
-		uint64_t offset = size_value.get_offset();
-		uint64_t size = smallest_block_it->first;
+	uint32_t BlockAllocator::HashTable::find(uint64_t key) const
+	{
+		for (uint32_t i = (uint32_t)hash_offset(key) & mask; slots[i].node != invalid_node; i = (i + 1) & mask)
+		{
+			if (slots[i].key == key)
+			{
+				return slots[i].node;
+			}
+		}
+		return invalid_node;
+	}
 
-		uint64_t new_offset = offset + requested_size;
-		uint64_t new_size = size - requested_size;
+	void BlockAllocator::HashTable::insert(uint64_t key, uint32_t node)
+	{
+		uint32_t i = (uint32_t)hash_offset(key) & mask;
+		while (slots[i].node != invalid_node)
+		{
+			i = (i + 1) & mask;
+		}
+		slots[i] = { key, node };
+	}
 
-		blocks_by_size.erase(smallest_block_it);
-		blocks_by_offset.erase(size_value.offset_iterator);
+	void BlockAllocator::HashTable::remove(uint64_t key)
+	{
+		uint32_t i = (uint32_t)hash_offset(key) & mask;
+		while (slots[i].node != invalid_node && slots[i].key != key)
+		{
+			i = (i + 1) & mask;
+		}
 
-		if (new_size > 0)
+		ASSERT(slots[i].node != invalid_node);
+		if (slots[i].node == invalid_node)
 		{
-			add_new_block(new_offset, new_size);
+			return;
 		}
 
-		available_size -= requested_size;
-		return offset;
+		// Backward shift deletion: move later entries of the probe sequence into the gap, so that no tombstones are needed.
+		uint32_t gap = i;
+		for (uint32_t j = (gap + 1) & mask; slots[j].node != invalid_node; j = (j + 1) & mask)
+		{
+			uint32_t home = (uint32_t)hash_offset(slots[j].key) & mask;
+			if (((j - home) & mask) >= ((j - gap) & mask))
+			{
+				slots[gap] = slots[j];
+				gap = j;
+			}
+		}
+		slots[gap].node = invalid_node;
 	}
 
-	void BlockAllocator::free(uint64_t offset, uint64_t size)
+	void BlockAllocator::initialize(uint64_t capacity, uint32_t max_num_free_blocks)
+	{
+		available_size = 0;
+		num_free_blocks = 0;
+
+		first_level_bitmap = 0;
+		memset(second_level_bitmaps, 0, sizeof(second_level_bitmaps));
+		for (uint32_t fl = 0; fl < num_first_level; ++fl)
+		{
+			for (uint32_t sl = 0; sl < num_second_level; ++sl)
+			{
+				free_lists[fl][sl] = invalid_node;
+			}
+		}
+
+		max_num_free_blocks = max(max_num_free_blocks, 2u);
+		nodes.resize(max_num_free_blocks);
+		for (uint32_t i = 0; i < max_num_free_blocks; ++i)
+		{
+			nodes[i].next = (i + 1 < max_num_free_blocks) ? i + 1 : invalid_node;
+		}
+		first_unused_node = 0;
+
+		blocks_by_start.initialize(max_num_free_blocks);
+		blocks_by_end.initialize(max_num_free_blocks);
+
+		if (capacity > 0)
+		{
+			add_free_block(0, capacity);
+			available_size = capacity;
+		}
+	}
+
+	// Size classes: sizes below num_second_level map linearly into the first row. Above, the first level is the power of two and
+	// the second level splits each power of two range into num_second_level equal parts.
+	void BlockAllocator::mapping_insert(uint64_t size, uint32_t& first_level, uint32_t& second_level)
 	{
-		auto next_block_it = blocks_by_offset.upper_bound(offset);
-		auto& prev_block_it = next_block_it;
-		if (prev_block_it != blocks_by_offset.begin())
+		if (size < num_second_level)
 		{
-			--prev_block_it;
+			first_level = 0;
+			second_level = (uint32_t)size;
 		}
 		else
 		{
-			prev_block_it = blocks_by_offset.end();
+			uint32_t highest_bit = index_of_highest_bit(size);
+			first_level = highest_bit - second_level_bits + 1;
+			second_level = (uint32_t)(size >> (highest_bit - second_level_bits)) ^ num_second_level;
 		}
+	}
 
-		uint64 new_offset = 0, new_size = 0;
-		if (prev_block_it != blocks_by_offset.end() && offset == prev_block_it->first + prev_block_it->second.get_size())
+	// Rounds the size up to the next class boundary, so that every block in the returned class is large enough.
+	bool BlockAllocator::mapping_search(uint64_t size, uint32_t& first_level, uint32_t& second_level)
+	{
+		if (size >= num_second_level)
 		{
-			// PrevBlock.Offset           Offset
-			// |                          |
-			// |<-----PrevBlock.Size----->|<------Size-------->|
-			//
-			new_size = prev_block_it->second.get_size() + size;
-			new_offset = prev_block_it->first;
+			uint64_t round = (1ull << (index_of_highest_bit(size) - second_level_bits)) - 1;
+			if (size > UINT64_MAX - round)
+			{
+				return false;
+			}
+			size += round;
+		}
+		mapping_insert(size, first_level, second_level);
+		return true;
+	}
 
-			if (next_block_it != blocks_by_offset.end() && offset + size == next_block_it->first)
+	uint32_t BlockAllocator::find_free_block(uint64_t size)
+	{
+		uint32_t fl, sl;
+		if (mapping_search(size, fl, sl))
+		{
+			uint32_t second_level_map = second_level_bitmaps[fl] & (~0u << sl);
+			if (!second_level_map)
 			{
-				// PrevBlock.Offset           Offset               NextBlock.Offset
-				// |                          |                    |
-				// |<-----PrevBlock.Size----->|<------Size-------->|<-----NextBlock.Size----->|
-				//
-				new_size += next_block_it->second.get_size();
-				blocks_by_size.erase(prev_block_it->second.size_iterator);
-				blocks_by_size.erase(prev_block_it->second.size_iterator);
-				// Delete the range of two blocks
-				++next_block_it;
-				blocks_by_offset.erase(prev_block_it, next_block_it);
+				uint64_t first_level_map = (fl + 1 < 64) ? (first_level_bitmap & (~0ull << (fl + 1))) : 0;
+				if (first_level_map)
+				{
+					fl = index_of_lowest_bit(first_level_map);
+					second_level_map = second_level_bitmaps[fl];
+				}
 			}
-			else
+
+			if (second_level_map)
 			{
-				// PrevBlock.Offset           Offset                       NextBlock.Offset
-				// |                          |                            |
-				// |<-----PrevBlock.Size----->|<------Size-------->| ~ ~ ~ |<-----NextBlock.Size----->|
-				//
-				blocks_by_size.erase(prev_block_it->second.size_iterator);
-				blocks_by_offset.erase(prev_block_it);
+				return free_lists[fl][index_of_lowest_bit(second_level_map)];
 			}
 		}
-		else if (next_block_it != blocks_by_offset.end() && offset + size == next_block_it->first)
+
+		// Blocks in the requested size's own class may still be large enough, e.g. when allocating the whole capacity. Only the
+		// head of the list is checked, so that this stays O(1). A fitting block further down is missed, but only when no larger
+		// class has a free block either.
+		mapping_insert(size, fl, sl);
+		uint32_t node = free_lists[fl][sl];
+		if (node != invalid_node && nodes[node].size >= size)
 		{
-			// PrevBlock.Offset                   Offset               NextBlock.Offset
-			// |                                  |                    |
-			// |<-----PrevBlock.Size----->| ~ ~ ~ |<------Size-------->|<-----NextBlock.Size----->|
-			//
-			new_size = size + next_block_it->second.get_size();
-			new_offset = offset;
-			blocks_by_size.erase(next_block_it->second.size_iterator);
-			blocks_by_offset.erase(next_block_it);
+			return node;
 		}
-		else
+
+		return invalid_node;
+	}
+
+	uint64_t BlockAllocator::allocate(uint64_t requested_size)
+	{
+		if (requested_size == 0)
 		{
-			// PrevBlock.Offset                   Offset                       NextBlock.Offset
-			// |                                  |                            |
-			// |<-----PrevBlock.Size----->| ~ ~ ~ |<------Size-------->| ~ ~ ~ |<-----NextBlock.Size----->|
-			//
-			new_size = size;
-			new_offset = offset;
+			return UINT64_MAX;
+		}
+
+		uint32_t node = find_free_block(requested_size);
+		if (node == invalid_node)
+		{
+			return UINT64_MAX;
 		}
 
-		add_new_block(new_offset, new_size);
+		uint64_t offset = nodes[node].offset;
+		uint64_t size = nodes[node].size;
+
+		remove_free_block(node);
+
+		if (size > requested_size)
+		{
+			add_free_block(offset + requested_size, size - requested_size);
+		}
+
+		available_size -= requested_size;
+		return offset;
+	}
+
+	void BlockAllocator::free(uint64_t offset, uint64_t size)
+	{
+		if (size == 0)
+		{
+			return;
+		}
 
 		available_size += size;
+
+		uint64_t new_offset = offset;
+		uint64_t new_size = size;
+
+		// PrevBlock.Offset           Offset
+		// |                          |
+		// |<-----PrevBlock.Size----->|<------Size-------->|
+		//
+		uint32_t prev = blocks_by_end.find(offset);
+		if (prev != invalid_node)
+		{
+			new_offset = nodes[prev].offset;
+			new_size += nodes[prev].size;
+			remove_free_block(prev);
+		}
+
+		//                            Offset               NextBlock.Offset
+		//                            |                    |
+		//                            |<------Size-------->|<-----NextBlock.Size----->|
+		//
+		uint32_t next = blocks_by_start.find(offset + size);
+		if (next != invalid_node)
+		{
+			new_size += nodes[next].size;
+			remove_free_block(next);
+		}
+
+		add_free_block(new_offset, new_size);
 	}
 
-	void BlockAllocator::add_new_block(uint64_t offset, uint64_t size)
+	uint64_t BlockAllocator::get_largest_free_block() const
 	{
-		auto new_block_it = blocks_by_offset.emplace(offset, OffsetValue());
-		auto order_it = blocks_by_size.emplace(size, new_block_it.first);
-		new_block_it.first->second.size_iterator = order_it;
+		if (!first_level_bitmap)
+		{
+			return 0;
+		}
+
+		uint32_t fl = index_of_highest_bit(first_level_bitmap);
+		uint32_t sl = index_of_highest_bit(second_level_bitmaps[fl]);
+
+		uint64_t result = 0;
+		for (uint32_t node = free_lists[fl][sl]; node != invalid_node; node = nodes[node].next)
+		{
+			result = max(result, nodes[node].size);
+		}
+		return result;
+	}
+
+	void BlockAllocator::add_free_block(uint64_t offset, uint64_t size)
+	{
+		uint32_t node = allocate_node();
+
+		uint32_t fl, sl;
+		mapping_insert(size, fl, sl);
+
+		Node& n = nodes[node];
+		n.offset = offset;
+		n.size = size;
+		n.prev = invalid_node;
+		n.next = free_lists[fl][sl];
+		if (n.next != invalid_node)
+		{
+			nodes[n.next].prev = node;
+		}
+		free_lists[fl][sl] = node;
+
+		first_level_bitmap |= 1ull << fl;
+		second_level_bitmaps[fl] |= 1u << sl;
+
+		blocks_by_start.insert(offset, node);
+		blocks_by_end.insert(offset + size, node);
+		++num_free_blocks;
+	}
+
+	void BlockAllocator::remove_free_block(uint32_t node)
+	{
+		Node& n = nodes[node];
+
+		uint32_t fl, sl;
+		mapping_insert(n.size, fl, sl);
+
+		if (n.prev != invalid_node)
+		{
+			nodes[n.prev].next = n.next;
+		}
+		else
+		{
+			free_lists[fl][sl] = n.next;
+			if (n.next == invalid_node)
+			{
+				second_level_bitmaps[fl] &= ~(1u << sl);
+				if (!second_level_bitmaps[fl])
+				{
+					first_level_bitmap &= ~(1ull << fl);
+				}
+			}
+		}
+		if (n.next != invalid_node)
+		{
+			nodes[n.next].prev = n.prev;
+		}
+
+		blocks_by_start.remove(n.offset);
+		blocks_by_end.remove(n.offset + n.size);
+		--num_free_blocks;
+
+		n.next = first_unused_node;
+		first_unused_node = node;
+	}
+
+	uint32_t BlockAllocator::allocate_node()
+	{
+		if (first_unused_node == invalid_node)
+		{
+			grow();
+		}
+
+		uint32_t node = first_unused_node;
+		first_unused_node = nodes[node].next;
+		return node;
+	}
+
+	void BlockAllocator::grow()
+	{
+		// Only happens if fragmentation exceeds what initialize reserved for.
+		uint32_t old_count = (uint32_t)nodes.size();
+		uint32_t new_count = old_count * 2;
+
+		nodes.resize(new_count);
+		for (uint32_t i = old_count; i < new_count; ++i)
+		{
+			nodes[i].next = (i + 1 < new_count) ? i + 1 : invalid_node;
+		}
+		first_unused_node = old_count;
+
+		blocks_by_start.initialize(new_count);
+		blocks_by_end.initialize(new_count);
+
+		for (uint32_t fl = 0; fl < num_first_level; ++fl)
+		{
+			for (uint32_t sl = 0; sl < num_second_level; ++sl)
+			{
+				for (uint32_t node = free_lists[fl][sl]; node != invalid_node; node = nodes[node].next)
+				{
+					blocks_by_start.insert(nodes[node].offset, node);
+					blocks_by_end.insert(nodes[node].offset + nodes[node].size, node);
+				}
+			}
+		}
 	}
-}
\ No newline at end of file
+}
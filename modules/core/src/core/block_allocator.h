@@ -4,44 +4,77 @@
 
 namespace era_engine
 {
+	// Two-level segregated fit (TLSF) allocator for ranges of an external resource, e.g. a GPU heap or a descriptor heap. It only
+	// hands out offsets and never touches the managed memory. Allocate and free are O(1): free blocks are kept in lists per size
+	// class, and two bitmaps find the first non-empty class which is large enough. Free blocks are found by their start and end
+	// offsets through two fixed size hash tables, so that free can merge with its neighbors.
+	// All bookkeeping is allocated in initialize. It only grows, if more free blocks exist at once than were reserved for.
 	class ERA_CORE_API BlockAllocator
 	{
 	public:
-		void initialize(uint64_t capacity);
+		void initialize(uint64_t capacity, uint32_t max_num_free_blocks = 1024);
 
-		// Returns the offset
+		// Returns the offset, or UINT64_MAX if no free block is large enough.
 		uint64_t allocate(uint64_t requested_size);
 		void free(uint64_t offset, uint64_t size);
 
+		// Size of the largest allocation which would currently succeed. Together with available_size a measure of fragmentation.
+		uint64_t get_largest_free_block() const;
+		uint32_t get_num_free_blocks() const { return num_free_blocks; }
+
 		uint64_t available_size;
 
 	private:
-		struct OffsetValue;
-		struct SizeValue;
+		static constexpr uint32_t second_level_bits = 4;
+		static constexpr uint32_t num_second_level = 1u << second_level_bits;
+		static constexpr uint32_t num_first_level = 64 - second_level_bits + 1;
+		static constexpr uint32_t invalid_node = UINT32_MAX;
 
-		// Referencing each-other
-		using BlockByOffsetMap = std::map<uint64_t, OffsetValue>;
-		using BlockBySizeMap = std::multimap<uint64_t, SizeValue>;
+		struct Node
+		{
+			uint64_t offset;
+			uint64_t size;
+			uint32_t prev; // Neighbors in the free list of the size class, or in the unused node list.
+			uint32_t next;
+		};
 
-		struct OffsetValue
+		struct HashSlot
 		{
-			OffsetValue() = default;
-			OffsetValue(const BlockBySizeMap::iterator& _size_iterator) : size_iterator(_size_iterator) {}
-			uint64_t get_size() const { return size_iterator->first; }
-			BlockBySizeMap::iterator size_iterator;
+			uint64_t key;
+			uint32_t node; // invalid_node, if empty.
 		};
 
-		struct SizeValue
+		struct HashTable
 		{
-			SizeValue() = default;
-			SizeValue(const BlockByOffsetMap::iterator& _offset_iterator) : offset_iterator(_offset_iterator) {}
-			uint64_t get_offset() const { return offset_iterator->first; }
-			BlockByOffsetMap::iterator offset_iterator;
+			void initialize(uint32_t capacity);
+			uint32_t find(uint64_t key) const;
+			void insert(uint64_t key, uint32_t node);
+			void remove(uint64_t key);
+
+			std::vector<HashSlot> slots;
+			uint32_t mask;
 		};
 
-		void add_new_block(uint64_t offset, uint64_t size);
+		static void mapping_insert(uint64_t size, uint32_t& first_level, uint32_t& second_level);
+		static bool mapping_search(uint64_t size, uint32_t& first_level, uint32_t& second_level);
+
+		uint32_t find_free_block(uint64_t size);
+
+		void add_free_block(uint64_t offset, uint64_t size);
+		void remove_free_block(uint32_t node);
+
+		uint32_t allocate_node();
+		void grow();
+
+		std::vector<Node> nodes;
+		uint32_t first_unused_node;
+		uint32_t num_free_blocks;
+
+		uint64_t first_level_bitmap;
+		uint32_t second_level_bitmaps[num_first_level];
+		uint32_t free_lists[num_first_level][num_second_level];
 
-		BlockByOffsetMap blocks_by_offset;
-		BlockBySizeMap blocks_by_size;
+		HashTable blocks_by_start;
+		HashTable blocks_by_end;
 	};
-}
\ No newline at end of file
+}
@@ -8,6 +8,8 @@ namespace era_engine
 	RTTR_REGISTRATION
 	{
 		using namespace rttr;
+		impl::ensure_component_type_registered<InputRootComponent>();
+
 		rttr::registration::class_<InputRootComponent>("InputRootComponent")
 			.constructor<ref<Entity::EcsData>>();
 	}
@@ -5,6 +5,9 @@
 #include "core/log.h"
 #include "core/sync.h"
 
+#include <atomic>
+#include <vector>
+
 namespace era_engine
 {
 	template <typename Event_>
@@ -44,22 +47,292 @@ namespace era_engine
 		size_t num = 0;
 	};
 
-	template <typename Event, size_t MAX_PENDING = 1024, EventType<Event> = true>
-	struct ERA_CORE_API ConcurrentEventQueue : EventQueue<Event, MAX_PENDING>
+	/*
+		Lock-free multi-producer/single-consumer queue. Events live in fixed size segments, which are linked as the queue grows, so
+		pushing never fails. Producers reserve slots with one atomic add per segment, which push_events uses to reserve a whole batch
+		at once. The consumer drains in one pass without taking any lock, so handlers may run for as long as they like and may push
+		new events, which are processed in the next pass.
+
+		Drained segments are retired and recycled with epochs: a producer announces itself in the current epoch before it touches
+		a segment, and the epoch only advances once no producer of the previous one is left. Segments retired in an epoch are
+		recycled when it advances the second time, so a continuous stream of producers can't hold them back. Events from one
+		producer are processed in the order they were pushed.
+	*/
+	template <typename Event, uint32 SEGMENT_SIZE = 256, EventType<Event> = true>
+	struct MPSCEventQueue
 	{
-		void push_event(const Event& event) override
+		MPSCEventQueue()
+		{
+			head = new Segment;
+			tail.store(head);
+		}
+
+		~MPSCEventQueue()
+		{
+			process_queue([](Event&) {});
+
+			while (head)
+			{
+				Segment* next = head->next.load();
+				delete head;
+				head = next;
+			}
+			for (std::vector<Segment*>& list : retired)
+			{
+				for (Segment* segment : list)
+				{
+					delete segment;
+				}
+			}
+			delete spare.load();
+		}
+
+		MPSCEventQueue(const MPSCEventQueue&) = delete;
+		MPSCEventQueue& operator=(const MPSCEventQueue&) = delete;
+
+		// Thread safe.
+		void push_event(const Event& event)
+		{
+			push([&event](uint32) -> const Event& { return event; }, 1);
+		}
+
+		// Thread safe.
+		void push_event(Event&& event)
 		{
-			ScopedSpinLock lock{ sync };
-			EventQueue::push_event(event);
+			push([&event](uint32) -> Event&& { return std::move(event); }, 1);
 		}
 
-		void process_queue(ProcessEventFunction<Event> func) override
+		// Thread safe. Reserves slots for the whole batch at once, instead of once per event.
+		void push_events(const Event* events, uint32 count)
 		{
-			ScopedSpinLock lock{ sync };
-			EventQueue::process_queue(func);
+			push([events](uint32 i) -> const Event& { return events[i]; }, count);
+		}
+
+		// Consumer only. Returns the number of processed events.
+		template <typename Func_>
+		uint32 process_queue(Func_&& func)
+		{
+			// Only process what is visible now, so that handlers which push events can't keep the pass going forever.
+			Segment* endSegment = tail.load();
+			uint32 endIndex = min(endSegment->reserved.load(std::memory_order_acquire), SEGMENT_SIZE);
+
+			uint32 numProcessed = 0;
+			while (true)
+			{
+				bool isEndSegment = head == endSegment;
+				uint32 end = isEndSegment ? endIndex : SEGMENT_SIZE;
+
+				// A slot which is reserved, but not yet written, stops the pass. It is picked up next time.
+				while (readIndex < end && head->ready[readIndex].load(std::memory_order_acquire))
+				{
+					Event* event = head->slot(readIndex);
+					func(*event);
+					event->~Event();
+
+					head->ready[readIndex].store(false, std::memory_order_relaxed);
+					++readIndex;
+					++numProcessed;
+				}
+
+				if (isEndSegment || readIndex < SEGMENT_SIZE)
+				{
+					break;
+				}
+
+				// The tail has moved past this segment, so no producer can reach it anymore except the ones already inside a push.
+				Segment* next = head->next.load(std::memory_order_acquire);
+				retired[epoch.load(std::memory_order_relaxed) & 1].push_back(head);
+				head = next;
+				readIndex = 0;
+			}
+
+			reclaimRetired();
+
+			return numProcessed;
+		}
+
+		// Consumer only.
+		bool empty() const noexcept
+		{
+			if (readIndex < SEGMENT_SIZE)
+			{
+				return !head->ready[readIndex].load(std::memory_order_acquire);
+			}
+
+			Segment* next = head->next.load(std::memory_order_acquire);
+			return !next || !next->ready[0].load(std::memory_order_acquire);
 		}
 
 	private:
-		SpinLock sync;
+		struct Segment
+		{
+			Segment()
+			{
+				reset();
+			}
+
+			void reset()
+			{
+				reserved.store(0, std::memory_order_relaxed);
+				next.store(nullptr, std::memory_order_relaxed);
+				for (uint32 i = 0; i < SEGMENT_SIZE; ++i)
+				{
+					ready[i].store(false, std::memory_order_relaxed);
+				}
+			}
+
+			Event* slot(uint32 index) { return (Event*)storage + index; }
+
+			// Producers hammer this counter. Keep it away from the data the consumer reads.
+			alignas(64) std::atomic<uint32> reserved;
+			std::atomic<Segment*> next;
+
+			alignas(64) std::atomic<bool> ready[SEGMENT_SIZE];
+			alignas(Event) uint8 storage[SEGMENT_SIZE * sizeof(Event)];
+		};
+
+		template <typename Source_>
+		void push(Source_&& source, uint32 count)
+		{
+			// Keeps the consumer from recycling segments, which this producer may still hold a pointer to. If the epoch advanced between
+			// reading it and being counted, this producer is counted in the wrong epoch and has to announce itself again. The tail must
+			// only be loaded after that.
+			uint32 epochIndex;
+			while (true)
+			{
+				epochIndex = epoch.load() & 1;
+				activeProducers[epochIndex].fetch_add(1);
+				if ((epoch.load() & 1) == epochIndex)
+				{
+					break;
+				}
+				activeProducers[epochIndex].fetch_sub(1);
+			}
+
+			Segment* segment = tail.load();
+			uint32 numWritten = 0;
+			while (numWritten < count)
+			{
+				uint32 numWanted = min(count - numWritten, SEGMENT_SIZE);
+				uint32 first = segment->reserved.fetch_add(numWanted, std::memory_order_acq_rel);
+
+				// The counter may overshoot the segment size. Everything past the end belongs to the next segment.
+				if (first < SEGMENT_SIZE)
+				{
+					uint32 numReserved = min(numWanted, SEGMENT_SIZE - first);
+					for (uint32 i = 0; i < numReserved; ++i)
+					{
+						new (segment->slot(first + i)) Event(source(numWritten + i));
+						segment->ready[first + i].store(true, std::memory_order_release);
+					}
+
+					numWritten += numReserved;
+					if (numWritten == count)
+					{
+						break;
+					}
+				}
+
+				segment = advance(segment);
+			}
+
+			activeProducers[epochIndex].fetch_sub(1);
+		}
+
+		// Consumer only. Producers of the current epoch validated it after the previous epoch's segments were retired, and loaded
+		// the tail after that, when it had already moved past them. So once no producer of the previous epoch is left, its segments
+		// can be recycled and the epoch may advance. No producer is ever more than one epoch behind.
+		void reclaimRetired()
+		{
+			uint32 current = epoch.load(std::memory_order_relaxed) & 1;
+			uint32 previous = current ^ 1;
+
+			if (activeProducers[previous].load() != 0)
+			{
+				return;
+			}
+
+			recycleRetired(previous);
+
+			if (!retired[current].empty())
+			{
+				epoch.fetch_add(1);
+
+				// Often nobody is inside a push, so there is no need to wait for the next pass.
+				if (activeProducers[current].load() == 0)
+				{
+					recycleRetired(current);
+				}
+			}
+		}
+
+		void recycleRetired(uint32 epochIndex)
+		{
+			for (Segment* segment : retired[epochIndex])
+			{
+				recycleSegment(segment);
+			}
+			retired[epochIndex].clear();
+		}
+
+		// Returns the segment after the given full one, appending a new one if necessary.
+		Segment* advance(Segment* segment)
+		{
+			Segment* next = segment->next.load(std::memory_order_acquire);
+			if (!next)
+			{
+				Segment* fresh = allocateSegment();
+				if (segment->next.compare_exchange_strong(next, fresh, std::memory_order_acq_rel))
+				{
+					next = fresh;
+				}
+				else
+				{
+					// Another producer was faster. Next now holds its segment.
+					recycleSegment(fresh);
+				}
+			}
+
+			// Fails harmlessly, if another producer has moved the tail already.
+			Segment* expected = segment;
+			tail.compare_exchange_strong(expected, next);
+
+			return next;
+		}
+
+		Segment* allocateSegment()
+		{
+			Segment* segment = spare.exchange(nullptr, std::memory_order_acquire);
+			return segment ? segment : new Segment;
+		}
+
+		void recycleSegment(Segment* segment)
+		{
+			segment->reset();
+
+			Segment* expected = nullptr;
+			if (!spare.compare_exchange_strong(expected, segment, std::memory_order_release))
+			{
+				delete segment;
+			}
+		}
+
+		std::atomic<Segment*> tail;
+		std::atomic<Segment*> spare = nullptr;
+		std::atomic<uint32> epoch = 0;
+
+		// Producers inside a push, by the parity of the epoch they entered in.
+		alignas(64) std::atomic<uint32> activeProducers[2] = {};
+
+		// Consumer only.
+		Segment* head;
+		uint32 readIndex = 0;
+
+		// Segments retired in an epoch, by its parity.
+		std::vector<Segment*> retired[2];
 	};
+
+	// Thread safe push with a single consumer.
+	template <typename Event, uint32 SEGMENT_SIZE = 256>
+	using ConcurrentEventQueue = MPSCEventQueue<Event, SEGMENT_SIZE>;
 }
\ No newline at end of file
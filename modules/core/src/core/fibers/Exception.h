@@ -14,6 +14,6 @@ namespace era_engine
 		Exception(const std::string& str) throw() : m_str(str) {};
 		~Exception() throw() = default;
 
-		virtual const char* what() const override { return m_str.c_str(); }
+		virtual const char* what() const noexcept override { return m_str.c_str(); }
 	};
 }
\ No newline at end of file
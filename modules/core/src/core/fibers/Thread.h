@@ -65,5 +65,8 @@ namespace era_engine
 
 		// Static Methods
 		static void SleepFor(uint32_t ms);
+
+		// ID of the calling thread, comparable with GetID()
+		static uint32_t GetCurrentID();
 	};
 }
\ No newline at end of file
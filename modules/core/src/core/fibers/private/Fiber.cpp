@@ -4,6 +4,10 @@
 
 #ifdef _WIN32
 #include <Windows.h>
+#else
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
 
 // TODO: Add exceptiosn for invalid stuff?
@@ -21,35 +25,128 @@ namespace era_engine
 		callback(fiber);
 	}
 
+#ifndef _WIN32
+	// Portable backend: ucontext with mmap'ed stacks. Stack memory is reserved up front and committed by the OS on first touch,
+	// the lowest page is a guard page.
+	static constexpr size_t FIBER_STACK_SIZE = 1024 * 1024;
+
+	struct FiberContext
+	{
+		ucontext_t context;
+		void* stack = nullptr;
+		size_t stack_size = 0;
+	};
+
+	// ucontext needs the running context to save into. Win32 tracks this internally.
+	static thread_local FiberContext* current_context = nullptr;
+
+	// Not inlined, so the compiler can't cache the thread local's address across a switch (the fiber may resume on another thread).
+	static __attribute__((noinline)) FiberContext*& get_current_context()
+	{
+		return current_context;
+	}
+
+	static void LaunchFiberContext(uint32_t low, uint32_t high)
+	{
+		LaunchFiber((Fiber*)(((uintptr_t)high << 32) | (uintptr_t)low));
+	}
+
+	static FiberContext* CreateFiberContext(Fiber* fiber)
+	{
+		const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+		FiberContext* context = new FiberContext();
+		context->stack_size = FIBER_STACK_SIZE + page_size;
+		context->stack = mmap(nullptr, context->stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (context->stack == MAP_FAILED)
+		{
+			delete context;
+			return nullptr;
+		}
+		mprotect(context->stack, page_size, PROT_NONE);
+
+		getcontext(&context->context);
+		context->context.uc_stack.ss_sp = (uint8_t*)context->stack + page_size;
+		context->context.uc_stack.ss_size = FIBER_STACK_SIZE;
+		context->context.uc_link = nullptr;
+
+		const uintptr_t ptr = (uintptr_t)fiber;
+		makecontext(&context->context, (void(*)())LaunchFiberContext, 2, (uint32_t)(ptr & 0xFFFFFFFF), (uint32_t)(ptr >> 32));
+
+		return context;
+	}
+
+	static void DeleteFiberContext(void* fiber)
+	{
+		FiberContext* context = (FiberContext*)fiber;
+		if (context->stack)
+		{
+			munmap(context->stack, context->stack_size);
+		}
+		delete context;
+	}
+
+	static void SwitchFiberContext(void* to)
+	{
+		FiberContext*& current = get_current_context();
+		if (current == nullptr)
+		{
+			throw Exception("SwitchTo: current thread is not a fiber (call FromCurrentThread first)");
+		}
+
+		FiberContext* from = current;
+		current = (FiberContext*)to;
+		swapcontext(&from->context, &((FiberContext*)to)->context);
+	}
+#endif
+
 	Fiber::Fiber()
 	{
 #ifdef _WIN32
 		m_fiber = CreateFiber(0, (LPFIBER_START_ROUTINE)LaunchFiber, this);
-		m_thread_fiber = false;
+#else
+		m_fiber = CreateFiberContext(this);
 #endif
+		m_thread_fiber = false;
 	}
 
 	Fiber::~Fiber()
 	{
-#ifdef _WIN32
 		if (m_fiber && !m_thread_fiber) 
 		{
+#ifdef _WIN32
 			DeleteFiber(m_fiber);
+#else
+			DeleteFiberContext(m_fiber);
+#endif
+		}
+#ifndef _WIN32
+		if (m_thread_fiber)
+		{
+			delete (FiberContext*)m_fiber;
 		}
 #endif
 	}
 
 	void Fiber::FromCurrentThread()
 	{
-#ifdef _WIN32
 		if (m_fiber && !m_thread_fiber) 
 		{
+#ifdef _WIN32
 			DeleteFiber(m_fiber);
+#else
+			DeleteFiberContext(m_fiber);
+#endif
 		}
 
+#ifdef _WIN32
 		m_fiber = ConvertThreadToFiber(nullptr);
-		m_thread_fiber = true;
+#else
+		// Filled in by the first switch away from this thread.
+		m_fiber = new FiberContext();
+		get_current_context() = (FiberContext*)m_fiber;
 #endif
+		m_thread_fiber = true;
 	}
 
 	void Fiber::SetCallback(Callback_t cb)
@@ -72,14 +169,22 @@ namespace era_engine
 		fiber->m_userdata = userdata;
 		fiber->m_return_fiber = this;
 
+#ifdef _WIN32
 		SwitchToFiber(fiber->m_fiber);
+#else
+		SwitchFiberContext(fiber->m_fiber);
+#endif
 	}
 
 	void Fiber::SwitchBack()
 	{
 		if (m_return_fiber && m_return_fiber->m_fiber) 
 		{
+#ifdef _WIN32
 			SwitchToFiber(m_return_fiber->m_fiber);
+#else
+			SwitchFiberContext(m_return_fiber->m_fiber);
+#endif
 		}
 		else 
 		{
@@ -1,18 +1,11 @@
 #include "core/fibers/Manager.h"
 #include "core/fibers/Thread.h"
 
-#ifdef _WIN32
-#include <Windows.h>
-#else
-#error Linux is not supported!
-#endif
-
 namespace era_engine
 {
 	uint8_t Manager::GetCurrentThreadIndex() const
 	{
-#ifdef _WIN32
-		uint32_t idx = GetCurrentThreadId();
+		uint32_t idx = Thread::GetCurrentID();
 		for (uint8_t i = 0; i < m_numThreads; i++) 
 		{
 			if (m_threads[i].GetID() == idx)
@@ -20,15 +13,13 @@ namespace era_engine
 				return i;
 			}
 		}
-#endif
 
 		return UINT8_MAX;
 	}
 
 	Thread* Manager::GetCurrentThread() const
 	{
-#ifdef _WIN32
-		uint32_t idx = GetCurrentThreadId();
+		uint32_t idx = Thread::GetCurrentID();
 		for (uint8_t i = 0; i < m_numThreads; i++)
 		{
 			if (m_threads[i].GetID() == idx)
@@ -36,15 +27,13 @@ namespace era_engine
 				return &m_threads[i];
 			}
 		}
-#endif
 
 		return nullptr;
 	}
 
 	TLS* Manager::GetCurrentTLS() const
 	{
-#ifdef _WIN32
-		uint32_t idx = GetCurrentThreadId();
+		uint32_t idx = Thread::GetCurrentID();
 		for (uint8_t i = 0; i < m_numThreads; i++) 
 		{
 			if (m_threads[i].GetID() == idx) 
@@ -52,7 +41,6 @@ namespace era_engine
 				return m_threads[i].GetTLS();
 			}
 		}
-#endif
 
 		return nullptr;
 	}
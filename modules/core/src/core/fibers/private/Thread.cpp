@@ -4,6 +4,13 @@
 
 #ifdef _WIN32
 #include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
 #endif
 
 namespace era_engine
@@ -22,8 +29,39 @@ namespace era_engine
 		thread->WaitForReady();
 		callback(thread);
 	}
+#else
+	static std::atomic<uint32_t> next_thread_id = 0;
+	static thread_local uint32_t current_thread_id = UINT32_MAX;
+
+	static void* LaunchThread(void* ptr)
+	{
+		auto thread = reinterpret_cast<Thread*>(ptr);
+		auto callback = thread->GetCallback();
+
+		if (callback == nullptr)
+		{
+			throw Exception("LaunchThread: callback is nullptr");
+		}
+
+		current_thread_id = thread->GetID();
+		callback(thread);
+		return nullptr;
+	}
 #endif
 
+	uint32_t Thread::GetCurrentID()
+	{
+#ifdef _WIN32
+		return GetCurrentThreadId();
+#else
+		if (current_thread_id == UINT32_MAX)
+		{
+			current_thread_id = next_thread_id++;
+		}
+		return current_thread_id;
+#endif
+	}
+
 	bool Thread::Spawn(Callback_t callback, void* userdata)
 	{
 		m_handle = nullptr;
@@ -37,6 +75,18 @@ namespace era_engine
 			std::lock_guard<std::mutex> lock(m_startupIdMutex);
 			m_handle = CreateThread(0, 0, (LPTHREAD_START_ROUTINE)LaunchThread, this, 0, (DWORD*)&m_id);
 		}
+#else
+		// The ID is assigned before the thread starts, so there is nothing to wait for in WaitForReady.
+		m_id = next_thread_id++;
+
+		pthread_t* handle = new pthread_t();
+		if (pthread_create(handle, nullptr, LaunchThread, this) != 0)
+		{
+			delete handle;
+			m_id = UINT32_MAX;
+			return false;
+		}
+		m_handle = handle;
 #endif
 
 		return HasSpawned();
@@ -52,6 +102,16 @@ namespace era_engine
 
 		DWORD_PTR mask = 1ull << i;
 		SetThreadAffinityMask(m_handle, mask);
+#elif defined(__linux__)
+		if (!HasSpawned() || !m_handle)
+		{
+			return;
+		}
+
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(i, &set);
+		pthread_setaffinity_np(*(pthread_t*)m_handle, sizeof(set), &set);
 #endif
 	}
 
@@ -64,13 +124,25 @@ namespace era_engine
 
 #ifdef _WIN32
 		WaitForSingleObject(m_handle, INFINITE);
+#else
+		if (m_handle)
+		{
+			pthread_join(*(pthread_t*)m_handle, nullptr);
+			delete (pthread_t*)m_handle;
+			m_handle = nullptr;
+		}
 #endif
 	}
 
 	void Thread::FromCurrentThread()
 	{
+#ifdef _WIN32
 		m_handle = GetCurrentThread();
-		m_id = GetCurrentThreadId();
+#else
+		// Not joinable, the handle is only used for affinity.
+		m_handle = nullptr;
+#endif
+		m_id = GetCurrentID();
 	}
 
 	void Thread::WaitForReady()
@@ -95,6 +167,8 @@ namespace era_engine
 	{
 #ifdef _WIN32
 		Sleep(ms);
+#else
+		std::this_thread::sleep_for(std::chrono::milliseconds(ms));
 #endif
 	}
 }
\ No newline at end of file
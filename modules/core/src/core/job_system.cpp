@@ -3,16 +3,95 @@
 #include "core/job_system.h"
 #include "core/math.h"
 #include "core/imgui.h"
+#include "core/memory.h"
+
+#include "core/fibers/Fiber.h"
+
+#ifdef _WIN32
+#define JOB_NOINLINE __declspec(noinline)
+#else
+#define JOB_NOINLINE __attribute__((noinline))
+#endif
 
 namespace era_engine
 {
+    static std::atomic<uint32> num_job_threads = 1;
+    static thread_local uint32 job_thread_index = 0;
+
+    // A fiber suspended in JobHandle::wait_for_completion. Lives on the stack of the suspended fiber.
+    struct JobWaiter
+    {
+        Fiber* fiber = nullptr;
+        JobQueue* queue = nullptr;
+        JobWaiter* next = nullptr;
+
+        // Set by the fiber that runs next, once the waiting fiber's context has been saved. Only then it may be resumed.
+        std::atomic<bool> suspended = false;
+    };
+
+    // Marks a job's waiter list as closed: the job has finished and later waiters must not suspend.
+    static JobWaiter* const closed_waiters = (JobWaiter*)uintptr_t(1);
+
+    // Per thread fiber state. A fiber can't finish its own bookkeeping before it has switched away, so it leaves it for the fiber that
+    // runs next (see finish_fiber_switch).
+    struct JobFiberState
+    {
+        JobQueue* worker_queue = nullptr;
+        Fiber* current_fiber = nullptr;
+
+        JobWaiter* pending_suspend = nullptr;
+        Fiber* pending_release = nullptr;
+
+        // Number of pinned waits on this thread's stack. Jobs executed inside one must not suspend, or the pinned wait would migrate.
+        uint32 pinned_waits = 0;
+    };
+
+    static thread_local JobFiberState job_fiber_state;
+
+    // Not inlined: a fiber may be resumed on another thread, so the address of the thread local must not be cached across a switch.
+    static JOB_NOINLINE JobFiberState& get_job_fiber_state()
+    {
+        return job_fiber_state;
+    }
+
+    static void finish_fiber_switch(Fiber* fiber)
+    {
+        JobFiberState& state = get_job_fiber_state();
+        state.current_fiber = fiber;
+
+        if (state.pending_suspend)
+        {
+            state.pending_suspend->suspended.store(true, std::memory_order_release);
+            state.pending_suspend = nullptr;
+        }
+
+        if (state.pending_release)
+        {
+            state.worker_queue->free_fibers.enqueue(state.pending_release);
+            state.pending_release = nullptr;
+        }
+    }
+
     void JobQueue::initialize(uint32 num_threads, uint32 thread_offset, int thread_priority, const wchar* description)
     {
         queue = moodycamel::ConcurrentQueue<int32>(capacity);
 
+        max_fibers = num_threads * max_fibers_per_thread;
+
+        if (num_threads > 0)
+        {
+            free_fibers = moodycamel::ConcurrentQueue<Fiber*>(num_threads * 4);
+            ready_waiters = moodycamel::ConcurrentQueue<JobWaiter*>(num_threads * 4);
+        }
+
         for (uint32 i = 0; i < num_threads; ++i)
         {
-            std::thread thread([this, i]() { thread_func(i); });
+            uint32 thread_index = num_job_threads++;
+            std::thread thread([this, i, thread_index]()
+                {
+                    job_thread_index = thread_index;
+                    thread_func(i);
+                });
 
             HANDLE handle = (HANDLE)thread.native_handle();
             SetThreadPriority(handle, thread_priority);
@@ -67,16 +146,69 @@ namespace era_engine
         }
     }
 
-    void JobQueue::wait_for_completion(int32 handle)
+    void JobQueue::help_until_finished(JobQueueEntry& job)
+    {
+        // Doesn't switch fibers, so the state stays this thread's for the whole wait.
+        JobFiberState& state = get_job_fiber_state();
+
+        ++state.pinned_waits;
+        while (job.num_unfinished_jobs > 0)
+        {
+            execute_next_job();
+        }
+        --state.pinned_waits;
+    }
+
+    void JobQueue::wait_for_completion(int32 handle, bool pinned)
     {
         if (handle != -1)
         {
             JobQueueEntry& job = all_jobs[handle];
 
-            while (job.num_unfinished_jobs > 0)
+            if (job.num_unfinished_jobs <= 0)
             {
-                execute_next_job();
+                return;
             }
+
+            JobFiberState& state = get_job_fiber_state();
+            JobQueue* worker_queue = state.worker_queue;
+
+            Fiber* next_fiber = nullptr;
+            if (worker_queue && !pinned && state.pinned_waits == 0)
+            {
+                // The wait may migrate this job. Jobs running here meanwhile would allocate below the scope's marker.
+                ASSERT(!has_open_frame_allocator_scopes());
+
+                next_fiber = worker_queue->acquire_fiber(true);
+            }
+
+            if (!next_fiber)
+            {
+                help_until_finished(job);
+                return;
+            }
+
+            JobWaiter waiter;
+            waiter.fiber = state.current_fiber;
+            waiter.queue = worker_queue;
+
+            JobWaiter* head = job.waiters.load(std::memory_order_acquire);
+            do
+            {
+                if (head == closed_waiters)
+                {
+                    worker_queue->free_fibers.enqueue(next_fiber);
+                    return;
+                }
+                waiter.next = head;
+            } while (!job.waiters.compare_exchange_weak(head, &waiter, std::memory_order_acq_rel, std::memory_order_acquire));
+
+            // Keep the worker busy with other jobs until finish_job hands this fiber back to one of the queue's workers.
+            state.pending_suspend = &waiter;
+            waiter.fiber->SwitchTo(next_fiber, worker_queue);
+
+            // Possibly on another thread now, everything thread-affine has to be fetched again.
+            finish_fiber_switch(waiter.fiber);
         }
     }
 
@@ -103,7 +235,27 @@ namespace era_engine
             {
                 job.continuation.queue->submit(job.continuation.index);
             }
+
+            JobWaiter* waiter = job.waiters.exchange(closed_waiters, std::memory_order_acq_rel);
+            while (waiter && waiter != closed_waiters)
+            {
+                // Read before handing over, the waiter's stack may be gone once it has been resumed.
+                JobWaiter* next = waiter->next;
+                waiter->queue->resume_waiter(waiter);
+                waiter = next;
+            }
+        }
+    }
+
+    void JobQueue::resume_waiter(JobWaiter* waiter)
+    {
+        ready_waiters.enqueue(waiter);
+
+        // Taking the lock orders this with a worker that is about to sleep, so the wake up can't get lost.
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex);
         }
+        wake_condition.notify_one();
     }
 
     bool JobQueue::execute_next_job()
@@ -123,13 +275,73 @@ namespace era_engine
     }
 
     void JobQueue::thread_func(int32 thread_index)
+    {
+        // The thread's own fiber is never resumed, workers only run on pool fibers, so that any of them can be suspended in a wait.
+        Fiber* thread_fiber = new Fiber();
+        thread_fiber->FromCurrentThread();
+
+        JobFiberState& state = get_job_fiber_state();
+        state.worker_queue = this;
+        state.current_fiber = thread_fiber;
+
+        thread_fiber->SwitchTo(acquire_fiber(false), this);
+    }
+
+    Fiber* JobQueue::acquire_fiber(bool bounded)
+    {
+        Fiber* fiber = nullptr;
+        if (!free_fibers.try_dequeue(fiber))
+        {
+            // Grows with the number of jobs suspended at the same time, up to max_fibers. Every worker's first fiber is not bounded.
+            uint32 count = num_fibers.fetch_add(1, std::memory_order_relaxed);
+            if (bounded && count >= max_fibers)
+            {
+                num_fibers.fetch_sub(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            fiber = new Fiber();
+            fiber->SetCallback(worker_fiber_func);
+        }
+        return fiber;
+    }
+
+    void JobQueue::worker_fiber_func(Fiber* fiber)
+    {
+        finish_fiber_switch(fiber);
+
+        JobQueue* job_queue = (JobQueue*)fiber->GetUserdata();
+        job_queue->worker_loop();
+    }
+
+    void JobQueue::worker_loop()
     {
         while (true)
         {
+            JobWaiter* waiter = nullptr;
+            if (ready_waiters.try_dequeue(waiter))
+            {
+                if (!waiter->suspended.load(std::memory_order_acquire))
+                {
+                    // Woken before it finished switching away, try again later.
+                    ready_waiters.enqueue(waiter);
+                    continue;
+                }
+
+                JobFiberState& state = get_job_fiber_state();
+                Fiber* fiber = state.current_fiber;
+                state.pending_release = fiber;
+                fiber->SwitchTo(waiter->fiber);
+
+                // Resumed from the pool by another worker.
+                finish_fiber_switch(fiber);
+                continue;
+            }
+
             if (!execute_next_job())
             {
                 std::unique_lock<std::mutex> lock(wake_mutex);
-                wake_condition.wait(lock);
+                wake_condition.wait(lock, [this]() { return queue.size_approx() > 0 || ready_waiters.size_approx() > 0; });
             }
         }
     }
@@ -141,12 +353,23 @@ namespace era_engine
 
     void JobHandle::submit_after(JobHandle before)
     {
+        // Assets loaded synchronously have no load job.
+        if (before.index == -1)
+        {
+            submit_now();
+            return;
+        }
         before.queue->add_continuation(before.index, *this);
     }
 
     void JobHandle::wait_for_completion()
     {
-        queue->wait_for_completion(index);
+        queue->wait_for_completion(index, false);
+    }
+
+    void JobHandle::wait_for_completion_on_this_thread()
+    {
+        queue->wait_for_completion(index, true);
     }
 
     JobQueue high_priority_job_queue;
@@ -172,4 +395,20 @@ namespace era_engine
         main_thread_job_queue.wait_for_completion();
     }
 
+    // Not inlined, for the same reason as get_job_fiber_state().
+    JOB_NOINLINE uint32 get_job_thread_index()
+    {
+        return job_thread_index;
+    }
+
+    uint32 get_num_job_threads()
+    {
+        return num_job_threads.load(std::memory_order_relaxed);
+    }
+
+    bool is_low_priority_job_thread()
+    {
+        return get_job_fiber_state().worker_queue == &low_priority_job_queue;
+    }
+
 }
\ No newline at end of file
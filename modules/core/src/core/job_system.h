@@ -8,12 +8,25 @@
 
 namespace era_engine
 {
+    class Fiber;
+    struct JobWaiter;
+
     struct ERA_CORE_API JobHandle
     {
         void submit_now();
         void submit_after(JobHandle before);
+
+        // On a job system worker thread this suspends the calling job's fiber until the job has finished, and the worker keeps executing
+        // other jobs in the meantime. The waiting job may be resumed on a different worker of the same queue, so nothing thread-affine may
+        // be held across the wait: no open CPU_PROFILE_BLOCK or ScopedFrameAllocator, no get_job_thread_index() or anything picked with
+        // it (frame arenas, command buffer lanes). Fetch such state again after the wait. On any other thread this helps executing jobs until the job has finished.
         void wait_for_completion();
 
+        // Never migrates: helps executing jobs on the calling thread until the job has finished. For helpers that can't know what their
+        // callers hold across the call. Waits inside jobs executed meanwhile are pinned as well. wait_for_completion() falls back to this
+        // when the fiber pool is exhausted.
+        void wait_for_completion_on_this_thread();
+
         int32 index = -1;
         struct JobQueue* queue;
     };
@@ -32,7 +45,10 @@ namespace era_engine
             int32 parent;
             JobHandle continuation;
 
-            static constexpr uint64 SIZE = sizeof(function) + sizeof(templated_function) + sizeof(num_unfinished_jobs) + sizeof(parent) + sizeof(continuation);
+            // Fibers suspended in wait_for_completion on this job.
+            std::atomic<JobWaiter*> waiters;
+
+            static constexpr uint64 SIZE = sizeof(function) + sizeof(templated_function) + sizeof(num_unfinished_jobs) + sizeof(parent) + sizeof(continuation) + sizeof(waiters);
             static constexpr uint64 DATA_SIZE = (3 * 64) - SIZE;
 
             uint8 data[DATA_SIZE];
@@ -54,6 +70,7 @@ namespace era_engine
             job.num_unfinished_jobs = 1;
             job.parent = parent.index;
             job.continuation.index = -1;
+            job.waiters = nullptr;
 
             if (parent.index != -1)
             {
@@ -83,14 +100,32 @@ namespace era_engine
 
         void add_continuation(int32 first, JobHandle second);
         void submit(int32 handle);
-        void wait_for_completion(int32 handle);
+        void wait_for_completion(int32 handle, bool pinned);
+        void help_until_finished(JobQueueEntry& job);
 
         int32 allocate_job();
         void finish_job(int32 handle);
         bool execute_next_job();
         void thread_func(int32 thread_index);
 
+        // Returns null if bounded and the pool has reached max_fibers.
+        Fiber* acquire_fiber(bool bounded);
+        void resume_waiter(JobWaiter* waiter);
+        void worker_loop();
+
+        static void worker_fiber_func(Fiber* fiber);
+
         moodycamel::ConcurrentQueue<int32> queue;
+
+        // Worker fibers. Fibers never leave the workers of the queue they were created for.
+        moodycamel::ConcurrentQueue<Fiber*> free_fibers;
+        moodycamel::ConcurrentQueue<JobWaiter*> ready_waiters;
+
+        // Every fiber reserves a full stack, so the number of jobs suspended at the same time is bounded. Past that, waits are pinned.
+        static constexpr uint32 max_fibers_per_thread = 16;
+        std::atomic<uint32> num_fibers = 0;
+        uint32 max_fibers = 0;
+
         std::atomic<uint32> running_jobs = 0;
 
         static constexpr uint32 capacity = 4096;
@@ -107,6 +142,16 @@ namespace era_engine
     extern JobQueue low_priority_job_queue;
     extern JobQueue main_thread_job_queue;
 
-    void initialize_job_system();
+    ERA_CORE_API void initialize_job_system();
     void execute_main_thread_jobs();
+
+    // Index of the calling thread among all job system threads. The main thread (and any other thread not spawned by the job system) is 0,
+    // worker threads are numbered from 1. Stable for the lifetime of the thread, so it can be used to pick per-thread scratch data.
+    NODISCARD uint32 get_job_thread_index();
+
+    // Number of distinct values get_job_thread_index() can return.
+    NODISCARD ERA_CORE_API uint32 get_num_job_threads();
+
+    // True on the workers of low_priority_job_queue, whose jobs may run across frame boundaries.
+    NODISCARD bool is_low_priority_job_thread();
 }
\ No newline at end of file
@@ -2,13 +2,15 @@
 
 #include "core/memory.h"
 #include "core/math.h"
+#include "core/job_system.h"
 
 #include <rttr/registration>
 
+// Virtual reservation per frame arena buffer. Only what is used gets committed.
+#define FRAME_ARENA_RESERVE_SIZE GB(1)
+
 namespace era_engine
 {
-	static std::mutex mutex;
-
 	RTTR_REGISTRATION
 	{
 		using namespace rttr;
@@ -22,16 +24,18 @@ namespace era_engine
 		initialize();
 	}
 
-	Allocator::Allocator(uint64 _minimum_block_size, uint64 _reserve_size)
+	Allocator::Allocator(uint64 _minimum_block_size, uint64 _reserve_size, MemoryTag _tag)
 	{
-		initialize(_minimum_block_size, _reserve_size);
+		initialize(_minimum_block_size, _reserve_size, _tag);
 	}
 
-	void Allocator::initialize(uint64 _minimum_block_size, uint64 _reserve_size)
+	void Allocator::initialize(uint64 _minimum_block_size, uint64 _reserve_size, MemoryTag _tag)
 	{
 		reset(true);
 
+		tag = _tag;
 		memory = (uint8*)VirtualAlloc(0, _reserve_size, MEM_RESERVE, PAGE_READWRITE);
+		track_reserved(tag, _reserve_size);
 
 		SYSTEM_INFO systemInfo;
 		GetSystemInfo(&systemInfo);
@@ -44,7 +48,7 @@ namespace era_engine
 
 	void Allocator::ensure_free_size(uint64 size)
 	{
-		std::lock_guard lock{ mutex };
+		ScopedLock<AdaptiveMutex> lock{ sync };
 		ensure_free_size_internal(size);
 	}
 
@@ -62,6 +66,7 @@ namespace era_engine
 			uint64 allocationSize = max(size, minimum_block_size);
 			allocationSize = page_size * bucketize(allocationSize, page_size);
 			VirtualAlloc(memory + committed_memory, allocationSize, MEM_COMMIT, PAGE_READWRITE);
+			track_committed(tag, allocationSize);
 
 			size_left_total += allocationSize;
 			size_left_current += allocationSize;
@@ -78,7 +83,7 @@ namespace era_engine
 
 		uint8* result = nullptr;
 		{
-			std::lock_guard lock{ mutex };
+			ScopedLock<AdaptiveMutex> lock{ sync };
 			uint64 mask = alignment - 1;
 			uint64 misalignment = current & mask;
 			uint64 adjustment = (misalignment == 0) ? 0 : (alignment - misalignment);
@@ -110,6 +115,9 @@ namespace era_engine
 		if (memory && free_memory)
 		{
 			VirtualFree(memory, 0, MEM_RELEASE);
+			track_committed(tag, -(int64)committed_memory);
+			track_reserved(tag, -(int64)reserve_size);
+
 			memory = 0;
 			committed_memory = 0;
 		}
@@ -117,4 +125,70 @@ namespace era_engine
 		reset_to_marker(MemoryMarker{ 0 });
 	}
 
+	static std::atomic<uint64> frame_arena_index = 0;
+
+	struct ThreadFrameArenas
+	{
+		ThreadFrameArenas()
+		{
+			for (uint32 i = 0; i < 2; ++i)
+			{
+				arenas[i].initialize(0, FRAME_ARENA_RESERVE_SIZE, memory_tag_frame_arenas);
+				frames[i] = UINT64_MAX;
+			}
+		}
+
+		Allocator arenas[2];
+		uint64 frames[2];
+
+		uint32 num_open_scopes = 0;
+	};
+
+	static thread_local ThreadFrameArenas thread_frame_arenas;
+
+	Allocator& get_frame_arena()
+	{
+		// These jobs may outlive the frame. See memory.h.
+		ASSERT(!is_low_priority_job_thread());
+
+		uint64 frame = frame_arena_index.load(std::memory_order_relaxed);
+		uint32 index = (uint32)(frame & 1);
+
+		// This buffer was last used two frames ago.
+		if (thread_frame_arenas.frames[index] != frame)
+		{
+			thread_frame_arenas.arenas[index].reset();
+			thread_frame_arenas.frames[index] = frame;
+		}
+
+		return thread_frame_arenas.arenas[index];
+	}
+
+	void advance_frame_arenas()
+	{
+		frame_arena_index.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	bool has_open_frame_allocator_scopes()
+	{
+		return thread_frame_arenas.num_open_scopes > 0;
+	}
+
+	ScopedFrameAllocator::ScopedFrameAllocator()
+		: ScopedAllocator(get_frame_arena())
+	{
+		++thread_frame_arenas.num_open_scopes;
+	}
+
+	ScopedFrameAllocator::~ScopedFrameAllocator()
+	{
+		// Without get_frame_arena(), which would reset the buffer if the frame has advanced.
+		uint64 frame = frame_arena_index.load(std::memory_order_relaxed);
+		uint32 index = (uint32)(frame & 1);
+
+		// Opened on another thread, or in an earlier frame.
+		ASSERT(&arena == &thread_frame_arenas.arenas[index] && thread_frame_arenas.frames[index] == frame);
+
+		--thread_frame_arenas.num_open_scopes;
+	}
 }
\ No newline at end of file
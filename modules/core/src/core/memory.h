@@ -5,6 +5,7 @@
 #include "core_api.h"
 
 #include "core/sync.h"
+#include "core/memory_tracking.h"
 
 #include <rttr/type>
 
@@ -67,15 +68,24 @@ namespace era_engine
 		uint64 before;
 	};
 
+	// Every allocator gets its own lock, also when copied, so that unrelated arenas don't serialize each other.
+	struct AllocatorLock : AdaptiveMutex
+	{
+		AllocatorLock() = default;
+		AllocatorLock(const AllocatorLock&) {}
+		AllocatorLock& operator=(const AllocatorLock&) { return *this; }
+	};
+
 	struct ERA_CORE_API Allocator
 	{
 		Allocator();
-		Allocator(uint64 _minimum_block_size, uint64 _reserve_size);
+		Allocator(uint64 _minimum_block_size, uint64 _reserve_size, MemoryTag _tag = memory_tag_general);
 		Allocator(const Allocator&) = default;
 		Allocator(Allocator&&) = default;
 		~Allocator() { reset(true); }
 
-		void initialize(uint64 _minimum_block_size = 0, uint64 _reserve_size = GB(8));
+		// The reservation and the committed memory are reported under the tag.
+		void initialize(uint64 _minimum_block_size = 0, uint64 _reserve_size = GB(8), MemoryTag _tag = memory_tag_general);
 
 		void ensure_free_size(uint64 size);
 
@@ -134,6 +144,10 @@ namespace era_engine
 		uint64 minimum_block_size = 0;
 
 		uint64 reserve_size = 0;
+
+		MemoryTag tag = memory_tag_general;
+
+		AllocatorLock sync;
 	};
 
 	class ERA_CORE_API ScopedAllocator
@@ -147,4 +161,73 @@ namespace era_engine
 
 		RTTR_ENABLE()
 	};
+
+	/*
+		Per-thread, double buffered scratch memory. Memory allocated from a frame arena stays valid until the end of the next frame.
+		Each thread only ever allocates from its own arenas, and a thread resets its arena the first time it uses it in a new frame,
+		so no other thread ever touches it.
+
+		The arenas belong to threads, not to jobs, which restricts the callers:
+		- Callers must finish in the frame they fetched the arena in: the main thread, and high priority jobs which are waited for
+		  in the same frame. Low priority jobs may run across frame boundaries, so their thread could reset a buffer they still
+		  use. get_frame_arena() asserts that it is not called on a low priority worker.
+		- A job which waits may resume on another thread (see JobHandle::wait_for_completion). Fetch the arena again after a wait.
+		  A ScopedFrameAllocator must not be open across a wait, since it would roll back allocations of the jobs that ran on its
+		  thread in the meantime. This is asserted in the wait and in the scope's destructor.
+	*/
+	NODISCARD ERA_CORE_API Allocator& get_frame_arena();
+
+	// Called once per frame by the main thread.
+	ERA_CORE_API void advance_frame_arenas();
+
+	// True while a ScopedFrameAllocator is open on the calling thread.
+	NODISCARD bool has_open_frame_allocator_scopes();
+
+	// Temporary allocations on the current thread's frame arena, which are released at the end of the scope. Must be closed on the
+	// thread and in the frame it was opened in.
+	class ERA_CORE_API ScopedFrameAllocator : public ScopedAllocator
+	{
+	public:
+		ScopedFrameAllocator();
+		~ScopedFrameAllocator();
+
+		template <typename T>
+		NODISCARD T* allocate(uint32 count = 1, bool clear_to_zero = false)
+		{
+			return arena.allocate<T>(count, clear_to_zero);
+		}
+
+		RTTR_ENABLE(ScopedAllocator)
+	};
+
+	// STL allocator on top of an arena. Deallocation does nothing; the memory is released with the arena.
+	template <typename T>
+	struct ArenaStlAllocator
+	{
+		using value_type = T;
+
+		ArenaStlAllocator(Allocator& _arena) noexcept : arena(&_arena) {}
+
+		template <typename U>
+		ArenaStlAllocator(const ArenaStlAllocator<U>& other) noexcept : arena(other.arena) {}
+
+		NODISCARD T* allocate(size_t count)
+		{
+			return (T*)arena->allocate(sizeof(T) * count, alignof(T));
+		}
+
+		void deallocate(T*, size_t) noexcept {}
+
+		template <typename U>
+		bool operator==(const ArenaStlAllocator<U>& other) const noexcept { return arena == other.arena; }
+
+		template <typename U>
+		bool operator!=(const ArenaStlAllocator<U>& other) const noexcept { return arena != other.arena; }
+
+		Allocator* arena;
+	};
+
+	// Scratch vector for the current frame, e.g. FrameVector<uint32> indices(get_frame_arena());
+	template <typename T>
+	using FrameVector = std::vector<T, ArenaStlAllocator<T>>;
 }
\ No newline at end of file
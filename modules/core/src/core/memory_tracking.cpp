@@ -0,0 +1,193 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#include "core/memory_tracking.h"
+#include "core/memory.h"
+#include "core/log.h"
+#include "core/cpu_profiling.h"
+
+#include <atomic>
+
+namespace era_engine
+{
+	// Zero initialized, so that allocators constructed during static initialization can report.
+	struct MemoryTagCounters
+	{
+		std::atomic<uint64> live_bytes;
+		std::atomic<uint64> peak_live_bytes;
+		std::atomic<int64> committed_bytes;
+		std::atomic<int64> reserved_bytes;
+
+		std::atomic<uint64> num_allocations;
+		std::atomic<uint64> allocated_bytes; // Allocated or newly committed since startup. Drives the allocation rate.
+
+		std::atomic<uint64> budget;
+
+		// Main thread only.
+		uint64 last_allocated_bytes;
+		float allocation_rate;
+		bool over_budget;
+	};
+
+	static MemoryTagCounters memory_tags[memory_tag_count];
+
+#if ENABLE_MEMORY_TRACKING
+
+	// Profile stats keep the label pointers.
+	struct MemoryTagLabels
+	{
+		char live[64];
+		char committed[64];
+		char allocation_rate[64];
+	};
+
+	static MemoryTagLabels memory_tag_labels[memory_tag_count];
+
+	static uint64 get_footprint(const MemoryTagCounters& counters)
+	{
+		int64 committed = counters.committed_bytes.load(std::memory_order_relaxed);
+		return counters.live_bytes.load(std::memory_order_relaxed) + (uint64)max(committed, (int64)0);
+	}
+
+	void track_allocation(MemoryTag tag, uint64 size)
+	{
+		MemoryTagCounters& counters = memory_tags[tag];
+
+		uint64 live = counters.live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+		counters.num_allocations.fetch_add(1, std::memory_order_relaxed);
+		counters.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+		uint64 peak = counters.peak_live_bytes.load(std::memory_order_relaxed);
+		while (live > peak && !counters.peak_live_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed));
+	}
+
+	void track_free(MemoryTag tag, uint64 size)
+	{
+		memory_tags[tag].live_bytes.fetch_sub(size, std::memory_order_relaxed);
+	}
+
+	void track_reserved(MemoryTag tag, int64 delta)
+	{
+		memory_tags[tag].reserved_bytes.fetch_add(delta, std::memory_order_relaxed);
+	}
+
+	void track_committed(MemoryTag tag, int64 delta)
+	{
+		memory_tags[tag].committed_bytes.fetch_add(delta, std::memory_order_relaxed);
+		if (delta > 0)
+		{
+			memory_tags[tag].allocated_bytes.fetch_add(delta, std::memory_order_relaxed);
+		}
+	}
+
+	void update_memory_tracking(float dt)
+	{
+		static bool labels_initialized = false;
+		if (!labels_initialized)
+		{
+			for (uint32 i = 0; i < memory_tag_count; ++i)
+			{
+				MemoryTagLabels& labels = memory_tag_labels[i];
+				snprintf(labels.live, sizeof(labels.live), "%s memory live (MB)", memory_tag_names[i]);
+				snprintf(labels.committed, sizeof(labels.committed), "%s memory committed (MB)", memory_tag_names[i]);
+				snprintf(labels.allocation_rate, sizeof(labels.allocation_rate), "%s allocation rate (MB/s)", memory_tag_names[i]);
+			}
+			labels_initialized = true;
+		}
+
+		for (uint32 i = 0; i < memory_tag_count; ++i)
+		{
+			MemoryTagCounters& counters = memory_tags[i];
+
+			uint64 allocated = counters.allocated_bytes.load(std::memory_order_relaxed);
+			if (dt > 0.f)
+			{
+				counters.allocation_rate = (float)(allocated - counters.last_allocated_bytes) / dt;
+			}
+			counters.last_allocated_bytes = allocated;
+
+			bool over_budget = is_over_memory_budget((MemoryTag)i);
+			if (over_budget && !counters.over_budget)
+			{
+				LOG_WARNING("Memory> %s is over its budget: %llu of %llu bytes.", memory_tag_names[i],
+					get_footprint(counters), counters.budget.load(std::memory_order_relaxed));
+			}
+			counters.over_budget = over_budget;
+
+			MemoryTagStats stats = get_memory_tag_stats((MemoryTag)i);
+			const MemoryTagLabels& labels = memory_tag_labels[i];
+			CPU_PROFILE_STAT(labels.live, (float)stats.live_bytes / MB(1));
+			CPU_PROFILE_STAT(labels.committed, (float)stats.committed_bytes / MB(1));
+			CPU_PROFILE_STAT(labels.allocation_rate, stats.allocation_rate / MB(1));
+		}
+	}
+
+	bool write_memory_snapshot(const fs::path& path)
+	{
+		FILE* file = _wfopen(path.c_str(), L"w");
+		if (!file)
+		{
+			return false;
+		}
+
+		MemoryTagStats total = {};
+
+		fprintf(file, "{\n\t\"tags\": [\n");
+		for (uint32 i = 0; i < memory_tag_count; ++i)
+		{
+			MemoryTagStats stats = get_memory_tag_stats((MemoryTag)i);
+
+			fprintf(file, "\t\t{ \"name\": \"%s\", \"live_bytes\": %llu, \"peak_live_bytes\": %llu, \"committed_bytes\": %llu, "
+				"\"reserved_bytes\": %llu, \"num_allocations\": %llu, \"allocation_rate\": %.1f, \"budget\": %llu, \"over_budget\": %s }%s\n",
+				memory_tag_names[i], stats.live_bytes, stats.peak_live_bytes, stats.committed_bytes, stats.reserved_bytes,
+				stats.num_allocations, stats.allocation_rate, stats.budget, is_over_memory_budget((MemoryTag)i) ? "true" : "false",
+				(i + 1 < memory_tag_count) ? "," : "");
+
+			total.live_bytes += stats.live_bytes;
+			total.committed_bytes += stats.committed_bytes;
+			total.reserved_bytes += stats.reserved_bytes;
+			total.num_allocations += stats.num_allocations;
+			total.allocation_rate += stats.allocation_rate;
+		}
+		fprintf(file, "\t],\n");
+
+		fprintf(file, "\t\"total\": { \"live_bytes\": %llu, \"committed_bytes\": %llu, \"reserved_bytes\": %llu, \"num_allocations\": %llu, "
+			"\"allocation_rate\": %.1f }\n}\n",
+			total.live_bytes, total.committed_bytes, total.reserved_bytes, total.num_allocations, total.allocation_rate);
+
+		fclose(file);
+		return true;
+	}
+
+#endif
+
+	void set_memory_budget(MemoryTag tag, uint64 budget)
+	{
+		memory_tags[tag].budget.store(budget, std::memory_order_relaxed);
+	}
+
+	MemoryTagStats get_memory_tag_stats(MemoryTag tag)
+	{
+		const MemoryTagCounters& counters = memory_tags[tag];
+
+		MemoryTagStats result;
+		result.live_bytes = counters.live_bytes.load(std::memory_order_relaxed);
+		result.peak_live_bytes = counters.peak_live_bytes.load(std::memory_order_relaxed);
+		result.committed_bytes = (uint64)max(counters.committed_bytes.load(std::memory_order_relaxed), (int64)0);
+		result.reserved_bytes = (uint64)max(counters.reserved_bytes.load(std::memory_order_relaxed), (int64)0);
+		result.num_allocations = counters.num_allocations.load(std::memory_order_relaxed);
+		result.allocation_rate = counters.allocation_rate;
+		result.budget = counters.budget.load(std::memory_order_relaxed);
+		return result;
+	}
+
+	bool is_over_memory_budget(MemoryTag tag)
+	{
+#if ENABLE_MEMORY_TRACKING
+		const MemoryTagCounters& counters = memory_tags[tag];
+		uint64 budget = counters.budget.load(std::memory_order_relaxed);
+		return budget != 0 && get_footprint(counters) > budget;
+#else
+		return false;
+#endif
+	}
+}
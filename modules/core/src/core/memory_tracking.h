@@ -0,0 +1,94 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#pragma once
+
+#include "core_api.h"
+
+#include <era_common.h>
+
+namespace era_engine
+{
+	enum MemoryTag
+	{
+		memory_tag_general,
+		memory_tag_rendering,
+		memory_tag_textures,
+		memory_tag_meshes,
+		memory_tag_animation,
+		memory_tag_physics,
+		memory_tag_audio,
+		memory_tag_ecs,
+		memory_tag_frame_arenas,
+
+		memory_tag_count,
+	};
+
+	static const char* memory_tag_names[] =
+	{
+		"General",
+		"Rendering",
+		"Textures",
+		"Meshes",
+		"Animation",
+		"Physics",
+		"Audio",
+		"ECS",
+		"Frame arenas",
+	};
+
+	static_assert(sizeof(memory_tag_names) / sizeof(memory_tag_names[0]) == memory_tag_count);
+
+	/*
+		Memory per subsystem. Heap style allocators (PhysX, asset caches) report live bytes per allocation. Arenas report how much
+		address space they reserve and how much of it is committed, since their individual allocations are never freed. The footprint
+		of a tag, which is checked against its budget, is live plus committed bytes.
+	*/
+	struct ERA_CORE_API MemoryTagStats
+	{
+		uint64 live_bytes;
+		uint64 peak_live_bytes;
+		uint64 committed_bytes;
+		uint64 reserved_bytes;
+
+		uint64 num_allocations; // Since startup.
+		float allocation_rate; // Bytes per second, measured between the last two calls to update_memory_tracking.
+
+		uint64 budget; // Zero, if unlimited.
+	};
+
+#if ENABLE_MEMORY_TRACKING
+
+	ERA_CORE_API void track_allocation(MemoryTag tag, uint64 size);
+	ERA_CORE_API void track_free(MemoryTag tag, uint64 size);
+
+	ERA_CORE_API void track_reserved(MemoryTag tag, int64 delta);
+	ERA_CORE_API void track_committed(MemoryTag tag, int64 delta);
+
+	// Once per frame. Updates allocation rates and warns once whenever a tag goes over its budget.
+	ERA_CORE_API void update_memory_tracking(float dt);
+
+	// Writes the stats of all tags as JSON.
+	ERA_CORE_API bool write_memory_snapshot(const fs::path& path);
+
+#else
+
+	inline void track_allocation(MemoryTag tag, uint64 size) {}
+	inline void track_free(MemoryTag tag, uint64 size) {}
+
+	inline void track_reserved(MemoryTag tag, int64 delta) {}
+	inline void track_committed(MemoryTag tag, int64 delta) {}
+
+	inline void update_memory_tracking(float dt) {}
+
+	inline bool write_memory_snapshot(const fs::path& path) { return false; }
+
+#endif
+
+	// Budgets are kept, even if tracking is disabled, so that code which checks them doesn't need to know.
+	ERA_CORE_API void set_memory_budget(MemoryTag tag, uint64 budget);
+
+	NODISCARD ERA_CORE_API MemoryTagStats get_memory_tag_stats(MemoryTag tag);
+
+	// Always false, if tracking is disabled.
+	NODISCARD ERA_CORE_API bool is_over_memory_budget(MemoryTag tag);
+}
@@ -0,0 +1,172 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#pragma once
+
+#include "core_api.h"
+
+#include "core/random.h"
+#include "core/math_simd.h"
+
+namespace era_engine
+{
+	// Wide versions of the 2D noise functions in random.h. Each lane produces the same hash values as the scalar version, so
+	// results match up to floating point rounding (for non-negative inputs, where frac and x - floor(x) agree).
+
+	template <typename int_t>
+	NODISCARD inline int_t hash_internal(int_t x)
+	{
+		x += (x << 10);
+		x ^= (x >> 6);
+		x += (x << 3);
+		x ^= (x >> 11);
+		x += (x << 15);
+		return x;
+	}
+
+	template <typename float_t, typename int_t>
+	NODISCARD inline float_t float_construct_internal(int_t m)
+	{
+		m = (m & int_t(0x007FFFFF)) | int_t(0x3F800000); // Mantissa bits in [1:2].
+		return reinterpret(m) - float_t(1.f);
+	}
+
+	template <typename float_t, typename int_t>
+	NODISCARD inline float_t random1_internal(float_t x, float_t y)
+	{
+		return float_construct_internal<float_t, int_t>(hash_internal(reinterpret(x) ^ hash_internal(reinterpret(y))));
+	}
+
+	template <typename float_t, typename int_t>
+	NODISCARD inline wN_vec3<float_t> value_noise_internal(wN_vec2<float_t> x)
+	{
+		float_t px = floor(x.x);
+		float_t py = floor(x.y);
+		float_t wx = x.x - px;
+		float_t wy = x.y - py;
+
+		float_t ux = wx * wx * wx * (wx * (wx * 6.f - 15.f) + 10.f);
+		float_t uy = wy * wy * wy * (wy * (wy * 6.f - 15.f) + 10.f);
+		float_t dux = 30.f * wx * wx * (wx * (wx - 2.f) + 1.f);
+		float_t duy = 30.f * wy * wy * (wy * (wy - 2.f) + 1.f);
+
+		float_t px1 = px + 1.f;
+		float_t py1 = py + 1.f;
+
+		float_t a = random1_internal<float_t, int_t>(px, py);
+		float_t b = random1_internal<float_t, int_t>(px1, py);
+		float_t c = random1_internal<float_t, int_t>(px, py1);
+		float_t d = random1_internal<float_t, int_t>(px1, py1);
+
+		float_t k0 = a;
+		float_t k1 = b - a;
+		float_t k2 = c - a;
+		float_t k3 = a - b - c + d;
+
+		float_t value = fmadd(fmadd(ux * uy, k3, fmadd(uy, k2, fmadd(ux, k1, k0))), 2.f, -1.f);
+		float_t derivX = 2.f * dux * fmadd(k3, uy, k1);
+		float_t derivY = 2.f * duy * fmadd(k3, ux, k2);
+
+		return wN_vec3<float_t>(value, derivX, derivY);
+	}
+
+	template <typename float_t, typename int_t>
+	NODISCARD inline wN_vec3<float_t> gradient_noise_internal(wN_vec2<float_t> x)
+	{
+		float_t px = floor(x.x);
+		float_t py = floor(x.y);
+		float_t wx = x.x - px;
+		float_t wy = x.y - py;
+
+		float_t ux = wx * wx * wx * (wx * (wx * 6.f - 15.f) + 10.f);
+		float_t uy = wy * wy * wy * (wy * (wy * 6.f - 15.f) + 10.f);
+		float_t dux = 30.f * wx * wx * (wx * (wx - 2.f) + 1.f);
+		float_t duy = 30.f * wy * wy * (wy * (wy - 2.f) + 1.f);
+
+		// Gradients. Like random2, the x component only depends on the x coordinate of the corner, so four hashes are enough.
+		float_t gx0 = float_construct_internal<float_t, int_t>(hash_internal(reinterpret(px * 15123.6989f)));
+		float_t gx1 = float_construct_internal<float_t, int_t>(hash_internal(reinterpret((px + 1.f) * 15123.6989f)));
+		float_t gy0 = float_construct_internal<float_t, int_t>(hash_internal(reinterpret(py * 6192.234f)));
+		float_t gy1 = float_construct_internal<float_t, int_t>(hash_internal(reinterpret((py + 1.f) * 6192.234f)));
+
+		// Projections. Corners a = (0, 0), b = (1, 0), c = (0, 1), d = (1, 1).
+		float_t wx1 = wx - 1.f;
+		float_t wy1 = wy - 1.f;
+		float_t va = fmadd(gx0, wx, gy0 * wy);
+		float_t vb = fmadd(gx1, wx1, gy0 * wy);
+		float_t vc = fmadd(gx0, wx, gy1 * wy1);
+		float_t vd = fmadd(gx1, wx1, gy1 * wy1);
+
+		// Interpolation.
+		float_t k = va - vb - vc + vd;
+		float_t value = fmadd(ux * uy, k, fmadd(uy, vc - va, fmadd(ux, vb - va, va)));
+
+		// The terms of the gradient interpolation that cancel out because of the shared components are left out.
+		float_t derivX = fmadd(dux, fmadd(uy, k, vb - va), fmadd(ux, gx1 - gx0, gx0));
+		float_t derivY = fmadd(duy, fmadd(ux, k, vc - va), fmadd(uy, gy1 - gy0, gy0));
+
+		return wN_vec3<float_t>(value, derivX, derivY);
+	}
+
+	template <typename float_t, typename noise_func_t>
+	NODISCARD inline wN_vec3<float_t> fbm_internal(noise_func_t noise_func, wN_vec2<float_t> x, uint32 num_octaves, float lacunarity, float gain)
+	{
+		float_t value = float_t::zero();
+		float_t derivX = float_t::zero();
+		float_t derivY = float_t::zero();
+
+		float amplitude = 0.5f;
+		float m = 1.f;
+
+		for (uint32 i = 0; i < num_octaves; ++i)
+		{
+			wN_vec3<float_t> n = noise_func(x);
+
+			value = fmadd(n.x, amplitude, value);				// Accumulate values.
+			derivX = fmadd(n.y, amplitude * m, derivX);			// Accumulate derivatives.
+			derivY = fmadd(n.z, amplitude * m, derivY);
+
+			amplitude *= gain;
+
+			x.x *= lacunarity;
+			x.y *= lacunarity;
+			m *= lacunarity;
+		}
+		return wN_vec3<float_t>(value, derivX, derivY);
+	}
+
+#if defined(SIMD_SSE_2)
+	typedef w4_vec3(*w4_fbm_noise_2D)(w4_vec2);
+
+	NODISCARD inline w4_vec3 value_noise(w4_vec2 x) { return value_noise_internal<w4_float, w4_int>(x); }
+	NODISCARD inline w4_vec3 gradient_noise(w4_vec2 x) { return gradient_noise_internal<w4_float, w4_int>(x); }
+
+	NODISCARD inline w4_vec3 fbm(w4_fbm_noise_2D noise_func, w4_vec2 x, uint32 num_octaves = 6, float lacunarity = 1.98f, float gain = 0.49f)
+	{
+		return fbm_internal<w4_float>(noise_func, x, num_octaves, lacunarity, gain);
+	}
+#endif
+
+#if defined(SIMD_AVX_2)
+	typedef w8_vec3(*w8_fbm_noise_2D)(w8_vec2);
+
+	NODISCARD inline w8_vec3 value_noise(w8_vec2 x) { return value_noise_internal<w8_float, w8_int>(x); }
+	NODISCARD inline w8_vec3 gradient_noise(w8_vec2 x) { return gradient_noise_internal<w8_float, w8_int>(x); }
+
+	NODISCARD inline w8_vec3 fbm(w8_fbm_noise_2D noise_func, w8_vec2 x, uint32 num_octaves = 6, float lacunarity = 1.98f, float gain = 0.49f)
+	{
+		return fbm_internal<w8_float>(noise_func, x, num_octaves, lacunarity, gain);
+	}
+#endif
+
+#if defined(SIMD_AVX_512)
+	typedef w16_vec3(*w16_fbm_noise_2D)(w16_vec2);
+
+	NODISCARD inline w16_vec3 value_noise(w16_vec2 x) { return value_noise_internal<w16_float, w16_int>(x); }
+	NODISCARD inline w16_vec3 gradient_noise(w16_vec2 x) { return gradient_noise_internal<w16_float, w16_int>(x); }
+
+	NODISCARD inline w16_vec3 fbm(w16_fbm_noise_2D noise_func, w16_vec2 x, uint32 num_octaves = 6, float lacunarity = 1.98f, float gain = 0.49f)
+	{
+		return fbm_internal<w16_float>(noise_func, x, num_octaves, lacunarity, gain);
+	}
+#endif
+}
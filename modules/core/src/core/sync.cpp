@@ -0,0 +1,85 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#include "core/sync.h"
+#include "core/cpu_profiling.h"
+
+#define MAX_NUM_LOCK_STATS 64
+
+namespace era_engine
+{
+	struct LockStatsLabels
+	{
+		char acquisitions[64];
+		char contended_acquisitions[64];
+		char wait_time[64];
+	};
+
+	// Slots are never freed, so pointers handed out to locks and labels handed to the profiler stay valid.
+	static LockStats lock_stats[MAX_NUM_LOCK_STATS];
+	static LockStatsLabels lock_stats_labels[MAX_NUM_LOCK_STATS];
+	static std::atomic<uint32> num_lock_stats = 0;
+	static std::mutex lock_stats_mutex;
+
+	LockStats* get_lock_stats(const char* name)
+	{
+		if (!name)
+		{
+			return nullptr;
+		}
+
+		Lock lock{ lock_stats_mutex };
+
+		uint32 count = num_lock_stats.load(std::memory_order_relaxed);
+		for (uint32 i = 0; i < count; ++i)
+		{
+			if (strcmp(lock_stats[i].name, name) == 0)
+			{
+				return &lock_stats[i];
+			}
+		}
+
+		if (count == MAX_NUM_LOCK_STATS)
+		{
+			return nullptr;
+		}
+
+		LockStats& stats = lock_stats[count];
+		stats.name = name;
+
+		LockStatsLabels& labels = lock_stats_labels[count];
+		snprintf(labels.acquisitions, sizeof(labels.acquisitions), "%s lock acquisitions", name);
+		snprintf(labels.contended_acquisitions, sizeof(labels.contended_acquisitions), "%s lock contended", name);
+		snprintf(labels.wait_time, sizeof(labels.wait_time), "%s lock wait (ms)", name);
+
+		// Publishes the slot to report_lock_stats.
+		num_lock_stats.store(count + 1, std::memory_order_release);
+
+		return &stats;
+	}
+
+	void report_lock_stats()
+	{
+		uint64 clock_frequency;
+		QueryPerformanceFrequency((LARGE_INTEGER*)&clock_frequency);
+
+		uint32 count = num_lock_stats.load(std::memory_order_acquire);
+		for (uint32 i = 0; i < count; ++i)
+		{
+			LockStats& stats = lock_stats[i];
+
+			uint32 acquisitions = stats.acquisitions.exchange(0, std::memory_order_relaxed);
+			uint32 contended_acquisitions = stats.contended_acquisitions.exchange(0, std::memory_order_relaxed);
+			uint64 wait_ticks = stats.wait_ticks.exchange(0, std::memory_order_relaxed);
+
+			if (acquisitions == 0)
+			{
+				continue;
+			}
+
+			const LockStatsLabels& labels = lock_stats_labels[i];
+			CPU_PROFILE_STAT(labels.acquisitions, acquisitions);
+			CPU_PROFILE_STAT(labels.contended_acquisitions, contended_acquisitions);
+			CPU_PROFILE_STAT(labels.wait_time, (float)wait_ticks / clock_frequency * 1000.f);
+		}
+	}
+}
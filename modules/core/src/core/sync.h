@@ -4,9 +4,14 @@
 
 #include "core_api.h"
 
+// Force included everywhere. Included explicitly as well, so that this header does not depend on it.
+#include <era_common.h>
+
 #include <atomic>
 #include <mutex>
 
+#include <immintrin.h>
+
 namespace era_engine
 {
 	struct ERA_CORE_API Lock
@@ -24,6 +29,59 @@ namespace era_engine
 		std::mutex& sync;
 	};
 
+	// Contention counters, shared by all locks created with the same name. Reported as CPU_PROFILE_STATs by report_lock_stats.
+	struct ERA_CORE_API LockStats
+	{
+		const char* name;
+		std::atomic<uint32> acquisitions;
+		std::atomic<uint32> contended_acquisitions;
+		std::atomic<uint64> wait_ticks; // QueryPerformanceCounter ticks spent waiting.
+	};
+
+	// Returns the stats for the name, which must outlive the program (usually a string literal). Returns null, if all slots are in use.
+	NODISCARD ERA_CORE_API LockStats* get_lock_stats(const char* name);
+
+	// Emits the counters of all lock stats, which were acquired since the last call, and resets them. Called once per frame.
+	ERA_CORE_API void report_lock_stats();
+
+	inline void spin_pause(uint32 count)
+	{
+		for (uint32 i = 0; i < count; ++i)
+		{
+			_mm_pause();
+		}
+	}
+
+	inline uint64 lock_wait_begin(LockStats* stats)
+	{
+		uint64 start = 0;
+		if (stats)
+		{
+			QueryPerformanceCounter((LARGE_INTEGER*)&start);
+		}
+		return start;
+	}
+
+	inline void lock_wait_end(LockStats* stats, uint64 start)
+	{
+		if (stats)
+		{
+			uint64 end;
+			QueryPerformanceCounter((LARGE_INTEGER*)&end);
+			stats->acquisitions.fetch_add(1, std::memory_order_relaxed);
+			stats->contended_acquisitions.fetch_add(1, std::memory_order_relaxed);
+			stats->wait_ticks.fetch_add(end - start, std::memory_order_relaxed);
+		}
+	}
+
+	inline void lock_acquired_uncontended(LockStats* stats)
+	{
+		if (stats)
+		{
+			stats->acquisitions.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
 	class SpinLock
 	{
 		std::atomic_flag flag;
@@ -31,12 +89,19 @@ namespace era_engine
 	public:
 		void lock()
 		{
-			while (!flag.test_and_set(std::memory_order_acquire));
+			while (flag.test_and_set(std::memory_order_acquire))
+			{
+				// Spin on a plain load, so that waiting threads don't keep stealing the cache line from the owner.
+				while (flag.test(std::memory_order_relaxed))
+				{
+					_mm_pause();
+				}
+			}
 		}
 
 		bool try_lock()
 		{
-			return flag.test_and_set(std::memory_order_acquire);
+			return !flag.test_and_set(std::memory_order_acquire);
 		}
 
 		void unlock() noexcept
@@ -53,4 +118,253 @@ namespace era_engine
 		ScopedSpinLock(SpinLock& _lock) : lock(_lock) { lock.lock(); }
 		~ScopedSpinLock() { lock.unlock(); }
 	};
+
+	// Spins with exponential backoff for a short while, then parks the thread until the owner unlocks. Use this instead of SpinLock
+	// when the lock may be held for longer than a few hundred cycles, or when more threads than cores may wait.
+	class AdaptiveMutex
+	{
+		static constexpr uint32 unlocked = 0;
+		static constexpr uint32 locked = 1;
+		static constexpr uint32 locked_with_waiters = 2;
+
+		static constexpr uint32 max_spin_iterations = 16;
+		static constexpr uint32 max_backoff = 64;
+
+		std::atomic<uint32> state = unlocked;
+		LockStats* stats = nullptr;
+
+	public:
+		AdaptiveMutex() = default;
+		AdaptiveMutex(const char* stats_name) : stats(get_lock_stats(stats_name)) {}
+
+		AdaptiveMutex(const AdaptiveMutex&) = delete;
+		AdaptiveMutex& operator=(const AdaptiveMutex&) = delete;
+
+		void lock()
+		{
+			uint32 expected = unlocked;
+			if (state.compare_exchange_strong(expected, locked, std::memory_order_acquire))
+			{
+				lock_acquired_uncontended(stats);
+				return;
+			}
+
+			uint64 start = lock_wait_begin(stats);
+
+			uint32 backoff = 1;
+			for (uint32 i = 0; i < max_spin_iterations; ++i)
+			{
+				spin_pause(backoff);
+				backoff = min(backoff * 2, max_backoff);
+
+				expected = unlocked;
+				if (state.load(std::memory_order_relaxed) == unlocked
+					&& state.compare_exchange_weak(expected, locked, std::memory_order_acquire))
+				{
+					lock_wait_end(stats, start);
+					return;
+				}
+			}
+
+			// Park. Whoever takes the lock from here on marks it as having waiters, so that unlock wakes the next one.
+			while (state.exchange(locked_with_waiters, std::memory_order_acquire) != unlocked)
+			{
+				state.wait(locked_with_waiters, std::memory_order_relaxed);
+			}
+
+			lock_wait_end(stats, start);
+		}
+
+		bool try_lock()
+		{
+			uint32 expected = unlocked;
+			bool result = state.compare_exchange_strong(expected, locked, std::memory_order_acquire);
+			if (result)
+			{
+				lock_acquired_uncontended(stats);
+			}
+			return result;
+		}
+
+		void unlock() noexcept
+		{
+			if (state.exchange(unlocked, std::memory_order_release) == locked_with_waiters)
+			{
+				state.notify_one();
+			}
+		}
+	};
+
+	// Many readers or one writer. Waiting writers block new readers, so a steady stream of readers can't starve them.
+	class RWSpinLock
+	{
+		static constexpr uint32 writer = 1u << 31;
+		static constexpr uint32 writer_pending = 1u << 30;
+		static constexpr uint32 reader_mask = writer_pending - 1;
+
+		std::atomic<uint32> state = 0;
+		LockStats* stats = nullptr;
+
+	public:
+		RWSpinLock() = default;
+		RWSpinLock(const char* stats_name) : stats(get_lock_stats(stats_name)) {}
+
+		RWSpinLock(const RWSpinLock&) = delete;
+		RWSpinLock& operator=(const RWSpinLock&) = delete;
+
+		void lock()
+		{
+			if (try_lock())
+			{
+				return;
+			}
+
+			uint64 start = lock_wait_begin(stats);
+			while (true)
+			{
+				uint32 current = state.load(std::memory_order_relaxed);
+				if ((current & ~writer_pending) == 0)
+				{
+					// Taking the lock clears the pending flag. Other waiting writers set it again.
+					if (state.compare_exchange_weak(current, writer, std::memory_order_acquire))
+					{
+						break;
+					}
+				}
+				else if (!(current & writer_pending))
+				{
+					state.fetch_or(writer_pending, std::memory_order_relaxed);
+				}
+				_mm_pause();
+			}
+			lock_wait_end(stats, start);
+		}
+
+		bool try_lock()
+		{
+			uint32 expected = 0;
+			bool result = state.compare_exchange_strong(expected, writer, std::memory_order_acquire);
+			if (result)
+			{
+				lock_acquired_uncontended(stats);
+			}
+			return result;
+		}
+
+		void unlock() noexcept
+		{
+			state.fetch_and(~writer, std::memory_order_release);
+		}
+
+		void lock_shared()
+		{
+			if (try_lock_shared())
+			{
+				return;
+			}
+
+			uint64 start = lock_wait_begin(stats);
+			while (true)
+			{
+				uint32 current = state.load(std::memory_order_relaxed);
+				if (!(current & (writer | writer_pending))
+					&& state.compare_exchange_weak(current, current + 1, std::memory_order_acquire))
+				{
+					break;
+				}
+				_mm_pause();
+			}
+			lock_wait_end(stats, start);
+		}
+
+		bool try_lock_shared()
+		{
+			uint32 current = state.load(std::memory_order_relaxed);
+			bool result = !(current & (writer | writer_pending))
+				&& state.compare_exchange_strong(current, current + 1, std::memory_order_acquire);
+			if (result)
+			{
+				lock_acquired_uncontended(stats);
+			}
+			return result;
+		}
+
+		void unlock_shared() noexcept
+		{
+			state.fetch_sub(1, std::memory_order_release);
+		}
+	};
+
+	// FIFO spinlock. Threads get the lock in the order in which they started waiting, which keeps the wait times even. Only use it
+	// for short critical sections with fewer waiters than cores: if the next thread in line is descheduled, everybody waits.
+	class TicketLock
+	{
+		std::atomic<uint32> next_ticket = 0;
+		std::atomic<uint32> now_serving = 0;
+		LockStats* stats = nullptr;
+
+	public:
+		TicketLock() = default;
+		TicketLock(const char* stats_name) : stats(get_lock_stats(stats_name)) {}
+
+		TicketLock(const TicketLock&) = delete;
+		TicketLock& operator=(const TicketLock&) = delete;
+
+		void lock()
+		{
+			uint32 ticket = next_ticket.fetch_add(1, std::memory_order_relaxed);
+			uint32 serving = now_serving.load(std::memory_order_acquire);
+			if (serving == ticket)
+			{
+				lock_acquired_uncontended(stats);
+				return;
+			}
+
+			uint64 start = lock_wait_begin(stats);
+			while (serving != ticket)
+			{
+				// Back off in proportion to the number of threads ahead of us.
+				spin_pause(ticket - serving);
+				serving = now_serving.load(std::memory_order_acquire);
+			}
+			lock_wait_end(stats, start);
+		}
+
+		bool try_lock()
+		{
+			uint32 serving = now_serving.load(std::memory_order_relaxed);
+			uint32 expected = serving;
+			bool result = next_ticket.compare_exchange_strong(expected, serving + 1, std::memory_order_acquire);
+			if (result)
+			{
+				lock_acquired_uncontended(stats);
+			}
+			return result;
+		}
+
+		void unlock() noexcept
+		{
+			now_serving.store(now_serving.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+	};
+
+	template <typename Lock_>
+	class ScopedLock
+	{
+		Lock_& lock;
+
+	public:
+		ScopedLock(Lock_& _lock) : lock(_lock) { lock.lock(); }
+		~ScopedLock() { lock.unlock(); }
+	};
+
+	template <typename Lock_>
+	class ScopedSharedLock
+	{
+		Lock_& lock;
+
+	public:
+		ScopedSharedLock(Lock_& _lock) : lock(_lock) { lock.lock_shared(); }
+		~ScopedSharedLock() { lock.unlock_shared(); }
+	};
 }
\ No newline at end of file
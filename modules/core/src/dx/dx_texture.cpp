@@ -3,8 +3,10 @@
 #include "dx/dx_texture.h"
 #include "dx/dx_context.h"
 #include "dx/dx_command_list.h"
+#include "dx/dx_texture_streaming.h"
 
 #include "core/hash.h"
+#include "core/memory.h"
 
 #include "asset/file_registry.h"
 
@@ -19,10 +21,20 @@ namespace era_engine
 {
 	static void initializeTexture(ref<dx_texture> result, D3D12_RESOURCE_DESC textureDesc, D3D12_SUBRESOURCE_DATA* subresourceData, uint32 numSubresources, D3D12_RESOURCE_STATES initialState = D3D12_RESOURCE_STATE_COMMON, bool mipUAVs = false);
 
-	static void uploadImageToGPU(ref<dx_texture> result, DirectX::ScratchImage& scratchImage, D3D12_RESOURCE_DESC& textureDesc, uint32 flags)
+	// firstMip > 0 uploads only the mips from firstMip of a single 2D image (the mip tail of a streamed texture).
+	static void uploadImageToGPU(ref<dx_texture> result, DirectX::ScratchImage& scratchImage, D3D12_RESOURCE_DESC textureDesc, uint32 flags, uint32 firstMip = 0)
 	{
-		const DirectX::Image* images = scratchImage.GetImages();
-		uint32 numImages = (uint32)scratchImage.GetImageCount();
+		const DirectX::Image* images = scratchImage.GetImages() + firstMip;
+		uint32 numImages = (uint32)scratchImage.GetImageCount() - firstMip;
+
+		if (firstMip > 0)
+		{
+			ASSERT(textureDesc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE2D && textureDesc.DepthOrArraySize == 1 && numImages == textureDesc.MipLevels - firstMip);
+
+			textureDesc.Width = max(1u, (uint32)textureDesc.Width >> firstMip);
+			textureDesc.Height = max(1u, textureDesc.Height >> firstMip);
+			textureDesc.MipLevels = (uint16)numImages;
+		}
 
 		D3D12_SUBRESOURCE_DATA subresources[128];
 		for (uint32 i = 0; i < numImages; ++i)
@@ -45,10 +57,10 @@ namespace era_engine
 		}
 	}
 
-	NODISCARD static ref<dx_texture> uploadImageToGPU(DirectX::ScratchImage& scratchImage, D3D12_RESOURCE_DESC& textureDesc, uint32 flags)
+	NODISCARD static ref<dx_texture> uploadImageToGPU(DirectX::ScratchImage& scratchImage, const D3D12_RESOURCE_DESC& textureDesc, uint32 flags, uint32 firstMip = 0)
 	{
 		ref<dx_texture> result = make_ref<dx_texture>();
-		uploadImageToGPU(result, scratchImage, textureDesc, flags);
+		uploadImageToGPU(result, scratchImage, textureDesc, flags, firstMip);
 		return result;
 	}
 
@@ -65,14 +77,22 @@ namespace era_engine
 		else if (!loadImageFromFile(path, flags, scratchImage, textureDesc))
 			return;
 
-		uploadImageToGPU(result, scratchImage, textureDesc, flags);
+		// Streamed textures start out with their mip tail only.
+		uint32 firstMip = getInitialStreamedMip(path, flags, textureDesc);
+		uploadImageToGPU(result, scratchImage, textureDesc, flags, firstMip);
+		registerStreamedTexture(result, path, flags, textureDesc, firstMip);
 
 		result->loadState.store(AssetLoadState::LOADED, std::memory_order_release);
 	}
 
+	static void updateCachedTextureSize(AssetHandle handle, uint32 flags);
+
 	NODISCARD static ref<dx_texture> loadTextureInternal(const fs::path& path, AssetHandle handle, uint32 flags,
 		bool async, JobHandle parentJob)
 	{
+		// The cache key uses the requested flags.
+		const uint32 cacheFlags = flags;
+
 		if (flags & image_load_flags_gen_mips_on_gpu)
 		{
 			flags &= ~image_load_flags_gen_mips_on_cpu;
@@ -92,11 +112,14 @@ namespace era_engine
 			else if (!loadImageFromFile(path, flags, scratchImage, textureDesc))
 				return 0;
 
-			ref<dx_texture> result = uploadImageToGPU(scratchImage, textureDesc, flags);
+			uint32 firstMip = getInitialStreamedMip(path, flags, textureDesc);
+			ref<dx_texture> result = uploadImageToGPU(scratchImage, textureDesc, flags, firstMip);
 			result->handle = handle;
 			result->flags = flags;
 			result->loadJob = {};
 
+			registerStreamedTexture(result, path, flags, textureDesc, firstMip);
+
 			return result;
 		}
 		else
@@ -116,13 +139,15 @@ namespace era_engine
 				ref<dx_texture> texture;
 				fs::path path;
 				uint32 flags;
+				uint32 cacheFlags;
 			};
 
-			texture_loading_data data = { result, path, flags };
+			texture_loading_data data = { result, path, flags, cacheFlags };
 
 			JobHandle job = low_priority_job_queue.createJob<texture_loading_data>([](texture_loading_data& data, JobHandle)
 				{
 					textureLoaderThread(data.texture, data.path, data.flags);
+					updateCachedTextureSize(data.texture->handle, data.cacheFlags);
 				}, data, parentJob);
 			job.submit_now();
 
@@ -233,8 +258,18 @@ namespace era_engine
 		return a.handle == b.handle && a.flags == b.flags;
 	}
 
-	static std::unordered_map<texture_key, weakref<dx_texture>> textureCache;
-	static std::mutex mutex;
+	static uint64 getTextureMemorySize(const dx_texture& texture)
+	{
+		// Textures that are still loading asynchronously have no allocation yet.
+		return texture.allocation ? texture.allocation->GetSize() : 0;
+	}
+
+	static AssetCache<texture_key, dx_texture> textureCache(getTextureMemorySize, MB(256), memory_tag_textures);
+
+	static void updateCachedTextureSize(AssetHandle handle, uint32 flags)
+	{
+		textureCache.update_size({ handle, flags });
+	}
 
 	NODISCARD static ref<dx_texture> loadTextureFromFileAndHandle(const fs::path& filename, AssetHandle handle, uint32 flags,
 		bool async = false, JobHandle parentJob = {})
@@ -244,15 +279,10 @@ namespace era_engine
 
 		texture_key key = { handle, flags };
 
-		Lock lock{ mutex };
-
-		ref<dx_texture> result = textureCache[key].lock();
-		if (!result)
-		{
-			result = loadTextureInternal(filename, handle, flags, async, parentJob);
-			textureCache[key] = result;
-		}
-		return result;
+		return textureCache.get_or_load(key, [&]()
+			{
+				return loadTextureInternal(filename, handle, flags, async, parentJob);
+			});
 	}
 
 	NODISCARD ref<dx_texture> loadTextureFromFile(const fs::path& filename, uint32 flags)
@@ -283,6 +313,16 @@ namespace era_engine
 		return loadTextureFromFileAndHandle(sceneFilename, handle, flags, true, parentJob);
 	}
 
+	void setTextureCacheBudget(uint64 budget)
+	{
+		textureCache.set_budget(budget);
+	}
+
+	NODISCARD AssetCacheStats getTextureCacheStats()
+	{
+		return textureCache.get_stats();
+	}
+
 	NODISCARD ref<dx_texture> loadTextureFromMemory(const void* ptr, uint32 size, image_format imageFormat, const fs::path& cacheFilename, uint32 flags)
 	{
 		return loadTextureFromMemoryInternal(ptr, size, imageFormat, cacheFilename, flags);
@@ -1218,6 +1258,128 @@ namespace era_engine
 		texture->setName(name);
 	}
 
+	void changeTextureResidentMips(ref<dx_texture> texture, uint32 fullWidth, uint32 fullHeight, uint32 fullNumMips,
+		uint32 currentFirstMip, uint32 newFirstMip, const D3D12_SUBRESOURCE_DATA* fullMipChain)
+	{
+		if (!texture || newFirstMip == currentFirstMip || newFirstMip >= fullNumMips)
+			return;
+
+		ASSERT(newFirstMip > currentFirstMip || fullMipChain);
+
+		wchar name[128];
+		uint32 size = sizeof(name);
+		texture->resource->GetPrivateData(WKPDID_D3DDebugObjectNameW, &size, name);
+		name[min((uint32)arraysize(name) - 1, size)] = 0;
+
+		dx_resource oldResource = texture->resource;
+		D3D12MA::Allocation* oldAllocation = texture->allocation;
+
+		D3D12_RESOURCE_DESC desc = oldResource->GetDesc();
+		ASSERT(desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE2D && desc.DepthOrArraySize == 1);
+
+		desc.Width = max(1u, fullWidth >> newFirstMip);
+		desc.Height = max(1u, fullHeight >> newFirstMip);
+		desc.MipLevels = (uint16)(fullNumMips - newFirstMip);
+
+		dx_resource newResource;
+		D3D12MA::Allocation* newAllocation = 0;
+
+#if !USE_D3D12_BLOCK_ALLOCATOR
+		auto heapDesc = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+		checkResult(dxContext.device->CreateCommittedResource(
+			&heapDesc,
+			D3D12_HEAP_FLAG_NONE,
+			&desc,
+			D3D12_RESOURCE_STATE_COMMON,
+			0,
+			IID_PPV_ARGS(&newResource)
+		));
+#else
+		D3D12MA::ALLOCATION_DESC allocationDesc = {};
+		allocationDesc.HeapType = D3D12_HEAP_TYPE_DEFAULT;
+
+		checkResult(dxContext.memoryAllocator->CreateResource(
+			&allocationDesc,
+			&desc,
+			D3D12_RESOURCE_STATE_COMMON,
+			0,
+			&newAllocation,
+			IID_PPV_ARGS(&newResource)));
+#endif
+
+		dx_command_list* cl = dxContext.getFreeCopyCommandList();
+		cl->transitionBarrier(newResource, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
+
+		// Mips both resources hold are copied on the GPU.
+		for (uint32 mip = max(currentFirstMip, newFirstMip); mip < fullNumMips; ++mip)
+		{
+			CD3DX12_TEXTURE_COPY_LOCATION dest(newResource.Get(), mip - newFirstMip);
+			CD3DX12_TEXTURE_COPY_LOCATION source(oldResource.Get(), mip - currentFirstMip);
+			cl->commandList->CopyTextureRegion(&dest, 0, 0, 0, &source, 0);
+		}
+
+		// Only the missing, more detailed mips are uploaded.
+		if (newFirstMip < currentFirstMip)
+		{
+			uint32 numUploadedMips = currentFirstMip - newFirstMip;
+			uint64 requiredSize = GetRequiredIntermediateSize(newResource.Get(), 0, numUploadedMips);
+
+			dx_resource intermediateResource;
+			auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(requiredSize);
+
+#if !USE_D3D12_BLOCK_ALLOCATOR
+			auto uploadHeapDesc = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+			checkResult(dxContext.device->CreateCommittedResource(
+				&uploadHeapDesc,
+				D3D12_HEAP_FLAG_NONE,
+				&bufferDesc,
+				D3D12_RESOURCE_STATE_GENERIC_READ,
+				0,
+				IID_PPV_ARGS(&intermediateResource)
+			));
+#else
+			D3D12MA::ALLOCATION_DESC uploadAllocationDesc = {};
+			uploadAllocationDesc.HeapType = D3D12_HEAP_TYPE_UPLOAD;
+
+			D3D12MA::Allocation* uploadAllocation;
+			checkResult(dxContext.memoryAllocator->CreateResource(
+				&uploadAllocationDesc,
+				&bufferDesc,
+				D3D12_RESOURCE_STATE_GENERIC_READ,
+				0,
+				&uploadAllocation,
+				IID_PPV_ARGS(&intermediateResource)));
+			dxContext.retire(uploadAllocation);
+#endif
+
+			UpdateSubresources<128>(cl->commandList.Get(), newResource.Get(), intermediateResource.Get(), 0, 0, numUploadedMips, fullMipChain + newFirstMip);
+			dxContext.retire(intermediateResource);
+		}
+
+		dxContext.executeCommandList(cl);
+
+		// The old resource and its descriptors stay alive until the frames in flight are done with them.
+		retire(oldResource, texture->srvUavAllocation, texture->rtvAllocation, texture->dsvAllocation);
+		if (oldAllocation)
+		{
+			dxContext.retire(oldAllocation);
+		}
+
+		texture->resource = newResource;
+		texture->allocation = newAllocation;
+		texture->width = (uint32)desc.Width;
+		texture->height = desc.Height;
+		texture->numMipLevels = desc.MipLevels;
+		texture->requestedNumMipLevels = desc.MipLevels;
+		texture->rtvAllocation = {};
+		texture->dsvAllocation = {};
+
+		texture->srvUavAllocation = dxContext.srvUavAllocator.allocate(1);
+		texture->defaultSRV = dx_cpu_descriptor_handle(texture->srvUavAllocation.cpuAt(0)).create2DTextureSRV(texture);
+
+		texture->setName(name);
+	}
+
 	texture_grave::~texture_grave()
 	{
 		wchar name[128];
@@ -9,6 +9,7 @@
 #include "dx/dx_descriptor_allocation.h"
 
 #include "asset/asset.h"
+#include "asset/asset_cache.h"
 #include "asset/image.h"
 
 namespace era_engine
@@ -55,6 +56,8 @@ namespace era_engine
 		AssetHandle handle;
 		uint32 flags = 0;
 
+		uint32 streamingIndex = UINT32_MAX; // Set if the mips of this texture are streamed (see dx_texture_streaming.h).
+
 		std::atomic<AssetLoadState> loadState = AssetLoadState::LOADED;
 		JobHandle loadJob;
 	};
@@ -133,6 +136,12 @@ namespace era_engine
 	NODISCARD ref<dx_texture> createVolumeTexture(const void* data, uint32 width, uint32 height, uint32 depth, DXGI_FORMAT format, bool allowUnorderedAccess = false, D3D12_RESOURCE_STATES initialState = D3D12_RESOURCE_STATE_COMMON);
 	void resizeTexture(ref<dx_texture> texture, uint32 newWidth, uint32 newHeight, D3D12_RESOURCE_STATES initialState = (D3D12_RESOURCE_STATES)-1);
 
+	// For mip streaming of sampled 2D textures. Replaces the texture's resource, which holds the mips from currentFirstMip of the full
+	// mip chain, with one that holds the mips from newFirstMip. Mips held by both are copied on the GPU, missing ones are uploaded from
+	// fullMipChain (one entry per mip of the full chain, may be null when only dropping mips). Work is submitted to the copy queue.
+	void changeTextureResidentMips(ref<dx_texture> texture, uint32 fullWidth, uint32 fullHeight, uint32 fullNumMips,
+		uint32 currentFirstMip, uint32 newFirstMip, const D3D12_SUBRESOURCE_DATA* fullMipChain);
+
 	NODISCARD ref<dx_texture> createPlacedTexture(dx_heap heap, uint64 offset, uint32 width, uint32 height, DXGI_FORMAT format, bool allocateMips = false, bool allowRenderTarget = false, bool allowUnorderedAccess = false, D3D12_RESOURCE_STATES initialState = D3D12_RESOURCE_STATE_COMMON, bool mipUAVs = false);
 	NODISCARD ref<dx_texture> createPlacedTexture(dx_heap heap, uint64 offset, D3D12_RESOURCE_DESC textureDesc, D3D12_RESOURCE_STATES initialState = D3D12_RESOURCE_STATE_COMMON, bool mipUAVs = false);
 
@@ -142,8 +151,8 @@ namespace era_engine
 	NODISCARD dx_tiled_texture createTiledTexture(D3D12_RESOURCE_DESC textureDesc, D3D12_RESOURCE_STATES initialState = D3D12_RESOURCE_STATE_COMMON, bool mipUAVs = false);
 	NODISCARD dx_tiled_texture createTiledTexture(uint32 width, uint32 height, DXGI_FORMAT format, bool allocateMips = false, bool allowRenderTarget = false, bool allowUnorderedAccess = false, D3D12_RESOURCE_STATES initialState = D3D12_RESOURCE_STATE_COMMON, bool mipUAVs = false);
 
-	// This system caches textures. It does not keep the resource alive (we store weak ptrs).
-	// So if no one else has a reference, the texture gets deleted.
+	// This system caches textures. Recently used textures are kept alive up to the texture cache budget (256 MB by default),
+	// older ones only as long as someone else holds a reference.
 	// This means you should keep a reference to your textures yourself and not call this every frame.
 
 	NODISCARD ref<dx_texture> loadTextureFromFile(const fs::path& filename, uint32 flags = image_load_flags_default);
@@ -151,6 +160,9 @@ namespace era_engine
 	NODISCARD ref<dx_texture> loadTextureFromFileAsync(const fs::path& filename, uint32 flags = image_load_flags_default, JobHandle parentJob = {});
 	NODISCARD ref<dx_texture> loadTextureFromHandleAsync(AssetHandle handle, uint32 flags = image_load_flags_default, JobHandle parentJob = {});
 
+	void setTextureCacheBudget(uint64 budget);
+	NODISCARD AssetCacheStats getTextureCacheStats();
+
 	NODISCARD ref<dx_texture> loadTextureFromMemory(const void* ptr, uint32 size, image_format imageFormat, const fs::path& cacheFilename, uint32 flags = image_load_flags_default);
 	NODISCARD ref<dx_texture> loadVolumeTextureFromDirectory(const fs::path& dirname, uint32 flags = image_load_flags_compress | image_load_flags_cache_to_dds | image_load_flags_noncolor);
 
@@ -0,0 +1,323 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#include "dx/dx_texture_streaming.h"
+#include "dx/dx_texture.h"
+#include "dx/dx_context.h"
+
+#include "core/sync.h"
+#include "core/job_system.h"
+#include "core/cpu_profiling.h"
+
+#include <DirectXTex/DirectXTex.h>
+
+namespace era_engine
+{
+	struct streamed_texture_entry
+	{
+		weakref<dx_texture> texture;
+		fs::path path;
+		uint32 flags = 0;
+
+		uint32 fullWidth = 0;
+		uint32 fullHeight = 0;
+		uint32 numMips = 0;
+
+		// Incremented whenever the slot is reused, so that loads finishing for a removed texture are dropped.
+		uint32 generation = 0;
+		bool active = false;
+	};
+
+	struct pending_streamed_texture
+	{
+		weakref<dx_texture> texture;
+		fs::path path;
+		uint32 flags;
+		D3D12_RESOURCE_DESC fullDesc;
+		uint32 firstResidentMip;
+	};
+
+	struct completed_mip_load
+	{
+		uint32 index;
+		uint32 generation;
+		uint32 firstResidentMip;
+		uint32 previousFirstMip;
+		ref<DirectX::ScratchImage> image; // Mips firstResidentMip..previousFirstMip-1. Null if loading failed.
+	};
+
+	static texture_streaming_manager manager;
+	static std::vector<streamed_texture_entry> entries;
+	static std::vector<texture_streaming_request> requests;
+
+	static std::mutex pendingMutex;
+	static std::vector<pending_streamed_texture> pendingTextures;
+
+	static std::mutex completedMutex;
+	static std::vector<completed_mip_load> completedLoads;
+
+	// Read by loader jobs, only written before any texture is loaded.
+	static uint32 alwaysResidentMips = texture_streaming_settings{}.alwaysResidentMips;
+
+	void initializeTextureStreaming(const texture_streaming_settings& settings)
+	{
+		manager.initialize(settings);
+		alwaysResidentMips = settings.alwaysResidentMips;
+	}
+
+	static bool isStreamable(const fs::path& path, uint32 flags, const D3D12_RESOURCE_DESC& desc)
+	{
+		// Mips generated on the GPU can't be loaded again from file, and missing mips are only ever read from the DDS cache.
+		if (!(flags & image_load_flags_gen_mips_on_cpu) || (flags & image_load_flags_gen_mips_on_gpu) || path.extension() == ".svg")
+			return false;
+
+		if (!(flags & image_load_flags_cache_to_dds) || (flags & image_load_flags_always_load_from_source))
+			return false;
+
+		if (desc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D || desc.DepthOrArraySize != 1 || desc.MipLevels <= 1)
+			return false;
+
+		// Every mip of a block compressed texture must stay a multiple of the block size when it becomes the most detailed one.
+		if (!is_power_of_two((uint32)desc.Width) || !is_power_of_two(desc.Height))
+			return false;
+
+		return true;
+	}
+
+	uint32 getInitialStreamedMip(const fs::path& path, uint32 flags, const D3D12_RESOURCE_DESC& fullDesc)
+	{
+		if (!isStreamable(path, flags, fullDesc) || fullDesc.MipLevels <= alwaysResidentMips)
+			return 0;
+
+		uint32 firstMip = fullDesc.MipLevels - alwaysResidentMips;
+
+		// The tail's most detailed mip must still be a whole block in both dimensions.
+		while (firstMip > 0 && (min((uint32)fullDesc.Width, fullDesc.Height) >> firstMip) < 4)
+		{
+			--firstMip;
+		}
+		return firstMip;
+	}
+
+	void registerStreamedTexture(const ref<dx_texture>& texture, const fs::path& path, uint32 flags, const D3D12_RESOURCE_DESC& fullDesc, uint32 firstResidentMip)
+	{
+		if (!texture || !texture->resource)
+			return;
+
+		if (!isStreamable(path, flags, fullDesc))
+		{
+			ASSERT(firstResidentMip == 0);
+			return;
+		}
+
+		Lock lock{ pendingMutex };
+		pendingTextures.push_back({ texture, path, flags, fullDesc, firstResidentMip });
+	}
+
+	void requestTextureDetail(const ref<dx_texture>& texture, float uvPerPixel)
+	{
+		if (!texture || texture->streamingIndex == UINT32_MAX)
+			return;
+
+		const streamed_texture_entry& entry = entries[texture->streamingIndex];
+		uint32 mip = texture_streaming_manager::computeRequiredMip(max(entry.fullWidth, entry.fullHeight), uvPerPixel, entry.numMips);
+		manager.requestMip(texture->streamingIndex, mip);
+	}
+
+	static void removeStreamedTexture(uint32 index)
+	{
+		streamed_texture_entry& entry = entries[index];
+		if (ref<dx_texture> texture = entry.texture.lock())
+		{
+			texture->streamingIndex = UINT32_MAX;
+		}
+
+		manager.removeTexture(index);
+
+		entry.texture.reset();
+		entry.path.clear();
+		entry.active = false;
+		++entry.generation;
+	}
+
+	static void addPendingTextures()
+	{
+		std::vector<pending_streamed_texture> textures;
+		{
+			Lock lock{ pendingMutex };
+			textures.swap(pendingTextures);
+		}
+
+		for (pending_streamed_texture& pending : textures)
+		{
+			ref<dx_texture> texture = pending.texture.lock();
+			if (!texture || texture->streamingIndex != UINT32_MAX)
+				continue;
+
+			const D3D12_RESOURCE_DESC& desc = pending.fullDesc;
+			uint32 numMips = desc.MipLevels;
+
+			D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprints[D3D12_REQ_MIP_LEVELS];
+			uint32 numRows[D3D12_REQ_MIP_LEVELS];
+			uint64 rowSizes[D3D12_REQ_MIP_LEVELS];
+			dxContext.device->GetCopyableFootprints(&desc, 0, numMips, 0, footprints, numRows, rowSizes, 0);
+
+			uint64 mipSizes[D3D12_REQ_MIP_LEVELS];
+			for (uint32 mip = 0; mip < numMips; ++mip)
+			{
+				mipSizes[mip] = numRows[mip] * rowSizes[mip];
+			}
+
+			uint32 index = manager.addTexture(numMips, mipSizes, pending.firstResidentMip);
+			if (index >= entries.size())
+			{
+				entries.resize(index + 1);
+			}
+
+			streamed_texture_entry& entry = entries[index];
+			entry.texture = texture;
+			entry.path = std::move(pending.path);
+			entry.flags = pending.flags;
+			entry.fullWidth = (uint32)desc.Width;
+			entry.fullHeight = desc.Height;
+			entry.numMips = numMips;
+			entry.active = true;
+
+			texture->streamingIndex = index;
+		}
+	}
+
+	static bool applyCompletedLoads()
+	{
+		std::vector<completed_mip_load> loads;
+		{
+			Lock lock{ completedMutex };
+			loads.swap(completedLoads);
+		}
+
+		bool changed = false;
+		for (completed_mip_load& load : loads)
+		{
+			streamed_texture_entry& entry = entries[load.index];
+			if (!entry.active || entry.generation != load.generation)
+				continue;
+
+			ref<dx_texture> texture = entry.texture.lock();
+			if (!texture || !load.image)
+			{
+				// Stop streaming this texture, it keeps the mips it has.
+				removeStreamedTexture(load.index);
+				continue;
+			}
+
+			const DirectX::Image* images = load.image->GetImages();
+			uint32 numImages = (uint32)load.image->GetImageCount();
+			uint32 currentFirstMip = entry.numMips - texture->numMipLevels;
+			if (numImages != load.previousFirstMip - load.firstResidentMip || currentFirstMip != load.previousFirstMip)
+			{
+				removeStreamedTexture(load.index);
+				continue;
+			}
+
+			// Indexed by mip of the full chain, only the loaded mips are read.
+			D3D12_SUBRESOURCE_DATA subresources[D3D12_REQ_MIP_LEVELS] = {};
+			for (uint32 i = 0; i < numImages; ++i)
+			{
+				D3D12_SUBRESOURCE_DATA& subresource = subresources[load.firstResidentMip + i];
+				subresource.RowPitch = images[i].rowPitch;
+				subresource.SlicePitch = images[i].slicePitch;
+				subresource.pData = images[i].pixels;
+			}
+
+			changeTextureResidentMips(texture, entry.fullWidth, entry.fullHeight, entry.numMips, currentFirstMip, load.firstResidentMip, subresources);
+			manager.completeRequest(load.index, load.firstResidentMip);
+			changed = true;
+		}
+		return changed;
+	}
+
+	// Loads only the missing mips firstResidentMip..previousFirstMip-1.
+	static void loadMipsAsync(uint32 index, uint32 firstResidentMip, uint32 previousFirstMip)
+	{
+		const streamed_texture_entry& entry = entries[index];
+
+		struct mip_loading_data
+		{
+			uint32 index;
+			uint32 generation;
+			uint32 firstResidentMip;
+			uint32 previousFirstMip;
+			uint32 flags;
+			fs::path path;
+		};
+
+		mip_loading_data data = { index, entry.generation, firstResidentMip, previousFirstMip, entry.flags, entry.path };
+
+		JobHandle job = low_priority_job_queue.createJob<mip_loading_data>([](mip_loading_data& data, JobHandle)
+			{
+				ref<DirectX::ScratchImage> image = make_ref<DirectX::ScratchImage>();
+				if (!loadImageMipsFromCache(data.path, data.flags, data.firstResidentMip, data.previousFirstMip - data.firstResidentMip, *image))
+				{
+					image = nullptr;
+				}
+
+				Lock lock{ completedMutex };
+				completedLoads.push_back({ data.index, data.generation, data.firstResidentMip, data.previousFirstMip, std::move(image) });
+			}, data);
+		job.submit_now();
+	}
+
+	void updateTextureStreaming()
+	{
+		CPU_PROFILE_BLOCK("Update texture streaming");
+
+		bool changed = applyCompletedLoads();
+
+		for (uint32 i = 0; i < (uint32)entries.size(); ++i)
+		{
+			if (entries[i].active && entries[i].texture.expired())
+			{
+				removeStreamedTexture(i);
+			}
+		}
+
+		addPendingTextures();
+
+		requests.clear();
+		manager.update(requests);
+
+		for (const texture_streaming_request& request : requests)
+		{
+			if (request.firstResidentMip > request.previousFirstMip)
+			{
+				// Dropping mips needs no data, the remaining ones are copied on the GPU.
+				const streamed_texture_entry& entry = entries[request.texture];
+				ref<dx_texture> texture = entry.texture.lock();
+				if (texture)
+				{
+					changeTextureResidentMips(texture, entry.fullWidth, entry.fullHeight, entry.numMips, request.previousFirstMip, request.firstResidentMip, 0);
+					changed = true;
+				}
+				manager.completeRequest(request.texture, texture ? request.firstResidentMip : request.previousFirstMip);
+			}
+			else
+			{
+				loadMipsAsync(request.texture, request.firstResidentMip, request.previousFirstMip);
+			}
+		}
+
+		if (changed)
+		{
+			dxContext.renderQueue.waitForOtherQueue(dxContext.copyQueue);
+		}
+	}
+
+	void setTextureStreamingBudget(uint64 budget)
+	{
+		manager.setBudget(budget);
+	}
+
+	texture_streaming_stats getTextureStreamingStats()
+	{
+		return manager.getStats();
+	}
+}
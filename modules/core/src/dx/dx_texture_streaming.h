@@ -0,0 +1,37 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#pragma once
+
+#include "core_api.h"
+
+#include "rendering/texture_streaming.h"
+
+#include <dx/d3dx12.h>
+
+namespace era_engine
+{
+	struct dx_texture;
+
+	// Mip streaming for textures loaded from file. Streamed textures start out with only their mip tail (alwaysResidentMips). Once per
+	// frame, renderers report how much detail they need (requestTextureDetail), and updateTextureStreaming loads the missing mips in the
+	// background, reading only those mips from the image's DDS cache, and drops mips that are not needed when the budget is exceeded.
+
+	void initializeTextureStreaming(const texture_streaming_settings& settings = {});
+
+	// Called by the texture loader before uploading. Returns the first mip of the full chain to upload: the start of the mip tail for
+	// textures that can be streamed (2D, power of two, mips generated on the CPU and cached as DDS), 0 for all others. Thread safe.
+	NODISCARD uint32 getInitialStreamedMip(const fs::path& path, uint32 flags, const D3D12_RESOURCE_DESC& fullDesc);
+
+	// Called by the texture loader after uploading the mips from firstResidentMip (see getInitialStreamedMip) of the full chain described
+	// by fullDesc. Textures that can't be streamed are ignored. Thread safe.
+	void registerStreamedTexture(const ref<dx_texture>& texture, const fs::path& path, uint32 flags, const D3D12_RESOURCE_DESC& fullDesc, uint32 firstResidentMip);
+
+	// uvPerPixel is the distance in texture coordinates between two neighboring screen pixels. Call from the main thread only.
+	void requestTextureDetail(const ref<dx_texture>& texture, float uvPerPixel);
+
+	// Call once per frame from the main thread, before rendering.
+	void updateTextureStreaming();
+
+	void setTextureStreamingBudget(uint64 budget);
+	NODISCARD texture_streaming_stats getTextureStreamingStats();
+}
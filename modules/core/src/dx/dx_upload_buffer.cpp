@@ -115,6 +115,6 @@ namespace era_engine
 	void dx_page_pool::initialize(uint32 sizeInBytes)
 	{
 		pageSize = sizeInBytes;
-		arena.initialize(0, sizeof(dx_page) * 512);
+		arena.initialize(0, sizeof(dx_page) * 512, memory_tag_rendering);
 	}
 }
\ No newline at end of file
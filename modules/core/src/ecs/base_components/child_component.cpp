@@ -9,6 +9,8 @@ namespace era_engine
 	RTTR_REGISTRATION
 	{
 		using namespace rttr;
+		impl::ensure_component_type_registered<ChildComponent>();
+
 		rttr::registration::class_<ChildComponent>("ChildComponent")
 			.constructor<ref<Entity::EcsData>, weakref<Entity::EcsData>>()
 			.property("parent", &ChildComponent::parent);
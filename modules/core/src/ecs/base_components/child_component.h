@@ -9,7 +9,7 @@ namespace era_engine
 	class ERA_CORE_API ChildComponent final : public Component
 	{
 	public:
-		ChildComponent(ref<Entity::EcsData> _data, weakref<Entity::EcsData> _parent);
+		ChildComponent(ref<Entity::EcsData> _data, weakref<Entity::EcsData> _parent = {});
 		~ChildComponent() override;
 
 		virtual void release() override;
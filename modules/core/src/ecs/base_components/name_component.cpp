@@ -8,6 +8,8 @@ namespace era_engine
 	RTTR_REGISTRATION
 	{
 		using namespace rttr;
+		impl::ensure_component_type_registered<NameComponent>();
+
 		rttr::registration::class_<NameComponent>("NameComponent")
 			.constructor<ref<Entity::EcsData>, const char*>()
 			.property("name", &NameComponent::name);
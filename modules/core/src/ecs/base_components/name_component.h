@@ -11,7 +11,7 @@ namespace era_engine
 	{
 	public:
 		NameComponent() = default;
-		NameComponent(ref<Entity::EcsData> _data, const char* n);
+		NameComponent(ref<Entity::EcsData> _data, const char* n = "");
 
 		~NameComponent() override;
 
@@ -14,6 +14,8 @@ namespace era_engine
 				value("DYNAMIC", TransformComponent::DYNAMIC)
 			);
 
+		impl::ensure_component_type_registered<TransformComponent>();
+
 		rttr::registration::class_<TransformComponent>("TransformComponent")
 			.constructor<ref<Entity::EcsData>, const trs&>()
 			.constructor<ref<Entity::EcsData>, const trs&, TransformComponent::TransformType>()
@@ -0,0 +1,362 @@
+#include "ecs/command_buffer.h"
+#include "ecs/world.h"
+#include "ecs/base_components/base_components.h"
+
+#include "core/cpu_profiling.h"
+#include "core/job_system.h"
+#include "core/log.h"
+
+#include <algorithm>
+
+namespace era_engine
+{
+	namespace impl
+	{
+		uint32 next_command_type_id()
+		{
+			static std::atomic<uint32> counter = 0;
+			return counter++;
+		}
+	}
+
+	ref<Entity::EcsData> CommandBuffer::PlaybackContext::resolve(const Target& target) const
+	{
+		if (target.handle != Entity::NullHandle)
+		{
+			auto& entity_datas = world->world_data->entity_datas;
+			auto it = entity_datas.find(target.handle);
+			return (it != entity_datas.end()) ? it->second : nullptr;
+		}
+
+		const DeferredEntity& deferred = target.deferred;
+		if (deferred.generation == generation)
+		{
+			ASSERT(deferred.lane < (uint32)created.size() && deferred.index < (uint32)created[deferred.lane].size());
+			return created[deferred.lane][deferred.index];
+		}
+
+		// Created by the previous playback, while the recording job was still running.
+		ASSERT(deferred.generation + 1 == generation);
+		const auto& previous = *previously_created;
+		if (deferred.generation + 1 != generation || deferred.lane >= (uint32)previous.size() || deferred.index >= (uint32)previous[deferred.lane].size())
+		{
+			return nullptr;
+		}
+		return previous[deferred.lane][deferred.index].lock();
+	}
+
+	static uint32 get_num_command_lanes()
+	{
+		// Job threads are numbered 1..n, everything else shares lane 0.
+		return max(get_num_job_threads(), std::thread::hardware_concurrency() * 2 + 1);
+	}
+
+	CommandBuffer::CommandBuffer(World* _world)
+		: world(_world), lanes(get_num_command_lanes()), playback_lanes(lanes.size())
+	{
+	}
+
+	CommandBuffer::~CommandBuffer()
+	{
+		for (uint32 i = 0; i < (uint32)lanes.size(); ++i)
+		{
+			for (ComponentCommandsBase* commands : lanes[i].commands.component_commands)
+			{
+				delete commands;
+			}
+			for (ComponentCommandsBase* commands : playback_lanes[i].component_commands)
+			{
+				delete commands;
+			}
+		}
+	}
+
+	CommandBuffer::Lane& CommandBuffer::acquire_lane()
+	{
+		uint32 index = get_job_thread_index();
+		Lane& lane = (index < (uint32)lanes.size()) ? lanes[index] : lanes[0];
+		lane.lock.lock();
+		return lane;
+	}
+
+	void CommandBuffer::release_lane(Lane& lane)
+	{
+		lane.lock.unlock();
+	}
+
+	bool CommandBuffer::swap_lanes()
+	{
+		// All locks at once, so that the swap is atomic for a job recording into several lanes (e.g. after migrating threads).
+		for (Lane& lane : lanes)
+		{
+			lane.lock.lock();
+		}
+
+		bool any = false;
+		for (uint32 i = 0; i < (uint32)lanes.size(); ++i)
+		{
+			// The playback lane was cleared by the previous playback, but keeps its capacity and command objects for reuse.
+			std::swap(lanes[i].commands, playback_lanes[i]);
+			any |= (playback_lanes[i].num_commands > 0);
+		}
+		++generation;
+
+		for (Lane& lane : lanes)
+		{
+			lane.lock.unlock();
+		}
+		return any;
+	}
+
+	CommandBuffer::DeferredEntity CommandBuffer::create_entity(const char* _name)
+	{
+		Lane& lane = acquire_lane();
+
+		DeferredEntity result;
+		result.lane = (uint32)(&lane - lanes.data());
+		result.index = (uint32)lane.commands.created_names.size();
+		result.generation = generation;
+
+		lane.commands.created_names.emplace_back(_name ? _name : "");
+		++lane.commands.num_commands;
+
+		release_lane(lane);
+		return result;
+	}
+
+	void CommandBuffer::destroy_entity(Entity::Handle _handle)
+	{
+		if (_handle == Entity::NullHandle)
+		{
+			return;
+		}
+
+		Lane& lane = acquire_lane();
+		lane.commands.destroyed.push_back(_handle);
+		++lane.commands.num_commands;
+		release_lane(lane);
+	}
+
+	void CommandBuffer::playback()
+	{
+		// The deferred entities of the previous playback stay resolvable for exactly one more playback.
+		const uint32 playback_generation = generation;
+		if (!swap_lanes())
+		{
+			previously_created.clear();
+			return;
+		}
+
+		CPU_PROFILE_BLOCK("ECS command buffer playback");
+
+		PlaybackContext context;
+		context.world = world;
+		context.registry = &world->get_registry();
+		context.created.resize(lanes.size());
+		context.previously_created = &previously_created;
+		context.generation = playback_generation;
+
+		play_creations(context);
+
+		uint32 num_command_types = 0;
+		for (const LaneCommands& lane : playback_lanes)
+		{
+			num_command_types = max(num_command_types, (uint32)lane.component_commands.size());
+		}
+
+		// All adds first, then all removes. Within a pass, one component type at a time across all lanes.
+		for (uint32 pass = 0; pass < 2; ++pass)
+		{
+			const bool removes = (pass == 1);
+
+			for (uint32 id = 0; id < num_command_types; ++id)
+			{
+				uint32 count = 0;
+				ComponentCommandsBase* first = nullptr;
+				for (LaneCommands& lane : playback_lanes)
+				{
+					if (id < (uint32)lane.component_commands.size() && lane.component_commands[id] && lane.component_commands[id]->removes == removes)
+					{
+						first = first ? first : lane.component_commands[id];
+						count += lane.component_commands[id]->size();
+					}
+				}
+
+				if (count == 0)
+				{
+					continue;
+				}
+
+				first->reserve(context, count);
+
+				for (LaneCommands& lane : playback_lanes)
+				{
+					if (id < (uint32)lane.component_commands.size() && lane.component_commands[id] && lane.component_commands[id]->removes == removes)
+					{
+						lane.component_commands[id]->playback(context);
+						lane.component_commands[id]->clear();
+					}
+				}
+			}
+		}
+
+		play_destructions(context);
+
+		for (LaneCommands& lane : playback_lanes)
+		{
+			lane.created_names.clear();
+			lane.destroyed.clear();
+			lane.num_commands = 0;
+		}
+
+		previously_created.resize(context.created.size());
+		for (uint32 i = 0; i < (uint32)context.created.size(); ++i)
+		{
+			previously_created[i].assign(context.created[i].begin(), context.created[i].end());
+		}
+	}
+
+	void CommandBuffer::play_creations(PlaybackContext& context)
+	{
+		uint32 num_created = 0;
+		for (const LaneCommands& lane : playback_lanes)
+		{
+			num_created += (uint32)lane.created_names.size();
+		}
+
+		if (num_created == 0)
+		{
+			return;
+		}
+
+		entt::registry& registry = *context.registry;
+
+		std::vector<Entity::Handle> handles(num_created);
+		registry.create(handles.begin(), handles.end());
+
+		impl::ensure_component_type_registered<TransformComponent>();
+		impl::ensure_component_type_registered<ChildComponent>();
+		impl::ensure_component_type_registered<NameComponent>();
+
+		registry.storage<TransformComponent>().reserve(registry.storage<TransformComponent>().size() + num_created);
+		registry.storage<ChildComponent>().reserve(registry.storage<ChildComponent>().size() + num_created);
+
+		World::WorldData& world_data = *world->world_data;
+		weakref<Entity::EcsData> root_data = world_data.root_entity.get_data_weakref();
+
+		{
+			// One lock for the whole batch instead of one per entity.
+			Lock _lock{ world_data.sync };
+			world_data.entity_datas.reserve(world_data.entity_datas.size() + num_created);
+
+			uint32 next = 0;
+			for (uint32 lane_index = 0; lane_index < (uint32)lanes.size(); ++lane_index)
+			{
+				const LaneCommands& lane = playback_lanes[lane_index];
+				std::vector<ref<Entity::EcsData>>& created = context.created[lane_index];
+				created.reserve(lane.created_names.size());
+
+				for (uint32 i = 0; i < (uint32)lane.created_names.size(); ++i)
+				{
+					ref<Entity::EcsData> data = make_ref<Entity::EcsData>(handles[next++], world, &registry);
+					world_data.entity_datas.emplace(data->entity_handle, data);
+					created.push_back(data);
+				}
+			}
+		}
+
+		// Base components per type, so that each pool is filled in one go.
+		for (const std::vector<ref<Entity::EcsData>>& created : context.created)
+		{
+			for (const ref<Entity::EcsData>& data : created)
+			{
+				registry.emplace<TransformComponent>(data->entity_handle, data);
+			}
+		}
+
+		for (const std::vector<ref<Entity::EcsData>>& created : context.created)
+		{
+			for (const ref<Entity::EcsData>& data : created)
+			{
+				registry.emplace<ChildComponent>(data->entity_handle, data, root_data);
+			}
+		}
+
+		for (uint32 lane_index = 0; lane_index < (uint32)lanes.size(); ++lane_index)
+		{
+			const LaneCommands& lane = playback_lanes[lane_index];
+			for (uint32 i = 0; i < (uint32)lane.created_names.size(); ++i)
+			{
+				if (!lane.created_names[i].empty())
+				{
+					const ref<Entity::EcsData>& data = context.created[lane_index][i];
+					registry.emplace<NameComponent>(data->entity_handle, data, lane.created_names[i].c_str());
+				}
+			}
+		}
+	}
+
+	void CommandBuffer::play_destructions(PlaybackContext& context)
+	{
+		std::vector<Entity::Handle> handles;
+		for (const LaneCommands& lane : playback_lanes)
+		{
+			handles.insert(handles.end(), lane.destroyed.begin(), lane.destroyed.end());
+		}
+
+		if (handles.empty())
+		{
+			return;
+		}
+
+		entt::registry& registry = *context.registry;
+
+		// Children are destroyed with their parents, same as World::destroy_entity.
+		for (uint32 i = 0; i < (uint32)handles.size(); ++i)
+		{
+			for (const Entity::Handle child : EntityContainer::get_childs(handles[i]))
+			{
+				handles.push_back(child);
+			}
+		}
+
+		std::sort(handles.begin(), handles.end());
+		handles.erase(std::unique(handles.begin(), handles.end()), handles.end());
+		handles.erase(std::remove_if(handles.begin(), handles.end(), [&](Entity::Handle handle) { return !registry.valid(handle); }), handles.end());
+
+		// Walk every storage once for the whole batch, instead of once per entity.
+		for (auto&& [id, storage] : registry.storage())
+		{
+			const impl::ComponentTypeInfo* info = impl::find_component_type(storage.type().hash());
+			if (!info)
+			{
+				// Every component type registers itself in its RTTR registration, so this is a pool emplaced around Entity.
+				LOG_WARNING("ECS> Component pool '%.*s' is not registered, its components are not released", (int)storage.type().name().size(), storage.type().name().data());
+				continue;
+			}
+			if (!info->releasable)
+			{
+				continue;
+			}
+
+			for (Entity::Handle handle : handles)
+			{
+				if (storage.contains(handle))
+				{
+					IReleasable* component = reinterpret_cast<IReleasable*>(storage.get(handle));
+					ASSERT(component != nullptr);
+					component->release();
+				}
+			}
+		}
+
+		registry.destroy(handles.begin(), handles.end());
+
+		World::WorldData& world_data = *world->world_data;
+		Lock _data_lock{ world_data.sync };
+		for (Entity::Handle handle : handles)
+		{
+			world_data.entity_datas.erase(handle);
+		}
+	}
+}
@@ -0,0 +1,268 @@
+#pragma once
+
+#include "core_api.h"
+
+#include "core/sync.h"
+
+#include "ecs/entity.h"
+
+#include <tuple>
+
+namespace era_engine
+{
+	class World;
+
+	// Records structural changes (entity creation and destruction, component adds and removes) from any thread and applies them in
+	// bulk at a sync point. Every job thread records into its own lane, guarded by a spin lock that is only contended while playback
+	// swaps the lane out. Threads that are not job threads share lane 0.
+	//
+	// Lanes are double buffered: playback swaps every lane with an empty one under the lane locks and then applies the swapped-out
+	// commands without holding any lock. Jobs that keep recording during playback (e.g. low priority streaming jobs) land in the next
+	// playback.
+	//
+	// Playback order: creations, component adds, component removes, destructions. Commands of one type are applied together, so each
+	// component pool is resized once and touched in one pass. Recording order is NOT preserved, not even per entity: a remove followed
+	// by an add of the same component type in one playback leaves the entity without the component (the add is skipped, because the
+	// component still exists, and then the remove runs). Record such a re-add after the next playback instead.
+	class ERA_CORE_API CommandBuffer final
+	{
+	public:
+		// Entity that only exists once the buffer is played back. Can be used as the target of add_component until the second
+		// playback after its creation, so a recording job that straddles one playback still resolves it.
+		struct DeferredEntity
+		{
+			uint32 lane = 0;
+			uint32 index = UINT32_MAX;
+			uint32 generation = 0;
+		};
+
+		// Either an existing entity or a deferred one.
+		struct Target
+		{
+			Target(Entity::Handle _handle) : handle(_handle) {}
+			Target(const Entity& _entity) : handle(_entity.get_handle()) {}
+			Target(DeferredEntity _deferred) : deferred(_deferred) {}
+
+			Entity::Handle handle = Entity::NullHandle;
+			DeferredEntity deferred;
+		};
+
+		struct PlaybackContext;
+
+		struct ComponentCommandsBase
+		{
+			virtual ~ComponentCommandsBase() = default;
+
+			virtual uint32 size() const = 0;
+			virtual void reserve(PlaybackContext& context, uint32 count) = 0;
+			virtual void playback(PlaybackContext& context) = 0;
+			virtual void clear() = 0;
+
+			bool removes = false;
+		};
+
+		CommandBuffer(World* _world);
+		~CommandBuffer();
+
+		CommandBuffer(const CommandBuffer&) = delete;
+		CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+		DeferredEntity create_entity(const char* _name = nullptr);
+
+		void destroy_entity(Entity::Handle _handle);
+
+		template <typename Component_, typename... Args_>
+		void add_component(Target _target, Args_&&... args);
+
+		template <typename Component_>
+		void remove_component(Entity::Handle _handle);
+
+		// Main thread only. May run concurrently with recording, see above.
+		void playback();
+
+	private:
+		struct LaneCommands
+		{
+			std::vector<std::string> created_names; // One per deferred entity, empty if unnamed.
+			std::vector<Entity::Handle> destroyed;
+			std::vector<ComponentCommandsBase*> component_commands; // Indexed by command type id.
+			uint32 num_commands = 0;
+		};
+
+		struct Lane
+		{
+			SpinLock lock;
+			LaneCommands commands;
+		};
+
+		template <typename Commands_>
+		Commands_& get_commands(LaneCommands& lane);
+
+		// Locks the lane of the calling thread. Recording must not wait on jobs while holding it.
+		Lane& acquire_lane();
+		void release_lane(Lane& lane);
+
+		// Swaps every recording lane with its playback lane. Returns true if anything was recorded.
+		bool swap_lanes();
+
+		void play_creations(PlaybackContext& context);
+		void play_destructions(PlaybackContext& context);
+
+		World* world = nullptr;
+
+		std::vector<Lane> lanes;
+		std::vector<LaneCommands> playback_lanes;
+
+		// Incremented by every swap, while all lane locks are held.
+		uint32 generation = 0;
+
+		// Entities created by the previous playback, to resolve deferred entities recorded before it.
+		std::vector<std::vector<weakref<Entity::EcsData>>> previously_created;
+	};
+
+	namespace impl
+	{
+		ERA_CORE_API uint32 next_command_type_id();
+
+		template <typename Commands_>
+		inline uint32 command_type_id()
+		{
+			static const uint32 id = next_command_type_id();
+			return id;
+		}
+	}
+
+	struct CommandBuffer::PlaybackContext
+	{
+		World* world;
+		entt::registry* registry;
+
+		// Per lane, the entities created for the deferred entities of that lane.
+		std::vector<std::vector<ref<Entity::EcsData>>> created;
+		const std::vector<std::vector<weakref<Entity::EcsData>>>* previously_created;
+		uint32 generation;
+
+		ref<Entity::EcsData> resolve(const Target& target) const;
+	};
+
+	template <typename Component_, typename... Args_>
+	struct AddComponentCommands final : CommandBuffer::ComponentCommandsBase
+	{
+		struct Command
+		{
+			CommandBuffer::Target target;
+			std::tuple<Args_...> args;
+		};
+
+		uint32 size() const override { return (uint32)commands.size(); }
+
+		void reserve(CommandBuffer::PlaybackContext& context, uint32 count) override
+		{
+			impl::ensure_component_type_registered<Component_>();
+
+			auto& storage = context.registry->storage<Component_>();
+			storage.reserve(storage.size() + count);
+		}
+
+		void playback(CommandBuffer::PlaybackContext& context) override
+		{
+			for (Command& command : commands)
+			{
+				ref<Entity::EcsData> data = context.resolve(command.target);
+				if (!data || context.registry->any_of<Component_>(data->entity_handle))
+				{
+					continue;
+				}
+
+				std::apply([&](auto&&... args)
+					{
+						if constexpr (is_slim_component_v<Component_>)
+						{
+							context.registry->emplace<Component_>(data->entity_handle, std::move(args)...);
+						}
+						else
+						{
+							context.registry->emplace<Component_>(data->entity_handle, data, std::move(args)...);
+						}
+					}, command.args);
+			}
+		}
+
+		void clear() override { commands.clear(); }
+
+		std::vector<Command> commands;
+	};
+
+	template <typename Component_>
+	struct RemoveComponentCommands final : CommandBuffer::ComponentCommandsBase
+	{
+		RemoveComponentCommands() { removes = true; }
+
+		uint32 size() const override { return (uint32)handles.size(); }
+
+		void reserve(CommandBuffer::PlaybackContext& context, uint32 count) override {}
+
+		void playback(CommandBuffer::PlaybackContext& context) override
+		{
+			entt::registry& registry = *context.registry;
+
+			if constexpr (!is_slim_component_v<Component_>)
+			{
+				for (Entity::Handle handle : handles)
+				{
+					if (registry.valid(handle))
+					{
+						if (Component_* component = registry.try_get<Component_>(handle))
+						{
+							component->release();
+						}
+					}
+				}
+			}
+
+			auto last = std::remove_if(handles.begin(), handles.end(), [&](Entity::Handle handle) { return !registry.valid(handle); });
+			registry.remove<Component_>(handles.begin(), last);
+		}
+
+		void clear() override { handles.clear(); }
+
+		std::vector<Entity::Handle> handles;
+	};
+
+	template <typename Commands_>
+	inline Commands_& CommandBuffer::get_commands(LaneCommands& lane)
+	{
+		uint32 id = impl::command_type_id<Commands_>();
+		if (id >= (uint32)lane.component_commands.size())
+		{
+			lane.component_commands.resize(id + 1, nullptr);
+		}
+
+		ComponentCommandsBase*& commands = lane.component_commands[id];
+		if (!commands)
+		{
+			commands = new Commands_();
+		}
+		return *static_cast<Commands_*>(commands);
+	}
+
+	template <typename Component_, typename... Args_>
+	inline void CommandBuffer::add_component(Target _target, Args_&&... args)
+	{
+		using Commands = AddComponentCommands<Component_, std::decay_t<Args_>...>;
+
+		Lane& lane = acquire_lane();
+		get_commands<Commands>(lane.commands).commands.push_back({ _target, std::tuple<std::decay_t<Args_>...>(std::forward<Args_>(args)...) });
+		++lane.commands.num_commands;
+		release_lane(lane);
+	}
+
+	template <typename Component_>
+	inline void CommandBuffer::remove_component(Entity::Handle _handle)
+	{
+		Lane& lane = acquire_lane();
+		get_commands<RemoveComponentCommands<Component_>>(lane.commands).handles.push_back(_handle);
+		++lane.commands.num_commands;
+		release_lane(lane);
+	}
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ecs/world.h"
+#include "ecs/world_snapshot.h"
 
 #include "rendering/light_source.h"
 #include "rendering/pbr.h"
@@ -45,7 +46,7 @@ namespace era_engine
 		{
 			if (mode == scene_mode_editor)
 			{
-				//runtime_world->destroy(false);
+				editor_snapshot.capture(*runtime_world);
 			}
 			mode = scene_mode_runtime_playing;
 		}
@@ -60,6 +61,10 @@ namespace era_engine
 
 		void stop()
 		{
+			if (mode != scene_mode_editor && !editor_snapshot.empty())
+			{
+				editor_snapshot.restore(*runtime_world);
+			}
 			mode = scene_mode_editor;
 		}
 
@@ -90,5 +95,8 @@ namespace era_engine
 		pbr_environment environment;
 
 		fs::path save_path;
+
+		// World state at the moment play was pressed in the editor, restored on stop.
+		WorldSnapshot editor_snapshot;
 	};
 }
\ No newline at end of file
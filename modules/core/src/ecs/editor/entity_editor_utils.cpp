@@ -19,6 +19,13 @@ namespace era_engine
 			auto& storage = curr.second;
 			entt::type_info ctype = storage.type();
 
+			const impl::ComponentTypeInfo* info = impl::find_component_type(ctype.hash());
+			if (!info || !info->releasable)
+			{
+				// Slim components have no vptr, so they can't be inspected through a type-erased Component pointer.
+				continue;
+			}
+
 			if (storage.contains(handle))
 			{
 				Component* comp = static_cast<Component*>(world->world_data->registry.storage(cid)->second.get(handle));
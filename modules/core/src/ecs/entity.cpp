@@ -27,6 +27,55 @@ namespace era_engine
 	{
 	}
 
+	namespace impl
+	{
+		struct ComponentTypeRegistry
+		{
+			std::unordered_map<entt::id_type, ComponentTypeInfo> types;
+			std::unordered_map<rttr::type, entt::id_type> by_reflection_type;
+			RWSpinLock sync{ "Component types" };
+		};
+
+		// Function local, since component types register themselves from RTTR_REGISTRATION blocks during static initialization.
+		static ComponentTypeRegistry& get_component_type_registry()
+		{
+			static ComponentTypeRegistry registry;
+			return registry;
+		}
+
+		void register_component_type(entt::id_type type_hash, const ComponentTypeInfo& info)
+		{
+			ComponentTypeRegistry& registry = get_component_type_registry();
+			ScopedLock<RWSpinLock> _lock{ registry.sync };
+			registry.types[type_hash] = info;
+			registry.by_reflection_type[info.type] = type_hash;
+		}
+
+		const ComponentTypeInfo* find_component_type(entt::id_type type_hash)
+		{
+			ComponentTypeRegistry& registry = get_component_type_registry();
+			ScopedSharedLock<RWSpinLock> _lock{ registry.sync };
+			auto it = registry.types.find(type_hash);
+			return (it != registry.types.end()) ? &it->second : nullptr;
+		}
+
+		const ComponentTypeInfo* find_component_type(const rttr::type& type, entt::id_type* out_type_hash)
+		{
+			ComponentTypeRegistry& registry = get_component_type_registry();
+			ScopedSharedLock<RWSpinLock> _lock{ registry.sync };
+			auto it = registry.by_reflection_type.find(type);
+			if (it == registry.by_reflection_type.end())
+			{
+				return nullptr;
+			}
+			if (out_type_hash)
+			{
+				*out_type_hash = it->second;
+			}
+			return &registry.types.at(it->second);
+		}
+	}
+
 	Entity::Entity(const Entity& _entity) noexcept
 		: internal_data(_entity.internal_data)
 	{
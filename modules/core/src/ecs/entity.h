@@ -37,6 +37,43 @@ namespace era_engine
 		ERA_REFLECT
 	};
 
+	// Plain-data component: any type that does not derive from IReleasable. It is constructed from its own arguments only
+	// (no ref<Entity::EcsData>), has no vtable and is released through the registry's on_destroy signal
+	// (see World::connect_release_hook) instead of virtual release().
+	template <typename Component_>
+	inline constexpr bool is_slim_component_v = !std::is_base_of_v<IReleasable, Component_>;
+
+	// Components that own objects outside the registry, which other systems point into (PhysX actors and shapes), can't be restored
+	// from a plain copy: the copy shares the original's pointers, and the original is released by the restore. They declare
+	//     void restore_snapshot_state();
+	// which WorldSnapshot calls on every restored component, once all pools and entities are back, to re-create those objects from
+	// the component's own data. Pools are visited in ascending
+	//     static constexpr uint32 snapshot_restore_order = ...; // 0 if not declared.
+	template <typename Component_>
+	inline constexpr bool has_snapshot_restore_v = requires(Component_& component) { component.restore_snapshot_state(); };
+
+	template <typename Component_>
+	inline constexpr uint32 snapshot_restore_order_v = []()
+	{
+		if constexpr (requires { Component_::snapshot_restore_order; })
+		{
+			return (uint32)Component_::snapshot_restore_order;
+		}
+		return 0u;
+	}();
+
+	// Components whose outside objects can't be re-created (e.g. PhysX joints) declare
+	//     static constexpr bool snapshot_excluded = true;
+	// WorldSnapshot does not copy their pools, and refuses to restore a world that contains them. Inherited by derived components.
+	template <typename Component_>
+	inline constexpr bool is_snapshot_excluded_v = requires { requires Component_::snapshot_excluded; };
+
+	namespace impl
+	{
+		template <typename Component_>
+		void ensure_component_type_registered();
+	}
+
 	class ERA_CORE_API Entity final
 	{
 	public:
@@ -78,7 +115,15 @@ namespace era_engine
 		{
 			if (!has_component<Component_>())
 			{
-				internal_data->native_registry->emplace_or_replace<Component_>(internal_data->entity_handle, internal_data, std::forward<Args_>(a)...);
+				impl::ensure_component_type_registered<Component_>();
+				if constexpr (is_slim_component_v<Component_>)
+				{
+					internal_data->native_registry->emplace_or_replace<Component_>(internal_data->entity_handle, std::forward<Args_>(a)...);
+				}
+				else
+				{
+					internal_data->native_registry->emplace_or_replace<Component_>(internal_data->entity_handle, internal_data, std::forward<Args_>(a)...);
+				}
 			}
 			return *this;
 		}
@@ -93,10 +138,13 @@ namespace era_engine
 		template <typename Component_>
 		void remove_component()
 		{
-			IReleasable* component = get_component_if_exists<Component_>();
-			ASSERT(component != nullptr);
+			if constexpr (!is_slim_component_v<Component_>)
+			{
+				IReleasable* component = get_component_if_exists<Component_>();
+				ASSERT(component != nullptr);
 
-			component->release();
+				component->release();
+			}
 			internal_data->native_registry->remove<Component_>(internal_data->entity_handle);
 		}
 
@@ -168,4 +216,178 @@ namespace era_engine
 
 		friend class World;
 	};
+
+	namespace impl
+	{
+		struct ComponentTypeInfo
+		{
+			bool releasable = false;
+			bool trivially_copyable = false;
+			uint32 size = 0; // 0 for empty (tag) components, which have no payload in their pool.
+			uint32 alignment = 0;
+			rttr::type type = rttr::type::get<void>();
+
+			// Whole-pool copies used by WorldSnapshot. Null if the component is not copy constructible or is snapshot excluded.
+			// copy_out writes every element in packed order to dst, copy_in inserts count elements for the given entities
+			// from src, destroy runs the destructors of elements written by copy_out.
+			void (*copy_out)(entt::registry& registry, void* dst) = nullptr;
+			void (*copy_in)(entt::registry& registry, const entt::entity* entities, uint32 count, const void* src) = nullptr;
+			void (*destroy)(void* data, uint32 count) = nullptr;
+
+			// Calls restore_snapshot_state on every component of a restored pool. Null if the component doesn't declare it.
+			void (*restore_pool)(entt::registry& registry) = nullptr;
+			uint32 restore_order = 0;
+
+			// Used by WorldSerializer. emplace_default constructs components for count entities before their reflected
+			// properties are filled in. Null if the component can't be constructed from its entity data alone.
+			void (*emplace_default)(entt::registry& registry, const ref<Entity::EcsData>* datas, uint32 count) = nullptr;
+			rttr::instance (*get_instance)(entt::registry& registry, entt::entity entity) = nullptr;
+		};
+
+		// Keyed by entt::type_hash, which is what type-erased storages report. Lets World::destroy_entity and the editor
+		// tell IReleasable components from slim ones without reinterpreting storage memory.
+		ERA_CORE_API void register_component_type(entt::id_type type_hash, const ComponentTypeInfo& info);
+		NODISCARD ERA_CORE_API const ComponentTypeInfo* find_component_type(entt::id_type type_hash);
+		NODISCARD ERA_CORE_API const ComponentTypeInfo* find_component_type(const rttr::type& type, entt::id_type* out_type_hash = nullptr);
+
+		template <typename Component_>
+		void copy_pool_out(entt::registry& registry, void* dst)
+		{
+			if constexpr (!entt::ignore_as_empty_v<Component_>)
+			{
+				constexpr size_t page_size = entt::component_traits<Component_>::page_size;
+
+				auto& storage = registry.storage<Component_>();
+				Component_** pages = storage.raw();
+				Component_* out = (Component_*)dst;
+
+				const size_t count = storage.size();
+				for (size_t i = 0; i < count; i += page_size)
+				{
+					const size_t n = std::min(page_size, count - i);
+					if constexpr (std::is_trivially_copyable_v<Component_>)
+					{
+						memcpy(out + i, pages[i / page_size], n * sizeof(Component_));
+					}
+					else
+					{
+						std::uninitialized_copy_n(pages[i / page_size], n, out + i);
+					}
+				}
+			}
+		}
+
+		template <typename Component_>
+		void copy_pool_in(entt::registry& registry, const entt::entity* entities, uint32 count, const void* src)
+		{
+			auto& storage = registry.storage<Component_>();
+			if constexpr (entt::ignore_as_empty_v<Component_>)
+			{
+				storage.insert(entities, entities + count);
+			}
+			else if constexpr (std::is_trivially_copyable_v<Component_> && std::is_default_constructible_v<Component_>)
+			{
+				ASSERT(storage.empty());
+				storage.insert(entities, entities + count);
+
+				constexpr size_t page_size = entt::component_traits<Component_>::page_size;
+				Component_** pages = storage.raw();
+				const Component_* in = (const Component_*)src;
+				for (size_t i = 0; i < count; i += page_size)
+				{
+					memcpy(pages[i / page_size], in + i, std::min(page_size, count - i) * sizeof(Component_));
+				}
+			}
+			else
+			{
+				storage.insert(entities, entities + count, (const Component_*)src);
+			}
+		}
+
+		template <typename Component_>
+		void destroy_pool_copy(void* data, uint32 count)
+		{
+			if constexpr (!entt::ignore_as_empty_v<Component_> && !std::is_trivially_destructible_v<Component_>)
+			{
+				std::destroy_n((Component_*)data, count);
+			}
+		}
+
+		template <typename Component_>
+		void restore_pool_state(entt::registry& registry)
+		{
+			for (auto&& [entity, component] : registry.view<Component_>().each())
+			{
+				component.restore_snapshot_state();
+			}
+		}
+
+		template <typename Component_>
+		void emplace_default_components(entt::registry& registry, const ref<Entity::EcsData>* datas, uint32 count)
+		{
+			auto& storage = registry.storage<Component_>();
+			storage.reserve(storage.size() + count);
+
+			for (uint32 i = 0; i < count; ++i)
+			{
+				const Entity::Handle handle = datas[i]->entity_handle;
+				if constexpr (is_slim_component_v<Component_>)
+				{
+					registry.emplace<Component_>(handle);
+				}
+				else
+				{
+					registry.emplace<Component_>(handle, datas[i]);
+				}
+			}
+		}
+
+		template <typename Component_>
+		rttr::instance get_component_instance(entt::registry& registry, entt::entity entity)
+		{
+			return rttr::instance(registry.get<Component_>(entity));
+		}
+
+		template <typename Component_>
+		inline ComponentTypeInfo make_component_type_info()
+		{
+			ComponentTypeInfo info;
+			info.releasable = !is_slim_component_v<Component_>;
+			info.trivially_copyable = std::is_trivially_copyable_v<Component_>;
+			info.type = rttr::type::get<Component_>();
+			if constexpr (!entt::ignore_as_empty_v<Component_>)
+			{
+				info.size = (uint32)sizeof(Component_);
+				info.alignment = (uint32)alignof(Component_);
+			}
+			if constexpr (std::is_copy_constructible_v<Component_> && !is_snapshot_excluded_v<Component_>)
+			{
+				info.copy_out = &copy_pool_out<Component_>;
+				info.copy_in = &copy_pool_in<Component_>;
+				info.destroy = &destroy_pool_copy<Component_>;
+
+				if constexpr (has_snapshot_restore_v<Component_>)
+				{
+					info.restore_pool = &restore_pool_state<Component_>;
+					info.restore_order = snapshot_restore_order_v<Component_>;
+				}
+			}
+			if constexpr (!entt::ignore_as_empty_v<Component_>)
+			{
+				info.get_instance = &get_component_instance<Component_>;
+			}
+			if constexpr (is_slim_component_v<Component_> ? std::is_default_constructible_v<Component_> : std::is_constructible_v<Component_, ref<Entity::EcsData>>)
+			{
+				info.emplace_default = &emplace_default_components<Component_>;
+			}
+			return info;
+		}
+
+		template <typename Component_>
+		void ensure_component_type_registered()
+		{
+			static const bool registered = (register_component_type(entt::type_hash<Component_>::value(), make_component_type_info<Component_>()), true);
+			(void)registered;
+		}
+	}
 }
\ No newline at end of file
@@ -8,6 +8,8 @@ namespace era_engine
 	RTTR_REGISTRATION
 	{
 		using namespace rttr;
+		impl::ensure_component_type_registered<MeshComponent>();
+
 		rttr::registration::class_<MeshComponent>("MeshComponent")
 			.constructor<ref<Entity::EcsData>, ref<multi_mesh>, bool>()
 			.property("mesh", &MeshComponent::mesh)
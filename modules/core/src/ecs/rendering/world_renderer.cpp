@@ -15,6 +15,7 @@
 #include "geometry/mesh.h"
 
 #include "dx/dx_context.h"
+#include "dx/dx_texture_streaming.h"
 
 #include "terrain/tree.h"
 #include "terrain/water.h"
@@ -854,6 +855,43 @@ namespace era_engine
 		}
 	}
 
+	static void requestStreamedTextureDetail(const render_camera& camera, ref<World> world, const camera_frustum_planes& frustum)
+	{
+		CPU_PROFILE_BLOCK("Request texture detail");
+
+		camera_projection_extents extents = camera.getProjectionExtents();
+		float pixelsPerUnitAtDistance1 = camera.height / (extents.top + extents.bottom);
+
+		for (auto [entityHandle, transform, mesh] : world->view<TransformComponent, MeshComponent>().each())
+		{
+			if (!shouldRender(frustum, mesh, transform))
+				continue;
+
+			// Assumes the UV range [0, uvScale] is spread over the object's bounds.
+			const trs& t = transform.transform;
+			for (auto& sm : mesh.mesh->submeshes)
+			{
+				if (!sm.material)
+					continue;
+
+				vec3 radius = sm.aabb.getRadius() * t.scale;
+				float worldRadius = max(radius.x, max(radius.y, radius.z));
+				vec3 center = t.position + t.rotation * (sm.aabb.getCenter() * t.scale);
+
+				float distance = max(length(center - camera.position) - worldRadius, camera.nearPlane);
+				float projectedPixels = 2.f * worldRadius / distance * pixelsPerUnitAtDistance1;
+				if (projectedPixels < 1.f)
+					continue;
+
+				float uvPerPixel = sm.material->uvScale / projectedPixels;
+				requestTextureDetail(sm.material->albedo, uvPerPixel);
+				requestTextureDetail(sm.material->normal, uvPerPixel);
+				requestTextureDetail(sm.material->roughness, uvPerPixel);
+				requestTextureDetail(sm.material->metallic, uvPerPixel);
+			}
+		}
+	}
+
 	void render_world(const render_camera& camera, ref<World> world, Allocator& arena, Entity::Handle selectedObjectID, directional_light& sun, scene_lighting& lighting, bool invalidateShadowMapCache, opaque_render_pass* opaqueRenderPass, transparent_render_pass* transparentRenderPass, ldr_render_pass* ldrRenderPass, sun_shadow_render_pass* sunShadowRenderPass, compute_pass* computePass, float dt)
 	{
 		CPU_PROFILE_BLOCK("Submit scene render commands");
@@ -915,6 +953,8 @@ namespace era_engine
 
 		camera_frustum_planes frustum = camera.getWorldSpaceFrustumPlanes();
 
+		requestStreamedTextureDetail(camera, world, frustum);
+
 		renderStaticObjects(world, frustum, arena, selectedObjectID, opaqueRenderPass, transparentRenderPass, ldrRenderPass, staticShadowPasses);
 		renderDynamicObjects(world, frustum, arena, selectedObjectID, opaqueRenderPass, transparentRenderPass, ldrRenderPass, dynamicShadowPasses);
 		renderAnimatedObjects(world, frustum, arena, selectedObjectID, opaqueRenderPass, transparentRenderPass, ldrRenderPass, dynamicShadowPasses);
@@ -1,4 +1,5 @@
 #include "ecs/world.h"
+#include "ecs/command_buffer.h"
 #include "ecs/base_components/base_components.h"
 
 #include "core/sync.h"
@@ -13,6 +14,7 @@ namespace era_engine
 		world_data = make_ref<WorldData>();
 		world_data->name = _name;
 		world_data->registry.reserve(64000);
+		world_data->command_buffer = make_ref<CommandBuffer>(this);
 
 		worlds.emplace(_name, this);
 	}
@@ -89,6 +91,19 @@ namespace era_engine
 			{
 				if (curr.second.contains(_handle))
 				{
+					const impl::ComponentTypeInfo* info = impl::find_component_type(curr.second.type().hash());
+					if (!info)
+					{
+						// Every component type registers itself in its RTTR registration, so this is a pool emplaced around Entity.
+						LOG_WARNING("ECS> Component pool '%.*s' is not registered, its components are not released", (int)curr.second.type().name().size(), curr.second.type().name().data());
+						continue;
+					}
+					if (!info->releasable)
+					{
+						// Slim components are released by their on_destroy hooks in registry.destroy below.
+						continue;
+					}
+
 					IReleasable* comp = reinterpret_cast<IReleasable*>(world_data->registry.storage(curr.first)->second.get(_handle));
 					ASSERT(comp != nullptr);
 					comp->release();
@@ -146,6 +161,11 @@ namespace era_engine
 		return world_data->registry;
 	}
 
+	CommandBuffer& World::get_command_buffer()
+	{
+		return *world_data->command_buffer;
+	}
+
 	void World::add_base_components(Entity& entity)
 	{
 		entity.add_component<TransformComponent>().add_component<ChildComponent>(weakref<Entity::EcsData>(world_data->root_entity.internal_data));
@@ -33,6 +33,8 @@ namespace era_engine
 	template<typename... Type_>
 	inline constexpr ComponentsGroup<Type_...> components_group{};
 
+	class CommandBuffer;
+
 	class ERA_CORE_API World
 	{
 		struct WorldData
@@ -41,6 +43,7 @@ namespace era_engine
 			std::unordered_map<Entity::Handle, ref<Entity::EcsData>> entity_datas;
 			entt::registry registry;
 			Entity root_entity;
+			ref<CommandBuffer> command_buffer = nullptr;
 			const char* name = nullptr;
 		};
 
@@ -70,12 +73,20 @@ namespace era_engine
 
 		entt::registry& get_registry();
 
+		// Deferred structural changes, played back by the WorldSystemScheduler after every update group.
+		CommandBuffer& get_command_buffer();
+
 		template <typename Component_>
 		Entity get_entity_from_component(const Component_& comp)
 		{
 			return { entt::to_entity(world_data->registry, comp), this };
 		}
 
+		Entity get_root_entity() const
+		{
+			return world_data->root_entity;
+		}
+
 		template <typename Component_>
 		Component_* get_root_component()
 		{
@@ -93,6 +104,15 @@ namespace era_engine
 			return world_data->root_entity.get_component_if_exists<Component_>();
 		}
 
+		// Release hook for slim components (see is_slim_component_v). Called for every removal of Component_,
+		// including entity destruction, with the component still in place.
+		template <typename Component_, auto Candidate_, typename... Args_>
+		void connect_release_hook(Args_&&... args)
+		{
+			static_assert(is_slim_component_v<Component_>, "Components derived from IReleasable are released through release()");
+			world_data->registry.on_destroy<Component_>().template connect<Candidate_>(std::forward<Args_>(args)...);
+		}
+
 		template <typename Component_>
 		void copy_component_if_exists(Entity& src, Entity& dst)
 		{
@@ -186,6 +206,8 @@ namespace era_engine
 		template <typename Component_>
 		void copy_component_pool_to(World& target)
 		{
+			impl::ensure_component_type_registered<Component_>();
+
 			auto v = view<Component_>();
 			auto& s = world_data->registry.storage<Component_>();
 			target.world_data->registry.insert<Component_>(v.begin(), v.end(), s.cbegin());
@@ -213,6 +235,9 @@ namespace era_engine
 
 		friend class Entity;
 		friend class EntityEditorUtils;
+		friend class CommandBuffer;
+		friend class WorldSnapshot;
+		friend class WorldSerializer;
 	};
 
 	World* get_world_by_name(const char* _name);
@@ -0,0 +1,732 @@
+#include "ecs/world_serializer.h"
+#include "ecs/world.h"
+#include "ecs/base_components/base_components.h"
+
+#include "geometry/mesh.h"
+
+#include "core/cpu_profiling.h"
+#include "core/log.h"
+#include "core/math.h"
+#include "core/sync.h"
+
+namespace era_engine
+{
+	static const uint32 WORLD_FILE_HEADER = 'ERAW';
+	static const uint32 WORLD_FILE_VERSION = 1;
+
+	static const uint32 NULL_ENTITY_INDEX = UINT32_MAX;
+	static const uint32 ROOT_ENTITY_INDEX = UINT32_MAX - 1;
+
+	struct WorldFileHeader
+	{
+		uint32 header = WORLD_FILE_HEADER;
+		uint32 version = WORLD_FILE_VERSION;
+		uint32 num_entities = 0;
+		uint32 num_columns = 0;
+	};
+
+	// Followed by the type name, the entity indices and num_properties property sub-columns. payload_size covers all of that.
+	struct ColumnHeader
+	{
+		uint64 schema_hash = 0;
+		uint64 payload_size = 0;
+		uint32 count = 0;
+		uint32 num_properties = 0;
+		uint32 name_length = 0;
+	};
+
+	// Followed by the property name and the values of all entities of the column. size covers both.
+	struct PropertyHeader
+	{
+		uint64 schema_hash = 0;
+		uint64 size = 0;
+		uint32 name_length = 0;
+	};
+
+	struct WriteBuffer
+	{
+		void write(const void* data, uint64 size)
+		{
+			const uint64 offset = bytes.size();
+			bytes.resize(offset + size);
+			memcpy(bytes.data() + offset, data, size);
+		}
+
+		template <typename T>
+		void write(const T& value)
+		{
+			write(&value, sizeof(T));
+		}
+
+		template <typename T>
+		void patch(uint64 offset, const T& value)
+		{
+			memcpy(bytes.data() + offset, &value, sizeof(T));
+		}
+
+		std::vector<uint8> bytes;
+	};
+
+	struct ReadBuffer
+	{
+		bool read(void* data, uint64 size)
+		{
+			if (size > end - offset)
+			{
+				offset = end;
+				return false;
+			}
+			memcpy(data, bytes + offset, size);
+			offset += size;
+			return true;
+		}
+
+		template <typename T>
+		bool read(T& value)
+		{
+			return read(&value, sizeof(T));
+		}
+
+		const uint8* bytes = nullptr;
+		uint64 offset = 0;
+		uint64 end = 0;
+	};
+
+	struct SaveContext
+	{
+		// Indexed by entt::to_entity.
+		std::vector<uint32> entity_indices;
+
+		uint32 get_index(const ref<Entity::EcsData>& data) const
+		{
+			if (!data)
+			{
+				return NULL_ENTITY_INDEX;
+			}
+			const uint32 id = (uint32)entt::to_entity(data->entity_handle);
+			return id < (uint32)entity_indices.size() ? entity_indices[id] : NULL_ENTITY_INDEX;
+		}
+	};
+
+	struct LoadContext
+	{
+		std::vector<ref<Entity::EcsData>> datas;
+		ref<Entity::EcsData> root;
+
+		ref<Entity::EcsData> resolve(uint32 index) const
+		{
+			if (index == ROOT_ENTITY_INDEX)
+			{
+				return root;
+			}
+			return index < (uint32)datas.size() ? datas[index] : nullptr;
+		}
+	};
+
+	// Types written as raw bytes.
+	struct LeafType
+	{
+		void (*write)(const rttr::variant& value, WriteBuffer& out);
+		bool (*read)(ReadBuffer& in, rttr::variant& value);
+	};
+
+	template <typename T>
+	static void write_pod(const rttr::variant& value, WriteBuffer& out)
+	{
+		out.write(value.get_value<T>());
+	}
+
+	template <typename T>
+	static bool read_pod(ReadBuffer& in, rttr::variant& value)
+	{
+		T result;
+		if (!in.read(result))
+		{
+			return false;
+		}
+		value = result;
+		return true;
+	}
+
+	static void write_trs(const rttr::variant& value, WriteBuffer& out)
+	{
+		const trs& transform = value.get_value<trs>();
+		out.write(transform.rotation);
+		out.write(transform.position);
+		out.write(transform.scale);
+	}
+
+	static bool read_trs(ReadBuffer& in, rttr::variant& value)
+	{
+		quat rotation;
+		vec3 position, scale;
+		if (!in.read(rotation) || !in.read(position) || !in.read(scale))
+		{
+			return false;
+		}
+		value = trs(position, rotation, scale);
+		return true;
+	}
+
+	// Meshes are stored as their asset handle and creation flags, and loaded again through the mesh cache.
+	static void write_mesh(const rttr::variant& value, WriteBuffer& out)
+	{
+		const ref<multi_mesh>& mesh = value.get_value<ref<multi_mesh>>();
+		out.write(mesh ? mesh->handle.value : 0ull);
+		out.write(mesh ? mesh->flags : 0u);
+	}
+
+	static bool read_mesh(ReadBuffer& in, rttr::variant& value)
+	{
+		uint64 handle;
+		uint32 flags;
+		if (!in.read(handle) || !in.read(flags))
+		{
+			return false;
+		}
+
+		ref<multi_mesh> mesh = nullptr;
+		if (handle != 0)
+		{
+			mesh = loadMeshFromHandle(AssetHandle(handle), flags);
+			if (!mesh)
+			{
+				LOG_WARNING("ECS> Mesh asset %llu could not be loaded", handle);
+			}
+		}
+		value = mesh;
+		return true;
+	}
+
+	template <typename T>
+	static std::pair<const rttr::type, LeafType> pod_leaf()
+	{
+		return { rttr::type::get<T>(), LeafType{ &write_pod<T>, &read_pod<T> } };
+	}
+
+	static const LeafType* find_leaf_type(const rttr::type& type)
+	{
+		static const std::unordered_map<rttr::type, LeafType> leaf_types =
+		{
+			pod_leaf<bool>(), pod_leaf<char>(),
+			pod_leaf<int8>(), pod_leaf<uint8>(), pod_leaf<int16>(), pod_leaf<uint16>(),
+			pod_leaf<int32>(), pod_leaf<uint32>(), pod_leaf<int64>(), pod_leaf<uint64>(),
+			pod_leaf<float>(), pod_leaf<double>(),
+			pod_leaf<vec2>(), pod_leaf<vec3>(), pod_leaf<vec4>(), pod_leaf<quat>(), pod_leaf<mat4>(),
+			{ rttr::type::get<trs>(), LeafType{ &write_trs, &read_trs } },
+			{ rttr::type::get<ref<multi_mesh>>(), LeafType{ &write_mesh, &read_mesh } },
+		};
+
+		auto it = leaf_types.find(type);
+		return (it != leaf_types.end()) ? &it->second : nullptr;
+	}
+
+	static uint64 hash_string(std::string_view str, uint64 hash = 14695981039346656037ull)
+	{
+		for (char c : str)
+		{
+			hash = (hash ^ (uint8)c) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	static bool is_serializable(const rttr::type& type)
+	{
+		return find_leaf_type(type)
+			|| type == rttr::type::get<std::string>()
+			|| type == rttr::type::get<ref<Entity::EcsData>>()
+			|| type == rttr::type::get<weakref<Entity::EcsData>>()
+			|| type.is_enumeration()
+			|| type.is_sequential_container()
+			|| (type.is_class() && !type.get_properties().empty());
+	}
+
+	// Changes whenever the binary layout of a value of this type changes.
+	static uint64 get_schema_hash(const rttr::type& type)
+	{
+		uint64 hash = hash_string(type.get_name().to_string());
+
+		if (!find_leaf_type(type) && !type.is_enumeration() && !type.is_sequential_container() && type.is_class())
+		{
+			for (const rttr::property& prop : type.get_properties())
+			{
+				if (is_serializable(prop.get_type()))
+				{
+					hash = hash_string(prop.get_name().to_string(), hash);
+					hash = hash_string(std::to_string(get_schema_hash(prop.get_type())), hash);
+				}
+			}
+		}
+
+		return hash;
+	}
+
+	static void write_value(const rttr::variant& value, const rttr::type& type, WriteBuffer& out, const SaveContext& context)
+	{
+		if (const LeafType* leaf = find_leaf_type(type))
+		{
+			leaf->write(value, out);
+		}
+		else if (type == rttr::type::get<std::string>())
+		{
+			const std::string& str = value.get_value<std::string>();
+			out.write((uint32)str.length());
+			out.write(str.data(), str.length());
+		}
+		else if (type == rttr::type::get<ref<Entity::EcsData>>())
+		{
+			out.write(context.get_index(value.get_value<ref<Entity::EcsData>>()));
+		}
+		else if (type == rttr::type::get<weakref<Entity::EcsData>>())
+		{
+			out.write(context.get_index(value.get_value<weakref<Entity::EcsData>>().lock()));
+		}
+		else if (type.is_enumeration())
+		{
+			// By name, so that reordering the enumerators doesn't break old files.
+			const rttr::string_view name = type.get_enumeration().value_to_name(value);
+			out.write((uint32)name.length());
+			out.write(name.data(), name.length());
+		}
+		else if (type.is_sequential_container())
+		{
+			rttr::variant_sequential_view view = value.create_sequential_view();
+			const rttr::type value_type = view.get_value_type();
+
+			out.write((uint32)view.get_size());
+			for (const rttr::variant& item : view)
+			{
+				write_value(item.extract_wrapped_value(), value_type, out, context);
+			}
+		}
+		else if (type.is_class())
+		{
+			for (const rttr::property& prop : type.get_properties())
+			{
+				if (is_serializable(prop.get_type()))
+				{
+					write_value(prop.get_value(value), prop.get_type(), out, context);
+				}
+			}
+		}
+	}
+
+	// Class and container values are read in place, so value must hold the current (default) value on entry.
+	static bool read_value(ReadBuffer& in, rttr::variant& value, const rttr::type& type, const LoadContext& context)
+	{
+		if (const LeafType* leaf = find_leaf_type(type))
+		{
+			return leaf->read(in, value);
+		}
+		else if (type == rttr::type::get<std::string>())
+		{
+			uint32 length;
+			if (!in.read(length))
+			{
+				return false;
+			}
+			std::string str(length, '\0');
+			if (!in.read(str.data(), length))
+			{
+				return false;
+			}
+			value = str;
+			return true;
+		}
+		else if (type == rttr::type::get<ref<Entity::EcsData>>() || type == rttr::type::get<weakref<Entity::EcsData>>())
+		{
+			uint32 index;
+			if (!in.read(index))
+			{
+				return false;
+			}
+
+			ref<Entity::EcsData> data = context.resolve(index);
+			if (type == rttr::type::get<ref<Entity::EcsData>>())
+			{
+				value = data;
+			}
+			else
+			{
+				value = weakref<Entity::EcsData>(data);
+			}
+			return true;
+		}
+		else if (type.is_enumeration())
+		{
+			uint32 length;
+			if (!in.read(length))
+			{
+				return false;
+			}
+			std::string name(length, '\0');
+			if (!in.read(name.data(), length))
+			{
+				return false;
+			}
+
+			// Unknown enumerators keep the default value.
+			rttr::variant result = type.get_enumeration().name_to_value(name);
+			if (result.is_valid())
+			{
+				value = result;
+			}
+			return true;
+		}
+		else if (type.is_sequential_container())
+		{
+			uint32 count;
+			if (!in.read(count))
+			{
+				return false;
+			}
+
+			rttr::variant_sequential_view view = value.create_sequential_view();
+			if (view.is_dynamic())
+			{
+				view.set_size(count);
+			}
+
+			const rttr::type value_type = view.get_value_type();
+			const uint32 size = (uint32)view.get_size();
+			for (uint32 i = 0; i < count; ++i)
+			{
+				rttr::variant item = (i < size) ? view.get_value(i).extract_wrapped_value() : rttr::variant();
+				if (!read_value(in, item, value_type, context))
+				{
+					return false;
+				}
+				if (i < size)
+				{
+					view.set_value(i, item);
+				}
+			}
+			return true;
+		}
+		else if (type.is_class())
+		{
+			for (const rttr::property& prop : type.get_properties())
+			{
+				if (!is_serializable(prop.get_type()))
+				{
+					continue;
+				}
+
+				rttr::variant prop_value = prop.get_value(value);
+				if (!read_value(in, prop_value, prop.get_type(), context))
+				{
+					return false;
+				}
+				prop.set_value(value, prop_value);
+			}
+			return true;
+		}
+		return true;
+	}
+
+	static void write_column(entt::registry& registry, const entt::sparse_set& storage, const impl::ComponentTypeInfo& info,
+		const SaveContext& context, WriteBuffer& out)
+	{
+		const std::string name = info.type.get_name().to_string();
+
+		const uint64 header_offset = out.bytes.size();
+		ColumnHeader header;
+		header.schema_hash = get_schema_hash(info.type);
+		header.name_length = (uint32)name.length();
+		out.write(header);
+		out.write(name.data(), name.length());
+
+		const uint64 payload_offset = out.bytes.size();
+
+		std::vector<Entity::Handle> handles;
+		handles.reserve(storage.size());
+		for (Entity::Handle handle : storage)
+		{
+			const uint32 index = context.entity_indices[(uint32)entt::to_entity(handle)];
+			if (index != ROOT_ENTITY_INDEX)
+			{
+				out.write(index);
+				handles.push_back(handle);
+			}
+		}
+		header.count = (uint32)handles.size();
+
+		if (info.get_instance)
+		{
+			for (const rttr::property& prop : info.type.get_properties())
+			{
+				const rttr::type prop_type = prop.get_type();
+				if (!is_serializable(prop_type))
+				{
+					continue;
+				}
+
+				const std::string prop_name = prop.get_name().to_string();
+
+				const uint64 prop_offset = out.bytes.size();
+				PropertyHeader prop_header;
+				prop_header.schema_hash = get_schema_hash(prop_type);
+				prop_header.name_length = (uint32)prop_name.length();
+				out.write(prop_header);
+				out.write(prop_name.data(), prop_name.length());
+
+				for (Entity::Handle handle : handles)
+				{
+					rttr::instance instance = info.get_instance(registry, handle);
+					write_value(prop.get_value(instance), prop_type, out, context);
+				}
+
+				prop_header.size = out.bytes.size() - prop_offset - sizeof(PropertyHeader);
+				out.patch(prop_offset, prop_header);
+				++header.num_properties;
+			}
+		}
+
+		header.payload_size = out.bytes.size() - payload_offset;
+		out.patch(header_offset, header);
+	}
+
+	bool WorldSerializer::save(World& world, const fs::path& path)
+	{
+		CPU_PROFILE_BLOCK("Save world");
+
+		World::WorldData& world_data = *world.world_data;
+		entt::registry& registry = world_data.registry;
+		const Entity::Handle root = world_data.root_entity.get_handle();
+
+		SaveContext context;
+		context.entity_indices.resize(registry.size(), NULL_ENTITY_INDEX);
+
+		std::vector<Entity::Handle> entities;
+		entities.reserve(registry.alive());
+		registry.each([&](Entity::Handle handle)
+		{
+			if (handle != root)
+			{
+				context.entity_indices[(uint32)entt::to_entity(handle)] = (uint32)entities.size();
+				entities.push_back(handle);
+			}
+		});
+		if (root != Entity::NullHandle)
+		{
+			context.entity_indices[(uint32)entt::to_entity(root)] = ROOT_ENTITY_INDEX;
+		}
+
+		FILE* file = fopen(path.string().c_str(), "wb");
+		if (!file)
+		{
+			LOG_ERROR("ECS> Failed to open '%s' for writing", path.string().c_str());
+			return false;
+		}
+
+		WorldFileHeader header;
+		header.num_entities = (uint32)entities.size();
+		fwrite(&header, sizeof(header), 1, file);
+
+		WriteBuffer column;
+		for (auto&& [id, storage] : registry.storage())
+		{
+			if (storage.empty())
+			{
+				continue;
+			}
+
+			const impl::ComponentTypeInfo* info = impl::find_component_type(storage.type().hash());
+			if (!info || id != storage.type().hash() || !info->emplace_default)
+			{
+				LOG_WARNING("ECS> Component pool '%.*s' can't be serialized", (int)storage.type().name().size(), storage.type().name().data());
+				continue;
+			}
+
+			column.bytes.clear();
+			write_column(registry, storage, *info, context, column);
+			fwrite(column.bytes.data(), 1, column.bytes.size(), file);
+			++header.num_columns;
+		}
+
+		_fseeki64(file, 0, SEEK_SET);
+		fwrite(&header, sizeof(header), 1, file);
+		fclose(file);
+
+		return true;
+	}
+
+	static void read_column(entt::registry& registry, const impl::ComponentTypeInfo& info, const ColumnHeader& header,
+		ReadBuffer& in, const LoadContext& context)
+	{
+		std::vector<ref<Entity::EcsData>> datas;
+		datas.reserve(header.count);
+		for (uint32 i = 0; i < header.count; ++i)
+		{
+			uint32 index = NULL_ENTITY_INDEX;
+			in.read(index);
+			datas.push_back((index != ROOT_ENTITY_INDEX) ? context.resolve(index) : nullptr);
+		}
+
+		// Construct the whole column first, then fill in one property at a time.
+		std::vector<ref<Entity::EcsData>> valid;
+		valid.reserve(datas.size());
+		for (const ref<Entity::EcsData>& data : datas)
+		{
+			if (data)
+			{
+				valid.push_back(data);
+			}
+		}
+		info.emplace_default(registry, valid.data(), (uint32)valid.size());
+
+		for (uint32 p = 0; p < header.num_properties; ++p)
+		{
+			PropertyHeader prop_header;
+			if (!in.read(prop_header))
+			{
+				return;
+			}
+
+			std::string prop_name(prop_header.name_length, '\0');
+			in.read(prop_name.data(), prop_header.name_length);
+
+			const uint64 next_offset = in.offset + (prop_header.size - prop_header.name_length);
+
+			rttr::property prop = info.type.get_property(prop_name);
+			if (!info.get_instance || !prop.is_valid() || get_schema_hash(prop.get_type()) != prop_header.schema_hash)
+			{
+				LOG_MESSAGE("ECS> Skipping property '%s' of '%s', it no longer matches the saved data", prop_name.c_str(), info.type.get_name().data());
+				in.offset = min(next_offset, in.end);
+				continue;
+			}
+
+			ReadBuffer prop_in = in;
+			prop_in.end = min(next_offset, in.end);
+
+			for (const ref<Entity::EcsData>& data : datas)
+			{
+				rttr::variant value;
+				if (data)
+				{
+					rttr::instance instance = info.get_instance(registry, data->entity_handle);
+					value = prop.get_value(instance);
+					if (!read_value(prop_in, value, prop.get_type(), context))
+					{
+						break;
+					}
+					prop.set_value(instance, value);
+				}
+				else if (!read_value(prop_in, value, prop.get_type(), context))
+				{
+					break;
+				}
+			}
+
+			in.offset = min(next_offset, in.end);
+		}
+	}
+
+	bool WorldSerializer::load(World& world, const fs::path& path)
+	{
+		CPU_PROFILE_BLOCK("Load world");
+
+		FILE* file = fopen(path.string().c_str(), "rb");
+		if (!file)
+		{
+			LOG_ERROR("ECS> Failed to open '%s'", path.string().c_str());
+			return false;
+		}
+
+		WorldFileHeader header;
+		if (fread(&header, sizeof(header), 1, file) != 1 || header.header != WORLD_FILE_HEADER || header.version != WORLD_FILE_VERSION)
+		{
+			LOG_ERROR("ECS> '%s' is not a world file of version %u", path.string().c_str(), WORLD_FILE_VERSION);
+			fclose(file);
+			return false;
+		}
+
+		World::WorldData& world_data = *world.world_data;
+		entt::registry& registry = world_data.registry;
+
+		LoadContext context;
+		context.root = world_data.root_entity.get_data_weakref().lock();
+
+		{
+			std::vector<Entity::Handle> handles(header.num_entities);
+			registry.create(handles.begin(), handles.end());
+
+			context.datas.reserve(header.num_entities);
+
+			Lock _lock{ world_data.sync };
+			world_data.entity_datas.reserve(world_data.entity_datas.size() + header.num_entities);
+			for (Entity::Handle handle : handles)
+			{
+				ref<Entity::EcsData> data = make_ref<Entity::EcsData>(handle, &world, &registry);
+				world_data.entity_datas.emplace(handle, data);
+				context.datas.push_back(data);
+			}
+		}
+
+		// One column in memory at a time.
+		std::vector<uint8> payload;
+		for (uint32 c = 0; c < header.num_columns; ++c)
+		{
+			ColumnHeader column_header;
+			if (fread(&column_header, sizeof(column_header), 1, file) != 1)
+			{
+				LOG_ERROR("ECS> '%s' is truncated", path.string().c_str());
+				break;
+			}
+
+			std::string name(column_header.name_length, '\0');
+			fread(name.data(), 1, column_header.name_length, file);
+
+			const rttr::type type = rttr::type::get_by_name(name);
+			const impl::ComponentTypeInfo* info = type.is_valid() ? impl::find_component_type(type) : nullptr;
+			if (!info || !info->emplace_default)
+			{
+				LOG_WARNING("ECS> Unknown component type '%s' in '%s', skipping", name.c_str(), path.string().c_str());
+				_fseeki64(file, (int64)column_header.payload_size, SEEK_CUR);
+				continue;
+			}
+
+			if (column_header.schema_hash != get_schema_hash(type))
+			{
+				LOG_MESSAGE("ECS> Component type '%s' changed since '%s' was saved, matching properties by name", name.c_str(), path.string().c_str());
+			}
+
+			payload.resize(column_header.payload_size);
+			if (fread(payload.data(), 1, payload.size(), file) != payload.size())
+			{
+				LOG_ERROR("ECS> '%s' is truncated", path.string().c_str());
+				break;
+			}
+
+			ReadBuffer in;
+			in.bytes = payload.data();
+			in.end = payload.size();
+			read_column(registry, *info, column_header, in, context);
+		}
+
+		fclose(file);
+
+		// Hierarchy links live in EntityContainer and are not reflected; rebuild them from the loaded parents.
+		for (const ref<Entity::EcsData>& data : context.datas)
+		{
+			if (!registry.all_of<TransformComponent>(data->entity_handle))
+			{
+				registry.emplace<TransformComponent>(data->entity_handle, data);
+			}
+
+			if (ChildComponent* child = registry.try_get<ChildComponent>(data->entity_handle))
+			{
+				if (ref<Entity::EcsData> parent = child->parent.lock())
+				{
+					EntityContainer::emplace_pair(parent->entity_handle, data->entity_handle);
+				}
+			}
+			else
+			{
+				registry.emplace<ChildComponent>(data->entity_handle, data, weakref<Entity::EcsData>(context.root));
+			}
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "core_api.h"
+
+namespace era_engine
+{
+	class World;
+
+	// Binary world format driven by the RTTR registrations of the components.
+	//
+	// Every component type is stored as one column: the indices of the entities that have it, followed by one sub-column per
+	// reflected property. Columns and sub-columns carry a schema hash of their type (property names and types, recursively),
+	// so a file survives added, removed or reordered properties: sub-columns that no longer match are skipped. Mesh references are
+	// stored as asset handles and loaded again through the mesh cache.
+	//
+	// Loading streams the file one column at a time and constructs each component type in bulk. Loaded entities are added to
+	// the world; the world's root entity is not saved and references to it resolve to the target world's root.
+	class ERA_CORE_API WorldSerializer final
+	{
+		WorldSerializer() = delete;
+
+	public:
+		static bool save(World& world, const fs::path& path);
+		static bool load(World& world, const fs::path& path);
+	};
+}
@@ -0,0 +1,227 @@
+#include "ecs/world_snapshot.h"
+#include "ecs/world.h"
+#include "ecs/base_components/child_component.h"
+
+#include "core/cpu_profiling.h"
+#include "core/log.h"
+#include "core/sync.h"
+
+#include <algorithm>
+
+namespace era_engine
+{
+	// Releasing the dropped ChildComponents erased their parents' child lists, including pairs the snapshot brings back.
+	static void rebuild_entity_hierarchy(entt::registry& registry)
+	{
+		for (auto&& [handle, child] : registry.view<ChildComponent>().each())
+		{
+			ref<Entity::EcsData> parent_data = child.parent.lock();
+			if (!parent_data)
+			{
+				continue;
+			}
+
+			std::vector<Entity::Handle> childs = EntityContainer::get_childs(parent_data->entity_handle);
+			if (std::find(childs.begin(), childs.end(), handle) == childs.end())
+			{
+				EntityContainer::emplace_pair(parent_data->entity_handle, handle);
+			}
+		}
+	}
+
+	WorldSnapshot::~WorldSnapshot()
+	{
+		clear();
+	}
+
+	void WorldSnapshot::capture(World& world)
+	{
+		CPU_PROFILE_BLOCK("World snapshot capture");
+
+		clear();
+
+		if (!arena_initialized)
+		{
+			arena.initialize(MB(4), GB(16), memory_tag_ecs);
+			arena_initialized = true;
+		}
+
+		World::WorldData& world_data = *world.world_data;
+		entt::registry& registry = world_data.registry;
+
+		num_entities = (uint32)registry.size();
+		if (num_entities > 0)
+		{
+			entities = arena.allocate<Entity::Handle>(num_entities);
+			memcpy(entities, registry.data(), num_entities * sizeof(Entity::Handle));
+		}
+		released = registry.released();
+
+		for (auto&& [id, storage] : registry.storage())
+		{
+			if (storage.empty())
+			{
+				continue;
+			}
+
+			const entt::type_info& type = storage.type();
+			const impl::ComponentTypeInfo* info = impl::find_component_type(type.hash());
+
+			// Pool copies go through registry.storage<T>(), so only the default storage of a type can be captured.
+			if (!info || !info->copy_out || id != type.hash())
+			{
+				LOG_WARNING("ECS> Component pool '%.*s' can't be captured in a world snapshot", (int)type.name().size(), type.name().data());
+				complete = false;
+				continue;
+			}
+
+			Pool& pool = pools.emplace_back();
+			pool.id = id;
+			pool.info = info;
+			pool.count = (uint32)storage.size();
+
+			pool.entities = arena.allocate<Entity::Handle>(pool.count);
+			memcpy(pool.entities, storage.data(), pool.count * sizeof(Entity::Handle));
+
+			if (info->size > 0)
+			{
+				pool.components = arena.allocate((uint64)info->size * pool.count, info->alignment);
+			}
+			info->copy_out(registry, pool.components);
+		}
+
+		Lock _lock{ world_data.sync };
+
+		entity_datas.reserve(world_data.entity_datas.size());
+		for (const auto& [handle, data] : world_data.entity_datas)
+		{
+			entity_datas.push_back(data);
+		}
+	}
+
+	bool WorldSnapshot::restore(World& world) const
+	{
+		CPU_PROFILE_BLOCK("World snapshot restore");
+
+		if (!complete)
+		{
+			LOG_ERROR("ECS> World snapshot is missing component pools and can't be restored");
+			return false;
+		}
+
+		World::WorldData& world_data = *world.world_data;
+		entt::registry& registry = world_data.registry;
+
+		// Clearing a pool that can't be captured would drop its components without giving their owners (e.g. Physics) a chance to
+		// unregister them.
+		for (auto&& [id, storage] : registry.storage())
+		{
+			if (storage.empty())
+			{
+				continue;
+			}
+
+			const entt::type_info& type = storage.type();
+			const impl::ComponentTypeInfo* info = impl::find_component_type(type.hash());
+			if (!info || !info->copy_out || id != type.hash())
+			{
+				LOG_ERROR("ECS> Can't restore world snapshot over component pool '%.*s'", (int)type.name().size(), type.name().data());
+				return false;
+			}
+		}
+
+		// Every current component is dropped, the snapshot's copies replace them. Slim components are released by the on_destroy
+		// signal of clear().
+		for (auto&& [id, storage] : registry.storage())
+		{
+			const impl::ComponentTypeInfo* info = impl::find_component_type(storage.type().hash());
+			if (!info || !info->releasable || info->size == 0)
+			{
+				continue;
+			}
+
+			for (Entity::Handle handle : storage)
+			{
+				IReleasable* component = reinterpret_cast<IReleasable*>(storage.get(handle));
+				ASSERT(component != nullptr);
+				component->release();
+			}
+		}
+
+		registry.clear();
+		registry.assign(entities, entities + num_entities, released);
+
+		for (const Pool& pool : pools)
+		{
+			pool.info->copy_in(registry, pool.entities, pool.count, pool.components);
+		}
+
+		rebuild_entity_hierarchy(registry);
+
+		{
+			Lock _lock{ world_data.sync };
+
+			for (auto it = world_data.entity_datas.begin(); it != world_data.entity_datas.end();)
+			{
+				it = registry.valid(it->first) ? std::next(it) : world_data.entity_datas.erase(it);
+			}
+
+			for (const ref<Entity::EcsData>& data : entity_datas)
+			{
+				world_data.entity_datas.try_emplace(data->entity_handle, data);
+			}
+		}
+
+		// Components owning outside objects (e.g. PhysX actors) re-create them last, they may look up other components and entities.
+		std::vector<const Pool*> restored_pools;
+		for (const Pool& pool : pools)
+		{
+			if (pool.info->restore_pool)
+			{
+				restored_pools.push_back(&pool);
+			}
+		}
+
+		std::stable_sort(restored_pools.begin(), restored_pools.end(), [](const Pool* a, const Pool* b)
+			{
+				return a->info->restore_order < b->info->restore_order;
+			});
+
+		for (const Pool* pool : restored_pools)
+		{
+			pool->info->restore_pool(registry);
+		}
+
+		return true;
+	}
+
+	void WorldSnapshot::clear()
+	{
+		for (Pool& pool : pools)
+		{
+			if (pool.components && pool.info->destroy)
+			{
+				pool.info->destroy(pool.components, pool.count);
+			}
+		}
+
+		pools.clear();
+		entity_datas.clear();
+
+		entities = nullptr;
+		num_entities = 0;
+		released = Entity::NullHandle;
+		complete = true;
+
+		if (arena_initialized)
+		{
+			// Keeps the committed memory for the next capture.
+			arena.reset();
+		}
+	}
+
+	uint64 WorldSnapshot::get_memory_size() const
+	{
+		return arena_initialized ? (uint64)((uint8*)arena.get_current() - arena.base()) : 0;
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "core_api.h"
+
+#include "core/memory.h"
+
+#include "ecs/entity.h"
+
+namespace era_engine
+{
+	class World;
+
+	// Copy of a world's registry: the entity pool and every component pool, copied wholesale in packed order. Trivially copyable
+	// components are memcpy'd page by page, everything else goes through its copy constructor. The copies live in an arena that is
+	// reused by the next capture, so repeated snapshots (play-in-editor, rollback, debug captures) don't allocate.
+	//
+	// Restore replaces the world's registry contents with the snapshot. Components it drops are released first, restored components
+	// that own outside objects re-create them (see has_snapshot_restore_v). Pools of snapshot excluded components (see
+	// is_snapshot_excluded_v) and of unregistered or non-copyable types can't be captured: a snapshot taken while such a pool is
+	// populated, or restored over a world that has one, fails instead of leaking or dangling. Context variables and any state outside
+	// the registry are not captured, e.g. velocities of physics bodies start from rest.
+	class ERA_CORE_API WorldSnapshot final
+	{
+	public:
+		WorldSnapshot() = default;
+		~WorldSnapshot();
+
+		WorldSnapshot(const WorldSnapshot&) = delete;
+		WorldSnapshot& operator=(const WorldSnapshot&) = delete;
+
+		void capture(World& world);
+
+		// Returns false, leaving the world untouched, if the snapshot or the world contains pools that can't be captured.
+		bool restore(World& world) const;
+
+		void clear();
+
+		NODISCARD bool empty() const { return num_entities == 0 && pools.empty(); }
+
+		NODISCARD uint64 get_memory_size() const;
+
+	private:
+		struct Pool
+		{
+			entt::id_type id = 0;
+			const impl::ComponentTypeInfo* info = nullptr;
+			Entity::Handle* entities = nullptr;
+			void* components = nullptr;
+			uint32 count = 0;
+		};
+
+		Allocator arena;
+		bool arena_initialized = false;
+
+		Entity::Handle* entities = nullptr;
+		uint32 num_entities = 0;
+		Entity::Handle released = Entity::NullHandle;
+
+		// False if a populated pool was skipped by capture.
+		bool complete = true;
+
+		std::vector<Pool> pools;
+		std::vector<ref<Entity::EcsData>> entity_datas;
+	};
+}
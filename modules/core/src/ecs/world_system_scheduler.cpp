@@ -5,6 +5,7 @@
 #include "ecs/reflection.h"
 #include "ecs/system.h"
 #include "ecs/world.h"
+#include "ecs/command_buffer.h"
 #include "ecs/update_groups.h"
 
 #include <rttr/policy.h>
@@ -99,6 +100,8 @@ namespace era_engine
 		JobHandle after_render_handle = high_priority_job_queue.createJob<UpdateParams>(simulation_task, { updates[update_types::AFTER_RENDER.name], elapsed });
 		after_render_handle.submit_after(render_handle);
 		after_render_handle.wait_for_completion();
+
+		world->get_command_buffer().playback();
 	}
 
 	void WorldSystemScheduler::physics_update(float elapsed)
@@ -121,6 +124,8 @@ namespace era_engine
 		JobHandle after_physics_handle = high_priority_job_queue.createJob<UpdateParams>(simulation_task, { updates[update_types::AFTER_PHYSICS.name], elapsed });
 		after_physics_handle.submit_after(physics_handle);
 		after_physics_handle.wait_for_completion();
+
+		world->get_command_buffer().playback();
 	}
 
 	void WorldSystemScheduler::end(float elapsed)
@@ -142,6 +147,8 @@ namespace era_engine
 		JobHandle end_handle = high_priority_job_queue.createJob<UpdateParams>(simulation_task, { updates[group.name], elapsed });
 		end_handle.submit_now();
 		end_handle.wait_for_completion();
+
+		world->get_command_buffer().playback();
 	}
 
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "editor/editor.h"
 #include "editor/system_calls.h"
+#include "editor/file_dialog.h"
 
 #include "core/cpu_profiling.h"
 #include "core/log.h"
@@ -32,6 +33,7 @@
 #include "ecs/world.h"
 #include "ecs/rendering/mesh_component.h"
 #include "ecs/editor/entity_editor_utils.h"
+#include "ecs/world_serializer.h"
 
 //#include "physics/core/physics.h"
 //#include "physics/body_component.h"
@@ -1091,40 +1093,54 @@ namespace era_engine
 
 	void eeditor::serializeToFile()
 	{
-		//serializeSceneToYAMLFile(*scene, renderer->settings);
+		if (scene->save_path.empty())
+		{
+			std::string filename = saveFileDialog("Scene files", "world");
+			if (filename.empty())
+			{
+				return;
+			}
+			scene->save_path = filename;
+		}
+
+		WorldSerializer::save(*scene->get_current_world(), scene->save_path);
 	}
 
 	bool eeditor::deserializeFromFile()
 	{
-		////std::string environmentName;
-		////if (deserializeSceneFromYAMLFile(*scene, renderer->settings, environmentName))
-		////{
-		////	scene->stop();
-
-		////	setSelectedEntity({});
-		////	scene->environment.setFromTexture(environmentName);
-		////	scene->environment.forceUpdate(this->scene->sun.direction);
-		////	renderer->pathTracer.resetRendering();
-
-		////	return true;
-		////}
-		return false;
+		std::string filename = openFileDialog("Scene files", "world");
+		if (filename.empty())
+		{
+			return false;
+		}
+
+		return deserializeFromCurrentFile(filename);
 	}
 
 	bool eeditor::deserializeFromCurrentFile(const fs::path& path)
 	{
-		//std::string environmentName;
-		//if (deserializeSceneFromCurrentYAMLFile(path, *scene, renderer->settings, environmentName))
-		//{
-		//	scene->stop();
+		scene->stop();
+		setSelectedEntity({});
 
-		//	setSelectedEntity({});
-		//	scene->environment.setFromTexture(environmentName);
-		//	scene->environment.forceUpdate(this->scene->sun.direction);
-		//	renderer->pathTracer.resetRendering();
+		ref<World> world = scene->get_current_world();
 
-		//	return true;
-		//}
+		const Entity::Handle root = world->get_root_entity().get_handle();
+		std::vector<Entity::Handle> entities;
+		world->for_each_entity([&](Entity::Handle handle) { entities.push_back(handle); });
+		for (Entity::Handle handle : entities)
+		{
+			if (handle != root)
+			{
+				world->destroy_entity(handle, false);
+			}
+		}
+
+		if (WorldSerializer::load(*world, path))
+		{
+			scene->save_path = path;
+			renderer->pathTracer.resetRendering();
+			return true;
+		}
 		return false;
 	}
 
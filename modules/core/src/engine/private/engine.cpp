@@ -4,10 +4,14 @@
 #include "core/imgui.h"
 #include "core/cpu_profiling.h"
 #include "core/job_system.h"
+#include "core/sync.h"
+#include "core/memory.h"
+#include "core/memory_tracking.h"
 
 #include "dx/dx_context.h"
 #include "dx/dx_command_list.h"
 #include "dx/dx_profiling.h"
+#include "dx/dx_texture_streaming.h"
 
 #include "window/dx_window.h"
 
@@ -170,6 +174,7 @@ namespace era_engine
 
 		initialize_job_system();
 		initializeFileRegistry();
+		initializeTextureStreaming();
 
 		dx_window window;
 		window.initialize(TEXT("  New Project - Era Engine - 0.1432v1 - <DX12>"), 1920, 1080);
@@ -334,6 +339,8 @@ namespace era_engine
 				window.toggleFullscreen(); // Also allowed if not focused on main window.
 			}
 
+			updateTextureStreaming();
+
 			scheduler->begin(dt);
 
 			renderer.beginFrame(renderWidth, renderHeight);
@@ -372,12 +379,27 @@ namespace era_engine
 				LOG_MESSAGE("Saved screenshot to '%ws'", path.c_str());
 			}
 
+			if (input.keyboard['M'].press_event && input.keyboard[key_ctrl].down && input.keyboard[key_shift].down)
+			{
+				const fs::path dir = "captures";
+				fs::create_directories(dir);
+
+				fs::path path = dir / ("memory_" + get_time_string() + ".json");
+				if (write_memory_snapshot(path))
+				{
+					LOG_MESSAGE("Saved memory snapshot to '%ws'", path.c_str());
+				}
+			}
+
 			fileBrowser.draw();
 
 			ImGui::End();
 
 			renderToMainWindow(window);
 
+			report_lock_stats();
+			advance_frame_arenas();
+			update_memory_tracking(dt);
 			cpu_profiling_frame_end_marker();
 
 			++frameID;
@@ -6,6 +6,7 @@
 
 #include "core/hash.h"
 #include "core/string.h"
+#include "core/memory.h"
 
 #include "asset/file_registry.h"
 #include "asset/model_asset.h"
@@ -44,7 +45,10 @@ namespace era_engine
 		result->aabb = bounding_box::negativeInfinity();
 
 		ModelAsset asset = load_3d_model_from_file(sceneFilename);
-		mesh_builder builder(flags | mesh_creation_flags_with_skin);
+
+		// Compressed layouts can't be skinned, so compressed imports drop the skin weights.
+		const uint32 builderFlags = (flags & mesh_creation_flags_compressed) ? (flags & ~mesh_creation_flags_with_skin) : (flags | mesh_creation_flags_with_skin);
+		mesh_builder builder(builderFlags);
 
 		for (auto& mesh : asset.meshes)
 		{
@@ -91,7 +95,10 @@ namespace era_engine
 
 			skeleton.joints = std::move(in.joints);
 			skeleton.nameToJointID = std::move(in.name_to_joint_id);
-			skeleton.analyzeJoints(builder.getPositions(), (uint8*)builder.getOthers() + builder.getSkinOffset(), builder.getOthersSize(), builder.getNumVertices());
+			if (builderFlags & mesh_creation_flags_with_skin)
+			{
+				skeleton.analyzeJoints(builder.getPositions(), (uint8*)builder.getOthers() + builder.getSkinOffset(), builder.getOthersSize(), builder.getNumVertices());
+			}
 		}
 
 		// Load animations
@@ -133,6 +140,8 @@ namespace era_engine
 		result->loadState.store(AssetLoadState::LOADED, std::memory_order_release);
 	}
 
+	static void updateCachedMeshSize(AssetHandle handle, uint32 flags);
+
 	static ref<multi_mesh> loadMeshFromFileInternal(const fs::path& sceneFilename, AssetHandle handle, uint32 flags, mesh_load_callback cb,
 		bool async, JobHandle parentJob)
 	{
@@ -164,6 +173,7 @@ namespace era_engine
 			JobHandle job = low_priority_job_queue.createJob<mesh_loading_data>([](mesh_loading_data& data, JobHandle job)
 				{
 					meshLoaderThread(data.mesh, data.path, data.flags, data.cb, true, job);
+					updateCachedMeshSize(data.mesh->handle, data.flags);
 				}, data, parentJob);
 			job.submit_now();
 
@@ -178,8 +188,24 @@ namespace era_engine
 		return a.handle == b.handle && a.flags == b.flags;
 	}
 
-	static std::unordered_map<mesh_key, weakref<multi_mesh>> meshCache;
-	static std::mutex mutex;
+	static uint64 getMeshMemorySize(const multi_mesh& mesh)
+	{
+		uint64 size = 0;
+		if (mesh.mesh.vertexBuffer.positions)
+			size += mesh.mesh.vertexBuffer.positions->totalSize;
+		if (mesh.mesh.vertexBuffer.others)
+			size += mesh.mesh.vertexBuffer.others->totalSize;
+		if (mesh.mesh.indexBuffer)
+			size += mesh.mesh.indexBuffer->totalSize;
+		return size;
+	}
+
+	static AssetCache<mesh_key, multi_mesh> meshCache(getMeshMemorySize, MB(128), memory_tag_meshes);
+
+	static void updateCachedMeshSize(AssetHandle handle, uint32 flags)
+	{
+		meshCache.update_size({ handle, flags });
+	}
 
 	static ref<multi_mesh> loadMeshFromFileAndHandle(const fs::path& filename, AssetHandle handle, uint32 flags, mesh_load_callback cb,
 		bool async = false, JobHandle parentJob = {})
@@ -189,17 +215,20 @@ namespace era_engine
 
 		mesh_key key = { handle, flags };
 
-		mutex.lock();
+		return meshCache.get_or_load(key, [&]()
+			{
+				return loadMeshFromFileInternal(filename, handle, flags, cb, async, parentJob);
+			});
+	}
 
-		ref<multi_mesh> result = { meshCache[key].lock(), {} };
-		if (!result)
-		{
-			result = loadMeshFromFileInternal(filename, handle, flags, cb, async, parentJob);
-			meshCache[key] = result;
-		}
+	void setMeshCacheBudget(uint64 budget)
+	{
+		meshCache.set_budget(budget);
+	}
 
-		mutex.unlock();
-		return result;
+	NODISCARD AssetCacheStats getMeshCacheStats()
+	{
+		return meshCache.get_stats();
 	}
 
 	NODISCARD ref<multi_mesh> loadMeshFromFile(const fs::path& filename, uint32 flags, mesh_load_callback cb)
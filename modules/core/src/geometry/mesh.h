@@ -6,6 +6,7 @@
 #include "core/bounding_volumes.h"
 
 #include "asset/asset.h"
+#include "asset/asset_cache.h"
 #include "asset/pbr_material_desc.h"
 
 #include "animation/animation.h"
@@ -42,6 +43,10 @@ namespace era_engine
 
 	using mesh_load_callback = std::function<void(mesh_builder& builder, std::vector<submesh>& submeshes, const bounding_box& boundingBox)>;
 
+	// Recently used meshes are kept alive up to the mesh cache budget (128 MB of GPU buffers by default).
+	void setMeshCacheBudget(uint64 budget);
+	NODISCARD AssetCacheStats getMeshCacheStats();
+
 	NODISCARD ref<multi_mesh> loadMeshFromFile(const fs::path& filename, uint32 flags = mesh_creation_flags_default, mesh_load_callback cb = nullptr);
 	NODISCARD ref<multi_mesh> loadMeshFromHandle(AssetHandle handle, uint32 flags = mesh_creation_flags_default, mesh_load_callback cb = nullptr);
 	NODISCARD ref<multi_mesh> loadMeshFromFileAsync(const fs::path& filename, uint32 flags = mesh_creation_flags_default, JobHandle parentJob = {}, mesh_load_callback cb = nullptr);
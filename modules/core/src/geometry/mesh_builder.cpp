@@ -4,6 +4,8 @@
 
 #include "core/color.h"
 
+#include "geometry/vertex_compression.h"
+
 #include "asset/model_asset.h"
 
 #define pushVertex(pos, uv, nor, tan, skin, col) \
@@ -33,22 +35,25 @@ namespace era_engine
 		uint32 skinOffset;
 	};
 
+	// The builder keeps full precision vertices, compression is only applied to the GPU buffers.
 	static vertex_info getVertexInfo(uint32 flags)
 	{
+		const uint32 fullPrecisionFlags = flags & ~mesh_creation_flags_compressed;
+
 		vertex_info result = {};
-		if (flags & mesh_creation_flags_with_uvs) { result.othersSize += sizeof(vec2); }
-		if (flags & mesh_creation_flags_with_normals) { result.othersSize += sizeof(vec3); }
-		if (flags & mesh_creation_flags_with_tangents) { result.othersSize += sizeof(vec3); }
-		if (flags & mesh_creation_flags_with_skin) { result.skinOffset = result.othersSize;	result.othersSize += sizeof(SkinningWeights); }
-		if (flags & mesh_creation_flags_with_colors) { result.othersSize += sizeof(uint32); }
+		result.othersSize = getVertexOthersSize(fullPrecisionFlags);
+		if (flags & mesh_creation_flags_with_skin)
+		{
+			result.skinOffset = getVertexOthersSize(fullPrecisionFlags & (mesh_creation_flags_with_uvs | mesh_creation_flags_with_normals | mesh_creation_flags_with_tangents));
+		}
 		return result;
 	}
 
 	mesh_builder::mesh_builder(uint32 vertexFlags, mesh_index_type indexType)
 	{
-		positionArena.initialize(0, GB(2));
-		othersArena.initialize(0, GB(2));
-		indexArena.initialize(0, GB(2));
+		positionArena.initialize(0, GB(2), memory_tag_meshes);
+		othersArena.initialize(0, GB(2), memory_tag_meshes);
+		indexArena.initialize(0, GB(2), memory_tag_meshes);
 
 		this->vertexFlags = vertexFlags;
 		this->indexType = indexType;
@@ -57,6 +62,8 @@ namespace era_engine
 		vertex_info info = getVertexInfo(vertexFlags);
 		othersSize = info.othersSize;
 		skinOffset = info.skinOffset;
+
+		ASSERT(!(vertexFlags & mesh_creation_flags_with_skin) || !(vertexFlags & mesh_creation_flags_compressed));
 	}
 
 	mesh_builder::~mesh_builder()
@@ -1332,6 +1339,21 @@ namespace era_engine
 		result.numIndices = numTrianglesInCurrentSubmesh * 3;
 		result.baseVertex = firstVertex;
 		result.numVertices = numVerticesInCurrentSubmesh;
+		result.quantizationBox = bounding_box::fromMinMax(vec3(0.f), vec3(0.f));
+
+		if (vertexFlags & mesh_creation_flags_quantized_positions)
+		{
+			const vec3* positions = getPositions() + firstVertex;
+
+			bounding_box box = bounding_box::negativeInfinity();
+			for (uint32 i = 0; i < numVerticesInCurrentSubmesh; ++i)
+			{
+				box.grow(positions[i]);
+			}
+			result.quantizationBox = box;
+
+			submeshInfos.push_back(result);
+		}
 
 		totalNumVertices += numVerticesInCurrentSubmesh;
 		totalNumTriangles += numTrianglesInCurrentSubmesh;
@@ -1356,6 +1378,11 @@ namespace era_engine
 
 	dx_mesh mesh_builder::createDXMesh()
 	{
+		if (vertexFlags & mesh_creation_flags_compressed)
+		{
+			return createCompressedDXMesh();
+		}
+
 		if (numVerticesInCurrentSubmesh > 0)
 		{
 			endSubmesh();
@@ -1371,6 +1398,80 @@ namespace era_engine
 		return result;
 	}
 
+	dx_mesh mesh_builder::createCompressedDXMesh()
+	{
+		if (numVerticesInCurrentSubmesh > 0)
+		{
+			endSubmesh();
+		}
+
+		const uint32 positionSize = getVertexPositionSize(vertexFlags);
+		const uint32 compressedOthersSize = getVertexOthersSize(vertexFlags);
+
+		Allocator compressedArena;
+		compressedArena.initialize(0, (uint64)(positionSize + compressedOthersSize) * totalNumVertices + KB(4));
+
+		uint8* compressedPositions = (uint8*)compressedArena.allocate((uint64)positionSize * totalNumVertices, 16);
+		uint8* compressedOthers = (uint8*)compressedArena.allocate((uint64)compressedOthersSize * totalNumVertices, 16);
+
+		const vec3* positions = getPositions();
+		if (vertexFlags & mesh_creation_flags_quantized_positions)
+		{
+			quantized_position* out = (quantized_position*)compressedPositions;
+			for (const submesh_info& info : submeshInfos)
+			{
+				for (uint32 i = info.baseVertex; i < info.baseVertex + info.numVertices; ++i)
+				{
+					out[i] = quantizePosition(positions[i], info.quantizationBox);
+				}
+			}
+		}
+		else
+		{
+			memcpy(compressedPositions, positions, sizeof(vec3) * totalNumVertices);
+		}
+
+		// Same member order as pushVertex.
+		const uint8* src = (const uint8*)getOthers();
+		uint8* dst = compressedOthers;
+		for (uint32 i = 0; i < totalNumVertices; ++i)
+		{
+			if (vertexFlags & mesh_creation_flags_with_uvs)
+			{
+				vec2 uv = *(const vec2*)src; src += sizeof(vec2);
+				if (vertexFlags & mesh_creation_flags_compressed_uvs) { *(half_uv*)dst = compressUV(uv); dst += sizeof(half_uv); }
+				else { *(vec2*)dst = uv; dst += sizeof(vec2); }
+			}
+			if (vertexFlags & mesh_creation_flags_with_normals)
+			{
+				vec3 normal = *(const vec3*)src; src += sizeof(vec3);
+				if (vertexFlags & mesh_creation_flags_compressed_normals) { *(oct_vector*)dst = compressUnitVector(normal); dst += sizeof(oct_vector); }
+				else { *(vec3*)dst = normal; dst += sizeof(vec3); }
+			}
+			if (vertexFlags & mesh_creation_flags_with_tangents)
+			{
+				vec3 tangent = *(const vec3*)src; src += sizeof(vec3);
+				if (vertexFlags & mesh_creation_flags_compressed_normals) { *(oct_vector*)dst = compressUnitVector(tangent); dst += sizeof(oct_vector); }
+				else { *(vec3*)dst = tangent; dst += sizeof(vec3); }
+			}
+			if (vertexFlags & mesh_creation_flags_with_colors)
+			{
+				*(uint32*)dst = *(const uint32*)src; src += sizeof(uint32); dst += sizeof(uint32);
+			}
+		}
+
+		ASSERT(dst == compressedOthers + (uint64)compressedOthersSize * totalNumVertices);
+
+		dx_mesh result;
+		result.vertexBuffer.positions = createVertexBuffer(positionSize, totalNumVertices, compressedPositions);
+		if ((vertexFlags & ~mesh_creation_flags_compressed) != mesh_creation_flags_with_positions)
+		{
+			result.vertexBuffer.others = createVertexBuffer(compressedOthersSize, totalNumVertices, compressedOthers, true);
+		}
+		result.indexBuffer = createIndexBuffer(indexSize, totalNumTriangles * 3, indexArena.base());
+		return result;
+	}
+
 	std::tuple<vec3*, uint8*, uint8*, uint32> mesh_builder::beginPrimitive(uint32 numVertices, uint32 numTriangles)
 	{
 		vec3* positionPtr = (vec3*)positionArena.allocate(sizeof(vec3) * numVertices);
@@ -20,6 +20,9 @@ namespace era_engine
 		uint32 firstIndex;
 		uint32 baseVertex;
 		uint32 numVertices;
+
+		// Only set for meshes created with mesh_creation_flags_quantized_positions. See getPositionDequantizationMatrix.
+		bounding_box quantizationBox;
 	};
 
 	// Members are always pushed in this order!
@@ -33,8 +36,17 @@ namespace era_engine
 		mesh_creation_flags_with_skin = (1 << 4),
 		mesh_creation_flags_with_colors = (1 << 5),
 
+		// Compressed GPU vertex layouts. The builder itself keeps full precision data, only the buffers created in createDXMesh are compressed.
+		// Opt-in: the built-in render pipelines read the full precision layout, see createCompressedDXMesh for what drawing these needs.
+		// Not supported for skinned meshes, since the skinning shader reads full precision vertices.
+		mesh_creation_flags_compressed_normals = (1 << 6),		// Octahedral normals and tangents (R16G16_SNORM each).
+		mesh_creation_flags_compressed_uvs = (1 << 7),			// Half-float UVs (R16G16_FLOAT).
+		mesh_creation_flags_quantized_positions = (1 << 8),	// Positions relative to the submesh AABB (R16G16B16A16_UNORM).
+
 		mesh_creation_flags_default = mesh_creation_flags_with_positions | mesh_creation_flags_with_uvs | mesh_creation_flags_with_normals | mesh_creation_flags_with_tangents,
 		mesh_creation_flags_animated = mesh_creation_flags_default | mesh_creation_flags_with_skin,
+		mesh_creation_flags_compressed = mesh_creation_flags_compressed_normals | mesh_creation_flags_compressed_uvs | mesh_creation_flags_quantized_positions,
+		mesh_creation_flags_default_compressed = mesh_creation_flags_default | mesh_creation_flags_compressed,
 	};
 
 	enum mesh_index_type
@@ -152,12 +164,20 @@ namespace era_engine
 		uint32 slices = 15;
 	};
 
+	// Sizes of the GPU vertex layout, including compression.
+	NODISCARD inline constexpr uint32 getVertexPositionSize(uint32 meshFlags)
+	{
+		return (meshFlags & mesh_creation_flags_quantized_positions) ? 4 * sizeof(uint16) : sizeof(vec3);
+	}
+
 	NODISCARD inline constexpr uint32 getVertexOthersSize(uint32 meshFlags)
 	{
+		const uint32 unitVectorSize = (meshFlags & mesh_creation_flags_compressed_normals) ? 2 * sizeof(int16) : sizeof(vec3);
+
 		uint32 size = 0;
-		if (meshFlags & mesh_creation_flags_with_uvs) { size += sizeof(vec2); }
-		if (meshFlags & mesh_creation_flags_with_normals) { size += sizeof(vec3); }
-		if (meshFlags & mesh_creation_flags_with_tangents) { size += sizeof(vec3); }
+		if (meshFlags & mesh_creation_flags_with_uvs) { size += (meshFlags & mesh_creation_flags_compressed_uvs) ? 2 * sizeof(uint16) : sizeof(vec2); }
+		if (meshFlags & mesh_creation_flags_with_normals) { size += unitVectorSize; }
+		if (meshFlags & mesh_creation_flags_with_tangents) { size += unitVectorSize; }
 		if (meshFlags & mesh_creation_flags_with_skin) { size += sizeof(era_engine::animation::SkinningWeights); }
 		if (meshFlags & mesh_creation_flags_with_colors) { size += sizeof(uint32); }
 		return size;
@@ -186,8 +206,13 @@ namespace era_engine
 
 		submesh_info endSubmesh();
 
+		// Layout selected by the compression flags. Without them this is the full precision layout, which all built-in pipelines expect.
 		dx_mesh createDXMesh();
 
+		// Layout selected by the compression flags. Pipelines drawing these buffers need inputLayout_compressed_position_uv_normal_tangent and the
+		// decoders in vertex_compression.hlsli, and must apply getPositionDequantizationMatrix(submesh.quantizationBox) before the model matrix.
+		dx_mesh createCompressedDXMesh();
+
 		NODISCARD vec3* getPositions() { return (vec3*)positionArena.base(); }
 		NODISCARD void* getOthers() { return othersArena.base(); }
 		NODISCARD void* getTriangles() { return indexArena.base(); }
@@ -217,6 +242,8 @@ namespace era_engine
 		uint32 numTrianglesInCurrentSubmesh = 0;
 
 		uint32 numSubmeshes = 0;
+
+		std::vector<submesh_info> submeshInfos; // Only recorded for quantized positions.
 	};
 
 	struct vertex_uv_normal_tangent
@@ -258,6 +285,14 @@ namespace era_engine
 		{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 	};
 
+	static D3D12_INPUT_ELEMENT_DESC inputLayout_compressed_position_uv_normal_tangent[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORDS", 0, DXGI_FORMAT_R16G16_FLOAT, 1, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 1, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 1, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+	};
+
 	static D3D12_INPUT_ELEMENT_DESC inputLayout_position_uv_normal_tangent_colors[] =
 	{
 		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
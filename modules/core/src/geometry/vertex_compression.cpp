@@ -0,0 +1,95 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#include "geometry/vertex_compression.h"
+
+namespace era_engine
+{
+	static float signNotZero(float v)
+	{
+		return (v >= 0.f) ? 1.f : -1.f;
+	}
+
+	static int16 floatToSnorm16(float v)
+	{
+		v = clamp(v, -1.f, 1.f);
+		return (int16)round(v * 32767.f);
+	}
+
+	static float snorm16ToFloat(int16 v)
+	{
+		// Same as the hardware conversion, -32768 and -32767 both map to -1.
+		return max((float)v / 32767.f, -1.f);
+	}
+
+	vec2 encodeOctahedral(vec3 dir)
+	{
+		float l1Norm = abs(dir.x) + abs(dir.y) + abs(dir.z);
+		vec2 result = vec2(dir.x, dir.y) * (1.f / l1Norm);
+
+		if (dir.z < 0.f)
+		{
+			result = vec2(
+				(1.f - abs(result.y)) * signNotZero(result.x),
+				(1.f - abs(result.x)) * signNotZero(result.y));
+		}
+
+		return result;
+	}
+
+	vec3 decodeOctahedral(vec2 o)
+	{
+		vec3 v = vec3(o.x, o.y, 1.f - abs(o.x) - abs(o.y));
+		if (v.z < 0.f)
+		{
+			float x = v.x;
+			v.x = (1.f - abs(v.y)) * signNotZero(x);
+			v.y = (1.f - abs(x)) * signNotZero(v.y);
+		}
+		return normalize(v);
+	}
+
+	oct_vector compressUnitVector(vec3 v)
+	{
+		vec2 o = encodeOctahedral(v);
+		return { floatToSnorm16(o.x), floatToSnorm16(o.y) };
+	}
+
+	vec3 decompressUnitVector(oct_vector o)
+	{
+		return decodeOctahedral(vec2(snorm16ToFloat(o.x), snorm16ToFloat(o.y)));
+	}
+
+	half_uv compressUV(vec2 uv)
+	{
+		return { half(uv.x), half(uv.y) };
+	}
+
+	vec2 decompressUV(half_uv uv)
+	{
+		return vec2((float)uv.u, (float)uv.v);
+	}
+
+	quantized_position quantizePosition(vec3 position, const bounding_box& box)
+	{
+		vec3 extent = box.maxCorner - box.minCorner;
+		vec3 t = position - box.minCorner;
+
+		quantized_position result;
+		result.x = (extent.x > 0.f) ? (uint16)round(clamp01(t.x / extent.x) * 65535.f) : 0;
+		result.y = (extent.y > 0.f) ? (uint16)round(clamp01(t.y / extent.y) * 65535.f) : 0;
+		result.z = (extent.z > 0.f) ? (uint16)round(clamp01(t.z / extent.z) * 65535.f) : 0;
+		result.w = 0;
+		return result;
+	}
+
+	vec3 dequantizePosition(quantized_position position, const bounding_box& box)
+	{
+		vec3 t = vec3((float)position.x, (float)position.y, (float)position.z) * (1.f / 65535.f);
+		return box.minCorner + t * (box.maxCorner - box.minCorner);
+	}
+
+	mat4 getPositionDequantizationMatrix(const bounding_box& box)
+	{
+		return create_model_matrix(box.minCorner, quat::identity, box.maxCorner - box.minCorner);
+	}
+}
@@ -0,0 +1,47 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#pragma once
+
+#include "core_api.h"
+
+#include "core/math.h"
+#include "core/bounding_volumes.h"
+
+namespace era_engine
+{
+	// Unit vector in octahedral encoding, stored as DXGI_FORMAT_R16G16_SNORM.
+	struct oct_vector
+	{
+		int16 x, y;
+	};
+
+	// UV stored as DXGI_FORMAT_R16G16_FLOAT.
+	struct half_uv
+	{
+		half u, v;
+	};
+
+	// Position relative to the submesh's AABB, stored as DXGI_FORMAT_R16G16B16A16_UNORM. w is padding.
+	struct quantized_position
+	{
+		uint16 x, y, z, w;
+	};
+
+	// [A Survey of Efficient Representations for Independent Unit Vectors]
+	// Maps between 3D direction and vec2 in [-1, 1]^2.
+	NODISCARD ERA_CORE_API vec2 encodeOctahedral(vec3 dir);
+	NODISCARD ERA_CORE_API vec3 decodeOctahedral(vec2 o);
+
+	NODISCARD ERA_CORE_API oct_vector compressUnitVector(vec3 v);
+	NODISCARD ERA_CORE_API vec3 decompressUnitVector(oct_vector o);
+
+	NODISCARD ERA_CORE_API half_uv compressUV(vec2 uv);
+	NODISCARD ERA_CORE_API vec2 decompressUV(half_uv uv);
+
+	// The box must contain the position. Degenerate axes decode to the box's minimum.
+	NODISCARD ERA_CORE_API quantized_position quantizePosition(vec3 position, const bounding_box& box);
+	NODISCARD ERA_CORE_API vec3 dequantizePosition(quantized_position position, const bounding_box& box);
+
+	// Maps the [0, 1] output of the UNORM vertex fetch back into the box. Apply this before the model matrix.
+	NODISCARD ERA_CORE_API mat4 getPositionDequantizationMatrix(const bounding_box& box);
+}
@@ -129,6 +129,8 @@ namespace era_engine
 			.property("numShadowCascades", &directional_light::numShadowCascades)
 			.property("stabilize", &directional_light::stabilize);
 
+		impl::ensure_component_type_registered<PointLightComponent>();
+
 		rttr::registration::class_<PointLightComponent>("PointLightComponent")
 			.constructor<>()
 			.property("color", &PointLightComponent::color)
@@ -137,6 +139,8 @@ namespace era_engine
 			.property("castsShadow", &PointLightComponent::castsShadow)
 			.property("shadowMapResolution", &PointLightComponent::shadowMapResolution);
 
+		impl::ensure_component_type_registered<SpotLightComponent>();
+
 		rttr::registration::class_<SpotLightComponent>("SpotLightComponent")
 			.constructor<>()
 			.property("color", &SpotLightComponent::color)
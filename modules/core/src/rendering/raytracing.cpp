@@ -560,6 +560,8 @@ namespace era_engine
 	RTTR_REGISTRATION
 	{
 		using namespace rttr;
+		impl::ensure_component_type_registered<RaytraceComponent>();
+
 		rttr::registration::class_<RaytraceComponent>("RaytraceComponent")
 			.constructor<>()
 			.constructor<ref<Entity::EcsData>, const raytracing_object_type&>()
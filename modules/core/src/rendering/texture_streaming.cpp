@@ -0,0 +1,290 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#include "rendering/texture_streaming.h"
+
+#include "core/memory.h"
+
+#include <algorithm>
+
+namespace era_engine
+{
+	void texture_streaming_manager::initialize(const texture_streaming_settings& settings)
+	{
+		this->settings = settings;
+	}
+
+	void texture_streaming_manager::setBudget(uint64 budget)
+	{
+		settings.budget = budget;
+	}
+
+	uint32 texture_streaming_manager::addTexture(uint32 numMips, const uint64* mipSizes, uint32 firstResidentMip)
+	{
+		ASSERT(numMips > 0);
+
+		uint32 index;
+		if (!freeTextures.empty())
+		{
+			index = freeTextures.back();
+			freeTextures.pop_back();
+		}
+		else
+		{
+			index = (uint32)textures.size();
+			textures.emplace_back();
+		}
+
+		streamed_texture& texture = textures[index];
+		texture.requestedMip.store(UINT32_MAX, std::memory_order_relaxed);
+		texture.numMips = numMips;
+		texture.tailMip = (numMips > settings.alwaysResidentMips) ? (numMips - settings.alwaysResidentMips) : 0;
+
+		texture.sizeFromMip.resize(numMips + 1);
+		texture.sizeFromMip[numMips] = 0;
+		for (int32 mip = (int32)numMips - 1; mip >= 0; --mip)
+		{
+			texture.sizeFromMip[mip] = texture.sizeFromMip[mip + 1] + mipSizes[mip];
+		}
+
+		texture.firstResidentMip = std::min(firstResidentMip, numMips - 1);
+		texture.requiredMip = texture.firstResidentMip;
+		texture.lastRequestedUpdate = updateIndex;
+		texture.pending = false;
+		texture.active = true;
+
+		residentSize += getResidentSize(texture);
+
+		return index;
+	}
+
+	void texture_streaming_manager::removeTexture(uint32 index)
+	{
+		streamed_texture& texture = textures[index];
+		ASSERT(texture.active);
+
+		residentSize -= getResidentSize(texture);
+		if (texture.pending)
+		{
+			--numPendingRequests;
+		}
+
+		texture.sizeFromMip.clear();
+		texture.pending = false;
+		texture.active = false;
+
+		freeTextures.push_back(index);
+	}
+
+	void texture_streaming_manager::requestMip(uint32 index, uint32 mip)
+	{
+		std::atomic<uint32>& requested = textures[index].requestedMip;
+
+		uint32 current = requested.load(std::memory_order_relaxed);
+		while (mip < current && !requested.compare_exchange_weak(current, mip, std::memory_order_relaxed));
+	}
+
+	bool texture_streaming_manager::makeRoom(uint64 size, uint32 loadingTexture, bool partial, std::vector<texture_streaming_request>& outRequests)
+	{
+		// Only detail beyond what a texture currently needs is given up.
+		FrameVector<uint32> candidates(get_frame_arena());
+		uint64 available = 0;
+
+		for (uint32 i = 0; i < (uint32)textures.size(); ++i)
+		{
+			const streamed_texture& texture = textures[i];
+			if (!texture.active || texture.pending || i == loadingTexture || texture.firstResidentMip >= texture.requiredMip)
+			{
+				continue;
+			}
+
+			candidates.push_back(i);
+			available += texture.sizeFromMip[texture.firstResidentMip] - texture.sizeFromMip[texture.requiredMip];
+		}
+
+		if (available < size && !partial)
+		{
+			return false;
+		}
+
+		std::sort(candidates.begin(), candidates.end(), [this](uint32 a, uint32 b)
+		{
+			return textures[a].lastRequestedUpdate < textures[b].lastRequestedUpdate;
+		});
+
+		uint64 freed = 0;
+		for (uint32 i : candidates)
+		{
+			if (freed >= size)
+			{
+				break;
+			}
+
+			streamed_texture& texture = textures[i];
+			const uint64 before = getResidentSize(texture);
+
+			outRequests.push_back({ i, texture.requiredMip, texture.firstResidentMip });
+			texture.firstResidentMip = texture.requiredMip;
+			texture.pending = true;
+			++numPendingRequests;
+			++numEvictionsLastUpdate;
+
+			const uint64 released = before - getResidentSize(texture);
+			residentSize -= released;
+			freed += released;
+		}
+
+		return true;
+	}
+
+	void texture_streaming_manager::update(std::vector<texture_streaming_request>& outRequests)
+	{
+		++updateIndex;
+
+		numLoadsLastUpdate = 0;
+		numEvictionsLastUpdate = 0;
+		numLoadsDeniedLastUpdate = 0;
+
+		FrameVector<uint32> loads(get_frame_arena());
+
+		for (uint32 i = 0; i < (uint32)textures.size(); ++i)
+		{
+			streamed_texture& texture = textures[i];
+			if (!texture.active)
+			{
+				continue;
+			}
+
+			const uint32 requested = texture.requestedMip.exchange(UINT32_MAX, std::memory_order_relaxed);
+			if (requested != UINT32_MAX)
+			{
+				texture.requiredMip = std::min(requested, texture.tailMip);
+				texture.lastRequestedUpdate = updateIndex;
+			}
+			else if (updateIndex - texture.lastRequestedUpdate > settings.framesUntilUnused)
+			{
+				texture.requiredMip = texture.tailMip;
+			}
+
+			if (!texture.pending && texture.requiredMip < texture.firstResidentMip)
+			{
+				loads.push_back(i);
+			}
+		}
+
+		// Over budget without any loads, e.g. after the budget was lowered.
+		if (residentSize > settings.budget)
+		{
+			makeRoom(residentSize - settings.budget, INVALID_TEXTURE, true, outRequests);
+		}
+
+		// Most missing mips first, then the cheapest.
+		std::sort(loads.begin(), loads.end(), [this](uint32 a, uint32 b)
+		{
+			const streamed_texture& ta = textures[a];
+			const streamed_texture& tb = textures[b];
+
+			const uint32 missingA = ta.firstResidentMip - ta.requiredMip;
+			const uint32 missingB = tb.firstResidentMip - tb.requiredMip;
+			if (missingA != missingB)
+			{
+				return missingA > missingB;
+			}
+			return ta.sizeFromMip[ta.requiredMip] < tb.sizeFromMip[tb.requiredMip];
+		});
+
+		uint64 uploadLeft = settings.maxUploadPerUpdate;
+
+		for (uint32 i : loads)
+		{
+			streamed_texture& texture = textures[i];
+			const uint64 currentSize = getResidentSize(texture);
+
+			// Go as far towards the required mip as the upload limit allows. One mip at a time is always allowed, as long as nothing
+			// else was loaded in this update.
+			uint32 target = texture.requiredMip;
+			while (target + 1 < texture.firstResidentMip && texture.sizeFromMip[target] - currentSize > uploadLeft)
+			{
+				++target;
+			}
+
+			const uint64 cost = texture.sizeFromMip[target] - currentSize;
+			if (cost > uploadLeft && numLoadsLastUpdate > 0)
+			{
+				continue;
+			}
+
+			if (residentSize + cost > settings.budget && !makeRoom(residentSize + cost - settings.budget, i, false, outRequests))
+			{
+				++numLoadsDeniedLastUpdate;
+				continue;
+			}
+
+			outRequests.push_back({ i, target, texture.firstResidentMip });
+			texture.firstResidentMip = target;
+			texture.pending = true;
+			++numPendingRequests;
+			++numLoadsLastUpdate;
+
+			residentSize += cost;
+			uploadLeft -= std::min(cost, uploadLeft);
+			if (uploadLeft == 0)
+			{
+				break;
+			}
+		}
+	}
+
+	void texture_streaming_manager::completeRequest(uint32 index, uint32 firstResidentMip)
+	{
+		streamed_texture& texture = textures[index];
+		ASSERT(texture.active && texture.pending);
+
+		firstResidentMip = std::min(firstResidentMip, texture.numMips - 1);
+
+		residentSize -= getResidentSize(texture);
+		texture.firstResidentMip = firstResidentMip;
+		residentSize += getResidentSize(texture);
+
+		texture.pending = false;
+		--numPendingRequests;
+	}
+
+	uint32 texture_streaming_manager::getFirstResidentMip(uint32 index) const
+	{
+		return textures[index].firstResidentMip;
+	}
+
+	texture_streaming_stats texture_streaming_manager::getStats() const
+	{
+		texture_streaming_stats stats;
+		stats.residentSize = residentSize;
+		stats.budget = settings.budget;
+		stats.numTextures = (uint32)(textures.size() - freeTextures.size());
+		stats.numPendingRequests = numPendingRequests;
+		stats.numLoadsLastUpdate = numLoadsLastUpdate;
+		stats.numEvictionsLastUpdate = numEvictionsLastUpdate;
+		stats.numLoadsDeniedLastUpdate = numLoadsDeniedLastUpdate;
+
+		for (const streamed_texture& texture : textures)
+		{
+			if (texture.active)
+			{
+				stats.requiredSize += texture.sizeFromMip[texture.requiredMip];
+			}
+		}
+
+		return stats;
+	}
+
+	uint32 texture_streaming_manager::computeRequiredMip(uint32 textureSize, float uvPerPixel, uint32 numMips)
+	{
+		const float texelsPerPixel = (float)textureSize * uvPerPixel;
+		if (!(texelsPerPixel > 1.f))
+		{
+			return 0;
+		}
+
+		const uint32 mip = (uint32)log2f(texelsPerPixel);
+		return std::min(mip, numMips - 1);
+	}
+}
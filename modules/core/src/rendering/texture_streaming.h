@@ -0,0 +1,111 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#pragma once
+
+#include "core_api.h"
+
+#include <atomic>
+#include <deque>
+
+namespace era_engine
+{
+	// Mip 0 is the most detailed mip. "Resident from mip m" means mips m..numMips-1 are in memory.
+
+	struct texture_streaming_settings
+	{
+		uint64 budget = 1024ull * 1024 * 1024;		// Bytes all streamed textures may occupy together.
+		uint64 maxUploadPerUpdate = 32ull * 1024 * 1024; // Bytes of mip data loaded per update.
+		uint32 alwaysResidentMips = 7;				// Mip tail that is never evicted (64x64 and smaller for a 4K texture).
+		uint32 framesUntilUnused = 60;				// Textures not requested for this many updates are evicted first.
+	};
+
+	struct texture_streaming_request
+	{
+		uint32 texture;
+		uint32 firstResidentMip;	// New first resident mip.
+		uint32 previousFirstMip;	// First resident mip before this request. Smaller than firstResidentMip for evictions.
+	};
+
+	struct texture_streaming_stats
+	{
+		uint64 residentSize = 0;
+		uint64 requiredSize = 0;		// Size if every texture was resident exactly from its required mip.
+		uint64 budget = 0;
+		uint32 numTextures = 0;
+		uint32 numPendingRequests = 0;
+		uint32 numLoadsLastUpdate = 0;
+		uint32 numEvictionsLastUpdate = 0;
+		uint32 numLoadsDeniedLastUpdate = 0; // Loads that didn't fit into the budget.
+	};
+
+	// Decides which mips of which textures should be in memory. Knows nothing about the graphics API: the backend registers textures
+	// with the sizes of their mips, renderers report the mip they need, and update() returns the load and evict requests for the backend
+	// to carry out.
+	//
+	// Each update, textures that need more detail are ordered by how many mips they are missing, and loaded as far as the per-update
+	// upload limit allows. When a load doesn't fit into the budget, textures that hold more detail than they currently need are trimmed
+	// to their required mip, least recently used first.
+	//
+	// addTexture, removeTexture, update and completeRequest must be called from one thread. requestMip may be called from any thread,
+	// but not concurrently with addTexture.
+	struct texture_streaming_manager
+	{
+		static constexpr uint32 INVALID_TEXTURE = UINT32_MAX;
+
+		void initialize(const texture_streaming_settings& settings);
+		void setBudget(uint64 budget);
+
+		// mipSizes holds the size in bytes of every mip of the full chain. The texture starts out resident from firstResidentMip.
+		NODISCARD uint32 addTexture(uint32 numMips, const uint64* mipSizes, uint32 firstResidentMip);
+		void removeTexture(uint32 texture);
+
+		// Reports that the texture is sampled at the given mip this frame. The most detailed report of an update wins.
+		void requestMip(uint32 texture, uint32 mip);
+
+		// Appends this update's requests to outRequests. Every request must be answered with completeRequest.
+		void update(std::vector<texture_streaming_request>& outRequests);
+
+		// Reports which mip the texture is actually resident from after a request (the requested one, or the previous one on failure).
+		void completeRequest(uint32 texture, uint32 firstResidentMip);
+
+		NODISCARD uint32 getFirstResidentMip(uint32 texture) const;
+		NODISCARD texture_streaming_stats getStats() const;
+
+		// Mip to sample for a texture whose largest dimension is textureSize, when one screen pixel covers uvPerPixel texture coordinates.
+		static NODISCARD uint32 computeRequiredMip(uint32 textureSize, float uvPerPixel, uint32 numMips);
+
+	private:
+		struct streamed_texture
+		{
+			std::atomic<uint32> requestedMip = UINT32_MAX;
+
+			std::vector<uint64> sizeFromMip; // Size of mips m..numMips-1, plus one trailing zero.
+			uint32 numMips = 0;
+			uint32 tailMip = 0;
+
+			uint32 firstResidentMip = 0;
+			uint32 requiredMip = 0;
+			uint64 lastRequestedUpdate = 0;
+
+			bool pending = false;
+			bool active = false;
+		};
+
+		NODISCARD uint64 getResidentSize(const streamed_texture& texture) const { return texture.sizeFromMip[texture.firstResidentMip]; }
+
+		bool makeRoom(uint64 size, uint32 loadingTexture, bool partial, std::vector<texture_streaming_request>& outRequests);
+
+		texture_streaming_settings settings;
+
+		std::deque<streamed_texture> textures;
+		std::vector<uint32> freeTextures;
+
+		uint64 residentSize = 0;
+		uint64 updateIndex = 0;
+		uint32 numPendingRequests = 0;
+
+		uint32 numLoadsLastUpdate = 0;
+		uint32 numEvictionsLastUpdate = 0;
+		uint32 numLoadsDeniedLastUpdate = 0;
+	};
+}
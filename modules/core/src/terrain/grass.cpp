@@ -267,6 +267,11 @@ namespace era_engine
 					for (uint32 x = 0; x < data.chunksPerDim; ++x)
 					{
 						auto& chunk = data.chunks[z * data.chunksPerDim + x];
+						if (!chunk.heightmap)
+						{
+							continue; // Not streamed in yet.
+						}
+
 						vec3 chunkMinCorner = minCorner + vec3(x * data.chunkSize, 0.f, z * data.chunkSize);
 						vec3 chunkMaxCorner = chunkMinCorner + chunkSize;
 
@@ -328,6 +333,8 @@ namespace era_engine
 	RTTR_REGISTRATION
 	{
 		using namespace rttr;
+		impl::ensure_component_type_registered<GrassComponent>();
+
 		rttr::registration::class_<GrassComponent>("GrassComponent")
 			.constructor<>()
 			.constructor<ref<Entity::EcsData>, const grass_settings&>()
@@ -106,6 +106,8 @@ namespace era_engine
 	RTTR_REGISTRATION
 	{
 		using namespace rttr;
+		impl::ensure_component_type_registered<ProcPlacementComponent>();
+
 		rttr::registration::class_<ProcPlacementComponent>("ProcPlacementComponent")
 			.constructor<>()
 			.constructor<ref<Entity::EcsData>, const std::vector<proc_placement_layer_desc>&>()
@@ -225,6 +227,11 @@ namespace era_engine
 					for (uint32 x = 0; x < terrain.chunksPerDim; ++x)
 					{
 						auto& chunk = terrain.chunk(x, z);
+						if (!chunk.heightmap)
+						{
+							continue; // Not streamed in yet.
+						}
+
 						vec3 chunkMinCorner = minCorner + vec3(x * terrain.chunkSize, 0.f, z * terrain.chunkSize);
 						vec3 chunkMaxCorner = chunkMinCorner + chunkSize;
 
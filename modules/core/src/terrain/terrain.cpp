@@ -16,6 +16,7 @@
 #include "rendering/render_algorithms.h"
 
 #include "core/random.h"
+#include "core/random_simd.h"
 #include "core/job_system.h"
 
 #include "ecs/component.h"
@@ -299,6 +300,9 @@ namespace era_engine
 	struct height_generator
 	{
 		fbm_noise_2D noiseFunc = value_noise;
+#if defined(SIMD_AVX_2)
+		w8_fbm_noise_2D noiseFuncW8 = value_noise; // Must be the wide version of noiseFunc.
+#endif
 
 		virtual float height(vec2 position) const = 0;
 		virtual vec2 grad(vec2 position) const = 0;
@@ -348,6 +352,40 @@ namespace era_engine
 
 			return grad;
 		}
+
+#if defined(SIMD_AVX_2)
+		// Same as the scalar versions above, for 8 positions at once.
+		w8_float height(w8_vec2 position) const
+		{
+			w8_vec2 fbmPosition = position * w8_float(settings.scale);
+
+			w8_vec3 domainWarpValue = fbm(noiseFuncW8, fbmPosition + w8_vec2(settings.domainWarpNoiseOffset.x, settings.domainWarpNoiseOffset.y), settings.domainWarpOctaves);
+
+			w8_float warp = domainWarpValue.x * settings.domainWarpStrength;
+			w8_vec2 warpedFbmPosition = fbmPosition + w8_vec2(warp, warp) + w8_vec2(settings.noiseOffset.x, settings.noiseOffset.y) + w8_vec2(1000.f, 1000.f);
+			w8_vec3 value = fbm(noiseFuncW8, warpedFbmPosition);
+
+			return fmadd(value.x, 0.5f, 0.5f);
+		}
+
+		w8_vec2 grad(w8_vec2 position) const
+		{
+			w8_vec2 fbmPosition = position * w8_float(settings.scale);
+
+			w8_vec3 domainWarpValue = fbm(noiseFuncW8, fbmPosition + w8_vec2(settings.domainWarpNoiseOffset.x, settings.domainWarpNoiseOffset.y), settings.domainWarpOctaves);
+
+			w8_float warp = domainWarpValue.x * settings.domainWarpStrength;
+			w8_vec2 warpedFbmPosition = fbmPosition + w8_vec2(warp, warp) + w8_vec2(settings.noiseOffset.x, settings.noiseOffset.y) + w8_vec2(1000.f, 1000.f);
+			w8_vec3 value = fbm(noiseFuncW8, warpedFbmPosition, settings.noiseOctaves);
+
+			// See the scalar version for the chain rule.
+			w8_float scale = 0.5f * settings.scale;
+			w8_float gradX = value.y * fmadd(domainWarpValue.y, settings.domainWarpStrength, 1.f) * scale;
+			w8_float gradY = value.z * fmadd(domainWarpValue.z, settings.domainWarpStrength, 1.f) * scale;
+
+			return w8_vec2(gradX, gradY);
+		}
+#endif
 	};
 
 	struct height_generator_layered : height_generator
@@ -422,9 +460,64 @@ namespace era_engine
 
 	const uint32 normalMapDimension = 2048;
 
+	static void generateChunkHeights(const height_generator_warped& generator, float chunkSize, vec2 minCorner, uint16* heights)
+	{
+		float positionScale = chunkSize / (float)(TERRAIN_LOD_0_VERTICES_PER_DIMENSION - 1);
+
+#if defined(SIMD_AVX_2)
+		const w8_float laneOffsets(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+#endif
+
+		for (uint32 z = 0; z < TERRAIN_LOD_0_VERTICES_PER_DIMENSION; ++z)
+		{
+			uint32 x = 0;
+
+#if defined(SIMD_AVX_2)
+			w8_float positionZ = w8_float(z * positionScale) + minCorner.y;
+			for (; x + 8 <= TERRAIN_LOD_0_VERTICES_PER_DIMENSION; x += 8)
+			{
+				w8_float positionX = (w8_float((float)x) + laneOffsets) * positionScale + minCorner.x;
+
+				alignas(32) float height[8];
+				generator.height(w8_vec2(positionX, positionZ)).store(height);
+
+				for (uint32 i = 0; i < 8; ++i)
+				{
+					ASSERT(height[i] >= 0.f);
+					ASSERT(height[i] <= 1.f);
+
+					heights[z * TERRAIN_LOD_0_VERTICES_PER_DIMENSION + x + i] = (uint16)(height[i] * UINT16_MAX);
+				}
+			}
+#endif
+
+			for (; x < TERRAIN_LOD_0_VERTICES_PER_DIMENSION; ++x)
+			{
+				vec2 position = vec2(x * positionScale, z * positionScale) + minCorner;
+
+				float height = generator.height(position);
+
+				ASSERT(height >= 0.f);
+				ASSERT(height <= 1.f);
+
+				heights[z * TERRAIN_LOD_0_VERTICES_PER_DIMENSION + x] = (uint16)(height * UINT16_MAX);
+			}
+		}
+	}
+
+	void generateTerrainChunkHeights(const terrain_generation_settings& settings, float chunkSize, int32 chunkX, int32 chunkZ, uint16* outHeights)
+	{
+		height_generator_warped generator;
+		generator.settings = settings;
+
+		generateChunkHeights(generator, chunkSize, vec2(chunkX * chunkSize, chunkZ * chunkSize), outHeights);
+	}
+
 	RTTR_REGISTRATION
 	{
 		using namespace rttr;
+		impl::ensure_component_type_registered<TerrainComponent>();
+
 		rttr::registration::class_<TerrainComponent>("TerrainComponent")
 			.constructor<>()
 			.property("genSettings", &TerrainComponent::genSettings);
@@ -450,8 +543,14 @@ namespace era_engine
 	{
 	}
 
-	void TerrainComponent::update()
+	void TerrainComponent::update(vec3 positionOffset, vec3 viewerPosition)
 	{
+		if (streaming)
+		{
+			update_streaming(positionOffset, viewerPosition);
+			return;
+		}
+
 		if (memcmp(&genSettings, &oldGenSettings, sizeof(terrain_generation_settings)) != 0)
 		{
 			generate_chunks_GPU();
@@ -509,6 +608,10 @@ namespace era_engine
 			for (int32 x = 0; x < (int32)chunksPerDim; ++x)
 			{
 				const terrain_chunk& c = chunk(x, z);
+				if (!c.heightmap)
+				{
+					continue; // Not streamed in yet.
+				}
 
 				int32 lod = lods[z * lodStride + x];
 
@@ -598,14 +701,11 @@ namespace era_engine
 						JobHandle job = high_priority_job_queue.createJob<chunk_gen_job_data>([](chunk_gen_job_data& data, JobHandle)
 							{
 								float chunkSize = data.terrain.chunkSize;
-								uint32 numSegmentsPerDim = TERRAIN_LOD_0_VERTICES_PER_DIMENSION - 1;
-								float positionScale = chunkSize / (float)numSegmentsPerDim;
 								float normalScale = chunkSize / (float)(normalMapDimension - 1);
 
 								int32 cx = data.cx;
 								int32 cz = data.cz;
 								height_generator_warped& generator = data.generator;
-								float amplitudeScale = data.terrain.amplitudeScale;
 
 								vec2 minCorner = vec2(cx * chunkSize, cz * chunkSize);
 
@@ -615,32 +715,37 @@ namespace era_engine
 								uint16* heights = c.heights.data();
 								vec2* normals = new vec2[normalMapDimension * normalMapDimension];
 
-								float minHeight = FLT_MAX;
-								float maxHeight = -FLT_MAX;
+								generateChunkHeights(generator, chunkSize, minCorner, heights);
 
-								for (uint32 z = 0; z < TERRAIN_LOD_0_VERTICES_PER_DIMENSION; ++z)
-								{
-									for (uint32 x = 0; x < TERRAIN_LOD_0_VERTICES_PER_DIMENSION; ++x)
-									{
-										vec2 position = vec2(x * positionScale, z * positionScale) + minCorner;
+								c.heightmap = createTexture(heights, TERRAIN_LOD_0_VERTICES_PER_DIMENSION, TERRAIN_LOD_0_VERTICES_PER_DIMENSION, DXGI_FORMAT_R16_UNORM, false, false, true, D3D12_RESOURCE_STATE_GENERIC_READ);
+								build_height_bounds(c);
 
-										float height = generator.height(position);
+#if defined(SIMD_AVX_2)
+								const w8_float laneOffsets(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+#endif
 
-										minHeight = min(minHeight, height * amplitudeScale);
-										maxHeight = max(maxHeight, height * amplitudeScale);
+								for (uint32 z = 0; z < normalMapDimension; ++z)
+								{
+									uint32 x = 0;
 
-										ASSERT(height >= 0.f);
-										ASSERT(height <= 1.f);
+#if defined(SIMD_AVX_2)
+									w8_float positionZ = w8_float(z * normalScale) + minCorner.y;
+									for (; x + 8 <= normalMapDimension; x += 8)
+									{
+										w8_float positionX = (w8_float((float)x) + laneOffsets) * normalScale + minCorner.x;
 
-										heights[z * TERRAIN_LOD_0_VERTICES_PER_DIMENSION + x] = (uint16)(height * UINT16_MAX);
-									}
-								}
+										alignas(32) float gradX[8];
+										alignas(32) float gradY[8];
+										generator.grad(w8_vec2(positionX, positionZ)).store(gradX, gradY);
 
-								c.heightmap = createTexture(heights, TERRAIN_LOD_0_VERTICES_PER_DIMENSION, TERRAIN_LOD_0_VERTICES_PER_DIMENSION, DXGI_FORMAT_R16_UNORM, false, false, true, D3D12_RESOURCE_STATE_GENERIC_READ);
+										for (uint32 i = 0; i < 8; ++i)
+										{
+											normals[z * normalMapDimension + x + i] = vec2(-gradX[i], -gradY[i]);
+										}
+									}
+#endif
 
-								for (uint32 z = 0; z < normalMapDimension; ++z)
-								{
-									for (uint32 x = 0; x < normalMapDimension; ++x)
+									for (; x < normalMapDimension; ++x)
 									{
 										vec2 position = vec2(x * normalScale, z * normalScale) + minCorner;
 
@@ -659,10 +764,12 @@ namespace era_engine
 			}, data);
 
 		parentJob.submit_now();
-		parentJob.wait_for_completion();
+
+		// Callers may hold thread-affine state across this call.
+		parentJob.wait_for_completion_on_this_thread();
 	}
 
-	void TerrainComponent::generate_chunks_GPU()
+	static terrain_generation_settings_cb getGenerationSettingsCB(const terrain_generation_settings& genSettings, float chunkSize)
 	{
 		uint32 numSegmentsPerDim = TERRAIN_LOD_0_VERTICES_PER_DIMENSION - 1;
 		float positionScale = chunkSize / (float)numSegmentsPerDim;
@@ -683,7 +790,12 @@ namespace era_engine
 		settings.noiseOffset = genSettings.noiseOffset;
 		settings.noiseOctaves = genSettings.noiseOctaves;
 
-		auto settingsCBV = dxContext.uploadDynamicConstantBuffer(settings);
+		return settings;
+	}
+
+	void TerrainComponent::generate_chunks_GPU()
+	{
+		auto settingsCBV = dxContext.uploadDynamicConstantBuffer(getGenerationSettingsCB(genSettings, chunkSize));
 
 		bool mipmaps = true;
 
@@ -751,8 +863,59 @@ namespace era_engine
 
 					c.heights.resize(TERRAIN_LOD_0_VERTICES_PER_DIMENSION * TERRAIN_LOD_0_VERTICES_PER_DIMENSION);
 					copyTextureToCPUBuffer(c.heightmap, c.heights.data(), D3D12_RESOURCE_STATE_GENERIC_READ);
+					build_height_bounds(c);
 				}
 			}
 		}
 	}
-}
\ No newline at end of file
+
+	void TerrainComponent::create_chunk_textures(const terrain_chunk_upload* uploads, uint32 count)
+	{
+		// The heights are already on the CPU, so the generation shader only writes the normals.
+		terrain_generation_settings_cb settings = getGenerationSettingsCB(genSettings, chunkSize);
+		settings.heightWidth = 0;
+		settings.heightHeight = 0;
+
+		auto settingsCBV = dxContext.uploadDynamicConstantBuffer(settings);
+
+		dx_command_list* cl = dxContext.getFreeRenderCommandList();
+
+		{
+			PROFILE_ALL(cl, "Create streamed terrain chunks");
+
+			for (uint32 i = 0; i < count; ++i)
+			{
+				terrain_chunk& c = *uploads[i].chunk;
+
+				c.heightmap = createTexture(c.heights.data(), TERRAIN_LOD_0_VERTICES_PER_DIMENSION, TERRAIN_LOD_0_VERTICES_PER_DIMENSION, DXGI_FORMAT_R16_UNORM, false, false, true, D3D12_RESOURCE_STATE_GENERIC_READ);
+				c.normalmap = createTexture(0, normalMapDimension, normalMapDimension, DXGI_FORMAT_R32G32_FLOAT, true, false, true, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+				barrier_batcher(cl)
+					.transition(c.heightmap, D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+				cl->setPipelineState(*terrainGenerationPipeline.pipeline);
+				cl->setComputeRootSignature(*terrainGenerationPipeline.rootSignature);
+				cl->setComputeDynamicConstantBuffer(TERRAIN_GENERATION_RS_SETTINGS, settingsCBV);
+
+				terrain_generation_cb cb;
+				cb.minCorner = vec2(uploads[i].chunkX * chunkSize, uploads[i].chunkZ * chunkSize);
+
+				cl->setCompute32BitConstants(TERRAIN_GENERATION_RS_CB, cb);
+				cl->setDescriptorHeapUAV(TERRAIN_GENERATION_RS_TEXTURES, 0, c.heightmap);
+				cl->setDescriptorHeapUAV(TERRAIN_GENERATION_RS_TEXTURES, 1, c.normalmap);
+
+				cl->dispatch(bucketize(normalMapDimension, 16), bucketize(normalMapDimension, 16));
+
+				barrier_batcher(cl)
+					.transition(c.heightmap, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_GENERIC_READ)
+					.transition(c.normalmap, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_GENERIC_READ);
+
+				generateMipMapsOnGPU(cl, c.normalmap);
+			}
+		}
+
+		// The heightmaps are uploaded on the copy queue.
+		dxContext.renderQueue.waitForOtherQueue(dxContext.copyQueue);
+		dxContext.executeCommandList(cl);
+	}
+}
@@ -16,12 +16,22 @@
 
 namespace era_engine
 {
+	struct terrain_height_bounds
+	{
+		uint16 minHeight;
+		uint16 maxHeight;
+	};
+
 	struct ERA_CORE_API terrain_chunk
 	{
 		ref<dx_texture> heightmap;
 		ref<dx_texture> normalmap;
 
 		std::vector<uint16> heights;
+
+		// Min/max quadtree over the grid cells of heights, for raycasts. Levels are stored one after another, starting with one node per cell
+		// and ending with the root.
+		std::vector<terrain_height_bounds> heightBounds;
 	};
 
 	struct ERA_CORE_API terrain_generation_settings
@@ -36,6 +46,38 @@ namespace era_engine
 		uint32 noiseOctaves = 15;
 	};
 
+	struct ERA_CORE_API terrain_streaming_settings
+	{
+		// CPU memory for the heights of chunks outside of the window. Least recently visible chunks are dropped first. Chunks release their
+		// GPU textures when they leave the window, so GPU memory only depends on the window size.
+		uint64 memoryBudget = 256ull * 1024 * 1024;
+
+		// Rings of chunks around the window which are prepared ahead of time, so that moving the window doesn't leave holes.
+		uint32 prefetchRings = 1;
+
+		uint32 maxChunkJobsInFlight = 8;
+		uint32 maxChunkUploadsPerFrame = 2;
+
+		// Generated heights are stored here, in a subdirectory per generation settings. Empty to disable persistence.
+		fs::path cacheDirectory = L"asset_cache/terrain";
+	};
+
+	struct terrain_streaming_stats
+	{
+		uint32 numWindowChunks;		// Chunks in the window which have their heights.
+		uint32 numCachedChunks;		// Chunks outside of the window which are kept for later.
+		uint32 numPendingChunks;	// Chunks being loaded or generated.
+
+		uint64 cachedMemory;
+		uint64 memoryBudget;
+
+		uint64 numLoadedFromDisk;
+		uint64 numGenerated;
+	};
+
+	struct terrain_streaming_state;
+	struct terrain_chunk_upload;
+
 	class ERA_CORE_API TerrainComponent : public Component
 	{
 	public:
@@ -45,7 +87,8 @@ namespace era_engine
 			const terrain_generation_settings& _gen_settings = {});
 		virtual ~TerrainComponent();
 
-		void update();
+		// viewerPosition is only used in streaming mode.
+		void update(vec3 positionOffset = vec3(0.f), vec3 viewerPosition = vec3(0.f));
 		void render(const render_camera& camera, struct opaque_render_pass* renderPass, struct sun_shadow_render_pass* shadowPass, struct ldr_render_pass* ldrPass,
 			vec3 positionOffset, bool selected = false,
 			struct TransformComponent* waterPlaneTransforms = 0, uint32 numWaters = 0);
@@ -56,9 +99,34 @@ namespace era_engine
 		vec3 get_min_corner(vec3 positionOffset) const
 		{
 			float xzOffset = -(chunkSize * chunksPerDim) * 0.5f; // Offsets entire terrain by half.
-			return positionOffset + vec3(xzOffset, 0.f, xzOffset);
+			return positionOffset + vec3(xzOffset + windowX * chunkSize, 0.f, xzOffset + windowZ * chunkSize);
 		}
 
+		// In streaming mode, the chunks are a window of chunksPerDim x chunksPerDim chunks which follows the viewer over an unbounded
+		// world, instead of being generated up front. Chunks entering the window are loaded from disk or generated in the background,
+		// so a chunk may have no heightmap yet. Call before the first update.
+		void enable_streaming(const terrain_streaming_settings& settings = {});
+		NODISCARD bool is_streaming() const { return streaming != nullptr; }
+		NODISCARD terrain_streaming_stats get_streaming_stats() const;
+
+		// Queries against the CPU copy of the heights, which match the rendered LOD 0 triangles. positionOffset is the position of the
+		// terrain's transform, as in render(). Positions outside of the terrain are clamped to its border. Thread safe, as long as the
+		// terrain isn't regenerated at the same time.
+		NODISCARD float get_height(vec3 positionOffset, vec2 position) const;
+		NODISCARD vec3 get_normal(vec3 positionOffset, vec2 position) const;
+		void get_heights(vec3 positionOffset, const vec2* positions, float* outHeights, uint32 count) const;
+
+#if defined(SIMD_AVX_2)
+		NODISCARD w8_float get_height(vec3 positionOffset, w8_float x, w8_float z) const;
+#endif
+
+		// Closest hit of the ray with the terrain surface within maxDistance (in units of the ray direction).
+		NODISCARD bool raycast(vec3 positionOffset, const ray& r, float maxDistance, float& outDistance, vec3* outNormal = 0) const;
+
+		// Raycasts need the height bounds of a chunk. Generated and streamed chunks build them, chunks whose heights are filled by
+		// hand must call this afterwards.
+		static void build_height_bounds(terrain_chunk& chunk);
+
 		ERA_VIRTUAL_REFLECT(Component)
 
 	public:
@@ -76,10 +144,21 @@ namespace era_engine
 		void generate_chunks_CPU();
 		void generate_chunks_GPU();
 
+		void update_streaming(vec3 positionOffset, vec3 viewerPosition);
+		void create_chunk_textures(const terrain_chunk_upload* uploads, uint32 count);
+
+		bool raycast_chunk(const terrain_chunk& chunk, vec3 chunkMinCorner, const ray& r, float& inOutDistance, vec3& outNormal) const;
+
 		terrain_generation_settings oldGenSettings;
 
 		std::vector<terrain_chunk> chunks;
 
+		// Chunk coordinates of chunk(0, 0). Always 0 if not streaming.
+		int32 windowX = 0;
+		int32 windowZ = 0;
+
+		ref<terrain_streaming_state> streaming;
+
 		friend struct GrassComponent;
 	};
 
@@ -0,0 +1,376 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#include "terrain/terrain.h"
+
+#include <algorithm>
+
+#include "terrain_rs.hlsli"
+
+namespace era_engine
+{
+	// The LOD 0 grid of a chunk has numCellsPerDim x numCellsPerDim cells. Each cell is split into two triangles along the diagonal from
+	// (x + 1, z) to (x, z + 1), like the index buffers built in initializeTerrainPipelines.
+	static constexpr uint32 numCellsPerDim = TERRAIN_LOD_0_VERTICES_PER_DIMENSION - 1;
+	static constexpr uint32 heightStride = TERRAIN_LOD_0_VERTICES_PER_DIMENSION;
+
+	static_assert(is_power_of_two(numCellsPerDim));
+
+	static constexpr uint32 getNumBoundsLevels()
+	{
+		uint32 result = 1;
+		for (uint32 dim = numCellsPerDim; dim > 1; dim >>= 1)
+		{
+			++result;
+		}
+		return result;
+	}
+
+	static constexpr uint32 numBoundsLevels = getNumBoundsLevels();
+
+	static constexpr uint32 getBoundsLevelOffset(uint32 level)
+	{
+		uint32 offset = 0;
+		for (uint32 l = 0; l < level; ++l)
+		{
+			uint32 dim = numCellsPerDim >> l;
+			offset += dim * dim;
+		}
+		return offset;
+	}
+
+	void TerrainComponent::build_height_bounds(terrain_chunk& chunk)
+	{
+		chunk.heightBounds.resize(getBoundsLevelOffset(numBoundsLevels));
+		terrain_height_bounds* bounds = chunk.heightBounds.data();
+
+		const uint16* heights = chunk.heights.data();
+		for (uint32 z = 0; z < numCellsPerDim; ++z)
+		{
+			for (uint32 x = 0; x < numCellsPerDim; ++x)
+			{
+				const uint16* h = heights + z * heightStride + x;
+				bounds[z * numCellsPerDim + x] =
+				{
+					min(min(h[0], h[1]), min(h[heightStride], h[heightStride + 1])),
+					max(max(h[0], h[1]), max(h[heightStride], h[heightStride + 1])),
+				};
+			}
+		}
+
+		for (uint32 level = 1; level < numBoundsLevels; ++level)
+		{
+			const terrain_height_bounds* children = bounds + getBoundsLevelOffset(level - 1);
+			terrain_height_bounds* nodes = bounds + getBoundsLevelOffset(level);
+
+			const uint32 childDim = numCellsPerDim >> (level - 1);
+			const uint32 dim = numCellsPerDim >> level;
+
+			for (uint32 z = 0; z < dim; ++z)
+			{
+				for (uint32 x = 0; x < dim; ++x)
+				{
+					const terrain_height_bounds* c = children + (2 * z) * childDim + 2 * x;
+					nodes[z * dim + x] =
+					{
+						min(min(c[0].minHeight, c[1].minHeight), min(c[childDim].minHeight, c[childDim + 1].minHeight)),
+						max(max(c[0].maxHeight, c[1].maxHeight), max(c[childDim].maxHeight, c[childDim + 1].maxHeight)),
+					};
+				}
+			}
+		}
+	}
+
+	struct terrain_cell
+	{
+		float h00, h10, h01, h11; // Heights of the cell corners, in [0, UINT16_MAX].
+		float u, v; // Position within the cell.
+	};
+
+	static bool findCell(const TerrainComponent& terrain, vec3 minCorner, vec2 position, terrain_cell& outCell)
+	{
+		const float cellSize = terrain.chunkSize / numCellsPerDim;
+		const float numCells = (float)(terrain.chunksPerDim * numCellsPerDim);
+
+		float gx = clamp((position.x - minCorner.x) / cellSize, 0.f, numCells);
+		float gz = clamp((position.y - minCorner.z) / cellSize, 0.f, numCells);
+		float cellX = min(floorf(gx), numCells - 1.f);
+		float cellZ = min(floorf(gz), numCells - 1.f);
+
+		uint32 x = (uint32)cellX;
+		uint32 z = (uint32)cellZ;
+
+		const terrain_chunk& chunk = terrain.chunk(x / numCellsPerDim, z / numCellsPerDim);
+		if (chunk.heights.empty())
+		{
+			return false;
+		}
+
+		const uint16* h = chunk.heights.data() + (z % numCellsPerDim) * heightStride + (x % numCellsPerDim);
+		outCell = { h[0], h[1], h[heightStride], h[heightStride + 1], gx - cellX, gz - cellZ };
+		return true;
+	}
+
+	float TerrainComponent::get_height(vec3 positionOffset, vec2 position) const
+	{
+		vec3 minCorner = get_min_corner(positionOffset);
+
+		terrain_cell c;
+		if (!findCell(*this, minCorner, position, c))
+		{
+			return minCorner.y;
+		}
+
+		float height = (c.u + c.v <= 1.f)
+			? c.h00 + c.u * (c.h10 - c.h00) + c.v * (c.h01 - c.h00)
+			: c.h11 + (1.f - c.u) * (c.h01 - c.h11) + (1.f - c.v) * (c.h10 - c.h11);
+
+		return minCorner.y + height * (amplitudeScale / UINT16_MAX);
+	}
+
+	vec3 TerrainComponent::get_normal(vec3 positionOffset, vec2 position) const
+	{
+		vec3 minCorner = get_min_corner(positionOffset);
+
+		terrain_cell c;
+		if (!findCell(*this, minCorner, position, c))
+		{
+			return vec3(0.f, 1.f, 0.f);
+		}
+
+		// Slopes of the triangle's plane, in height units per cell.
+		float dhdu, dhdv;
+		if (c.u + c.v <= 1.f)
+		{
+			dhdu = c.h10 - c.h00;
+			dhdv = c.h01 - c.h00;
+		}
+		else
+		{
+			dhdu = c.h11 - c.h01;
+			dhdv = c.h11 - c.h10;
+		}
+
+		float scale = (amplitudeScale / UINT16_MAX) / (chunkSize / numCellsPerDim);
+		return normalize(vec3(-dhdu * scale, 1.f, -dhdv * scale));
+	}
+
+#if defined(SIMD_AVX_2)
+	w8_float TerrainComponent::get_height(vec3 positionOffset, w8_float x, w8_float z) const
+	{
+		const vec3 minCorner = get_min_corner(positionOffset);
+		const float invCellSize = numCellsPerDim / chunkSize;
+		const float numCells = (float)(chunksPerDim * numCellsPerDim);
+
+		w8_float gx = clamp((x - minCorner.x) * invCellSize, 0.f, numCells);
+		w8_float gz = clamp((z - minCorner.z) * invCellSize, 0.f, numCells);
+		w8_float cellX = minimum(floor(gx), numCells - 1.f);
+		w8_float cellZ = minimum(floor(gz), numCells - 1.f);
+		w8_float u = gx - cellX;
+		w8_float v = gz - cellZ;
+
+		alignas(32) float cellXs[8];
+		alignas(32) float cellZs[8];
+		cellX.store(cellXs);
+		cellZ.store(cellZs);
+
+		// Lanes may fall into different chunks, so the corners are fetched per lane.
+		alignas(32) float h00[8], h10[8], h01[8], h11[8];
+		for (uint32 i = 0; i < 8; ++i)
+		{
+			uint32 cx = (uint32)cellXs[i];
+			uint32 cz = (uint32)cellZs[i];
+
+			const terrain_chunk& c = chunk(cx / numCellsPerDim, cz / numCellsPerDim);
+			if (c.heights.empty())
+			{
+				h00[i] = h10[i] = h01[i] = h11[i] = 0.f;
+				continue;
+			}
+
+			const uint16* h = c.heights.data() + (cz % numCellsPerDim) * heightStride + (cx % numCellsPerDim);
+			h00[i] = h[0];
+			h10[i] = h[1];
+			h01[i] = h[heightStride];
+			h11[i] = h[heightStride + 1];
+		}
+
+		w8_float a(h00), b(h10), c(h01), d(h11);
+
+		w8_float lower = fmadd(u, b - a, fmadd(v, c - a, a));
+		w8_float upper = fmadd(1.f - u, c - d, fmadd(1.f - v, b - d, d));
+		w8_float height = if_then(u + v <= 1.f, lower, upper);
+
+		return fmadd(height, amplitudeScale / UINT16_MAX, minCorner.y);
+	}
+#endif
+
+	void TerrainComponent::get_heights(vec3 positionOffset, const vec2* positions, float* outHeights, uint32 count) const
+	{
+		uint32 i = 0;
+
+#if defined(SIMD_AVX_2)
+		for (; i + 8 <= count; i += 8)
+		{
+			const vec2* p = positions + i;
+			w8_float x(p[0].x, p[1].x, p[2].x, p[3].x, p[4].x, p[5].x, p[6].x, p[7].x);
+			w8_float z(p[0].y, p[1].y, p[2].y, p[3].y, p[4].y, p[5].y, p[6].y, p[7].y);
+			get_height(positionOffset, x, z).store(outHeights + i);
+		}
+#endif
+
+		for (; i < count; ++i)
+		{
+			outHeights[i] = get_height(positionOffset, positions[i]);
+		}
+	}
+
+	// Entry distance of the ray into the box, if it enters before maxDistance.
+	static bool intersectBox(const ray& r, vec3 invDirection, vec3 minCorner, vec3 maxCorner, float maxDistance, float& outEnter)
+	{
+		vec3 t0 = (minCorner - r.origin) * invDirection;
+		vec3 t1 = (maxCorner - r.origin) * invDirection;
+
+		float enter = max(max(min(t0.x, t1.x), min(t0.y, t1.y)), max(min(t0.z, t1.z), 0.f));
+		float exit = min(min(max(t0.x, t1.x), max(t0.y, t1.y)), min(max(t0.z, t1.z), maxDistance));
+
+		outEnter = enter;
+		return enter <= exit;
+	}
+
+	bool TerrainComponent::raycast_chunk(const terrain_chunk& chunk, vec3 chunkMinCorner, const ray& r, float& inOutDistance, vec3& outNormal) const
+	{
+		struct quadtree_node
+		{
+			uint32 level;
+			uint32 x, z;
+		};
+
+		const vec3 invDirection = vec3(1.f / r.direction.x, 1.f / r.direction.y, 1.f / r.direction.z);
+		const float cellSize = chunkSize / numCellsPerDim;
+		const float heightScale = amplitudeScale / UINT16_MAX;
+
+		// Children are pushed far to near, so that the nearest one is visited first and hits prune the rest.
+		const uint32 farX = (r.direction.x >= 0.f) ? 1 : 0;
+		const uint32 farZ = (r.direction.z >= 0.f) ? 1 : 0;
+		const uint32 childOrder[4][2] = { { farX, farZ }, { farX ^ 1, farZ }, { farX, farZ ^ 1 }, { farX ^ 1, farZ ^ 1 } };
+
+		quadtree_node stack[4 * numBoundsLevels];
+		uint32 stackSize = 0;
+		stack[stackSize++] = { numBoundsLevels - 1, 0, 0 };
+
+		bool hit = false;
+
+		while (stackSize > 0)
+		{
+			quadtree_node node = stack[--stackSize];
+
+			const uint32 dim = numCellsPerDim >> node.level;
+			const terrain_height_bounds& bounds = chunk.heightBounds[getBoundsLevelOffset(node.level) + node.z * dim + node.x];
+
+			const float nodeSize = (float)(1 << node.level) * cellSize;
+			vec3 minCorner = chunkMinCorner + vec3(node.x * nodeSize, bounds.minHeight * heightScale, node.z * nodeSize);
+			vec3 maxCorner = chunkMinCorner + vec3((node.x + 1) * nodeSize, bounds.maxHeight * heightScale, (node.z + 1) * nodeSize);
+
+			float enter;
+			if (!intersectBox(r, invDirection, minCorner, maxCorner, inOutDistance, enter))
+			{
+				continue;
+			}
+
+			if (node.level > 0)
+			{
+				for (uint32 i = 0; i < 4; ++i)
+				{
+					stack[stackSize++] = { node.level - 1, node.x * 2 + childOrder[i][0], node.z * 2 + childOrder[i][1] };
+				}
+				continue;
+			}
+
+			const uint16* h = chunk.heights.data() + node.z * heightStride + node.x;
+			vec3 p00 = chunkMinCorner + vec3(node.x * cellSize, h[0] * heightScale, node.z * cellSize);
+			vec3 p10 = chunkMinCorner + vec3((node.x + 1) * cellSize, h[1] * heightScale, node.z * cellSize);
+			vec3 p01 = chunkMinCorner + vec3(node.x * cellSize, h[heightStride] * heightScale, (node.z + 1) * cellSize);
+			vec3 p11 = chunkMinCorner + vec3((node.x + 1) * cellSize, h[heightStride + 1] * heightScale, (node.z + 1) * cellSize);
+
+			const vec3 triangles[2][3] = { { p00, p01, p10 }, { p10, p01, p11 } };
+			for (const auto& tri : triangles)
+			{
+				float t;
+				bool frontFacing;
+				if (r.intersectTriangle(tri[0], tri[1], tri[2], t, frontFacing) && t < inOutDistance)
+				{
+					inOutDistance = t;
+					outNormal = normalize(cross(tri[1] - tri[0], tri[2] - tri[0]));
+					hit = true;
+				}
+			}
+		}
+
+		return hit;
+	}
+
+	bool TerrainComponent::raycast(vec3 positionOffset, const ray& r, float maxDistance, float& outDistance, vec3* outNormal) const
+	{
+		const vec3 minCorner = get_min_corner(positionOffset);
+		const vec3 invDirection = vec3(1.f / r.direction.x, 1.f / r.direction.y, 1.f / r.direction.z);
+		const float heightScale = amplitudeScale / UINT16_MAX;
+
+		struct chunk_candidate
+		{
+			float enter;
+			uint32 x, z;
+		};
+
+		std::vector<chunk_candidate> candidates;
+
+		for (uint32 z = 0; z < chunksPerDim; ++z)
+		{
+			for (uint32 x = 0; x < chunksPerDim; ++x)
+			{
+				const terrain_chunk& c = chunk(x, z);
+				if (c.heightBounds.empty())
+				{
+					continue;
+				}
+
+				const terrain_height_bounds& root = c.heightBounds.back();
+				vec3 chunkMinCorner = minCorner + vec3(x * chunkSize, root.minHeight * heightScale, z * chunkSize);
+				vec3 chunkMaxCorner = minCorner + vec3((x + 1) * chunkSize, root.maxHeight * heightScale, (z + 1) * chunkSize);
+
+				float enter;
+				if (intersectBox(r, invDirection, chunkMinCorner, chunkMaxCorner, maxDistance, enter))
+				{
+					candidates.push_back({ enter, x, z });
+				}
+			}
+		}
+
+		std::sort(candidates.begin(), candidates.end(), [](const chunk_candidate& a, const chunk_candidate& b) { return a.enter < b.enter; });
+
+		float distance = maxDistance;
+		vec3 normal;
+		bool hit = false;
+
+		for (const chunk_candidate& candidate : candidates)
+		{
+			if (candidate.enter > distance)
+			{
+				break;
+			}
+
+			vec3 chunkMinCorner = minCorner + vec3(candidate.x * chunkSize, 0.f, candidate.z * chunkSize);
+			hit |= raycast_chunk(chunk(candidate.x, candidate.z), chunkMinCorner, r, distance, normal);
+		}
+
+		if (hit)
+		{
+			outDistance = distance;
+			if (outNormal)
+			{
+				*outNormal = normal;
+			}
+		}
+
+		return hit;
+	}
+}
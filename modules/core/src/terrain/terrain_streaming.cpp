@@ -0,0 +1,513 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#include "terrain/terrain_streaming.h"
+
+#include "core/hash.h"
+#include "core/sync.h"
+#include "core/job_system.h"
+#include "core/cpu_profiling.h"
+
+#include "asset/io.h"
+
+#include <algorithm>
+
+#include "terrain_rs.hlsli"
+
+namespace era_engine
+{
+	static constexpr uint32 numHeightsPerDim = TERRAIN_LOD_0_VERTICES_PER_DIMENSION;
+
+	static constexpr uint32 terrainChunkFileMagic = 0x48435445; // "ETCH".
+	static constexpr uint32 terrainChunkFileVersion = 1;
+
+	struct terrain_chunk_file_header
+	{
+		uint32 magic;
+		uint32 version;
+		uint32 width;
+		uint32 height;
+	};
+
+	static int32 predictHeight(const uint16* heights, uint32 width, uint32 x, uint32 y)
+	{
+		const uint16* row = heights + y * width;
+		if (y == 0)
+		{
+			return (x == 0) ? 0 : row[x - 1];
+		}
+
+		const uint16* above = row - width;
+		if (x == 0)
+		{
+			return above[0];
+		}
+
+		return clamp((int32)row[x - 1] + (int32)above[x] - (int32)above[x - 1], 0, (int32)UINT16_MAX);
+	}
+
+	std::vector<uint8> compressTerrainHeights(const uint16* heights, uint32 width, uint32 height)
+	{
+		std::vector<uint8> result;
+		result.reserve(width * height);
+
+		for (uint32 y = 0; y < height; ++y)
+		{
+			for (uint32 x = 0; x < width; ++x)
+			{
+				int32 delta = (int32)heights[y * width + x] - predictHeight(heights, width, x, y);
+				uint32 zigzag = ((uint32)delta << 1) ^ (uint32)(delta >> 31);
+
+				while (zigzag >= 0x80)
+				{
+					result.push_back((uint8)(zigzag | 0x80));
+					zigzag >>= 7;
+				}
+				result.push_back((uint8)zigzag);
+			}
+		}
+
+		return result;
+	}
+
+	bool decompressTerrainHeights(const uint8* data, uint64 size, uint16* outHeights, uint32 width, uint32 height)
+	{
+		uint64 offset = 0;
+
+		for (uint32 y = 0; y < height; ++y)
+		{
+			for (uint32 x = 0; x < width; ++x)
+			{
+				uint32 zigzag = 0;
+				for (uint32 shift = 0; ; shift += 7)
+				{
+					if (offset >= size || shift > 14)
+					{
+						return false;
+					}
+
+					uint8 byte = data[offset++];
+					zigzag |= (uint32)(byte & 0x7F) << shift;
+					if (!(byte & 0x80))
+					{
+						break;
+					}
+				}
+
+				int32 delta = (int32)(zigzag >> 1) ^ -(int32)(zigzag & 1);
+				int32 value = predictHeight(outHeights, width, x, y) + delta;
+				if (value < 0 || value > (int32)UINT16_MAX)
+				{
+					return false;
+				}
+
+				outHeights[y * width + x] = (uint16)value;
+			}
+		}
+
+		return offset == size;
+	}
+
+	static uint64 getChunkKey(int32 x, int32 z)
+	{
+		return ((uint64)(uint32)x << 32) | (uint32)z;
+	}
+
+	static uint64 getChunkMemory(const terrain_chunk& c)
+	{
+		return c.heights.capacity() * sizeof(uint16) + c.heightBounds.capacity() * sizeof(terrain_height_bounds);
+	}
+
+	static fs::path getChunkPath(const fs::path& directory, int32 x, int32 z)
+	{
+		return directory / (std::to_string(x) + "_" + std::to_string(z) + ".heights");
+	}
+
+	// Chunks generated with different settings go to different directories, so changing the settings never picks up stale chunks.
+	static fs::path getChunkDirectory(const fs::path& cacheDirectory, const terrain_generation_settings& settings, float chunkSize)
+	{
+		if (cacheDirectory.empty())
+		{
+			return {};
+		}
+
+		size_t seed = 0;
+		hash_combine(seed, settings.scale);
+		hash_combine(seed, settings.domainWarpStrength);
+		hash_combine(seed, settings.domainWarpNoiseOffset);
+		hash_combine(seed, settings.domainWarpOctaves);
+		hash_combine(seed, settings.noiseOffset);
+		hash_combine(seed, settings.noiseOctaves);
+		hash_combine(seed, chunkSize);
+		hash_combine(seed, numHeightsPerDim);
+		hash_combine(seed, terrainChunkFileVersion);
+
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx", (unsigned long long)seed);
+		return cacheDirectory / name;
+	}
+
+	static bool loadChunkHeights(const fs::path& path, uint16* outHeights)
+	{
+		EntireFile file = load_file(path);
+		if (!file.content)
+		{
+			return false;
+		}
+
+		bool result = false;
+
+		terrain_chunk_file_header* header = file.consume<terrain_chunk_file_header>();
+		if (header && header->magic == terrainChunkFileMagic && header->version == terrainChunkFileVersion
+			&& header->width == numHeightsPerDim && header->height == numHeightsPerDim)
+		{
+			result = decompressTerrainHeights(file.content + file.read_offset, file.size - file.read_offset, outHeights, numHeightsPerDim, numHeightsPerDim);
+		}
+
+		free_file(file);
+		return result;
+	}
+
+	static void saveChunkHeights(const fs::path& path, const uint16* heights)
+	{
+		std::vector<uint8> compressed = compressTerrainHeights(heights, numHeightsPerDim, numHeightsPerDim);
+
+		// Write to a temporary file first, so that a partially written chunk is never picked up.
+		fs::path tempPath = path;
+		tempPath += ".tmp";
+
+		FILE* file = fopen(tempPath.string().c_str(), "wb");
+		if (!file)
+		{
+			return;
+		}
+
+		terrain_chunk_file_header header = { terrainChunkFileMagic, terrainChunkFileVersion, numHeightsPerDim, numHeightsPerDim };
+		bool written = fwrite(&header, sizeof(header), 1, file) == 1
+			&& fwrite(compressed.data(), compressed.size(), 1, file) == 1;
+		fclose(file);
+
+		std::error_code ec;
+		if (written)
+		{
+			fs::rename(tempPath, path, ec);
+		}
+		else
+		{
+			fs::remove(tempPath, ec);
+		}
+	}
+
+	void TerrainComponent::enable_streaming(const terrain_streaming_settings& settings)
+	{
+		streaming = make_ref<terrain_streaming_state>();
+		streaming->settings = settings;
+		streaming->completionQueue = make_ref<terrain_chunk_completion_queue>();
+
+		chunks.clear();
+		chunks.resize(chunksPerDim * chunksPerDim);
+		windowX = 0;
+		windowZ = 0;
+
+		oldGenSettings.scale = -FLT_MAX; // Set to garbage so that streaming starts in the next update.
+	}
+
+	void TerrainComponent::update_streaming(vec3 positionOffset, vec3 viewerPosition)
+	{
+		CPU_PROFILE_BLOCK("Update terrain streaming");
+
+		terrain_streaming_state& state = *streaming;
+		++state.frameIndex;
+
+		const int32 windowSize = (int32)chunksPerDim;
+
+		if (memcmp(&genSettings, &oldGenSettings, sizeof(terrain_generation_settings)) != 0)
+		{
+			++state.generation;
+			state.cachedChunks.clear();
+			state.pendingChunks.clear();
+			state.cachedMemory = 0;
+
+			for (terrain_chunk& c : chunks)
+			{
+				c = {};
+			}
+
+			state.directory = getChunkDirectory(state.settings.cacheDirectory, genSettings, chunkSize);
+			if (!state.directory.empty())
+			{
+				std::error_code ec;
+				fs::create_directories(state.directory, ec);
+			}
+
+			oldGenSettings = genSettings;
+		}
+
+		// Chunk coordinates of the viewer. Chunk (0, 0) starts at the same position as in the fixed size terrain.
+		const float xzOffset = -(chunkSize * chunksPerDim) * 0.5f;
+		const int32 viewerX = (int32)floorf((viewerPosition.x - positionOffset.x - xzOffset) / chunkSize);
+		const int32 viewerZ = (int32)floorf((viewerPosition.z - positionOffset.z - xzOffset) / chunkSize);
+
+		// Move the window only when the viewer is more than one chunk away from its center, so that walking along a chunk border doesn't
+		// move it back and forth.
+		const int32 newWindowX = viewerX - windowSize / 2;
+		const int32 newWindowZ = viewerZ - windowSize / 2;
+		if (abs(newWindowX - windowX) > 1 || abs(newWindowZ - windowZ) > 1)
+		{
+			std::vector<terrain_chunk> newChunks(chunks.size());
+
+			for (int32 z = 0; z < windowSize; ++z)
+			{
+				for (int32 x = 0; x < windowSize; ++x)
+				{
+					terrain_chunk& c = chunks[z * windowSize + x];
+					int32 newX = windowX + x - newWindowX;
+					int32 newZ = windowZ + z - newWindowZ;
+
+					if (newX >= 0 && newX < windowSize && newZ >= 0 && newZ < windowSize)
+					{
+						newChunks[newZ * windowSize + newX] = std::move(c);
+					}
+					else if (!c.heights.empty())
+					{
+						c.heightmap = nullptr;
+						c.normalmap = nullptr;
+
+						state.cachedMemory += getChunkMemory(c);
+						state.cachedChunks[getChunkKey(windowX + x, windowZ + z)] = { std::move(c), state.frameIndex };
+					}
+				}
+			}
+
+			chunks.swap(newChunks);
+			windowX = newWindowX;
+			windowZ = newWindowZ;
+
+			for (int32 z = 0; z < windowSize; ++z)
+			{
+				for (int32 x = 0; x < windowSize; ++x)
+				{
+					terrain_chunk& c = chunks[z * windowSize + x];
+					if (!c.heights.empty())
+					{
+						continue;
+					}
+
+					auto it = state.cachedChunks.find(getChunkKey(windowX + x, windowZ + z));
+					if (it != state.cachedChunks.end())
+					{
+						state.cachedMemory -= getChunkMemory(it->second.chunk);
+						c = std::move(it->second.chunk);
+						state.cachedChunks.erase(it);
+					}
+				}
+			}
+		}
+
+		// Pick up finished chunks.
+		{
+			std::vector<completed_terrain_chunk> completed;
+			{
+				Lock lock{ state.completionQueue->mutex };
+				completed.swap(state.completionQueue->chunks);
+			}
+
+			for (completed_terrain_chunk& done : completed)
+			{
+				if (done.generation != state.generation)
+				{
+					continue;
+				}
+
+				uint64 key = getChunkKey(done.chunkX, done.chunkZ);
+				state.pendingChunks.erase(key);
+				++(done.fromDisk ? state.numLoadedFromDisk : state.numGenerated);
+
+				int32 x = done.chunkX - windowX;
+				int32 z = done.chunkZ - windowZ;
+				if (x >= 0 && x < windowSize && z >= 0 && z < windowSize)
+				{
+					chunk(x, z) = std::move(done.chunk);
+				}
+				else
+				{
+					state.cachedMemory += getChunkMemory(done.chunk);
+					state.cachedChunks[key] = { std::move(done.chunk), state.frameIndex };
+				}
+			}
+		}
+
+		const int32 rings = (int32)state.settings.prefetchRings;
+		auto isInPrefetchRegion = [&](int32 x, int32 z)
+		{
+			return x >= windowX - rings && x < windowX + windowSize + rings && z >= windowZ - rings && z < windowZ + windowSize + rings;
+		};
+
+		// Request missing chunks in and around the window, closest to the viewer first.
+		{
+			struct chunk_request
+			{
+				int32 x, z;
+				int32 distance;
+			};
+
+			std::vector<chunk_request> requests;
+
+			for (int32 z = windowZ - rings; z < windowZ + windowSize + rings; ++z)
+			{
+				for (int32 x = windowX - rings; x < windowX + windowSize + rings; ++x)
+				{
+					uint64 key = getChunkKey(x, z);
+
+					bool inWindow = x >= windowX && x < windowX + windowSize && z >= windowZ && z < windowZ + windowSize;
+					bool resident = inWindow
+						? !chunk(x - windowX, z - windowZ).heights.empty()
+						: state.cachedChunks.find(key) != state.cachedChunks.end();
+
+					if (resident || state.pendingChunks.find(key) != state.pendingChunks.end())
+					{
+						continue;
+					}
+
+					int32 dx = x - viewerX;
+					int32 dz = z - viewerZ;
+					requests.push_back({ x, z, dx * dx + dz * dz });
+				}
+			}
+
+			std::sort(requests.begin(), requests.end(), [](const chunk_request& a, const chunk_request& b) { return a.distance < b.distance; });
+
+			uint32 numFreeJobs = state.settings.maxChunkJobsInFlight - min((uint32)state.pendingChunks.size(), state.settings.maxChunkJobsInFlight);
+			uint32 numJobs = min((uint32)requests.size(), numFreeJobs);
+
+			for (uint32 i = 0; i < numJobs; ++i)
+			{
+				struct terrain_chunk_job_data
+				{
+					ref<terrain_chunk_completion_queue> queue;
+					terrain_generation_settings genSettings;
+					float chunkSize;
+					int32 chunkX, chunkZ;
+					uint32 generation;
+					fs::path directory;
+				};
+
+				terrain_chunk_job_data data = { state.completionQueue, genSettings, chunkSize, requests[i].x, requests[i].z, state.generation, state.directory };
+
+				JobHandle job = low_priority_job_queue.createJob<terrain_chunk_job_data>([](terrain_chunk_job_data& data, JobHandle)
+					{
+						completed_terrain_chunk result;
+						result.chunkX = data.chunkX;
+						result.chunkZ = data.chunkZ;
+						result.generation = data.generation;
+
+						std::vector<uint16>& heights = result.chunk.heights;
+						heights.resize(numHeightsPerDim * numHeightsPerDim);
+
+						fs::path path = data.directory.empty() ? fs::path() : getChunkPath(data.directory, data.chunkX, data.chunkZ);
+
+						result.fromDisk = !path.empty() && loadChunkHeights(path, heights.data());
+						if (!result.fromDisk)
+						{
+							generateTerrainChunkHeights(data.genSettings, data.chunkSize, data.chunkX, data.chunkZ, heights.data());
+							if (!path.empty())
+							{
+								saveChunkHeights(path, heights.data());
+							}
+						}
+
+						build_height_bounds(result.chunk);
+
+						Lock lock{ data.queue->mutex };
+						data.queue->chunks.push_back(std::move(result));
+					}, data);
+				job.submit_now();
+
+				state.pendingChunks.insert(getChunkKey(requests[i].x, requests[i].z));
+			}
+		}
+
+		// Create the GPU textures of chunks in the window, closest to the viewer first.
+		{
+			std::vector<terrain_chunk_upload> uploads;
+
+			for (int32 z = 0; z < windowSize; ++z)
+			{
+				for (int32 x = 0; x < windowSize; ++x)
+				{
+					terrain_chunk& c = chunk(x, z);
+					if (!c.heights.empty() && !c.heightmap)
+					{
+						uploads.push_back({ &c, windowX + x, windowZ + z });
+					}
+				}
+			}
+
+			auto distance = [viewerX, viewerZ](const terrain_chunk_upload& u)
+			{
+				int32 dx = u.chunkX - viewerX;
+				int32 dz = u.chunkZ - viewerZ;
+				return dx * dx + dz * dz;
+			};
+			std::sort(uploads.begin(), uploads.end(), [&](const terrain_chunk_upload& a, const terrain_chunk_upload& b) { return distance(a) < distance(b); });
+
+			uint32 numUploads = min((uint32)uploads.size(), state.settings.maxChunkUploadsPerFrame);
+			if (numUploads > 0)
+			{
+				create_chunk_textures(uploads.data(), numUploads);
+			}
+		}
+
+		// Drop the least recently visible chunks outside of the window until the cache fits into the budget. Chunks which are about to
+		// be needed are kept, because they would be requested again right away.
+		if (state.cachedMemory > state.settings.memoryBudget)
+		{
+			std::vector<std::pair<uint64, uint64>> candidates; // Last visible frame, key.
+			for (const auto& [key, cached] : state.cachedChunks)
+			{
+				int32 x = (int32)(uint32)(key >> 32);
+				int32 z = (int32)(uint32)key;
+				if (!isInPrefetchRegion(x, z))
+				{
+					candidates.push_back({ cached.lastVisibleFrame, key });
+				}
+			}
+
+			std::sort(candidates.begin(), candidates.end());
+
+			for (const auto& [frame, key] : candidates)
+			{
+				if (state.cachedMemory <= state.settings.memoryBudget)
+				{
+					break;
+				}
+
+				auto it = state.cachedChunks.find(key);
+				state.cachedMemory -= getChunkMemory(it->second.chunk);
+				state.cachedChunks.erase(it);
+			}
+		}
+	}
+
+	terrain_streaming_stats TerrainComponent::get_streaming_stats() const
+	{
+		terrain_streaming_stats stats = {};
+		if (!streaming)
+		{
+			return stats;
+		}
+
+		for (const terrain_chunk& c : chunks)
+		{
+			stats.numWindowChunks += !c.heights.empty();
+		}
+
+		stats.numCachedChunks = (uint32)streaming->cachedChunks.size();
+		stats.numPendingChunks = (uint32)streaming->pendingChunks.size();
+		stats.cachedMemory = streaming->cachedMemory;
+		stats.memoryBudget = streaming->settings.memoryBudget;
+		stats.numLoadedFromDisk = streaming->numLoadedFromDisk;
+		stats.numGenerated = streaming->numGenerated;
+
+		return stats;
+	}
+}
@@ -0,0 +1,67 @@
+// Copyright (c) 2023-present Eldar Muradov. All rights reserved.
+
+#pragma once
+
+#include "core_api.h"
+
+#include "terrain/terrain.h"
+
+#include <unordered_set>
+
+namespace era_engine
+{
+	// Compact storage for chunk heights. Each height is predicted from its left, upper and upper left neighbors, and the difference to
+	// the prediction is stored as a variable length integer. Smooth terrain needs about one byte per height.
+	NODISCARD std::vector<uint8> compressTerrainHeights(const uint16* heights, uint32 width, uint32 height);
+	NODISCARD bool decompressTerrainHeights(const uint8* data, uint64 size, uint16* outHeights, uint32 width, uint32 height);
+
+	// Generates the LOD 0 heights of the chunk at the given chunk coordinates on the calling thread. Defined in terrain.cpp, next to the
+	// height generators.
+	void generateTerrainChunkHeights(const terrain_generation_settings& settings, float chunkSize, int32 chunkX, int32 chunkZ, uint16* outHeights);
+
+	struct terrain_chunk_upload
+	{
+		terrain_chunk* chunk;
+		int32 chunkX, chunkZ;
+	};
+
+	struct completed_terrain_chunk
+	{
+		int32 chunkX, chunkZ;
+		uint32 generation;
+		bool fromDisk;
+		terrain_chunk chunk; // Only heights and height bounds.
+	};
+
+	// Shared with the background jobs, which may outlive the terrain.
+	struct terrain_chunk_completion_queue
+	{
+		std::mutex mutex;
+		std::vector<completed_terrain_chunk> chunks;
+	};
+
+	struct cached_terrain_chunk
+	{
+		terrain_chunk chunk;
+		uint64 lastVisibleFrame;
+	};
+
+	struct terrain_streaming_state
+	{
+		terrain_streaming_settings settings;
+		fs::path directory; // Persistent chunks for the current generation settings.
+
+		std::unordered_map<uint64, cached_terrain_chunk> cachedChunks;
+		std::unordered_set<uint64> pendingChunks;
+		ref<terrain_chunk_completion_queue> completionQueue;
+
+		uint64 cachedMemory = 0;
+
+		// Incremented whenever the generation settings change, so that chunks finishing for old settings are dropped.
+		uint32 generation = 0;
+		uint64 frameIndex = 0;
+
+		uint64 numLoadedFromDisk = 0;
+		uint64 numGenerated = 0;
+	};
+}
@@ -127,6 +127,8 @@ namespace era_engine
     RTTR_REGISTRATION
     {
         using namespace rttr;
+        impl::ensure_component_type_registered<TreeComponent>();
+
         rttr::registration::class_<TreeComponent>("TreeComponent")
             .constructor<>()
             .constructor<ref<Entity::EcsData>, const tree_settings&>()
@@ -109,6 +109,8 @@ namespace era_engine
 	RTTR_REGISTRATION
 	{
 		using namespace rttr;
+		impl::ensure_component_type_registered<WaterComponent>();
+
 		rttr::registration::class_<WaterComponent>("WaterComponent")
 			.constructor<>()
 			.constructor<ref<Entity::EcsData>, const water_settings&>()
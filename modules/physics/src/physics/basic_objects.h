@@ -19,9 +19,14 @@ namespace era_engine::physics
 
 		virtual void release() override;
 
+		// The copy from a WorldSnapshot shares the plane actor of its released original, so a new one is created.
+		void restore_snapshot_state();
+
 		ERA_VIRTUAL_REFLECT(Component)
 
 	private:
+		void create_plane();
+
 		vec3 point = vec3();
 		vec3 normal = vec3();
 		physx::PxRigidStatic* plane = nullptr;
@@ -43,6 +43,9 @@ namespace era_engine::physics
 	class ERA_PHYSICS_API BodyComponent : public Component
 	{
 	public:
+		// Restored after the shapes, which register themselves with Physics again first.
+		static constexpr uint32 snapshot_restore_order = 1;
+
 		BodyComponent() = default;
 		BodyComponent(ref<Entity::EcsData> _data);
 		virtual ~BodyComponent();
@@ -56,8 +59,17 @@ namespace era_engine::physics
 
 		virtual void release() override;
 
+		// The copy from a WorldSnapshot shares the actor of its released original, so a new one is created.
+		void restore_snapshot_state();
+
 		ERA_VIRTUAL_REFLECT(Component)
 
+	protected:
+		// Creates the actor with the entity's colliders and adds it to the scene.
+		void create_actor();
+
+		virtual physx::PxRigidActor* create_rigid_actor(const physx::PxTransform& transform, void* user_data);
+
 	private:
 		void detach_shape(physx::PxShape* shape);
 
@@ -120,6 +132,9 @@ namespace era_engine::physics
 		void manual_clear_force_and_torque();
 
 		ERA_VIRTUAL_REFLECT(BodyComponent)
+
+	protected:
+		physx::PxRigidActor* create_rigid_actor(const physx::PxTransform& transform, void* user_data) override;
 	};
 
 	class ERA_PHYSICS_API StaticBodyComponent : public BodyComponent
@@ -132,5 +147,8 @@ namespace era_engine::physics
 		physx::PxRigidStatic* get_rigid_static() const;
 
 		ERA_VIRTUAL_REFLECT(BodyComponent)
+
+	protected:
+		physx::PxRigidActor* create_rigid_actor(const physx::PxTransform& transform, void* user_data) override;
 	};
 }
\ No newline at end of file
@@ -13,6 +13,9 @@ namespace era_engine::physics
     class ERA_PHYSICS_API CCTBaseComponent : public BodyComponent
     {
     public:
+        // Owns a character controller, which is not re-created from a WorldSnapshot.
+        static constexpr bool snapshot_excluded = true;
+
         CCTBaseComponent() = default;
         CCTBaseComponent(ref<Entity::EcsData> _data, float _mass = 1.0f);
         virtual ~CCTBaseComponent();
@@ -93,7 +93,7 @@ namespace era_engine::physics
 		moodycamel::ConcurrentQueue<CollisionHandlingData> collision_queue;
 		moodycamel::ConcurrentQueue<CollisionHandlingData> collision_exit_queue;
 
-		SpinLock sync;
+		AdaptiveMutex sync{ "Physics" };
 
 	private:
 		physx::PxScene* scene = nullptr;
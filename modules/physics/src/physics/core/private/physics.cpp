@@ -221,7 +221,7 @@ namespace era_engine::physics
 
 	void Physics::release()
 	{
-		ScopedSpinLock lock{ sync };
+		ScopedLock<AdaptiveMutex> lock{ sync };
 
 #if PX_VEHICLE
 		physx::PxCloseVehicleSDK();
@@ -336,13 +336,13 @@ namespace era_engine::physics
 
 	void Physics::add_shape_to_entity_data(ShapeComponent* shape)
 	{
-		ScopedSpinLock lock{ sync };
+		ScopedLock<AdaptiveMutex> lock{ sync };
 		colliders_map[shape->get_handle()].push_back(shape);
 	}
 
 	void Physics::remove_shape_from_entity_data(ShapeComponent* shape)
 	{
-		ScopedSpinLock lock{ sync };
+		ScopedLock<AdaptiveMutex> lock{ sync };
 
 		auto& shapes = colliders_map[shape->get_handle()];
 		const auto& end = shapes.end();
@@ -378,7 +378,7 @@ namespace era_engine::physics
 #endif
 
 		{
-			ScopedSpinLock l{ sync };
+			ScopedLock<AdaptiveMutex> l{ sync };
 			actors.emplace(actor);
 			actors_map.insert(std::make_pair(physx_actor, actor));
 		}
@@ -389,7 +389,7 @@ namespace era_engine::physics
 		using namespace physx;
 
 		{
-			ScopedSpinLock l{ sync };
+			ScopedLock<AdaptiveMutex> l{ sync };
 			actors.erase(actor);
 			actors_map.erase(actor->get_rigid_actor());
 		}
@@ -404,7 +404,7 @@ namespace era_engine::physics
 	void Physics::release_scene()
 	{
 		using namespace physx;
-		ScopedSpinLock l{ sync };
+		ScopedLock<AdaptiveMutex> l{ sync };
 
 		PxU32 size;
 		auto actors = scene->getActiveActors(size);
@@ -3,6 +3,7 @@
 #include "physics/body_component.h"
 
 #include "core/memory.h"
+#include "core/memory_tracking.h"
 #include "core/cpu_profiling.h"
 #include "core/log.h"
 
@@ -30,11 +31,20 @@ namespace era_engine::physics
 	void* PhysicsAllocatorCallback::allocate(size_t size, const char* type_name, const char* filename, int line)
 	{
 		PX_ASSERT(size < GB(1));
-		return _aligned_malloc(size, 16);
+		void* result = _aligned_malloc(size, 16);
+		if (result)
+		{
+			track_allocation(memory_tag_physics, size);
+		}
+		return result;
 	}
 
 	void PhysicsAllocatorCallback::deallocate(void* ptr)
 	{
+		if (ptr)
+		{
+			track_free(memory_tag_physics, _aligned_msize(ptr, 16, 0));
+		}
 		_aligned_free(ptr);
 	}
 
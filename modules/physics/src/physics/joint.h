@@ -18,6 +18,9 @@ namespace era_engine::physics
 	class ERA_PHYSICS_API JointComponent : public Component
 	{
 	public:
+		// Owns a PhysX joint, which is not re-created from a WorldSnapshot.
+		static constexpr bool snapshot_excluded = true;
+
 		enum JointState : uint8_t
 		{
 			ENABLED,
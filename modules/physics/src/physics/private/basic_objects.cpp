@@ -10,12 +10,29 @@ namespace era_engine::physics
 	RTTR_REGISTRATION
 	{
 		using namespace rttr;
+		impl::ensure_component_type_registered<PlaneComponent>();
+
 		rttr::registration::class_<PlaneComponent>("PlaneComponent")
 			.constructor<>();
 	}
 
 	PlaneComponent::PlaneComponent(ref<Entity::EcsData> _data, const vec3& _point, const vec3& _norm)
 		: Component(_data), point(_point), normal(_norm)
+	{
+		create_plane();
+	}
+
+	PlaneComponent::~PlaneComponent()
+	{
+	}
+
+	void PlaneComponent::restore_snapshot_state()
+	{
+		plane = nullptr;
+		create_plane();
+	}
+
+	void PlaneComponent::create_plane()
 	{
 		using namespace physx;
 
@@ -31,10 +48,6 @@ namespace era_engine::physics
 		physics->get_scene()->addActor(*plane);
 	}
 
-	PlaneComponent::~PlaneComponent()
-	{
-	}
-
 	void PlaneComponent::release()
 	{
 		using namespace physx;
@@ -18,6 +18,9 @@ namespace era_engine::physics
 	RTTR_REGISTRATION
 	{
 		using namespace rttr;
+		impl::ensure_component_type_registered<DynamicBodyComponent>();
+		impl::ensure_component_type_registered<StaticBodyComponent>();
+
 		rttr::registration::class_<BodyComponent>("BodyComponent")
 			.constructor<>();
 
@@ -87,23 +90,19 @@ namespace era_engine::physics
 		Component::release();
 	}
 
-	void BodyComponent::detach_shape(physx::PxShape* shape)
+	void BodyComponent::restore_snapshot_state()
 	{
-		if (actor != nullptr)
-		{
-			actor->detachShape(*shape);
-		}
+		actor = nullptr;
+		create_actor();
 	}
 
-	DynamicBodyComponent::DynamicBodyComponent(ref<Entity::EcsData> _data)
-		: BodyComponent(_data)
+	void BodyComponent::create_actor()
 	{
 		using namespace physx;
 
 		Entity entity = get_world()->get_entity(component_data->entity_handle);
 
 		auto& physicsRef = PhysicsHolder::physics_ref;
-		const auto& physics = physicsRef->get_physics();
 
 		auto& colliders = physicsRef->colliders_map[component_data->entity_handle];
 		if (colliders.empty())
@@ -113,7 +112,7 @@ namespace era_engine::physics
 		}
 
 		TransformComponent* transform = entity.get_component_if_exists<TransformComponent>();
-		transform->type = TransformComponent::DYNAMIC;
+
 		const vec3& pos = transform->transform.position;
 		PxVec3 pospx = create_PxVec3(pos);
 
@@ -122,7 +121,8 @@ namespace era_engine::physics
 
 		void* user_data = static_cast<void*>(component_data.get());
 
-		actor = PhysicsUtils::create_rigid_dynamic(PxTransform(pospx, rotpx), user_data);
+		actor = create_rigid_actor(PxTransform(pospx, rotpx), user_data);
+		ASSERT(actor != nullptr);
 
 		for (auto& coll : colliders)
 		{
@@ -137,6 +137,35 @@ namespace era_engine::physics
 		physicsRef->add_actor(this, actor);
 	}
 
+	physx::PxRigidActor* BodyComponent::create_rigid_actor(const physx::PxTransform& transform, void* user_data)
+	{
+		return nullptr;
+	}
+
+	void BodyComponent::detach_shape(physx::PxShape* shape)
+	{
+		if (actor != nullptr)
+		{
+			actor->detachShape(*shape);
+		}
+	}
+
+	DynamicBodyComponent::DynamicBodyComponent(ref<Entity::EcsData> _data)
+		: BodyComponent(_data)
+	{
+		Entity entity = get_world()->get_entity(component_data->entity_handle);
+
+		TransformComponent* transform = entity.get_component_if_exists<TransformComponent>();
+		transform->type = TransformComponent::DYNAMIC;
+
+		create_actor();
+	}
+
+	physx::PxRigidActor* DynamicBodyComponent::create_rigid_actor(const physx::PxTransform& transform, void* user_data)
+	{
+		return PhysicsUtils::create_rigid_dynamic(transform, user_data);
+	}
+
 	DynamicBodyComponent::~DynamicBodyComponent()
 	{
 	}
@@ -426,43 +455,12 @@ namespace era_engine::physics
 	StaticBodyComponent::StaticBodyComponent(ref<Entity::EcsData> _data)
 		: BodyComponent(_data)
 	{
-		using namespace physx;
-
-		Entity entity = get_world()->get_entity(component_data->entity_handle);
-
-		auto& physicsRef = PhysicsHolder::physics_ref;
-		const auto& physics = physicsRef->get_physics();
-
-		auto& colliders = physicsRef->colliders_map[component_data->entity_handle];
-		if (colliders.empty())
-		{
-			entity.add_component<CapsuleShapeComponent>(1.0f, 2.0f);
-			colliders.push_back(&entity.get_component<CapsuleShapeComponent>());
-		}
-
-		TransformComponent* transform = entity.get_component_if_exists<TransformComponent>();
-
-		const vec3& pos = transform->transform.position;
-		PxVec3 pospx = create_PxVec3(pos);
-
-		const quat& q = transform->transform.rotation;
-		PxQuat rotpx = create_PxQuat(q);
-
-		void* user_data = static_cast<void*>(component_data.get());
-
-		actor = PhysicsUtils::create_rigid_static(PxTransform(pospx, rotpx), user_data);
-
-		for (auto& coll : colliders)
-		{
-			PxShape* shape = coll->create_shape();
-			shape->userData = user_data;
-
-			actor->attachShape(*shape);
-		}
-
-		set_filter_mask(filter_group, filter_mask);
+		create_actor();
+	}
 
-		physicsRef->add_actor(this, actor);
+	physx::PxRigidActor* StaticBodyComponent::create_rigid_actor(const physx::PxTransform& transform, void* user_data)
+	{
+		return PhysicsUtils::create_rigid_static(transform, user_data);
 	}
 
 	StaticBodyComponent::~StaticBodyComponent()
@@ -13,6 +13,9 @@ namespace era_engine::physics
 	RTTR_REGISTRATION
 	{
 		using namespace rttr;
+		impl::ensure_component_type_registered<BoxCCTComponent>();
+		impl::ensure_component_type_registered<CapsuleCCTComponent>();
+
 		rttr::registration::class_<CCTBaseComponent>("CCTBaseComponent")
 			.constructor<>();
 
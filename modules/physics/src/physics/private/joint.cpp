@@ -65,6 +65,9 @@ namespace era_engine::physics
 	RTTR_REGISTRATION
 	{
 		using namespace rttr;
+		impl::ensure_component_type_registered<FixedJointComponent>();
+		impl::ensure_component_type_registered<RevoluteJointComponent>();
+		impl::ensure_component_type_registered<DistanceJointComponent>();
 
 		rttr::registration::enumeration<JointComponent::JointState>("JointState")
 		(
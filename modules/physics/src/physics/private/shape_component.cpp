@@ -14,6 +14,12 @@ namespace era_engine::physics
     RTTR_REGISTRATION
     {
         using namespace rttr;
+        impl::ensure_component_type_registered<BoxShapeComponent>();
+        impl::ensure_component_type_registered<SphereShapeComponent>();
+        impl::ensure_component_type_registered<CapsuleShapeComponent>();
+        impl::ensure_component_type_registered<TriangleMeshShapeComponent>();
+        impl::ensure_component_type_registered<ConvexMeshShapeComponent>();
+
         rttr::registration::class_<ShapeComponent>("ShapeComponent")
             .constructor<>();
 
@@ -64,6 +70,12 @@ namespace era_engine::physics
         PX_RELEASE(shape)
     }
 
+    void ShapeComponent::restore_snapshot_state()
+    {
+        shape = nullptr;
+        register_shape();
+    }
+
     void ShapeComponent::register_shape()
     {
         PhysicsHolder::physics_ref->add_shape_to_entity_data(this);
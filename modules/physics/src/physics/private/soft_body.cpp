@@ -9,6 +9,8 @@ namespace era_engine::physics
 	RTTR_REGISTRATION
 	{
 		using namespace rttr;
+		impl::ensure_component_type_registered<SoftBodyComponent>();
+
 		rttr::registration::class_<SoftBodyComponent>("SoftBodyComponent")
 			.constructor<>();
 	}
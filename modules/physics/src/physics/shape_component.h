@@ -39,6 +39,10 @@ namespace era_engine::physics
 
 		virtual void release() override;
 
+		// The copy from a WorldSnapshot shares the shape of its released original. It registers with Physics again, its body
+		// creates the new shape.
+		void restore_snapshot_state();
+
 		ERA_VIRTUAL_REFLECT(Component)
 
 	protected:
@@ -14,6 +14,9 @@ namespace era_engine::physics
 	class ERA_PHYSICS_API SoftBodyComponent : public Component
 	{
 	public:
+		// Owns PhysX objects that Physics tracks by pointer.
+		static constexpr bool snapshot_excluded = true;
+
 		SoftBodyComponent() = default;
 
 		SoftBodyComponent(ref<Entity::EcsData> _data);
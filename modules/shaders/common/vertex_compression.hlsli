@@ -0,0 +1,25 @@
+#ifndef VERTEX_COMPRESSION_HLSLI
+#define VERTEX_COMPRESSION_HLSLI
+
+// Decoders for the compressed vertex layouts of mesh_builder (see mesh_creation_flags_compressed).
+// Half-float UVs need no decoding, the input assembler already converts them to float.
+
+// Normals and tangents are octahedral encoded in R16G16_SNORM, so they arrive in [-1, 1]^2.
+static float3 decodeOctahedralVertexVector(float2 o)
+{
+	float3 v = float3(o, 1.f - abs(o.x) - abs(o.y));
+	if (v.z < 0.f)
+	{
+		float2 signs = float2(o.x >= 0.f ? 1.f : -1.f, o.y >= 0.f ? 1.f : -1.f);
+		v.xy = (1.f - abs(v.yx)) * signs;
+	}
+	return normalize(v);
+}
+
+// Positions are stored in R16G16B16A16_UNORM relative to the submesh's quantization box.
+static float3 dequantizeVertexPosition(float4 q, float3 boxMin, float3 boxExtent)
+{
+	return boxMin + q.xyz * boxExtent;
+}
+
+#endif